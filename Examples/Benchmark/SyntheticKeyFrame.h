@@ -0,0 +1,103 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNTHETICKEYFRAME_H
+#define SYNTHETICKEYFRAME_H
+
+#include<cstdlib>
+#include<cstring>
+#include<cmath>
+
+#include<KeyFrameCodec.h>
+
+inline float Uniform(float a, float b)
+{
+    return a + (b-a)*(rand()/(float)RAND_MAX);
+}
+
+// Keyframe with the layout of a KITTI stereo keyframe: random keypoints, descriptors and words,
+// a fraction of them with a map point
+inline void MakeKeyFrame(int N, float fMapPointRatio, ORB_SLAM2::RemoteKeyFrame &kf)
+{
+    kf.mnRobotId = 1;
+    kf.mSymbolChr = 'b';
+    kf.mnSymbolIndex = 1234;
+    kf.mfMinScore = 0.02f;
+
+    kf.fx = kf.fy = 718.856f;
+    kf.cx = 607.193f;
+    kf.cy = 185.216f;
+    kf.mK = cv::Mat::eye(3,3,CV_32F);
+    kf.mTcw = cv::Mat::eye(3,4,CV_32F);
+
+    kf.mnMinX = 0; kf.mnMinY = 0; kf.mnMaxX = 1241; kf.mnMaxY = 376;
+    kf.mfGridElementWidthInv = 64/kf.mnMaxX;
+    kf.mfGridElementHeightInv = 48/kf.mnMaxY;
+
+    kf.mnScaleLevels = 8;
+    kf.mfLogScaleFactor = log(1.2f);
+    float scale = 1;
+    for(int i=0; i<kf.mnScaleLevels; i++, scale*=1.2f)
+    {
+        kf.mvScaleFactors.push_back(scale);
+        kf.mvLevelSigma2.push_back(scale*scale);
+        kf.mvInvLevelSigma2.push_back(1.0f/(scale*scale));
+    }
+
+    kf.mDescriptors = cv::Mat(N,32,CV_8U);
+    kf.mStorage = cv::Mat::zeros(N,32,CV_8U);
+    kf.mWorldPositions = cv::Mat(N,3,CV_32F,cv::Scalar(-1));
+    kf.mvIndices.assign(N,-1);
+    kf.mvWorldPoints.resize(N);
+    kf.mvMaxDistanceInvariance.assign(N,-1);
+    kf.mvMinDistanceInvariance.assign(N,-1);
+    kf.mvPointDescriptors.resize(N);
+
+    for(int i=0; i<N; i++)
+    {
+        cv::KeyPoint kp;
+        kp.pt.x = Uniform(0,kf.mnMaxX);
+        kp.pt.y = Uniform(0,kf.mnMaxY);
+        kp.angle = Uniform(0,360);
+        kp.octave = rand()%kf.mnScaleLevels;
+        kp.size = 31*kf.mvScaleFactors[kp.octave];
+        kf.mvKeysUn.push_back(kp);
+
+        for(int j=0; j<32; j++)
+            kf.mDescriptors.at<unsigned char>(i,j) = rand() & 0xff;
+
+        kf.mBowVec.addWeight(rand()%1000000, Uniform(0,1e-3f));
+        kf.mFeatVec.addFeature(rand()%10000, i);
+
+        if(Uniform(0,1)<fMapPointRatio)
+        {
+            kf.mvIndices[i] = i;
+            for(int d=0; d<3; d++)
+                kf.mWorldPositions.at<float>(i,d) = Uniform(-50,50);
+            kf.mvMaxDistanceInvariance[i] = Uniform(10,60);
+            kf.mvMinDistanceInvariance[i] = Uniform(0.5f,5);
+            memcpy(kf.mStorage.ptr<unsigned char>(i),kf.mDescriptors.ptr<unsigned char>(i),32);
+        }
+        kf.mvWorldPoints[i] = cv::Mat(3,1,CV_32F,kf.mWorldPositions.ptr<float>(i));
+        kf.mvPointDescriptors[i] = kf.mStorage.row(i);
+    }
+}
+
+#endif // SYNTHETICKEYFRAME_H
@@ -0,0 +1,137 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include<iostream>
+#include<iomanip>
+#include<chrono>
+#include<vector>
+#include<cstdlib>
+#include<algorithm>
+
+#include<HammingDistance.h>
+
+using namespace std;
+
+// Implementation of ORBmatcher::DescriptorDistance before HammingDistance
+int BaselineDistance(const uint8_t *a, const uint8_t *b)
+{
+    const int *pa = (const int*)a;
+    const int *pb = (const int*)b;
+
+    int dist=0;
+
+    for(int i=0; i<8; i++, pa++, pb++)
+    {
+        unsigned  int v = *pa ^ *pb;
+        v = v - ((v >> 1) & 0x55555555);
+        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+    }
+
+    return dist;
+}
+
+double Seconds(const chrono::steady_clock::time_point &t1, const chrono::steady_clock::time_point &t2)
+{
+    return chrono::duration_cast<chrono::duration<double> >(t2-t1).count();
+}
+
+int main(int argc, char **argv)
+{
+    // Sizes similar to a frame: a few thousand keypoints matched against local map points
+    const int nA = argc>1 ? atoi(argv[1]) : 1000;
+    const int nB = argc>2 ? atoi(argv[2]) : 2000;
+    const int nRepetitions = argc>3 ? atoi(argv[3]) : 20;
+    const int D = ORB_SLAM2::HammingDistance::DESCRIPTOR_BYTES;
+
+    vector<uint8_t> vA(nA*D), vB(nB*D);
+    srand(0);
+    for(size_t i=0; i<vA.size(); i++)
+        vA[i] = rand() & 0xff;
+    for(size_t i=0; i<vB.size(); i++)
+        vB[i] = rand() & 0xff;
+
+    // Single distances are computed in the order of a shuffled index list, as the candidates
+    // returned by GetFeaturesInArea, so that the compiler cannot vectorize across calls
+    vector<int> vIndices(nB);
+    for(int j=0; j<nB; j++)
+        vIndices[j] = j;
+    for(int j=nB-1; j>0; j--)
+        swap(vIndices[j],vIndices[rand()%(j+1)]);
+
+    const double nDistances = (double)nA*nB*nRepetitions;
+    vector<int> vReference(nA*nB), vDists(nA*nB);
+
+    // Baseline
+    long checksum = 0;
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    for(int r=0; r<nRepetitions; r++)
+        for(int i=0; i<nA; i++)
+            for(int l=0; l<nB; l++)
+            {
+                const int j = vIndices[l];
+                checksum += vReference[i*nB+j] = BaselineDistance(&vA[i*D],&vB[j*D]);
+            }
+    chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+    const double tBaseline = Seconds(t1,t2);
+
+    cout << "Descriptors: " << nA << " x " << nB << ", repetitions: " << nRepetitions << " (checksum " << checksum << ")" << endl;
+    cout << fixed << setprecision(2);
+    cout << setw(10) << "kernel" << setw(16) << "single Mdist/s" << setw(16) << "batched Mdist/s"
+         << setw(10) << "speedup" << setw(10) << "correct" << endl;
+    cout << setw(10) << "baseline" << setw(16) << nDistances/tBaseline*1e-6 << setw(16) << "-"
+         << setw(10) << 1.0 << setw(10) << "yes" << endl;
+
+    const vector<string> vKernels = ORB_SLAM2::HammingDistance::AvailableKernels();
+    for(size_t k=0; k<vKernels.size(); k++)
+    {
+        ORB_SLAM2::HammingDistance::SetKernel(vKernels[k]);
+
+        // One call per pair to the pair distance of the kernel. ORBmatcher::DescriptorDistance
+        // inlines its own when the build targets POPCNT, which would be the same for every kernel
+        const ORB_SLAM2::HammingDistance::DistanceFunction pDistance = ORB_SLAM2::HammingDistance::KernelDistance();
+        bool bCorrect = true;
+        t1 = chrono::steady_clock::now();
+        for(int r=0; r<nRepetitions; r++)
+            for(int i=0; i<nA; i++)
+                for(int l=0; l<nB; l++)
+                {
+                    const int j = vIndices[l];
+                    vDists[i*nB+j] = pDistance(&vA[i*D],&vB[j*D]);
+                }
+        t2 = chrono::steady_clock::now();
+        const double tSingle = Seconds(t1,t2);
+        bCorrect = bCorrect && vDists==vReference;
+
+        // Batched, as ORBmatcher::DescriptorDistances
+        t1 = chrono::steady_clock::now();
+        for(int r=0; r<nRepetitions; r++)
+            ORB_SLAM2::HammingDistance::ManyToMany(&vA[0],D,nA,&vB[0],D,nB,&vDists[0]);
+        t2 = chrono::steady_clock::now();
+        const double tBatched = Seconds(t1,t2);
+        bCorrect = bCorrect && vDists==vReference;
+
+        cout << setw(10) << vKernels[k] << setw(16) << nDistances/tSingle*1e-6 << setw(16) << nDistances/tBatched*1e-6
+             << setw(10) << tBaseline/min(tSingle,tBatched) << setw(10) << (bCorrect ? "yes" : "NO") << endl;
+    }
+
+    return 0;
+}
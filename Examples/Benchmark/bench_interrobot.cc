@@ -0,0 +1,217 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include<iostream>
+#include<iomanip>
+#include<chrono>
+#include<vector>
+#include<map>
+#include<mutex>
+#include<memory>
+#include<cstdlib>
+#include<algorithm>
+
+#include<KeyFrameCodec.h>
+#include<LoopbackTransport.h>
+
+#include "SyntheticKeyFrame.h"
+
+using namespace std;
+using ORB_SLAM2::InterRobotTransport;
+using ORB_SLAM2::KeyFrameCodec;
+
+typedef chrono::steady_clock::time_point TimePoint;
+
+double Seconds(const TimePoint &t1, const TimePoint &t2)
+{
+    return chrono::duration_cast<chrono::duration<double> >(t2-t1).count();
+}
+
+// Latencies between a request and the reception of the keyframe requested, for all robots
+class LatencyLog
+{
+public:
+    LatencyLog(): mnInvalid(0) {}
+
+    void Requested(int robotID, int targetRobotID, uint64_t index)
+    {
+        unique_lock<mutex> lock(mMutex);
+        mmPending[MakeKey(robotID,targetRobotID,index)] = chrono::steady_clock::now();
+    }
+
+    void Received(int robotID, int targetRobotID, uint64_t index, bool bValid)
+    {
+        const TimePoint t = chrono::steady_clock::now();
+        unique_lock<mutex> lock(mMutex);
+        map<Key,TimePoint>::iterator it = mmPending.find(MakeKey(robotID,targetRobotID,index));
+        if(it==mmPending.end())
+            return;
+        mvLatencies.push_back(Seconds(it->second,t));
+        mmPending.erase(it);
+        if(!bValid)
+            mnInvalid++;
+    }
+
+    vector<double> mvLatencies;
+    unsigned long mnInvalid;
+
+protected:
+    typedef pair<pair<int,int>,uint64_t> Key;
+    static Key MakeKey(int a, int b, uint64_t index) { return make_pair(make_pair(a,b),index); }
+
+    mutex mMutex;
+    map<Key,TimePoint> mmPending;
+};
+
+// Robot exchanging keyframes as LoopClosingInterRobot does: it publishes the summary of each of
+// its keyframes, requests one out of nRequestPeriod summaries it receives as if a loop candidate
+// was found, answers the requests for its keyframes and decodes the keyframes it requested
+class Robot
+{
+public:
+    Robot(int robotID, ORB_SLAM2::LoopbackHub* pHub, const ORB_SLAM2::RemoteKeyFrame &kf, int nRequestPeriod, LatencyLog* pLog):
+        mnRobotID(robotID), mTransport(pHub), mKeyFrame(kf), mnRequestPeriod(nRequestPeriod), mpLog(pLog)
+    {
+        mKeyFrame.mnRobotId = robotID;
+        mTransport.Subscribe(InterRobotTransport::KEYFRAME_SUMMARY, [this](const InterRobotTransport::Message &msg){ OnSummary(msg); });
+        mTransport.Subscribe(InterRobotTransport::KEYFRAME_REQUEST, [this](const InterRobotTransport::Message &msg){ OnRequest(msg); });
+        mTransport.Subscribe(InterRobotTransport::KEYFRAME, [this](const InterRobotTransport::Message &msg){ OnKeyFrame(msg); });
+    }
+
+    void PublishKeyFrame(uint64_t index)
+    {
+        ORB_SLAM2::RemoteKeyFrame summary;
+        summary.mnRobotId = mnRobotID;
+        summary.mSymbolChr = mKeyFrame.mSymbolChr;
+        summary.mnSymbolIndex = index;
+        summary.mfMinScore = mKeyFrame.mfMinScore;
+        summary.mBowVec = mKeyFrame.mBowVec;
+
+        vector<unsigned char> vBuffer;
+        KeyFrameCodec::EncodeSummary(summary,vBuffer);
+        mTransport.Publish(InterRobotTransport::KEYFRAME_SUMMARY,vBuffer);
+    }
+
+protected:
+    void OnSummary(const InterRobotTransport::Message &msg)
+    {
+        ORB_SLAM2::RemoteKeyFrame summary;
+        if(!KeyFrameCodec::DecodeSummary(msg->data(),msg->size(),summary) || summary.mnSymbolIndex%mnRequestPeriod!=0)
+            return;
+
+        mpLog->Requested(mnRobotID,summary.mnRobotId,summary.mnSymbolIndex);
+        vector<unsigned char> vBuffer;
+        KeyFrameCodec::EncodeRequest(mnRobotID,summary.mnRobotId,summary.mnSymbolIndex,vBuffer);
+        mTransport.Publish(InterRobotTransport::KEYFRAME_REQUEST,vBuffer);
+    }
+
+    void OnRequest(const InterRobotTransport::Message &msg)
+    {
+        int robotID, targetRobotID;
+        uint64_t index;
+        if(KeyFrameCodec::PeekTargetRobotId(msg->data(),msg->size())!=mnRobotID ||
+           !KeyFrameCodec::DecodeRequest(msg->data(),msg->size(),robotID,targetRobotID,index))
+            return;
+
+        mKeyFrame.mnSymbolIndex = index;
+        vector<unsigned char> vBuffer;
+        KeyFrameCodec::Encode(mKeyFrame,robotID,false,vBuffer);
+        mTransport.Publish(InterRobotTransport::KEYFRAME,vBuffer);
+    }
+
+    void OnKeyFrame(const InterRobotTransport::Message &msg)
+    {
+        if(KeyFrameCodec::PeekTargetRobotId(msg->data(),msg->size())!=mnRobotID)
+            return;
+
+        ORB_SLAM2::RemoteKeyFrame kf;
+        const bool bValid = KeyFrameCodec::Decode(msg->data(),msg->size(),kf);
+        mpLog->Received(mnRobotID,kf.mnRobotId,kf.mnSymbolIndex,bValid && kf.mvKeysUn.size()==mKeyFrame.mvKeysUn.size());
+    }
+
+    int mnRobotID;
+    ORB_SLAM2::LoopbackTransport mTransport;
+    ORB_SLAM2::RemoteKeyFrame mKeyFrame;
+    int mnRequestPeriod;
+    LatencyLog* mpLog;
+};
+
+int main(int argc, char **argv)
+{
+    const int nRobots = argc>1 ? atoi(argv[1]) : 4;
+    const int nKeyFrames = argc>2 ? atoi(argv[2]) : 200;
+    const int nRequestPeriod = argc>3 ? max(1,atoi(argv[3])) : 10;
+    const int N = argc>4 ? atoi(argv[4]) : 2000;
+
+    srand(0);
+    ORB_SLAM2::RemoteKeyFrame kf;
+    MakeKeyFrame(N,0.5f,kf);
+
+    ORB_SLAM2::LoopbackHub hub;
+    LatencyLog log;
+    vector<unique_ptr<Robot> > vpRobots;
+    for(int i=0; i<nRobots; i++)
+        vpRobots.push_back(unique_ptr<Robot>(new Robot(i,&hub,kf,nRequestPeriod,&log)));
+
+    // Robots insert keyframes in turns, as fast as they can be published
+    const TimePoint t1 = chrono::steady_clock::now();
+    for(int k=0; k<nKeyFrames; k++)
+        for(int i=0; i<nRobots; i++)
+            vpRobots[i]->PublishKeyFrame(k);
+    hub.Flush();
+    const TimePoint t2 = chrono::steady_clock::now();
+    const double tTotal = Seconds(t1,t2);
+
+    const ORB_SLAM2::LoopbackHub::Stats stats = hub.GetStats();
+    const char* vChannels[InterRobotTransport::NUM_CHANNELS] = {"summary", "request", "keyframe"};
+    unsigned long nTotalBytes = 0;
+
+    cout << "Robots: " << nRobots << ", keyframes per robot: " << nKeyFrames << ", one request every "
+         << nRequestPeriod << " summaries, keypoints: " << N << endl;
+    cout << fixed << setprecision(2);
+    cout << setw(10) << "channel" << setw(12) << "messages" << setw(14) << "MB" << setw(14) << "B/message" << endl;
+    for(int c=0; c<InterRobotTransport::NUM_CHANNELS; c++)
+    {
+        nTotalBytes += stats.nBytes[c];
+        cout << setw(10) << vChannels[c] << setw(12) << stats.nMessages[c] << setw(14) << stats.nBytes[c]*1e-6
+             << setw(14) << (stats.nMessages[c] ? stats.nBytes[c]/(double)stats.nMessages[c] : 0.0) << endl;
+    }
+
+    // Broadcasting full keyframes sends every keyframe once in full
+    const double nBroadcastBytes = (double)nRobots*nKeyFrames*
+            (stats.nMessages[InterRobotTransport::KEYFRAME] ? stats.nBytes[InterRobotTransport::KEYFRAME]/(double)stats.nMessages[InterRobotTransport::KEYFRAME] : 0.0);
+    cout << "Published: " << nTotalBytes*1e-6 << " MB (full broadcast: " << nBroadcastBytes*1e-6 << " MB)" << endl;
+    cout << "Keyframes/s: " << nRobots*nKeyFrames/tTotal << " (" << tTotal << " s)" << endl;
+
+    vector<double> &vLatencies = log.mvLatencies;
+    if(!vLatencies.empty())
+    {
+        sort(vLatencies.begin(),vLatencies.end());
+        double total = 0;
+        for(size_t i=0; i<vLatencies.size(); i++)
+            total += vLatencies[i];
+        cout << "Request latency (ms) mean/median/max: " << 1e3*total/vLatencies.size() << "/"
+             << 1e3*vLatencies[vLatencies.size()/2] << "/" << 1e3*vLatencies.back()
+             << ", invalid keyframes: " << log.mnInvalid << endl;
+    }
+
+    return 0;
+}
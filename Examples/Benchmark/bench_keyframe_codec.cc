@@ -0,0 +1,131 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include<iostream>
+#include<iomanip>
+#include<chrono>
+#include<vector>
+#include<cstdlib>
+#include<cmath>
+#include<cstring>
+
+#include<KeyFrameCodec.h>
+
+#include "SyntheticKeyFrame.h"
+
+using namespace std;
+
+double Seconds(const chrono::steady_clock::time_point &t1, const chrono::steady_clock::time_point &t2)
+{
+    return chrono::duration_cast<chrono::duration<double> >(t2-t1).count();
+}
+
+// Size of the keyframe in the former distributed_mapper_msgs::Keyframe message: every field of the
+// keypoints as 32 bit values, words as uint32+float64, indices as uint32, the descriptors as two
+// images and all the per keypoint map point fields
+size_t FormerMessageBytes(const ORB_SLAM2::RemoteKeyFrame &kf)
+{
+    const size_t N = kf.mvKeysUn.size();
+    size_t bytes = 4*N*7 + 12*kf.mBowVec.size() + 4*kf.mFeatVec.size();
+    for(DBoW2::FeatureVector::const_iterator it=kf.mFeatVec.begin(); it!=kf.mFeatVec.end(); it++)
+        bytes += 4 + 4*it->second.size();
+    bytes += 2*(32*N + 64);
+    bytes += 4*N*(1+3+1+1);
+    return bytes;
+}
+
+int main(int argc, char **argv)
+{
+    const int N = argc>1 ? atoi(argv[1]) : 2000;
+    const float fMapPointRatio = argc>2 ? atof(argv[2]) : 0.5f;
+    const int nRepetitions = argc>3 ? atoi(argv[3]) : 200;
+
+    srand(0);
+    ORB_SLAM2::RemoteKeyFrame kf;
+    MakeKeyFrame(N,fMapPointRatio,kf);
+    const size_t nFormer = FormerMessageBytes(kf);
+
+    cout << "Keypoints: " << N << ", map points: " << fMapPointRatio*100 << "%, repetitions: " << nRepetitions << endl;
+    cout << fixed << setprecision(2);
+    cout << setw(12) << "encoding" << setw(10) << "bytes" << setw(10) << "B/kp" << setw(10) << "ratio"
+         << setw(12) << "encode us" << setw(12) << "decode us" << setw(12) << "dec MB/s" << setw(10) << "correct" << endl;
+    cout << setw(12) << "former" << setw(10) << nFormer << setw(10) << nFormer/(double)N << setw(10) << 1.0
+         << setw(12) << "-" << setw(12) << "-" << setw(12) << "-" << setw(10) << "-" << endl;
+
+    // Summary sent for every keyframe, the full keyframe is only sent on request
+    {
+        vector<unsigned char> vBuffer;
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+        for(int r=0; r<nRepetitions; r++)
+            ORB_SLAM2::KeyFrameCodec::EncodeSummary(kf,vBuffer);
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+        const double tEncode = Seconds(t1,t2)/nRepetitions;
+
+        ORB_SLAM2::RemoteKeyFrame decoded;
+        bool bCorrect = true;
+        t1 = chrono::steady_clock::now();
+        for(int r=0; r<nRepetitions; r++)
+            bCorrect = ORB_SLAM2::KeyFrameCodec::DecodeSummary(&vBuffer[0],vBuffer.size(),decoded) && bCorrect;
+        t2 = chrono::steady_clock::now();
+        const double tDecode = Seconds(t1,t2)/nRepetitions;
+        bCorrect = bCorrect && decoded.mnSymbolIndex==kf.mnSymbolIndex && decoded.mBowVec.size()==kf.mBowVec.size();
+
+        cout << setw(12) << "summary" << setw(10) << vBuffer.size()
+             << setw(10) << vBuffer.size()/(double)N << setw(10) << nFormer/(double)vBuffer.size()
+             << setw(12) << tEncode*1e6 << setw(12) << tDecode*1e6 << setw(12) << vBuffer.size()/tDecode*1e-6
+             << setw(10) << (bCorrect ? "yes" : "NO") << endl;
+    }
+
+    for(int c=0; c<2; c++)
+    {
+        const bool bCompress = c==1;
+        vector<unsigned char> vBuffer;
+
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+        for(int r=0; r<nRepetitions; r++)
+            ORB_SLAM2::KeyFrameCodec::Encode(kf,-1,bCompress,vBuffer);
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+        const double tEncode = Seconds(t1,t2)/nRepetitions;
+
+        ORB_SLAM2::RemoteKeyFrame decoded;
+        bool bCorrect = true;
+        t1 = chrono::steady_clock::now();
+        for(int r=0; r<nRepetitions; r++)
+            bCorrect = ORB_SLAM2::KeyFrameCodec::Decode(&vBuffer[0],vBuffer.size(),decoded) && bCorrect;
+        t2 = chrono::steady_clock::now();
+        const double tDecode = Seconds(t1,t2)/nRepetitions;
+
+        // Lossless fields, positions within the quantization step
+        bCorrect = bCorrect && decoded.mvIndices==kf.mvIndices && decoded.mFeatVec==kf.mFeatVec;
+        for(int i=0; bCorrect && i<N; i++)
+            bCorrect = fabs(decoded.mvKeysUn[i].pt.x-kf.mvKeysUn[i].pt.x)<=1.0f/16 &&
+                       fabs(decoded.mvKeysUn[i].pt.y-kf.mvKeysUn[i].pt.y)<=1.0f/16 &&
+                       decoded.mvKeysUn[i].octave==kf.mvKeysUn[i].octave &&
+                       memcmp(decoded.mDescriptors.ptr<unsigned char>(i),kf.mDescriptors.ptr<unsigned char>(i),32)==0;
+
+        cout << setw(12) << (bCompress ? "compressed" : "binary") << setw(10) << vBuffer.size()
+             << setw(10) << vBuffer.size()/(double)N << setw(10) << nFormer/(double)vBuffer.size()
+             << setw(12) << tEncode*1e6 << setw(12) << tDecode*1e6 << setw(12) << vBuffer.size()/tDecode*1e-6
+             << setw(10) << (bCorrect ? "yes" : "NO") << endl;
+    }
+
+    return 0;
+}
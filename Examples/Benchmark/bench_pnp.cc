@@ -0,0 +1,136 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include<iostream>
+#include<iomanip>
+#include<chrono>
+#include<vector>
+#include<cstdlib>
+#include<cmath>
+#include<algorithm>
+
+#include<PnPsolver.h>
+
+using namespace std;
+
+double Seconds(const chrono::steady_clock::time_point &t1, const chrono::steady_clock::time_point &t2)
+{
+    return chrono::duration_cast<chrono::duration<double> >(t2-t1).count();
+}
+
+double Uniform(double a, double b)
+{
+    return a + (b-a)*rand()/(double)RAND_MAX;
+}
+
+int main(int argc, char **argv)
+{
+    // Sizes similar to a relocalization candidate: a few hundred BoW matches, many of them wrong
+    const int nPoints = argc>1 ? atoi(argv[1]) : 300;
+    const float fOutlierRatio = argc>2 ? atof(argv[2]) : 0.3f;
+    const int nHypotheses = argc>3 ? atoi(argv[3]) : 20000;
+    const float fx = 500.f, fy = 500.f, cx = 320.f, cy = 240.f;
+
+    srand(0);
+
+    // Ground truth pose Tcw: small rotation around the optical axis plus translation
+    const double theta = 0.1;
+    const double Rcw[3][3] = {{cos(theta),-sin(theta),0},{sin(theta),cos(theta),0},{0,0,1}};
+    const double tcw[3] = {0.1,-0.2,0.3};
+
+    vector<cv::Point3f> vP3Dw(nPoints);
+    vector<cv::Point2f> vP2D(nPoints);
+    vector<float> vSigma2(nPoints,1.f);
+    int nOutliers = 0;
+    for(int i=0; i<nPoints; i++)
+    {
+        const double xc = Uniform(-2,2), yc = Uniform(-1.5,1.5), zc = Uniform(2,8);
+
+        // Pw = Rcw^T (Pc - tcw)
+        const double d[3] = {xc-tcw[0],yc-tcw[1],zc-tcw[2]};
+        vP3Dw[i] = cv::Point3f(Rcw[0][0]*d[0]+Rcw[1][0]*d[1]+Rcw[2][0]*d[2],
+                               Rcw[0][1]*d[0]+Rcw[1][1]*d[1]+Rcw[2][1]*d[2],
+                               Rcw[0][2]*d[0]+Rcw[1][2]*d[1]+Rcw[2][2]*d[2]);
+
+        if(Uniform(0,1)<fOutlierRatio)
+        {
+            vP2D[i] = cv::Point2f(Uniform(0,2*cx),Uniform(0,2*cy));
+            nOutliers++;
+        }
+        else
+            vP2D[i] = cv::Point2f(fx*xc/zc+cx+Uniform(-0.5,0.5),fy*yc/zc+cy+Uniform(-0.5,0.5));
+    }
+
+    cout << "Correspondences: " << nPoints << ", outliers: " << nOutliers << ", hypotheses: " << nHypotheses << endl;
+    cout << fixed << setprecision(2);
+
+    // Hypothesis throughput: an unreachable inlier threshold makes every iteration
+    // run minimal solver plus inlier check, without early termination or refinement
+    {
+        ORB_SLAM2::PnPsolver solver(vP3Dw,vP2D,vSigma2,fx,fy,cx,cy);
+        solver.SetRansacParameters(0.99,nPoints,nHypotheses,4,1.0f,5.991);
+
+        bool bNoMore;
+        vector<bool> vbInliers;
+        int nInliers;
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+        solver.iterate(nHypotheses,bNoMore,vbInliers,nInliers);
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+
+        cout << "RANSAC iterations/s: " << nHypotheses/Seconds(t1,t2) << endl;
+    }
+
+    // Full solve with the relocalization parameters, checked against the ground truth
+    {
+        const int nRepetitions = 100;
+        double tTotal = 0, maxError = 0;
+        int nSolved = 0;
+        for(int r=0; r<nRepetitions; r++)
+        {
+            ORB_SLAM2::PnPsolver solver(vP3Dw,vP2D,vSigma2,fx,fy,cx,cy);
+            solver.SetRansacParameters(0.99,10,300,4,0.5,5.991);
+
+            vector<bool> vbInliers;
+            int nInliers;
+            chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+            cv::Mat Tcw = solver.find(vbInliers,nInliers);
+            chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+            tTotal += Seconds(t1,t2);
+
+            if(Tcw.empty())
+                continue;
+
+            nSolved++;
+            for(int i=0; i<3; i++)
+            {
+                for(int j=0; j<3; j++)
+                    maxError = max(maxError,fabs(Tcw.at<float>(i,j)-Rcw[i][j]));
+                maxError = max(maxError,fabs(Tcw.at<float>(i,3)-tcw[i]));
+            }
+        }
+
+        cout << "find(): " << 1e3*tTotal/nRepetitions << " ms, solved " << nSolved << "/" << nRepetitions
+             << setprecision(5) << ", max pose error " << maxError << endl;
+    }
+
+    return 0;
+}
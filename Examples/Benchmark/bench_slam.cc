@@ -0,0 +1,659 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include<iostream>
+#include<algorithm>
+#include<fstream>
+#include<sstream>
+#include<iomanip>
+#include<chrono>
+#include<thread>
+#include<deque>
+#include<cstdlib>
+#include<cmath>
+
+#include<sys/resource.h>
+
+#include<opencv2/core/core.hpp>
+#include<opencv2/highgui/highgui.hpp>
+#include<opencv2/imgproc/imgproc.hpp>
+
+#include<Eigen/Core>
+#include<Eigen/Geometry>
+
+#include<System.h>
+#include<ImageReader.h>
+
+using namespace std;
+
+// Offline benchmark over KITTI, EuRoC and TUM sequences. Frames are either decoded up front
+// (--preload) or by ImageReader threads a few frames ahead, so that image decoding is not part
+// of the measured time. Results are written as JSON.
+
+enum eDataset
+{
+    KITTI_MONO,
+    KITTI_STEREO,
+    EUROC_MONO,
+    EUROC_STEREO,
+    TUM_MONO,
+    TUM_RGBD
+};
+
+struct Sequence
+{
+    eDataset dataset;
+    vector<string> vstrImages1;
+    vector<string> vstrImages2;
+    vector<double> vTimestamps;
+
+    // EuRoC stereo rectification
+    cv::Mat M1l, M2l, M1r, M2r;
+};
+
+struct InputFrame
+{
+    cv::Mat im1;
+    cv::Mat im2;
+    double timestamp;
+};
+
+struct Options
+{
+    Options(): bRealTime(false), bPreload(false), bViewer(false), bPipelined(false), nMaxFrames(-1), nPrefetch(8), nReaderThreads(2),
+        nGrowthPeriod(50), strOutput("bench_results.json") {}
+
+    bool bRealTime;
+    bool bPreload;
+    bool bViewer;
+    bool bPipelined;
+    int nMaxFrames;
+    int nPrefetch;
+    int nReaderThreads;
+    int nGrowthPeriod;
+    string strGroundTruth;
+    string strAssociations;
+    string strOutput;
+};
+
+bool SubmitFrame(ORB_SLAM2::System &SLAM, ORB_SLAM2::System::eSensor sensor, const InputFrame &frame)
+{
+    if(sensor==ORB_SLAM2::System::MONOCULAR)
+        return SLAM.SubmitMonocular(frame.im1,frame.timestamp);
+    else if(sensor==ORB_SLAM2::System::STEREO)
+        return SLAM.SubmitStereo(frame.im1,frame.im2,frame.timestamp);
+    else
+        return SLAM.SubmitRGBD(frame.im1,frame.im2,frame.timestamp);
+}
+
+double Seconds(const chrono::steady_clock::time_point &t1, const chrono::steady_clock::time_point &t2)
+{
+    return chrono::duration_cast<chrono::duration<double> >(t2-t1).count();
+}
+
+bool LoadKITTI(const string &strPath, bool bStereo, Sequence &seq)
+{
+    ifstream fTimes((strPath+"/times.txt").c_str());
+    string s;
+    while(getline(fTimes,s))
+    {
+        if(s.empty())
+            continue;
+        stringstream ss(s);
+        double t;
+        ss >> t;
+        seq.vTimestamps.push_back(t);
+    }
+
+    for(size_t i=0; i<seq.vTimestamps.size(); i++)
+    {
+        stringstream ss;
+        ss << setfill('0') << setw(6) << i << ".png";
+        seq.vstrImages1.push_back(strPath+"/image_0/"+ss.str());
+        if(bStereo)
+            seq.vstrImages2.push_back(strPath+"/image_1/"+ss.str());
+    }
+    return !seq.vTimestamps.empty();
+}
+
+// strPath is the mav0 folder. Timestamps and filenames come from cam0/data.csv
+bool LoadEuRoC(const string &strPath, const string &strSettings, bool bStereo, Sequence &seq)
+{
+    ifstream fData((strPath+"/cam0/data.csv").c_str());
+    string s;
+    while(getline(fData,s))
+    {
+        if(s.empty() || s[0]=='#')
+            continue;
+        const size_t comma = s.find(',');
+        if(comma==string::npos)
+            continue;
+        string strName = s.substr(comma+1);
+        strName.erase(strName.find_last_not_of(" \r\n")+1);
+        seq.vTimestamps.push_back(atof(s.substr(0,comma).c_str())/1e9);
+        seq.vstrImages1.push_back(strPath+"/cam0/data/"+strName);
+        if(bStereo)
+            seq.vstrImages2.push_back(strPath+"/cam1/data/"+strName);
+    }
+
+    if(!bStereo)
+        return !seq.vTimestamps.empty();
+
+    cv::FileStorage fsSettings(strSettings, cv::FileStorage::READ);
+    if(!fsSettings.isOpened())
+    {
+        cerr << "ERROR: Wrong path to settings" << endl;
+        return false;
+    }
+
+    cv::Mat K_l, K_r, P_l, P_r, R_l, R_r, D_l, D_r;
+    fsSettings["LEFT.K"] >> K_l;
+    fsSettings["RIGHT.K"] >> K_r;
+    fsSettings["LEFT.P"] >> P_l;
+    fsSettings["RIGHT.P"] >> P_r;
+    fsSettings["LEFT.R"] >> R_l;
+    fsSettings["RIGHT.R"] >> R_r;
+    fsSettings["LEFT.D"] >> D_l;
+    fsSettings["RIGHT.D"] >> D_r;
+
+    int rows_l = fsSettings["LEFT.height"];
+    int cols_l = fsSettings["LEFT.width"];
+    int rows_r = fsSettings["RIGHT.height"];
+    int cols_r = fsSettings["RIGHT.width"];
+
+    if(K_l.empty() || K_r.empty() || P_l.empty() || P_r.empty() || R_l.empty() || R_r.empty() || D_l.empty() || D_r.empty() ||
+            rows_l==0 || rows_r==0 || cols_l==0 || cols_r==0)
+    {
+        cerr << "ERROR: Calibration parameters to rectify stereo are missing!" << endl;
+        return false;
+    }
+
+    cv::initUndistortRectifyMap(K_l,D_l,R_l,P_l.rowRange(0,3).colRange(0,3),cv::Size(cols_l,rows_l),CV_32F,seq.M1l,seq.M2l);
+    cv::initUndistortRectifyMap(K_r,D_r,R_r,P_r.rowRange(0,3).colRange(0,3),cv::Size(cols_r,rows_r),CV_32F,seq.M1r,seq.M2r);
+
+    return !seq.vTimestamps.empty();
+}
+
+// Monocular reads rgb.txt, RGB-D an association file (timestamp rgb timestamp depth)
+bool LoadTUM(const string &strPath, const string &strAssociations, bool bRGBD, Sequence &seq)
+{
+    const string strList = bRGBD ? (strAssociations.empty() ? strPath+"/associations.txt" : strAssociations) : strPath+"/rgb.txt";
+    ifstream f(strList.c_str());
+    string s;
+    while(getline(f,s))
+    {
+        if(s.empty() || s[0]=='#')
+            continue;
+        stringstream ss(s);
+        double t;
+        string strRGB, strDepth;
+        ss >> t >> strRGB;
+        seq.vTimestamps.push_back(t);
+        seq.vstrImages1.push_back(strPath+"/"+strRGB);
+        if(bRGBD)
+        {
+            ss >> t >> strDepth;
+            seq.vstrImages2.push_back(strPath+"/"+strDepth);
+        }
+    }
+    return !seq.vTimestamps.empty();
+}
+
+struct Trajectory
+{
+    vector<double> vTimestamps;
+    vector<Eigen::Vector3d> vPositions;
+};
+
+// TUM format: timestamp tx ty tz qx qy qz qw
+bool LoadTrajectoryTUM(const string &strFile, Trajectory &traj)
+{
+    ifstream f(strFile.c_str());
+    string s;
+    while(getline(f,s))
+    {
+        if(s.empty() || s[0]=='#')
+            continue;
+        stringstream ss(s);
+        double t, x, y, z;
+        if(ss >> t >> x >> y >> z)
+        {
+            traj.vTimestamps.push_back(t);
+            traj.vPositions.push_back(Eigen::Vector3d(x,y,z));
+        }
+    }
+    return !traj.vTimestamps.empty();
+}
+
+// EuRoC state_groundtruth_estimate0/data.csv: timestamp[ns],px,py,pz,qw,qx,qy,qz,...
+bool LoadTrajectoryEuRoC(const string &strFile, Trajectory &traj)
+{
+    ifstream f(strFile.c_str());
+    string s;
+    while(getline(f,s))
+    {
+        if(s.empty() || s[0]=='#')
+            continue;
+        replace(s.begin(),s.end(),',',' ');
+        stringstream ss(s);
+        double t, x, y, z;
+        if(ss >> t >> x >> y >> z)
+        {
+            traj.vTimestamps.push_back(t/1e9);
+            traj.vPositions.push_back(Eigen::Vector3d(x,y,z));
+        }
+    }
+    return !traj.vTimestamps.empty();
+}
+
+// KITTI poses: one 3x4 row-major matrix per frame, timestamps from times.txt
+bool LoadTrajectoryKITTI(const string &strFile, const vector<double> &vTimestamps, Trajectory &traj)
+{
+    ifstream f(strFile.c_str());
+    string s;
+    size_t i = 0;
+    while(getline(f,s) && i<vTimestamps.size())
+    {
+        if(s.empty())
+            continue;
+        stringstream ss(s);
+        double T[12];
+        for(int j=0; j<12; j++)
+            ss >> T[j];
+        if(!ss)
+            continue;
+        traj.vTimestamps.push_back(vTimestamps[i++]);
+        traj.vPositions.push_back(Eigen::Vector3d(T[3],T[7],T[11]));
+    }
+    return !traj.vTimestamps.empty();
+}
+
+struct ATE
+{
+    ATE(): nPairs(0), rmse(0), mean(0), max(0), scale(1) {}
+
+    int nPairs;
+    double rmse;
+    double mean;
+    double max;
+    double scale;
+};
+
+// Absolute trajectory error after aligning the estimate to the ground truth (similarity for
+// monocular, rigid otherwise). Poses are associated by the closest timestamp within 20 ms.
+ATE ComputeATE(const Trajectory &est, const Trajectory &gt, bool bScale)
+{
+    ATE ate;
+    vector<Eigen::Vector3d> vEst, vGt;
+    for(size_t i=0; i<est.vTimestamps.size(); i++)
+    {
+        const double t = est.vTimestamps[i];
+        vector<double>::const_iterator it = lower_bound(gt.vTimestamps.begin(),gt.vTimestamps.end(),t);
+        size_t j = it-gt.vTimestamps.begin();
+        if(j>0 && (j==gt.vTimestamps.size() || t-gt.vTimestamps[j-1]<gt.vTimestamps[j]-t))
+            j--;
+        if(j<gt.vTimestamps.size() && fabs(gt.vTimestamps[j]-t)<0.02)
+        {
+            vEst.push_back(est.vPositions[i]);
+            vGt.push_back(gt.vPositions[j]);
+        }
+    }
+
+    ate.nPairs = vEst.size();
+    if(ate.nPairs<3)
+        return ate;
+
+    Eigen::Matrix3Xd src(3,ate.nPairs), dst(3,ate.nPairs);
+    for(int i=0; i<ate.nPairs; i++)
+    {
+        src.col(i) = vEst[i];
+        dst.col(i) = vGt[i];
+    }
+
+    const Eigen::Matrix4d T = Eigen::umeyama(src,dst,bScale);
+    ate.scale = T.block<3,3>(0,0).col(0).norm();
+
+    double sum = 0, sum2 = 0;
+    for(int i=0; i<ate.nPairs; i++)
+    {
+        const double e = (T.block<3,3>(0,0)*src.col(i)+T.block<3,1>(0,3)-dst.col(i)).norm();
+        sum += e;
+        sum2 += e*e;
+        ate.max = max(ate.max,e);
+    }
+    ate.mean = sum/ate.nPairs;
+    ate.rmse = sqrt(sum2/ate.nPairs);
+    return ate;
+}
+
+double Percentile(const vector<double> &vSorted, double p)
+{
+    if(vSorted.empty())
+        return 0;
+    // Nearest rank
+    const size_t rank = max<size_t>(1,ceil(p*vSorted.size()));
+    return vSorted[min(rank,vSorted.size())-1];
+}
+
+double PeakRSSMegabytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    return usage.ru_maxrss/1024.0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 5)
+    {
+        cerr << endl << "Usage: ./bench_slam path_to_vocabulary path_to_settings dataset path_to_sequence [options]" << endl
+             << "  dataset: kitti_mono, kitti_stereo, euroc_mono, euroc_stereo, tum_mono, tum_rgbd" << endl
+             << "  path_to_sequence: KITTI sequence folder, EuRoC mav0 folder or TUM sequence folder" << endl
+             << "  --realtime          pace frames at the sequence rate (default: as fast as possible)" << endl
+             << "  --preload           decode all frames before the run (default: prefetch in background)" << endl
+             << "  --frames N          process only the first N frames" << endl
+             << "  --readers N         image reader threads (default: 2)" << endl
+             << "  --pipelined         extract features of the next frame while tracking (System::Submit*)" << endl
+             << "  --gt file           ground truth (KITTI poses, EuRoC data.csv or TUM groundtruth.txt)" << endl
+             << "  --associations file TUM RGB-D association file (default: path_to_sequence/associations.txt)" << endl
+             << "  --output file       results (default: bench_results.json)" << endl
+             << "  --viewer            run the viewer" << endl;
+        return 1;
+    }
+
+    const string strDataset = argv[3];
+    const string strSequence = argv[4];
+
+    Options opt;
+    for(int i=5; i<argc; i++)
+    {
+        const string arg = argv[i];
+        const bool bHasValue = i+1<argc;
+        if(arg=="--realtime")
+            opt.bRealTime = true;
+        else if(arg=="--preload")
+            opt.bPreload = true;
+        else if(arg=="--viewer")
+            opt.bViewer = true;
+        else if(arg=="--pipelined")
+            opt.bPipelined = true;
+        else if(arg=="--frames" && bHasValue)
+            opt.nMaxFrames = atoi(argv[++i]);
+        else if(arg=="--readers" && bHasValue)
+            opt.nReaderThreads = atoi(argv[++i]);
+        else if(arg=="--gt" && bHasValue)
+            opt.strGroundTruth = argv[++i];
+        else if(arg=="--associations" && bHasValue)
+            opt.strAssociations = argv[++i];
+        else if(arg=="--output" && bHasValue)
+            opt.strOutput = argv[++i];
+        else
+        {
+            cerr << "ERROR: Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    Sequence seq;
+    bool bLoaded = false;
+    ORB_SLAM2::System::eSensor sensor = ORB_SLAM2::System::MONOCULAR;
+    if(strDataset=="kitti_mono" || strDataset=="kitti_stereo")
+    {
+        const bool bStereo = strDataset=="kitti_stereo";
+        seq.dataset = bStereo ? KITTI_STEREO : KITTI_MONO;
+        sensor = bStereo ? ORB_SLAM2::System::STEREO : ORB_SLAM2::System::MONOCULAR;
+        bLoaded = LoadKITTI(strSequence,bStereo,seq);
+    }
+    else if(strDataset=="euroc_mono" || strDataset=="euroc_stereo")
+    {
+        const bool bStereo = strDataset=="euroc_stereo";
+        seq.dataset = bStereo ? EUROC_STEREO : EUROC_MONO;
+        sensor = bStereo ? ORB_SLAM2::System::STEREO : ORB_SLAM2::System::MONOCULAR;
+        bLoaded = LoadEuRoC(strSequence,argv[2],bStereo,seq);
+    }
+    else if(strDataset=="tum_mono" || strDataset=="tum_rgbd")
+    {
+        const bool bRGBD = strDataset=="tum_rgbd";
+        seq.dataset = bRGBD ? TUM_RGBD : TUM_MONO;
+        sensor = bRGBD ? ORB_SLAM2::System::RGBD : ORB_SLAM2::System::MONOCULAR;
+        bLoaded = LoadTUM(strSequence,opt.strAssociations,bRGBD,seq);
+    }
+    else
+    {
+        cerr << "ERROR: Unknown dataset " << strDataset << endl;
+        return 1;
+    }
+
+    if(!bLoaded)
+    {
+        cerr << "ERROR: No images in provided path." << endl;
+        return 1;
+    }
+
+    size_t nImages = seq.vTimestamps.size();
+    if(opt.nMaxFrames>0)
+        nImages = min(nImages,(size_t)opt.nMaxFrames);
+
+    seq.vstrImages1.resize(nImages);
+    if(!seq.vstrImages2.empty())
+        seq.vstrImages2.resize(nImages);
+
+    ORB_SLAM2::ImageReader::PostProcess rectify;
+    if(seq.dataset==EUROC_STEREO)
+    {
+        rectify = [&seq](cv::Mat &imLeft, cv::Mat &imRight){
+            cv::Mat imLeftRect, imRightRect;
+            cv::remap(imLeft,imLeftRect,seq.M1l,seq.M2l,cv::INTER_LINEAR);
+            cv::remap(imRight,imRightRect,seq.M1r,seq.M2r,cv::INTER_LINEAR);
+            imLeft = imLeftRect;
+            imRight = imRightRect;
+        };
+    }
+
+    ORB_SLAM2::ImageReader reader(seq.vstrImages1,seq.vstrImages2,opt.nPrefetch,opt.nReaderThreads,rectify);
+
+    vector<InputFrame> vFrames;
+    if(opt.bPreload)
+    {
+        cout << "Preloading " << nImages << " frames ..." << endl;
+        vFrames.resize(nImages);
+        for(size_t i=0; i<nImages; i++)
+        {
+            if(!reader.Read(vFrames[i].im1,vFrames[i].im2))
+            {
+                cerr << endl << "Failed to load image at: " << reader.GetError() << endl;
+                return 1;
+            }
+        }
+    }
+
+    ORB_SLAM2::System SLAM(argv[1],argv[2],sensor,opt.bViewer);
+    ORB_SLAM2::Profiler::Reset();
+
+    vector<double> vTimesTrack;
+    vTimesTrack.reserve(nImages);
+
+    // Pipelined: submission time of the frames whose pose was not returned yet
+    deque<chrono::steady_clock::time_point> dqSubmitted;
+    cv::Mat Tcw;
+    double tPose;
+
+    // frame, keyframes, map points
+    vector<long unsigned int> vGrowth;
+
+    cout << endl << "-------" << endl;
+    cout << "Start processing sequence ..." << endl;
+    cout << "Images in the sequence: " << nImages << endl << endl;
+
+    const chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+    for(size_t ni=0; ni<nImages; ni++)
+    {
+        InputFrame frame;
+        if(opt.bPreload)
+            frame = vFrames[ni];
+        else if(!reader.Read(frame.im1,frame.im2))
+        {
+            cerr << endl << "Failed to load image at: " << reader.GetError() << endl;
+            break;
+        }
+        frame.timestamp = seq.vTimestamps[ni];
+
+        if(opt.bRealTime)
+        {
+            const double dt = frame.timestamp-seq.vTimestamps[0];
+            this_thread::sleep_until(tStart+chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(dt)));
+        }
+
+        const chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+
+        if(opt.bPipelined)
+        {
+            // Latency from submission until the pose is returned
+            while(!SubmitFrame(SLAM,sensor,frame))
+            {
+                SLAM.WaitPose(Tcw,tPose);
+                vTimesTrack.push_back(Seconds(dqSubmitted.front(),chrono::steady_clock::now()));
+                dqSubmitted.pop_front();
+            }
+            dqSubmitted.push_back(t1);
+
+            while(SLAM.PollPose(Tcw,tPose))
+            {
+                vTimesTrack.push_back(Seconds(dqSubmitted.front(),chrono::steady_clock::now()));
+                dqSubmitted.pop_front();
+            }
+        }
+        else
+        {
+            if(sensor==ORB_SLAM2::System::MONOCULAR)
+                SLAM.TrackMonocular(frame.im1,frame.timestamp);
+            else if(sensor==ORB_SLAM2::System::STEREO)
+                SLAM.TrackStereo(frame.im1,frame.im2,frame.timestamp);
+            else
+                SLAM.TrackRGBD(frame.im1,frame.im2,frame.timestamp);
+
+            const chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+            vTimesTrack.push_back(Seconds(t1,t2));
+        }
+
+        if(opt.bPreload)
+            vFrames[ni] = InputFrame();
+
+        if(ni%opt.nGrowthPeriod==0 || ni+1==nImages)
+        {
+            vGrowth.push_back(ni);
+            vGrowth.push_back(SLAM.KeyFramesInMap());
+            vGrowth.push_back(SLAM.MapPointsInMap());
+        }
+    }
+    while(SLAM.WaitPose(Tcw,tPose))
+    {
+        vTimesTrack.push_back(Seconds(dqSubmitted.front(),chrono::steady_clock::now()));
+        dqSubmitted.pop_front();
+    }
+    const double tWall = Seconds(tStart,chrono::steady_clock::now());
+
+    // Stop all threads
+    SLAM.Shutdown();
+
+    const long unsigned int nKFs = SLAM.KeyFramesInMap();
+    const long unsigned int nMPs = SLAM.MapPointsInMap();
+
+    // Loop corrected trajectory. Only keyframes for monocular
+    const string strTrajectory = opt.strOutput.substr(0,opt.strOutput.find_last_of('.'))+"_trajectory.txt";
+    if(nKFs>0)
+    {
+        if(sensor==ORB_SLAM2::System::MONOCULAR)
+            SLAM.SaveKeyFrameTrajectoryTUM(strTrajectory);
+        else
+            SLAM.SaveTrajectoryTUM(strTrajectory);
+    }
+
+    bool bATE = false;
+    ATE ate;
+    if(!opt.strGroundTruth.empty() && nKFs>0)
+    {
+        Trajectory est, gt;
+        bool bGt = false;
+        if(seq.dataset==KITTI_MONO || seq.dataset==KITTI_STEREO)
+            bGt = LoadTrajectoryKITTI(opt.strGroundTruth,seq.vTimestamps,gt);
+        else if(seq.dataset==EUROC_MONO || seq.dataset==EUROC_STEREO)
+            bGt = LoadTrajectoryEuRoC(opt.strGroundTruth,gt);
+        else
+            bGt = LoadTrajectoryTUM(opt.strGroundTruth,gt);
+
+        if(!bGt)
+            cerr << "ERROR: Could not read ground truth " << opt.strGroundTruth << endl;
+        else if(LoadTrajectoryTUM(strTrajectory,est))
+        {
+            ate = ComputeATE(est,gt,sensor==ORB_SLAM2::System::MONOCULAR);
+            bATE = ate.nPairs>=3;
+        }
+    }
+
+    vector<double> vSorted = vTimesTrack;
+    sort(vSorted.begin(),vSorted.end());
+    double totaltime = 0;
+    for(size_t i=0; i<vSorted.size(); i++)
+        totaltime += vSorted[i];
+    const size_t nProcessed = vSorted.size();
+
+    ofstream f(opt.strOutput.c_str());
+    f << fixed << setprecision(6);
+    f << "{" << endl;
+    f << "\"dataset\": \"" << strDataset << "\"," << endl;
+    f << "\"sequence\": \"" << strSequence << "\"," << endl;
+    f << "\"pacing\": \"" << (opt.bRealTime ? "realtime" : "unthrottled") << "\"," << endl;
+    f << "\"tracking\": \"" << (opt.bPipelined ? "pipelined" : "synchronous") << "\"," << endl;
+    f << "\"loading\": \"" << (opt.bPreload ? "preload" : "prefetch") << "\"," << endl;
+    f << "\"frames\": " << nProcessed << "," << endl;
+    f << "\"wall_time_s\": " << tWall << "," << endl;
+    f << "\"fps\": " << (tWall>0 ? nProcessed/tWall : 0) << "," << endl;
+    f << "\"track_ms\": {\"mean\": " << (nProcessed>0 ? 1e3*totaltime/nProcessed : 0)
+      << ", \"p50\": " << 1e3*Percentile(vSorted,0.5) << ", \"p90\": " << 1e3*Percentile(vSorted,0.9)
+      << ", \"p99\": " << 1e3*Percentile(vSorted,0.99) << ", \"max\": " << 1e3*Percentile(vSorted,1.0) << "}," << endl;
+    f << "\"peak_rss_mb\": " << PeakRSSMegabytes() << "," << endl;
+    f << "\"keyframes\": " << nKFs << "," << endl;
+    f << "\"mappoints\": " << nMPs << "," << endl;
+    f << "\"growth\": [";
+    for(size_t i=0; i<vGrowth.size(); i+=3)
+        f << (i==0 ? "" : ", ") << "{\"frame\": " << vGrowth[i] << ", \"keyframes\": " << vGrowth[i+1] << ", \"mappoints\": " << vGrowth[i+2] << "}";
+    f << "]," << endl;
+    if(bATE)
+        f << "\"ate\": {\"rmse_m\": " << ate.rmse << ", \"mean_m\": " << ate.mean << ", \"max_m\": " << ate.max
+          << ", \"scale\": " << ate.scale << ", \"poses\": " << ate.nPairs << "}," << endl;
+    else
+        f << "\"ate\": null," << endl;
+    f << "\"profile\": ";
+    ORB_SLAM2::Profiler::WriteJSON(f);
+    f << "}" << endl;
+    f.close();
+
+    cout << "-------" << endl << endl;
+    cout << "median tracking time: " << Percentile(vSorted,0.5) << endl;
+    cout << "mean tracking time: " << (nProcessed>0 ? totaltime/nProcessed : 0) << endl;
+    if(bATE)
+        cout << "ATE RMSE: " << ate.rmse << " m over " << ate.nPairs << " poses" << endl;
+    cout << "Results saved to " << opt.strOutput << endl;
+
+    return 0;
+}
@@ -27,6 +27,7 @@
 #include<opencv2/core/core.hpp>
 
 #include<System.h>
+#include<ImageReader.h>
 
 using namespace std;
 
@@ -60,18 +61,23 @@ int main(int argc, char **argv)
     cout << "Start processing sequence ..." << endl;
     cout << "Images in the sequence: " << nImages << endl << endl;
 
+    // Images are loaded in background threads, ahead of tracking
+    vector<string> vstrImagePaths(nImages);
+    for(int ni=0; ni<nImages; ni++)
+        vstrImagePaths[ni] = string(argv[3])+"/"+vstrImageFilenames[ni];
+    ORB_SLAM2::ImageReader reader(vstrImagePaths,vector<string>());
+
     // Main loop
     cv::Mat im;
     for(int ni=0; ni<nImages; ni++)
     {
         // Read image from file
-        im = cv::imread(string(argv[3])+"/"+vstrImageFilenames[ni],CV_LOAD_IMAGE_UNCHANGED);
         double tframe = vTimestamps[ni];
 
-        if(im.empty())
+        if(!reader.Read(im))
         {
             cerr << endl << "Failed to load image at: "
-                 << string(argv[3]) << "/" << vstrImageFilenames[ni] << endl;
+                 << reader.GetError() << endl;
             return 1;
         }
 
@@ -27,6 +27,7 @@
 #include<opencv2/core/core.hpp>
 
 #include<System.h>
+#include<ImageReader.h>
 
 using namespace std;
 
@@ -90,19 +91,26 @@ int main(int argc, char **argv)
   cout << "Start processing sequence ..." << endl;
   cout << "Images in the sequence: " << nImages << endl << endl;
 
+  // Images and depthmaps are loaded in background threads, ahead of tracking
+  vector<string> vstrPathsRGB(nImages), vstrPathsD(nImages);
+  for(int ni=0; ni<nImages; ni++)
+    {
+      vstrPathsRGB[ni] = string(argv[3])+"/"+vstrImageFilenamesRGB[ni];
+      vstrPathsD[ni] = string(argv[3])+"/"+vstrImageFilenamesD[ni];
+    }
+  ORB_SLAM2::ImageReader reader(vstrPathsRGB,vstrPathsD);
+
   // Main loop
   cv::Mat imRGB, imD;
   for(int ni=0; ni<nImages; ni++)
     {
       // Read image and depthmap from file
-      imRGB = cv::imread(string(argv[3])+"/"+vstrImageFilenamesRGB[ni],CV_LOAD_IMAGE_UNCHANGED);
-      imD = cv::imread(string(argv[3])+"/"+vstrImageFilenamesD[ni],CV_LOAD_IMAGE_UNCHANGED);
       double tframe = vTimestamps[ni];
 
-      if(imRGB.empty())
+      if(!reader.Read(imRGB,imD))
         {
           cerr << endl << "Failed to load image at: "
-               << string(argv[3]) << "/" << vstrImageFilenamesRGB[ni] << endl;
+               << reader.GetError() << endl;
           return 1;
         }
 
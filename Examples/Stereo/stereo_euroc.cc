@@ -28,6 +28,7 @@
 #include<opencv2/core/core.hpp>
 
 #include<System.h>
+#include<ImageReader.h>
 
 using namespace std;
 
@@ -111,31 +112,27 @@ int main(int argc, char **argv)
     cout << "Start processing sequence ..." << endl;
     cout << "Images in the sequence: " << nImages << endl << endl;
 
+    // Images are loaded and rectified in background threads, ahead of tracking
+    ORB_SLAM2::ImageReader reader(vstrImageLeft,vstrImageRight,8,2,[&](cv::Mat &imLeft, cv::Mat &imRight){
+        cv::Mat imLeftRect, imRightRect;
+        cv::remap(imLeft,imLeftRect,M1l,M2l,cv::INTER_LINEAR);
+        cv::remap(imRight,imRightRect,M1r,M2r,cv::INTER_LINEAR);
+        imLeft = imLeftRect;
+        imRight = imRightRect;
+    });
+
     // Main loop
-    cv::Mat imLeft, imRight, imLeftRect, imRightRect;
+    cv::Mat imLeftRect, imRightRect;
     for(int ni=0; ni<nImages; ni++)
     {
-        // Read left and right images from file
-        imLeft = cv::imread(vstrImageLeft[ni],CV_LOAD_IMAGE_UNCHANGED);
-        imRight = cv::imread(vstrImageRight[ni],CV_LOAD_IMAGE_UNCHANGED);
-
-        if(imLeft.empty())
-        {
-            cerr << endl << "Failed to load image at: "
-                 << string(vstrImageLeft[ni]) << endl;
-            return 1;
-        }
-
-        if(imRight.empty())
+        // Read left and right rectified images
+        if(!reader.Read(imLeftRect,imRightRect))
         {
             cerr << endl << "Failed to load image at: "
-                 << string(vstrImageRight[ni]) << endl;
+                 << reader.GetError() << endl;
             return 1;
         }
 
-        cv::remap(imLeft,imLeftRect,M1l,M2l,cv::INTER_LINEAR);
-        cv::remap(imRight,imRightRect,M1r,M2r,cv::INTER_LINEAR);
-
         double tframe = vTimeStamp[ni];
 
 
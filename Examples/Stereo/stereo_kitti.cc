@@ -28,6 +28,7 @@
 #include<opencv2/core/core.hpp>
 
 #include<System.h>
+#include<ImageReader.h>
 
 using namespace std;
 
@@ -61,19 +62,20 @@ int main(int argc, char **argv)
     cout << "Start processing sequence ..." << endl;
     cout << "Images in the sequence: " << nImages << endl << endl;   
 
+    // Images are loaded in background threads, ahead of tracking
+    ORB_SLAM2::ImageReader reader(vstrImageLeft,vstrImageRight);
+
     // Main loop
     cv::Mat imLeft, imRight;
     for(int ni=0; ni<nImages; ni++)
     {
         // Read left and right images from file
-        imLeft = cv::imread(vstrImageLeft[ni],CV_LOAD_IMAGE_UNCHANGED);
-        imRight = cv::imread(vstrImageRight[ni],CV_LOAD_IMAGE_UNCHANGED);
         double tframe = vTimestamps[ni];
 
-        if(imLeft.empty())
+        if(!reader.Read(imLeft,imRight))
         {
             cerr << endl << "Failed to load image at: "
-                 << string(vstrImageLeft[ni]) << endl;
+                 << reader.GetError() << endl;
             return 1;
         }
 
@@ -26,6 +26,13 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <cstring>
+#include <stdint.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -246,6 +253,25 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file created with saveToBinaryFile.
+   * The file is memory-mapped read-only and node descriptors point into the
+   * mapping, so several processes loading the same file share one copy of
+   * the descriptors in the page cache.
+   * Only valid for binary descriptors stored in a cv::Mat of F::L bytes.
+   * @param filename
+   * @return false if the file could not be mapped or is not a valid
+   *   binary vocabulary
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file (see loadFromBinaryFile)
+   * @param filename
+   * @return false if the file could not be written
+   */
+  bool saveToBinaryFile(const std::string &filename) const;
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -401,6 +427,28 @@ protected:
    * @param features
    */
   void setNodeWeights(const vector<vector<TDescriptor> > &features);
+
+  /**
+   * Unmaps the binary vocabulary file, if any. Node descriptors must not
+   * point into the mapping anymore when this is called
+   */
+  void releaseMapping();
+
+  /// Header of the binary vocabulary format. It is followed by the arrays
+  /// weight[nodes] (double), parent[nodes] (uint32), leaf[nodes] (uint8),
+  /// padded to 8 bytes, and descriptor[nodes][descriptor_bytes]
+  struct BinaryHeader
+  {
+    char magic[8];
+    uint32_t version;
+    int32_t k;
+    int32_t L;
+    int32_t scoring;
+    int32_t weighting;
+    uint32_t nodes;
+    uint32_t descriptor_bytes;
+    uint32_t reserved;
+  };
   
 protected:
 
@@ -425,6 +473,12 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Read-only mapping of the binary vocabulary file (NULL if not mapped)
+  void* m_mapped_data;
+
+  /// Size in bytes of the mapping
+  size_t m_mapped_size;
   
 };
 
@@ -434,7 +488,7 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
   (int k, int L, WeightingType weighting, ScoringType scoring)
   : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
-  m_scoring_object(NULL)
+  m_scoring_object(NULL), m_mapped_data(NULL), m_mapped_size(0)
 {
   createScoringObject();
 }
@@ -443,7 +497,8 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const std::string &filename): m_scoring_object(NULL)
+  (const std::string &filename): m_scoring_object(NULL),
+  m_mapped_data(NULL), m_mapped_size(0)
 {
   load(filename);
 }
@@ -452,7 +507,8 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const char *filename): m_scoring_object(NULL)
+  (const char *filename): m_scoring_object(NULL),
+  m_mapped_data(NULL), m_mapped_size(0)
 {
   load(filename);
 }
@@ -516,7 +572,7 @@ void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
   const TemplatedVocabulary<TDescriptor, F> &voc)
-  : m_scoring_object(NULL)
+  : m_scoring_object(NULL), m_mapped_data(NULL), m_mapped_size(0)
 {
   *this = voc;
 }
@@ -527,6 +583,9 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::~TemplatedVocabulary()
 {
   delete m_scoring_object;
+  m_words.clear();
+  m_nodes.clear();
+  releaseMapping();
 }
 
 // --------------------------------------------------------------------------
@@ -545,9 +604,18 @@ TemplatedVocabulary<TDescriptor,F>::operator=
   
   this->m_nodes.clear();
   this->m_words.clear();
+  this->releaseMapping();
   
   this->m_nodes = voc.m_nodes;
   this->createWords();
+
+  // descriptors of a mapped vocabulary do not own their data
+  if(voc.m_mapped_data)
+  {
+    typename vector<Node>::iterator nit;
+    for(nit = this->m_nodes.begin(); nit != this->m_nodes.end(); ++nit)
+      nit->descriptor = nit->descriptor.clone();
+  }
   
   return *this;
 }
@@ -560,6 +628,7 @@ void TemplatedVocabulary<TDescriptor,F>::create(
 {
   m_nodes.clear();
   m_words.clear();
+  releaseMapping();
   
   // expected_nodes = Sum_{i=0..L} ( k^i )
 	int expected_nodes = 
@@ -1345,6 +1414,7 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
 
     m_words.clear();
     m_nodes.clear();
+    releaseMapping();
 
     string s;
     getline(f,s);
@@ -1450,6 +1520,187 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::releaseMapping()
+{
+  if(m_mapped_data)
+  {
+    munmap(m_mapped_data, m_mapped_size);
+    m_mapped_data = NULL;
+    m_mapped_size = 0;
+  }
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename) const
+{
+    const uint32_t N = m_nodes.size();
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "DBOW2BIN", 8);
+    header.version = 1;
+    header.k = m_k;
+    header.L = m_L;
+    header.scoring = m_scoring;
+    header.weighting = m_weighting;
+    header.nodes = N;
+    header.descriptor_bytes = F::L;
+
+    vector<double> weights(N);
+    vector<uint32_t> parents(N);
+    vector<uint8_t> leaves(N + ((8 - N % 8) % 8), 0);
+    vector<uint8_t> descriptors((size_t)N * F::L, 0);
+
+    for(size_t i=0; i<N; i++)
+    {
+        const Node& node = m_nodes[i];
+        weights[i] = node.weight;
+        parents[i] = node.parent;
+        leaves[i] = (i>0 && node.isLeaf()) ? 1 : 0;
+        if(i>0)
+            memcpy(&descriptors[i*F::L], node.descriptor.data, F::L);
+    }
+
+    ofstream f(filename.c_str(), ios_base::out | ios_base::binary);
+    if(!f.is_open())
+        return false;
+
+    f.write((const char*)&header, sizeof(header));
+    f.write((const char*)&weights[0], weights.size()*sizeof(double));
+    f.write((const char*)&parents[0], parents.size()*sizeof(uint32_t));
+    f.write((const char*)&leaves[0], leaves.size());
+    f.write((const char*)&descriptors[0], descriptors.size());
+    f.close();
+
+    return !f.fail();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BinaryHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+
+    const uint8_t* base = (const uint8_t*)data;
+    const BinaryHeader& header = *(const BinaryHeader*)base;
+
+    // Each node takes at least its weight, parent, leaf flag and descriptor: bound N by the
+    // file size before computing the section offsets, so that they cannot overflow
+    const size_t nNodeBytes = sizeof(double) + sizeof(uint32_t) + 1 + F::L;
+    const size_t N = header.nodes;
+    bool bValid = memcmp(header.magic, "DBOW2BIN", 8) == 0 && header.version == 1 &&
+        header.descriptor_bytes == (uint32_t)F::L && N > 0 &&
+        N <= (size - sizeof(BinaryHeader)) / nNodeBytes &&
+        header.k > 0 && header.L > 0 &&
+        header.scoring >= L1_NORM && header.scoring <= DOT_PRODUCT &&
+        header.weighting >= TF_IDF && header.weighting <= BINARY;
+
+    const size_t nLeafBytes = N + ((8 - N % 8) % 8);
+    const size_t offWeights = sizeof(BinaryHeader);
+    const size_t offParents = offWeights + N*sizeof(double);
+    const size_t offLeaves = offParents + N*sizeof(uint32_t);
+    const size_t offDescriptors = offLeaves + nLeafBytes;
+
+    bValid = bValid && offDescriptors + N*F::L == size;
+
+    // The tree: parents come before their children, words have no children, the other nodes
+    // have between 1 and k, and no node is deeper than L
+    if(bValid)
+    {
+        const uint32_t* parents = (const uint32_t*)(base + offParents);
+        const uint8_t* leaves = base + offLeaves;
+        vector<uint32_t> vChildren(N, 0);
+        vector<int> vDepth(N, 0);
+        bValid = leaves[0] == 0;
+        for(size_t nid=1; nid<N && bValid; nid++)
+        {
+            const uint32_t parent = parents[nid];
+            bValid = parent < nid && !leaves[parent] && ++vChildren[parent] <= (uint32_t)header.k;
+            if(bValid)
+            {
+                vDepth[nid] = vDepth[parent] + 1;
+                bValid = vDepth[nid] <= header.L;
+            }
+        }
+        for(size_t nid=0; nid<N && bValid; nid++)
+            bValid = leaves[nid] ? vChildren[nid] == 0 : vChildren[nid] > 0 || N == 1;
+    }
+
+    if(!bValid)
+    {
+        std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+        munmap(data, size);
+        return false;
+    }
+
+    m_words.clear();
+    m_nodes.clear();
+    releaseMapping();
+
+    m_mapped_data = data;
+    m_mapped_size = size;
+
+    m_k = header.k;
+    m_L = header.L;
+    m_scoring = (ScoringType)header.scoring;
+    m_weighting = (WeightingType)header.weighting;
+    createScoringObject();
+
+    const double* weights = (const double*)(base + offWeights);
+    const uint32_t* parents = (const uint32_t*)(base + offParents);
+    const uint8_t* leaves = base + offLeaves;
+    uint8_t* descriptors = (uint8_t*)(base + offDescriptors);
+
+    m_nodes.resize(N);
+    m_words.reserve(N);
+    m_nodes[0].id = 0;
+
+    for(size_t nid=1; nid<N; nid++)
+    {
+        Node& node = m_nodes[nid];
+        node.id = nid;
+        node.parent = parents[nid];
+        node.weight = weights[nid];
+        m_nodes[node.parent].children.push_back(nid);
+
+        // header only, the data stays in the read-only mapping
+        node.descriptor = cv::Mat(1, F::L, CV_8U, descriptors + nid*F::L);
+
+        if(leaves[nid])
+        {
+            node.word_id = m_words.size();
+            m_words.push_back(&node);
+        }
+        else
+        {
+            node.children.reserve(m_k);
+        }
+    }
+
+    return true;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1575,6 +1826,7 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
 {
   m_words.clear();
   m_nodes.clear();
+  releaseMapping();
   
   cv::FileNode fvoc = fs[name];
   
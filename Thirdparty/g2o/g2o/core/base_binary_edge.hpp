@@ -24,6 +24,23 @@
 // NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+namespace internal {
+  /**
+   * edges linearized in parallel (see setParallelFor()) may share both vertices,
+   * lock them in a fixed order
+   */
+  inline void lockQuadraticForms(OptimizableGraph::Vertex* v1, OptimizableGraph::Vertex* v2)
+  {
+    if (v1 < v2) {
+      v1->lockQuadraticForm();
+      v2->lockQuadraticForm();
+    } else {
+      v2->lockQuadraticForm();
+      v1->lockQuadraticForm();
+    }
+  }
+}
+
 template <int D, typename E, typename VertexXiType, typename VertexXjType>
 OptimizableGraph::Vertex* BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::createFrom(){
   return new VertexXiType();
@@ -66,56 +83,58 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   bool toNotFixed = !(to->fixed());
 
   if (fromNotFixed || toNotFixed) {
-#ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-    to->lockQuadraticForm();
-#endif
     const InformationType& omega = _information;
     Matrix<double, D, 1> omega_r = - omega * _error;
+    InformationType weightedOmega;
     if (this->robustKernel() == 0) {
-      if (fromNotFixed) {
-        Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += AtO*A;
-        if (toNotFixed ) {
-          if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
-          else
-            _hessian.noalias() += AtO * B;
-        }
-      } 
-      if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * omega * B;
-      }
+      weightedOmega = omega;
     } else { // robust (weighted) error according to some kernel
       double error = this->chi2();
       Eigen::Vector3d rho;
       this->robustKernel()->robustify(error, rho);
-      InformationType weightedOmega = this->robustInformation(rho);
+      weightedOmega = this->robustInformation(rho);
       //std::cout << PVAR(rho.transpose()) << std::endl;
       //std::cout << PVAR(weightedOmega) << std::endl;
 
       omega_r *= rho[1];
-      if (fromNotFixed) {
-        from->b().noalias() += A.transpose() * omega_r;
-        from->A().noalias() += A.transpose() * weightedOmega * A;
-        if (toNotFixed ) {
-          if (_hessianRowMajor) // we have to write to the block as transposed
-            _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
-          else
-            _hessian.noalias() += A.transpose() * weightedOmega * B;
-        }
-      } 
-      if (toNotFixed) {
-        to->b().noalias() += B.transpose() * omega_r;
-        to->A().noalias() += B.transpose() * weightedOmega * B;
+    }
+
+    // the products are computed before locking the vertices, which may be shared
+    // with the edges built in parallel, so that only the sums are serialized
+    Matrix<double, Di, 1> fromB;
+    Matrix<double, Di, Di> fromA;
+    Matrix<double, Di, Dj> fromToA;
+    Matrix<double, Dj, 1> toB;
+    Matrix<double, Dj, Dj> toA;
+    if (fromNotFixed) {
+      Matrix<double, Di, D> AtO = A.transpose() * weightedOmega;
+      fromB.noalias() = A.transpose() * omega_r;
+      fromA.noalias() = AtO*A;
+      if (toNotFixed)
+        fromToA.noalias() = AtO * B;
+    }
+    if (toNotFixed) {
+      toB.noalias() = B.transpose() * omega_r;
+      toA.noalias() = B.transpose() * weightedOmega * B;
+    }
+
+    internal::lockQuadraticForms(from, to);
+    if (fromNotFixed) {
+      from->b().noalias() += fromB;
+      from->A().noalias() += fromA;
+      if (toNotFixed ) {
+        if (_hessianRowMajor) // we have to write to the block as transposed
+          _hessianTransposed.noalias() += fromToA.transpose();
+        else
+          _hessian.noalias() += fromToA;
       }
     }
-#ifdef G2O_OPENMP
+    if (toNotFixed) {
+      to->b().noalias() += toB;
+      to->A().noalias() += toA;
+    }
     to->unlockQuadraticForm();
     from->unlockQuadraticForm();
-#endif
   }
 }
 
@@ -139,10 +158,7 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus()
   if (!iNotFixed && !jNotFixed)
     return;
 
-#ifdef G2O_OPENMP
-  vi->lockQuadraticForm();
-  vj->lockQuadraticForm();
-#endif
+  internal::lockQuadraticForms(vi, vj);
 
   const double delta = 1e-9;
   const double scalar = 1.0 / (2*delta);
@@ -198,10 +214,8 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus()
   } // end dimension
 
   _error = errorBeforeNumeric;
-#ifdef G2O_OPENMP
   vj->unlockQuadraticForm();
   vi->unlockQuadraticForm();
-#endif
 }
 
 template <int D, typename E, typename VertexXiType, typename VertexXjType>
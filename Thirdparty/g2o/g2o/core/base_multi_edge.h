@@ -30,6 +30,8 @@
 #include <iostream>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
+#include <vector>
 
 #include <Eigen/StdVector>
 
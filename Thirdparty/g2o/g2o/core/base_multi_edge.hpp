@@ -62,12 +62,15 @@ void BaseMultiEdge<D, E>::linearizeOplus(JacobianWorkspace& jacobianWorkspace)
 template <int D, typename E>
 void BaseMultiEdge<D, E>::linearizeOplus()
 {
-#ifdef G2O_OPENMP
-  for (size_t i = 0; i < _vertices.size(); ++i) {
-    OptimizableGraph::Vertex* v = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
-    v->lockQuadraticForm();
-  }
-#endif
+  // edges linearized in parallel may share vertices, lock them in a fixed order.
+  // The buffer is kept per thread, so that linearizing an edge does not allocate
+  static thread_local std::vector<OptimizableGraph::Vertex*> lockedVertices;
+  lockedVertices.resize(_vertices.size());
+  for (size_t i = 0; i < _vertices.size(); ++i)
+    lockedVertices[i] = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
+  std::sort(lockedVertices.begin(), lockedVertices.end());
+  for (size_t i = 0; i < lockedVertices.size(); ++i)
+    lockedVertices[i]->lockQuadraticForm();
 
   const double delta = 1e-9;
   const double scalar = 1.0 / (2*delta);
@@ -116,12 +119,8 @@ void BaseMultiEdge<D, E>::linearizeOplus()
   }
   _error = errorBeforeNumeric;
 
-#ifdef G2O_OPENMP
-  for (int i = (int)(_vertices.size()) - 1; i >= 0; --i) {
-    OptimizableGraph::Vertex* v = static_cast<OptimizableGraph::Vertex*>(_vertices[i]);
-    v->unlockQuadraticForm();
-  }
-#endif
+  for (size_t i = 0; i < lockedVertices.size(); ++i)
+    lockedVertices[i]->unlockQuadraticForm();
 
 }
 
@@ -184,20 +183,20 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
       Eigen::Map<VectorXd> fromB(from->bData(), fromDim);
 
       // ii block in the hessian
-#ifdef G2O_OPENMP
       from->lockQuadraticForm();
-#endif
       fromMap.noalias() += AtO * A;
       fromB.noalias() += A.transpose() * weightedError;
+      from->unlockQuadraticForm();
 
-      // compute the off-diagonal blocks ij for all j
+      // compute the off-diagonal blocks ij for all j. The block is shared with the
+      // other edges between both vertices, which all hold the lock of the vertex
+      // with the lower address when writing it
       for (size_t j = i+1; j < _vertices.size(); ++j) {
         OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
-#ifdef G2O_OPENMP
-        to->lockQuadraticForm();
-#endif
         bool jstatus = !(to->fixed());
         if (jstatus) {
+          OptimizableGraph::Vertex* blockOwner = from < to ? from : to;
+          blockOwner->lockQuadraticForm();
           const MatrixXd& B = _jacobianOplus[j];
           int idx = internal::computeUpperTriangleIndex(i, j);
           assert(idx < (int)_hessian.size());
@@ -207,15 +206,9 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
           } else {
             hhelper.matrix.noalias() += AtO * B;
           }
+          blockOwner->unlockQuadraticForm();
         }
-#ifdef G2O_OPENMP
-        to->unlockQuadraticForm();
-#endif
       }
-
-#ifdef G2O_OPENMP
-      from->unlockQuadraticForm();
-#endif
     }
 
   }
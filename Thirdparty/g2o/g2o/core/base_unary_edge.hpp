@@ -50,24 +50,26 @@ void BaseUnaryEdge<D, E, VertexXiType>::constructQuadraticForm()
 
   bool istatus = !from->fixed();
   if (istatus) {
-#ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-#endif
+    // the products are computed before locking the vertex, which may be shared
+    // with the edges built in parallel
+    Matrix<double, VertexXiType::Dimension, 1> fromB;
+    Matrix<double, VertexXiType::Dimension, VertexXiType::Dimension> fromA;
     if (this->robustKernel()) {
       double error = this->chi2();
       Eigen::Vector3d rho;
       this->robustKernel()->robustify(error, rho);
       InformationType weightedOmega = this->robustInformation(rho);
 
-      from->b().noalias() -= rho[1] * A.transpose() * omega * _error;
-      from->A().noalias() += A.transpose() * weightedOmega * A;
+      fromB.noalias() = rho[1] * A.transpose() * omega * _error;
+      fromA.noalias() = A.transpose() * weightedOmega * A;
     } else {
-      from->b().noalias() -= A.transpose() * omega * _error;
-      from->A().noalias() += A.transpose() * omega * A;
+      fromB.noalias() = A.transpose() * omega * _error;
+      fromA.noalias() = A.transpose() * omega * A;
     }
-#ifdef G2O_OPENMP
+    from->lockQuadraticForm();
+    from->b().noalias() -= fromB;
+    from->A().noalias() += fromA;
     from->unlockQuadraticForm();
-#endif
   }
 }
 
@@ -87,9 +89,7 @@ void BaseUnaryEdge<D, E, VertexXiType>::linearizeOplus()
   if (vi->fixed())
     return;
 
-#ifdef G2O_OPENMP
   vi->lockQuadraticForm();
-#endif
 
   const double delta = 1e-9;
   const double scalar = 1.0 / (2*delta);
@@ -117,9 +117,7 @@ void BaseUnaryEdge<D, E, VertexXiType>::linearizeOplus()
   } // end dimension
 
   _error = errorBeforeNumeric;
-#ifdef G2O_OPENMP
   vi->unlockQuadraticForm();
-#endif
 }
 
 template <int D, typename E, typename VertexXiType>
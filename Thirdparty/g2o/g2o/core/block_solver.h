@@ -32,6 +32,7 @@
 #include "sparse_block_matrix.h"
 #include "sparse_block_matrix_diagonal.h"
 #include "openmp_mutex.h"
+#include "parallel_for.h"
 #include "../../config.h"
 
 namespace g2o {
@@ -162,9 +163,7 @@ namespace g2o {
       std::vector<PoseVectorType, Eigen::aligned_allocator<PoseVectorType> > _diagonalBackupPose;
       std::vector<LandmarkVectorType, Eigen::aligned_allocator<LandmarkVectorType> > _diagonalBackupLandmark;
 
-#    ifdef G2O_OPENMP
       std::vector<OpenMPMutex> _coefficientsMutex;
-#    endif
 
       bool _doSchur;
 
@@ -85,9 +85,7 @@ void BlockSolver<Traits>::resize(int* blockPoseIndices, int numPoseBlocks,
     _Hpl=new PoseLandmarkHessianType(blockPoseIndices, blockLandmarkIndices, numPoseBlocks, numLandmarkBlocks);
     _HplCCS = new SparseBlockMatrixCCS<PoseLandmarkMatrixType>(_Hpl->rowBlockIndices(), _Hpl->colBlockIndices());
     _HschurTransposedCCS = new SparseBlockMatrixCCS<PoseMatrixType>(_Hschur->colBlockIndices(), _Hschur->rowBlockIndices());
-#ifdef G2O_OPENMP
     _coefficientsMutex.resize(numPoseBlocks);
-#endif
   }
 }
 
@@ -375,61 +373,59 @@ bool BlockSolver<Traits>::solve(){
 
   //_DInvSchur->clear();
   memset (_coefficients, 0, _sizePoses*sizeof(double));
-# ifdef G2O_OPENMP
-# pragma omp parallel for default (shared) schedule(dynamic, 10)
-# endif
-  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
-    const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
-    assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
-
-    // calculate inverse block for the landmark
-    const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
-    assert (D && D->rows()==D->cols() && "Error in landmark matrix");
-    LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
-    Dinv = D->inverse();
-
-    LandmarkVectorType  db(D->rows());
-    for (int j=0; j<D->rows(); ++j) {
-      db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
-    }
-    db=Dinv*db;
-
-    assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
-    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
-
-    for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
-        it_outer != landmarkColumn.end(); ++it_outer) {
-      int i1 = it_outer->row;
-
-      const PoseLandmarkMatrixType* Bi = it_outer->block;
-      assert(Bi);
-
-      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
-      assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
-      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
-#    ifdef G2O_OPENMP
-      ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
-#    endif
-      Bb.noalias() += (*Bi)*db;
-
-      assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
-      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
-
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
-      for (; it_inner != landmarkColumn.end(); ++it_inner) {
-        int i2 = it_inner->row;
-        const PoseLandmarkMatrixType* Bj = it_inner->block;
-        assert(Bj); 
-        while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
-          ++targetColumnIt;
-        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
-        PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
-        assert(Hi1i2);
-        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+  // landmarks in parallel, the updates of each pose column are serialized by its mutex
+  parallelForRanges(static_cast<int>(_Hll->blockCols().size()), 32, [&](int landmarkBegin, int landmarkEnd) {
+    for (int landmarkIndex = landmarkBegin; landmarkIndex < landmarkEnd; ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      // calculate inverse block for the landmark
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      LandmarkVectorType  db(D->rows());
+      for (int j=0; j<D->rows(); ++j) {
+        db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+      }
+      db=Dinv*db;
+
+      assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
+          it_outer != landmarkColumn.end(); ++it_outer) {
+        int i1 = it_outer->row;
+
+        const PoseLandmarkMatrixType* Bi = it_outer->block;
+        assert(Bi);
+
+        PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
+        assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
+        typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+        ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
+        Bb.noalias() += (*Bi)*db;
+
+        assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
+        typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+        for (; it_inner != landmarkColumn.end(); ++it_inner) {
+          int i2 = it_inner->row;
+          const PoseLandmarkMatrixType* Bj = it_inner->block;
+          assert(Bj); 
+          while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
+            ++targetColumnIt;
+          assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+          PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
+          assert(Hi1i2);
+          (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        }
       }
     }
-  }
+  });
   //cerr << "Solve [marginalize] = " <<  get_monotonic_time()-t << endl;
 
   // _bschur = _b for calling solver, and not touching _b
@@ -502,14 +498,13 @@ template <typename Traits>
 bool BlockSolver<Traits>::buildSystem()
 {
   // clear b vector
-# ifdef G2O_OPENMP
-# pragma omp parallel for default (shared) if (_optimizer->indexMapping().size() > 1000)
-# endif
-  for (int i = 0; i < static_cast<int>(_optimizer->indexMapping().size()); ++i) {
-    OptimizableGraph::Vertex* v=_optimizer->indexMapping()[i];
-    assert(v);
-    v->clearQuadraticForm();
-  }
+  parallelForRanges(static_cast<int>(_optimizer->indexMapping().size()), 1000, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      OptimizableGraph::Vertex* v=_optimizer->indexMapping()[i];
+      assert(v);
+      v->clearQuadraticForm();
+    }
+  });
   _Hpp->clear();
   if (_doSchur) {
     _Hll->clear();
@@ -517,44 +512,40 @@ bool BlockSolver<Traits>::buildSystem()
   }
 
   // resetting the terms for the pairwise constraints
-  // built up the current system by storing the Hessian blocks in the edges and vertices
-# ifndef G2O_OPENMP
-  // no threading, we do not need to copy the workspace
-  JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
-# else
-  // if running with threads need to produce copies of the workspace for each thread
-  JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
-# pragma omp parallel for default (shared) firstprivate(jacobianWorkspace) if (_optimizer->activeEdges().size() > 100)
-# endif
-  for (int k = 0; k < static_cast<int>(_optimizer->activeEdges().size()); ++k) {
-    OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
-    e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
-    e->constructQuadraticForm();
+  // built up the current system by storing the Hessian blocks in the edges and vertices.
+  // Edges run in parallel, each range with its own copy of the workspace. The edges lock
+  // their vertices when adding to the Hessian blocks
+  parallelForRanges(static_cast<int>(_optimizer->activeEdges().size()), 64, [&](int begin, int end) {
+    JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
+    for (int k = begin; k < end; ++k) {
+      OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
+      e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
+      e->constructQuadraticForm();
 #  ifndef NDEBUG
-    for (size_t i = 0; i < e->vertices().size(); ++i) {
-      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
-      if (! v->fixed()) {
-        bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
-        if (hasANan) {
-          cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
-          break;
+      for (size_t i = 0; i < e->vertices().size(); ++i) {
+        const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+        if (! v->fixed()) {
+          bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
+          if (hasANan) {
+            cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
+            break;
+          }
         }
       }
-    }
 #  endif
-  }
+    }
+  });
 
   // flush the current system in a sparse block matrix
-# ifdef G2O_OPENMP
-# pragma omp parallel for default (shared) if (_optimizer->indexMapping().size() > 1000)
-# endif
-  for (int i = 0; i < static_cast<int>(_optimizer->indexMapping().size()); ++i) {
-    OptimizableGraph::Vertex* v=_optimizer->indexMapping()[i];
-    int iBase = v->colInHessian();
-    if (v->marginalized())
-      iBase+=_sizePoses;
-    v->copyB(_b+iBase);
-  }
+  parallelForRanges(static_cast<int>(_optimizer->indexMapping().size()), 1000, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      OptimizableGraph::Vertex* v=_optimizer->indexMapping()[i];
+      int iBase = v->colInHessian();
+      if (v->marginalized())
+        iBase+=_sizePoses;
+      v->copyB(_b+iBase);
+    }
+  });
 
   return 0;
 }
@@ -158,6 +158,14 @@ namespace g2o {
     _edges.clear();
   }
 
+  void HyperGraph::release()
+  {
+    for (VertexIDMap::iterator it=_vertices.begin(); it!=_vertices.end(); ++it)
+      it->second->edges().clear();
+    _vertices.clear();
+    _edges.clear();
+  }
+
   HyperGraph::~HyperGraph()
   {
     clear();
@@ -172,6 +172,12 @@ namespace g2o {
       virtual bool removeEdge(Edge* e);
       //! clears the graph and empties all structures.
       virtual void clear();
+      /**
+       * removes all vertices and edges from the graph without deleting them. The
+       * caller takes ownership, e.g., to add them again to the next graph instead
+       * of allocating new ones.
+       */
+      virtual void release();
 
       //! @returns the map <i>id -> vertex</i> where the vertices are stored
       const VertexIDMap& vertices() const {return _vertices;}
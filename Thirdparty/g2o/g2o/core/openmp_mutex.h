@@ -32,7 +32,7 @@
 #ifdef G2O_OPENMP
 #include <omp.h>
 #else
-#include <cassert>
+#include <mutex>
 #endif
 
 namespace g2o {
@@ -55,25 +55,22 @@ namespace g2o {
 
 #else
 
-  /*
-   * dummy which does nothing in case we don't have OpenMP support.
-   * In debug mode, the mutex allows to verify the correct lock and unlock behavior
+  /**
+   * \brief Mutex for the loops run by the function installed with setParallelFor()
+   *
+   * Copies are new unlocked mutexes, so that it can be stored in vertices and
+   * containers like the OpenMP lock.
    */
   class OpenMPMutex
   {
     public:
-#ifdef NDEBUG
       OpenMPMutex() {}
-#else
-      OpenMPMutex() : _cnt(0) {}
-#endif
-      ~OpenMPMutex() { assert(_cnt == 0 && "Freeing locked mutex");}
-      void lock() { assert(++_cnt == 1 && "Locking already locked mutex");}
-      void unlock() { assert(--_cnt == 0 && "Trying to unlock a mutex which is not locked");}
+      OpenMPMutex(const OpenMPMutex&) {}
+      OpenMPMutex& operator=(const OpenMPMutex&) { return *this; }
+      void lock() { _mutex.lock(); }
+      void unlock() { _mutex.unlock(); }
     protected:
-#ifndef NDEBUG
-      char _cnt;
-#endif
+      std::mutex _mutex;
   };
 
 #endif
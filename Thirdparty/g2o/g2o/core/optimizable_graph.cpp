@@ -864,6 +864,13 @@ void OptimizableGraph::clearParameters()
   _parameters.clear();
 }
 
+void OptimizableGraph::release()
+{
+  for (VertexIDMap::iterator it=_vertices.begin(); it!=_vertices.end(); ++it)
+    static_cast<OptimizableGraph::Vertex*>(it->second)->_graph = 0;
+  HyperGraph::release();
+}
+
 bool OptimizableGraph::verifyInformationMatrices(bool verbose) const
 {
   bool allEdgeOk = true;
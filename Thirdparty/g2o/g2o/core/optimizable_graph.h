@@ -417,6 +417,10 @@ namespace g2o {
          * specify the robust kernel to be used in this edge
          */
         void setRobustKernel(RobustKernel* ptr);
+        /**
+         * detach the robust kernel without deleting it, the caller takes ownership
+         */
+        RobustKernel* releaseRobustKernel() { RobustKernel* ptr = _robustKernel; _robustKernel = 0; return ptr; }
 
         //! returns the error vector cached after calling the computeError;
         virtual const double* errorData() const = 0;
@@ -634,6 +638,9 @@ namespace g2o {
      */
     virtual void clearParameters();
 
+    //! see HyperGraph::release()
+    virtual void release();
+
     bool addParameter(Parameter* p) {
       return _parameters.addParameter(p);
     }
@@ -0,0 +1,78 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace g2o {
+
+  namespace {
+    // function local, setParallelFor() may be called during static initialization
+    std::mutex& parallelForMutex()
+    {
+      static std::mutex mutex;
+      return mutex;
+    }
+
+    ParallelForFunction& parallelForFunction()
+    {
+      static ParallelForFunction function;
+      return function;
+    }
+  }
+
+  void setParallelFor(const ParallelForFunction& parallelFor)
+  {
+    std::lock_guard<std::mutex> lock(parallelForMutex());
+    parallelForFunction() = parallelFor;
+  }
+
+  void parallelForRanges(int n, int grainSize, const std::function<void(int begin, int end)>& f)
+  {
+    if (n <= 0)
+      return;
+
+    ParallelForFunction parallelFor;
+    if (n > grainSize) {
+      std::lock_guard<std::mutex> lock(parallelForMutex());
+      parallelFor = parallelForFunction();
+    }
+
+    if (! parallelFor) {
+      f(0, n);
+      return;
+    }
+
+    const int numRanges = (n + grainSize - 1) / grainSize;
+    parallelFor(numRanges, [&](int r) {
+        const int begin = r * grainSize;
+        f(begin, std::min(begin + grainSize, n));
+      });
+  }
+
+} // end namespace
@@ -0,0 +1,57 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_PARALLEL_FOR_H
+#define G2O_PARALLEL_FOR_H
+
+#include <functional>
+
+namespace g2o {
+
+  /**
+   * \brief runs f(i) for i in [0,n) and returns when all have finished
+   */
+  typedef std::function<void(int n, const std::function<void(int)>& f)> ParallelForFunction;
+
+  /**
+   * install the function used to run the loops over edges and vertices of the
+   * optimizer in parallel, e.g., one backed by the thread pool of the
+   * application. By default (or after setParallelFor(0)) all loops run on the
+   * calling thread.
+   */
+  void setParallelFor(const ParallelForFunction& parallelFor);
+
+  /**
+   * runs f(begin, end) over consecutive ranges of at most grainSize elements
+   * covering [0,n). Ranges may run concurrently, so f has to lock the state it
+   * shares with other elements. Loops of at most grainSize elements run on the
+   * calling thread.
+   */
+  void parallelForRanges(int n, int grainSize, const std::function<void(int begin, int end)>& f);
+
+} // end namespace
+
+#endif
@@ -38,6 +38,7 @@
 #include "batch_stats.h"
 #include "hyper_graph_action.h"
 #include "robust_kernel.h"
+#include "parallel_for.h"
 #include "../stuff/timeutil.h"
 #include "../stuff/macros.h"
 #include "../stuff/misc.h"
@@ -67,13 +68,12 @@ namespace g2o{
         (*(*it))(this);
     }
 
-#   ifdef G2O_OPENMP
-#   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
-#   endif
-    for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
-      OptimizableGraph::Edge* e = _activeEdges[k];
-      e->computeError();
-    }
+    parallelForRanges(static_cast<int>(_activeEdges.size()), 128, [this](int begin, int end) {
+      for (int k = begin; k < end; ++k) {
+        OptimizableGraph::Edge* e = _activeEdges[k];
+        e->computeError();
+      }
+    });
 
 #  ifndef NDEBUG
     for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
@@ -493,6 +493,14 @@ namespace g2o{
     OptimizableGraph::clear();
   }
 
+  void SparseOptimizer::release() {
+    clearIndexMapping();
+    _ivMap.clear();
+    _activeVertices.clear();
+    _activeEdges.clear();
+    OptimizableGraph::release();
+  }
+
   SparseOptimizer::VertexContainer::const_iterator SparseOptimizer::findActiveVertex(const OptimizableGraph::Vertex* v) const
   {
     VertexContainer::const_iterator lower = lower_bound(_activeVertices.begin(), _activeVertices.end(), v, VertexIDCompare());
@@ -244,6 +244,9 @@ namespace g2o {
      */
     virtual void clear();
 
+    //! see HyperGraph::release()
+    virtual void release();
+
     /**
      * computes the error vectors of all edges in the activeSet, and caches them
      */
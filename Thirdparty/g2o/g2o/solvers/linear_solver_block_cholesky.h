@@ -0,0 +1,358 @@
+// g2o - General Graph Optimization
+// Copyright (C) 2011 R. Kuemmerle, G. Grisetti, W. Burgard
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef G2O_LINEAR_SOLVER_BLOCK_CHOLESKY_H
+#define G2O_LINEAR_SOLVER_BLOCK_CHOLESKY_H
+
+#include <Eigen/Cholesky>
+#include <Eigen/Sparse>
+#include <Eigen/OrderingMethods>
+
+#include "../core/linear_solver.h"
+#include "../core/batch_stats.h"
+#include "../core/parallel_for.h"
+#include "../stuff/timeutil.h"
+
+#include "../core/eigen_types.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace g2o {
+
+/**
+ * \brief linear solver which factorizes the blocks of the matrix with a parallel Cholesky
+ *
+ * Left-looking Cholesky of the block structure after an AMD ordering of the
+ * blocks. Columns of the same height in the elimination tree
+ * do not depend on each other and are factorized in parallel, and the row
+ * blocks of each column are computed in parallel (see setParallelFor()). Meant
+ * for pose graphs, where the blocks are small and the factor is sparse.
+ */
+template <typename MatrixType>
+class LinearSolverBlockCholesky: public LinearSolver<MatrixType>
+{
+  public:
+    LinearSolverBlockCholesky() :
+      LinearSolver<MatrixType>(),
+      _init(true), _writeDebug(false)
+    {
+    }
+
+    virtual ~LinearSolverBlockCholesky()
+    {
+    }
+
+    virtual bool init()
+    {
+      _init = true;
+      return true;
+    }
+
+    bool solve(const SparseBlockMatrix<MatrixType>& A, double* x, double* b)
+    {
+      if (_init) // compute the symbolic composition once
+        computeSymbolicDecomposition(A);
+      _init = false;
+
+      double t=get_monotonic_time();
+      if (! factorize(A)) { // the matrix is not positive definite
+        if (_writeDebug) {
+          std::cerr << "Cholesky failure, writing debug.txt (Hessian loadable by Octave)" << std::endl;
+          A.writeOctave("debug.txt");
+        }
+        return false;
+      }
+
+      // Solving the system in the permuted order
+      const int n = _columns.size();
+      for (int j = 0; j < n; ++j)
+        _y.segment(_base[j], _columns[j].dim) = VectorXD::ConstMapType(b + A.colBaseOfBlock(_perm[j]), _columns[j].dim);
+
+      // L y = P b
+      for (int j = 0; j < n; ++j) {
+        const Column& col = _columns[j];
+        col.diagonal.template triangularView<Eigen::Lower>().solveInPlace(_y.segment(_base[j], col.dim));
+        for (size_t s = 0; s < col.rows.size(); ++s) {
+          const int i = col.rows[s];
+          _y.segment(_base[i], _columns[i].dim).noalias() -= col.blocks[s] * _y.segment(_base[j], col.dim);
+        }
+      }
+
+      // L^T P x = y
+      for (int j = n - 1; j >= 0; --j) {
+        const Column& col = _columns[j];
+        for (size_t s = 0; s < col.rows.size(); ++s) {
+          const int i = col.rows[s];
+          _y.segment(_base[j], col.dim).noalias() -= col.blocks[s].transpose() * _y.segment(_base[i], _columns[i].dim);
+        }
+        col.diagonal.template triangularView<Eigen::Lower>().transpose().solveInPlace(_y.segment(_base[j], col.dim));
+      }
+
+      for (int j = 0; j < n; ++j)
+        VectorXD::MapType(x + A.colBaseOfBlock(_perm[j]), _columns[j].dim) = _y.segment(_base[j], _columns[j].dim);
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats) {
+        globalStats->timeNumericDecomposition = get_monotonic_time() - t;
+        globalStats->choleskyNNZ = _nonZeros;
+      }
+
+      return true;
+    }
+
+    //! write a debug dump of the system matrix if it is not SPD in solve
+    virtual bool writeDebug() const { return _writeDebug;}
+    virtual void setWriteDebug(bool b) { _writeDebug = b;}
+
+  protected:
+    //! L(i,j) -= L(i,k) * L(j,k)^T, with both blocks in column k
+    struct Update {
+      int k;
+      int slotI;
+      int slotJ;
+    };
+
+    //! block column of the factor, in the permuted order
+    struct Column {
+      int dim;
+      MatrixXD diagonal;                          ///< lower triangular L(j,j)
+      std::vector<int> rows;                      ///< rows below the diagonal, ascending
+      std::vector<MatrixXD> blocks;               ///< L(rows[s],j)
+      std::vector<std::pair<int, int> > diagonalUpdates; ///< (k, slot of j in column k)
+      std::vector<std::vector<Update> > updates;  ///< per slot
+    };
+
+    bool _init;
+    bool _writeDebug;
+    std::vector<int> _perm;                 ///< permuted block -> block of A
+    std::vector<int> _base;                 ///< first scalar of each permuted block
+    std::vector<Column> _columns;
+    std::vector<std::vector<int> > _levels; ///< columns by height in the elimination tree
+    size_t _nonZeros;
+    VectorXD _y;
+
+    //! A(i,j) of the permuted matrix, or 0 if the block is zero
+    static const MatrixType* blockOfA(const SparseBlockMatrix<MatrixType>& A, int oi, int oj, bool& transposed)
+    {
+      transposed = oi > oj;
+      return transposed ? A.block(oj, oi) : A.block(oi, oj);
+    }
+
+    /**
+     * compute the symbolic decompostion of the matrix only once.
+     * Since A has the same pattern in all the iterations, we only
+     * compute the fill-in reducing ordering and the structure of the
+     * factor once and re-use them for all the following iterations.
+     */
+    void computeSymbolicDecomposition(const SparseBlockMatrix<MatrixType>& A)
+    {
+      double t=get_monotonic_time();
+      const int n = A.blockCols().size();
+
+      // AMD ordering of the block structure
+      {
+        typedef Eigen::SparseMatrix<double, Eigen::ColMajor> SparseMatrix;
+        std::vector<Eigen::Triplet<double> > triplets;
+        for (int c = 0; c < n; ++c) {
+          const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+          for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+            if (it->first > c) // only upper triangle
+              break;
+            triplets.push_back(Eigen::Triplet<double>(it->first, c, 0.));
+          }
+        }
+        SparseMatrix pattern(n, n);
+        pattern.setFromTriplets(triplets.begin(), triplets.end());
+        Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> P;
+        Eigen::AMDOrdering<int> ordering;
+        ordering(pattern.selfadjointView<Eigen::Upper>(), P);
+        _perm.assign(P.indices().data(), P.indices().data() + n);
+      }
+
+      std::vector<int> iperm(n);
+      for (int j = 0; j < n; ++j)
+        iperm[_perm[j]] = j;
+
+      // upper pattern of the permuted matrix, by column
+      std::vector<std::vector<int> > upper(n);
+      for (int c = 0; c < n; ++c) {
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          if (it->first >= c)
+            break;
+          const int i = iperm[it->first];
+          const int j = iperm[c];
+          upper[std::max(i, j)].push_back(std::min(i, j));
+        }
+      }
+
+      // elimination tree, and the row structure of L by walking it up to the diagonal
+      std::vector<int> parent(n, -1), ancestor(n, -1), mark(n, -1);
+      _columns.assign(n, Column());
+      for (int k = 0; k < n; ++k) {
+        for (size_t p = 0; p < upper[k].size(); ++p) {
+          int i = upper[k][p];
+          while (i != -1 && i < k) {
+            const int next = ancestor[i];
+            ancestor[i] = k;
+            if (next == -1)
+              parent[i] = k;
+            i = next;
+          }
+        }
+        mark[k] = k;
+        for (size_t p = 0; p < upper[k].size(); ++p) {
+          for (int i = upper[k][p]; mark[i] != k; i = parent[i]) {
+            mark[i] = k;
+            _columns[i].rows.push_back(k);
+          }
+        }
+      }
+
+      // sizes, storage and the updates of every block of the factor
+      _base.resize(n);
+      _nonZeros = 0;
+      int base = 0;
+      for (int j = 0; j < n; ++j) {
+        Column& col = _columns[j];
+        col.dim = A.colsOfBlock(_perm[j]);
+        std::sort(col.rows.begin(), col.rows.end());
+        col.diagonal.setZero(col.dim, col.dim);
+        col.updates.assign(col.rows.size(), std::vector<Update>());
+        col.diagonalUpdates.clear();
+        _base[j] = base;
+        base += col.dim;
+        _nonZeros += col.dim * (col.dim + 1) / 2;
+      }
+      _y.resize(base);
+
+      std::vector<int> slot(n, -1);
+      for (int j = 0; j < n; ++j) {
+        Column& col = _columns[j];
+        col.blocks.resize(col.rows.size());
+        for (size_t s = 0; s < col.rows.size(); ++s) {
+          col.blocks[s].setZero(_columns[col.rows[s]].dim, col.dim);
+          _nonZeros += col.blocks[s].size();
+        }
+      }
+      for (int k = 0; k < n; ++k) {
+        const Column& colK = _columns[k];
+        for (size_t sj = 0; sj < colK.rows.size(); ++sj) {
+          const int j = colK.rows[sj];
+          Column& colJ = _columns[j];
+          colJ.diagonalUpdates.push_back(std::make_pair(k, static_cast<int>(sj)));
+          for (size_t s = 0; s < colJ.rows.size(); ++s)
+            slot[colJ.rows[s]] = s;
+          // the rows of column k below j are rows of column j
+          for (size_t si = sj + 1; si < colK.rows.size(); ++si) {
+            Update u = {k, static_cast<int>(si), static_cast<int>(sj)};
+            colJ.updates[slot[colK.rows[si]]].push_back(u);
+          }
+        }
+      }
+
+      // height in the elimination tree, children come before their parent
+      std::vector<int> height(n, 0);
+      int maxHeight = 0;
+      for (int j = 0; j < n; ++j) {
+        maxHeight = std::max(maxHeight, height[j]);
+        if (parent[j] != -1)
+          height[parent[j]] = std::max(height[parent[j]], height[j] + 1);
+      }
+      _levels.assign(maxHeight + 1, std::vector<int>());
+      for (int j = 0; j < n; ++j)
+        _levels[height[j]].push_back(j);
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats)
+        globalStats->timeSymbolicDecomposition = get_monotonic_time() - t;
+    }
+
+    bool factorizeColumn(const SparseBlockMatrix<MatrixType>& A, int j)
+    {
+      Column& col = _columns[j];
+      const int oj = _perm[j];
+
+      bool transposed;
+      const MatrixType* a = blockOfA(A, oj, oj, transposed);
+      if (a)
+        col.diagonal = *a;
+      else
+        col.diagonal.setZero();
+      for (size_t u = 0; u < col.diagonalUpdates.size(); ++u) {
+        const MatrixXD& Ljk = _columns[col.diagonalUpdates[u].first].blocks[col.diagonalUpdates[u].second];
+        col.diagonal.noalias() -= Ljk * Ljk.transpose();
+      }
+
+      Eigen::LLT<MatrixXD> llt(col.diagonal);
+      if (llt.info() != Eigen::Success)
+        return false;
+      col.diagonal = llt.matrixL();
+
+      parallelForRanges(col.rows.size(), 16, [&](int begin, int end) {
+          for (int s = begin; s < end; ++s) {
+            MatrixXD& Lij = col.blocks[s];
+            bool transposedA;
+            const MatrixType* aij = blockOfA(A, _perm[col.rows[s]], oj, transposedA);
+            if (! aij)
+              Lij.setZero();
+            else if (transposedA)
+              Lij = aij->transpose();
+            else
+              Lij = *aij;
+            const std::vector<Update>& updates = col.updates[s];
+            for (size_t u = 0; u < updates.size(); ++u) {
+              const Column& colK = _columns[updates[u].k];
+              Lij.noalias() -= colK.blocks[updates[u].slotI] * colK.blocks[updates[u].slotJ].transpose();
+            }
+            // L(i,j) = A'(i,j) L(j,j)^-T
+            col.diagonal.template triangularView<Eigen::Lower>().solveInPlace(Lij.transpose());
+          }
+        });
+      return true;
+    }
+
+    bool factorize(const SparseBlockMatrix<MatrixType>& A)
+    {
+      bool ok = true;
+      for (size_t l = 0; l < _levels.size() && ok; ++l) {
+        const std::vector<int>& level = _levels[l];
+        std::vector<char> factorized(level.size(), 1);
+        parallelForRanges(level.size(), 4, [&](int begin, int end) {
+            for (int c = begin; c < end; ++c)
+              factorized[c] = factorizeColumn(A, level[c]);
+          });
+        ok = std::find(factorized.begin(), factorized.end(), 0) == factorized.end();
+      }
+      return ok;
+    }
+};
+
+} // end namespace
+
+#endif
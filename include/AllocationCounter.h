@@ -0,0 +1,45 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+namespace ORB_SLAM2
+{
+
+// Counts heap allocations (malloc family, which also backs operator new and cv::Mat) per thread.
+// Only active when the library is built with -DCOUNT_ALLOCATIONS=ON (glibc only), since it
+// replaces the process allocator entry points. Otherwise all counts are 0.
+class AllocationCounter
+{
+public:
+    static bool Enabled();
+
+    // Allocations made so far by the calling thread
+    static unsigned long ThreadAllocations();
+
+    // Attributes to the calling thread allocations made by other threads on its behalf
+    // (e.g. thread pool workers running a ParallelFor)
+    static void AddThreadAllocations(unsigned long n);
+};
+
+}// namespace ORB_SLAM
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,68 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EPOCHRECLAIMER_H
+#define EPOCHRECLAIMER_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+
+namespace ORB_SLAM2
+{
+
+// Epoch based reclamation of the read-copy-update snapshots that are read without locking.
+// A reader loads the pointer to the current snapshot from an atomic inside a Guard. A writer
+// replaces the pointer and then retires the previous snapshot, which is kept alive until every
+// Guard that may have loaded it has been left.
+// Entering and leaving a Guard only writes a slot owned by the calling thread, so readers never
+// wait and do not share a cache line (unlike std::atomic_load on a shared_ptr, which locks one
+// of a small table of global mutexes). Writers free the retired snapshots every RECLAIM_PERIOD
+// retirements, after scanning the slots.
+// Guards must not be nested. Threads beyond MAX_THREADS still work, but while one of them is in a
+// Guard nothing is freed.
+class EpochReclaimer
+{
+public:
+    static const int MAX_THREADS = 128;
+    static const size_t RECLAIM_PERIOD = 64;
+
+    class Guard
+    {
+    public:
+        Guard();
+        ~Guard();
+
+    private:
+        Guard(const Guard&);
+        Guard& operator=(const Guard&);
+
+        std::atomic<unsigned long>* mpSlot;
+    };
+
+    // Call after the pointer to pObject was replaced. Frees it, possibly later, once no reader can
+    // be using it.
+    static void Retire(std::shared_ptr<const void> pObject);
+};
+
+} //namespace ORB_SLAM
+
+#endif // EPOCHRECLAIMER_H
@@ -0,0 +1,108 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FEATUREGRID_H
+#define FEATUREGRID_H
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2
+{
+
+// Keypoints bucketed in a regular grid over the image, stored in compressed (CSR) form:
+// one offsets array with an entry per cell and one packed array of keypoint indices sorted by
+// cell. Cells are laid out row by row, so the cells of a query window that share a grid row
+// are a single contiguous range. Coordinates and octaves are stored next to the indices so
+// that radius queries never touch the keypoint vector.
+class FeatureGrid
+{
+public:
+    FeatureGrid();
+
+    // Assigns vKeys to cells (the cell containing round((pt-min)*cellInv)), reusing the storage
+    // of previous builds.
+    void Build(const std::vector<cv::KeyPoint> &vKeys, int nCols, int nRows,
+               float fMinX, float fMinY, float fCellWidthInv, float fCellHeightInv);
+
+    void Clear();
+
+    // Indices of the keypoints inside the square of half side r centered in (x,y) and with
+    // octave in [minLevel,maxLevel]. A negative maxLevel disables the upper bound.
+    void GetFeaturesInArea(const float &x, const float &y, const float &r, const int minLevel, const int maxLevel,
+                           std::vector<std::size_t> &vIndices) const;
+
+    std::vector<std::size_t> GetFeaturesInArea(const float &x, const float &y, const float &r,
+                                          const int minLevel=-1, const int maxLevel=-1) const;
+
+    int GetCols() const {
+        return mnCols;
+    }
+
+    int GetRows() const {
+        return mnRows;
+    }
+
+    // Number of keypoints stored in the grid (keypoints outside the image are dropped)
+    std::size_t Size() const {
+        return mvX.size();
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar, const unsigned int version)
+    {
+        ar & mnCols & mnRows;
+        ar & mfMinX & mfMinY & mfCellWidthInv & mfCellHeightInv;
+        ar & mvCellStart;
+        ar & mvIndices16 & mvIndices32;
+        ar & mvX & mvY & mvOctave;
+    }
+
+protected:
+
+    template<typename T>
+    void Query(const std::vector<T> &vCellIndices, float x, float y, float r, int minLevel, int maxLevel,
+               int nMinCellX, int nMaxCellX, int nMinCellY, int nMaxCellY, std::vector<std::size_t> &vIndices) const;
+
+    int mnCols;
+    int mnRows;
+    float mfMinX;
+    float mfMinY;
+    float mfCellWidthInv;
+    float mfCellHeightInv;
+
+    // Cell c = row*mnCols+col holds the entries [mvCellStart[c], mvCellStart[c+1])
+    std::vector<uint32_t> mvCellStart;
+
+    // Keypoint indices in cell order. Only one of them is used: 16 bits whenever the indices fit.
+    std::vector<uint16_t> mvIndices16;
+    std::vector<uint32_t> mvIndices32;
+
+    // Keypoint coordinates and octave, in cell order
+    std::vector<float> mvX;
+    std::vector<float> mvY;
+    std::vector<int8_t> mvOctave;
+};
+
+} //namespace ORB_SLAM
+
+#endif // FEATUREGRID_H
@@ -29,6 +29,7 @@
 #include "ORBVocabulary.h"
 #include "KeyFrame.h"
 #include "ORBextractor.h"
+#include "FeatureGrid.h"
 
 #include <opencv2/opencv.hpp>
 #include <gtsam/inference/Symbol.h>
@@ -49,6 +50,9 @@ public:
     // Copy constructor.
     Frame(const Frame &frame);
 
+    // Assignment, reuses the buffers of this frame (see CopyFrom).
+    Frame& operator=(const Frame &frame);
+
     // Constructor for stereo cameras.
     Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
 
@@ -58,6 +62,16 @@ public:
     // Constructor for Monocular cameras.
     Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
 
+    // Build the frame in place, as the constructors above. The buffers of the frame previously
+    // held by this object (keypoints, descriptors, grid, map point associations) are reused,
+    // so steady-state tracking does not reallocate them for each image.
+    void CreateStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+    void CreateRGBD(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, gtsam::Key key = gtsam::Symbol('x', 999999));
+    void CreateMonocular(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+
+    // Copy the given frame into this one reusing its buffers (unlike the copy constructor).
+    void CopyFrom(const Frame &frame);
+
     // Extract ORB on the image. 0 for left image and 1 for right image.
     void ExtractORB(int flag, const cv::Mat &im);
 
@@ -159,12 +173,12 @@ public:
     // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
     static float mfGridElementWidthInv;
     static float mfGridElementHeightInv;
-    std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+    FeatureGrid mGrid;
 
     // Camera pose.
     cv::Mat mTcw;
 
-    // Current and Next Frame id.
+    // Current and Next Frame id. Assigned when the frame is tracked, not when it is built.
     static long unsigned int nNextId;
     long unsigned int mnId;
 
@@ -205,6 +219,19 @@ private:
     // Assign keypoints to the grid for speed up feature matching (called in the constructor).
     void AssignFeaturesToGrid();
 
+    // Common initialization of the constructors, clears the data of the previous frame.
+    void Initialize(ORBVocabulary* voc, ORBextractor* extractorLeft, ORBextractor* extractorRight, const double &timeStamp,
+                    cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth);
+
+    // Clears the camera pose.
+    void ResetPose();
+
+    // Copies src into the first rows of buffer (grown if needed), dst is set to a view of them.
+    static void CopyToBuffer(const cv::Mat &src, cv::Mat &buffer, cv::Mat &dst);
+
+    // Storage of mDescriptors and mDescriptorsRight, reused between frames.
+    cv::Mat mDescriptorsBuffer, mDescriptorsRightBuffer;
+
     // Rotation, translation and camera center
     cv::Mat mRcw;
     cv::Mat mtcw;
@@ -0,0 +1,92 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HAMMINGDISTANCE_H
+#define HAMMINGDISTANCE_H
+
+#include<string>
+#include<vector>
+#include<stddef.h>
+#include<stdint.h>
+#include<string.h>
+
+namespace ORB_SLAM2
+{
+
+// Hamming distance between 256-bit ORB descriptors.
+// The kernel (scalar, POPCNT, AVX2, AVX-512 VPOPCNTDQ or NEON) for the batched distances is
+// selected at runtime from the CPU features. It can be forced with SetKernel, e.g. to compare
+// kernels in a benchmark.
+class HammingDistance
+{
+public:
+    typedef int (*DistanceFunction)(const uint8_t *a, const uint8_t *b);
+    typedef void (*OneToManyFunction)(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists);
+
+    static const int DESCRIPTOR_BYTES = 32;
+
+    // Distance between two descriptors.
+    // If the build targets POPCNT (e.g. -march=native) it is inlined, since an indirect call
+    // costs as much as the distance itself. Otherwise it uses the runtime selected kernel.
+    static inline int Distance(const uint8_t *a, const uint8_t *b)
+    {
+#if defined(__POPCNT__) || defined(__ARM_NEON)
+        uint64_t wa[4], wb[4];
+        memcpy(wa,a,32);
+        memcpy(wb,b,32);
+        return __builtin_popcountll(wa[0]^wb[0]) + __builtin_popcountll(wa[1]^wb[1]) +
+               __builtin_popcountll(wa[2]^wb[2]) + __builtin_popcountll(wa[3]^wb[3]);
+#else
+        return mpDistance(a,b);
+#endif
+    }
+
+    // Distances between descriptor q and the nB descriptors stored every strideB bytes from pB.
+    // pDists must hold nB values.
+    static inline void OneToMany(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+    {
+        mpOneToMany(q,pB,strideB,nB,pDists);
+    }
+
+    // Distances between the nA descriptors at pA and the nB descriptors at pB.
+    // pDists must hold nA x nB values (row-major, one row per descriptor in A).
+    static void ManyToMany(const uint8_t *pA, size_t strideA, size_t nA,
+                           const uint8_t *pB, size_t strideB, size_t nB, int *pDists);
+
+    // Kernels supported by this CPU, from slowest to fastest
+    static std::vector<std::string> AvailableKernels();
+
+    // Forces a kernel by name. Returns false if it is not supported by this CPU.
+    static bool SetKernel(const std::string &name);
+
+    static std::string KernelName();
+
+    // Pair distance of the selected kernel. Distance may not call it when it is inlined.
+    static DistanceFunction KernelDistance();
+
+protected:
+    static DistanceFunction mpDistance;
+    static OneToManyFunction mpOneToMany;
+    static const char* mpKernelName;
+};
+
+}// namespace ORB_SLAM
+
+#endif // HAMMINGDISTANCE_H
@@ -0,0 +1,100 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEREADER_H
+#define IMAGEREADER_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+
+namespace ORB_SLAM2
+{
+
+// Reads the images of a dataset sequence ahead of the thread that tracks them.
+// Several threads load and decode frames in parallel, at most nPrefetch frames ahead of Read(),
+// which returns them in order. A frame is one image (monocular) or a pair (stereo, RGB-D).
+class ImageReader
+{
+public:
+
+    // Called by the reader threads on every frame after loading it (e.g. stereo rectification)
+    typedef std::function<void(cv::Mat &im1, cv::Mat &im2)> PostProcess;
+
+    // vstrImages2 is empty for monocular sequences, otherwise it has the same size as vstrImages1
+    ImageReader(const std::vector<std::string> &vstrImages1, const std::vector<std::string> &vstrImages2,
+                int nPrefetch = 8, int nThreads = 2, const PostProcess &postProcess = PostProcess());
+    ~ImageReader();
+
+    // Next frame of the sequence. Returns false at the end of the sequence or if an image
+    // could not be loaded (see GetError)
+    bool Read(cv::Mat &im1, cv::Mat &im2);
+    bool Read(cv::Mat &im);
+
+    // Index of the frame returned by the next Read
+    size_t Position();
+    size_t Size();
+
+    // Path of the image that could not be loaded, empty if there was no error. If several frames
+    // failed, the first of them in the sequence, where Read stops.
+    std::string GetError();
+
+protected:
+
+    struct Slot
+    {
+        Slot(): nIndex(-1), bFailed(false) {}
+
+        cv::Mat im1;
+        cv::Mat im2;
+        long nIndex;
+        bool bFailed;
+    };
+
+    void Run();
+
+    const std::vector<std::string> mvstrImages1;
+    const std::vector<std::string> mvstrImages2;
+    PostProcess mPostProcess;
+
+    std::mutex mMutex;
+    std::condition_variable mcv;
+
+    // Frame i is stored in slot i%size until it is read
+    std::vector<Slot> mvSlots;
+    size_t mnNextToLoad;
+    size_t mnNextToRead;
+    // Error of the lowest failed frame (-1 if none), the frames are loaded out of order
+    std::string mstrError;
+    long mnErrorIndex;
+    bool mbStop;
+
+    std::vector<std::thread> mvThreads;
+};
+
+} //namespace ORB_SLAM
+
+#endif // IMAGEREADER_H
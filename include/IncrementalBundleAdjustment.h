@@ -0,0 +1,135 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INCREMENTALBUNDLEADJUSTMENT_H
+#define INCREMENTALBUNDLEADJUSTMENT_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <gtsam/nonlinear/ISAM2.h>
+#include <gtsam/geometry/Cal3_S2.h>
+#include <gtsam/geometry/Cal3_S2Stereo.h>
+
+
+namespace ORB_SLAM2
+{
+
+class Map;
+class KeyFrame;
+class MapPoint;
+
+// Global bundle adjustment by incremental smoothing (iSAM2). Keyframes, MapPoints and their
+// observations enter the graph as Loop Closing processes keyframes, and each update only
+// relinearizes the variables reached by the new or removed factors and those whose
+// linearization point moved past the threshold.
+//
+// A loop correction keeps the graph: only the observations of the fused MapPoints and of the
+// keyframes around the loop are added, and a few more updates relinearize the variables the
+// loop moves. The loop observations start with large residuals, as iSAM2 cannot take the poses
+// corrected by the essential graph as linearization points, and the robust kernel makes them
+// pull linearly until the variables are relinearized close to the solution.
+//
+// A MapPoint enters the graph once two keyframes in the graph observe it. Observations removed
+// from the map (outliers, fused points), bad MapPoints and culled keyframes are removed from
+// the graph; variables left with too few factors are held in place by a weak prior. Bad
+// keyframes and MapPoints are taken from the log of the map instead of scanning the graph.
+//
+// Not thread safe, only used by the Loop Closing thread.
+class IncrementalBundleAdjustment
+{
+public:
+
+    IncrementalBundleAdjustment(Map* pMap, const bool bMonocular);
+
+    ~IncrementalBundleAdjustment();
+
+    // Adds the keyframe and any covisible keyframe not in the graph yet, brings the
+    // observations of its covisible keyframes up to date and runs one update. Returns false if
+    // the smoother failed, it is then rebuilt from the map on the next call.
+    bool AddKeyFrame(KeyFrame* pKF);
+
+    // Adds the observations changed by the loop fusion around pLoopKF, the current keyframe of
+    // the loop, and updates until the relinearization settles. On success mTcwGBA and mPosGBA
+    // hold the estimate of the keyframes and MapPoints in the graph, tagged with the id of
+    // pLoopKF in mnBAGlobalForKF like the full global BA.
+    bool CorrectLoop(KeyFrame* pLoopKF);
+
+    void Reset();
+
+    size_t KeyFramesInGraph();
+    size_t MapPointsInGraph();
+
+protected:
+
+    // Adds every keyframe of the map, after a reset or a failure
+    void Rebuild();
+
+    // Adds the keyframes missing from the graph and brings their observations up to date
+    void Sync(const std::vector<KeyFrame*> &vpKFs);
+    void SyncObservations(KeyFrame* pKF);
+
+    // Removes the factors of the keyframes and MapPoints erased from the map since the last
+    // call. The keyframes that observed an erased MapPoint are added to vpKFs, a fused MapPoint
+    // moved their observation to the one replacing it
+    void Prune(std::vector<KeyFrame*> &vpKFs);
+
+    void AddPose(KeyFrame* pKF);
+    void AddObservation(KeyFrame* pKF, MapPoint* pMP, const size_t idx);
+    void RemoveObservation(KeyFrame* pKF, MapPoint* pMP);
+    void AddFactor(const gtsam::NonlinearFactor::shared_ptr &factor, KeyFrame* pKF, MapPoint* pMP);
+    void AnchorPose(KeyFrame* pKF);
+    void AnchorPoint(MapPoint* pMP);
+
+    // Commits the pending factors, variables and removals in one update
+    gtsam::ISAM2Result Update();
+
+    Map* mpMap;
+    bool mbMonocular;
+
+    gtsam::ISAM2* mpIsam;
+    bool mbRebuild;
+
+    // Pending changes, committed by Update. mvNewFactorObservations holds the keyframe and
+    // MapPoint of each new factor, NULL for priors
+    gtsam::NonlinearFactorGraph mNewFactors;
+    gtsam::Values mNewValues;
+    gtsam::FactorIndices mvRemovedFactors;
+    std::vector<std::pair<KeyFrame*,MapPoint*> > mvNewFactorObservations;
+
+    // Factor index of each observation in the graph, per keyframe. Pending factors have no
+    // index yet
+    std::map<KeyFrame*,std::map<MapPoint*,size_t> > mmKeyFrameFactors;
+    // Keyframes with an observation in the graph of each MapPoint in the graph
+    std::map<MapPoint*,std::set<KeyFrame*> > mmPointFactors;
+    // Variables held by a weak prior
+    std::set<gtsam::Key> msAnchored;
+
+    gtsam::Cal3_S2::shared_ptr mK;
+    gtsam::Cal3_S2Stereo::shared_ptr mKStereo;
+    // Robust noise models per scale level
+    std::vector<gtsam::SharedNoiseModel> mvMonoNoise;
+    std::vector<gtsam::SharedNoiseModel> mvStereoNoise;
+};
+
+} //namespace ORB_SLAM
+
+#endif // INCREMENTALBUNDLEADJUSTMENT_H
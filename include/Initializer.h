@@ -21,6 +21,7 @@
 #define INITIALIZER_H
 
 #include<opencv2/opencv.hpp>
+#include<Eigen/Core>
 #include "Frame.h"
 
 
@@ -37,7 +38,7 @@ public:
     // Fix the reference frame
     Initializer(const Frame &ReferenceFrame, float sigma = 1.0, int iterations = 200);
 
-    // Computes in parallel a fundamental matrix and a homography
+    // Scores in parallel the fundamental matrix and homography hypotheses
     // Selects a model and tries to recover the motion and the structure from motion
     bool Initialize(const Frame &CurrentFrame, const vector<int> &vMatches12,
                     cv::Mat &R21, cv::Mat &t21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated);
@@ -45,15 +46,18 @@ public:
 
 private:
 
-    void FindHomography(vector<bool> &vbMatchesInliers, float &score, cv::Mat &H21);
-    void FindFundamental(vector<bool> &vbInliers, float &score, cv::Mat &F21);
+    // Computes the model from the minimal set of RANSAC iteration it and returns its score.
+    // vBuffer is scratch space of the calling thread.
+    float FindHomography(const int it, Eigen::Matrix3f &H21, vector<float> &vBuffer);
+    float FindFundamental(const int it, Eigen::Matrix3f &F21, vector<float> &vBuffer);
 
-    cv::Mat ComputeH21(const vector<cv::Point2f> &vP1, const vector<cv::Point2f> &vP2);
-    cv::Mat ComputeF21(const vector<cv::Point2f> &vP1, const vector<cv::Point2f> &vP2);
+    Eigen::Matrix3f ComputeH21(const cv::Point2f *vP1, const cv::Point2f *vP2);
+    Eigen::Matrix3f ComputeF21(const cv::Point2f *vP1, const cv::Point2f *vP2);
 
-    float CheckHomography(const cv::Mat &H21, const cv::Mat &H12, vector<bool> &vbMatchesInliers, float sigma);
+    // Inliers are only returned if pvbMatchesInliers is not NULL
+    float CheckHomography(const Eigen::Matrix3f &H21, const Eigen::Matrix3f &H12, vector<bool> *pvbMatchesInliers, float sigma, vector<float> &vBuffer);
 
-    float CheckFundamental(const cv::Mat &F21, vector<bool> &vbMatchesInliers, float sigma);
+    float CheckFundamental(const Eigen::Matrix3f &F21, vector<bool> *pvbMatchesInliers, float sigma, vector<float> &vBuffer);
 
     bool ReconstructF(vector<bool> &vbMatchesInliers, cv::Mat &F21, cv::Mat &K,
                       cv::Mat &R21, cv::Mat &t21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated, float minParallax, int minTriangulated);
@@ -63,7 +67,7 @@ private:
 
     void Triangulate(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const cv::Mat &P1, const cv::Mat &P2, cv::Mat &x3D);
 
-    void Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2f> &vNormalizedPoints, cv::Mat &T);
+    void Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2f> &vNormalizedPoints, Eigen::Matrix3f &T);
 
     int CheckRT(const cv::Mat &R, const cv::Mat &t, const vector<cv::KeyPoint> &vKeys1, const vector<cv::KeyPoint> &vKeys2,
                        const vector<Match> &vMatches12, vector<bool> &vbInliers,
@@ -82,6 +86,13 @@ private:
     vector<Match> mvMatches12;
     vector<bool> mvbMatched1;
 
+    // Coordinates of the matched keypoints, in match order
+    vector<float> mvU1, mvV1, mvU2, mvV2;
+
+    // Normalized keypoints and normalization transforms (the reference frame is normalized once)
+    vector<cv::Point2f> mvPn1, mvPn2;
+    Eigen::Matrix3f mT1, mT2;
+
     // Calibration
     cv::Mat mK;
 
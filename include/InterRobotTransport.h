@@ -0,0 +1,84 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERROBOTTRANSPORT_H
+#define INTERROBOTTRANSPORT_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2
+{
+
+// Relative pose between a keyframe of another robot (1) and a keyframe of this robot (2),
+// found by LoopClosingInterRobot
+struct InterRobotMeasurement
+{
+    char mSymbolChr1;
+    uint64_t mnSymbolIndex1;
+    char mSymbolChr2;
+    uint64_t mnSymbolIndex2;
+
+    // Pose of keyframe 2 in keyframe 1: rotation (3x3), translation (3x1) and scale
+    cv::Mat mR;
+    cv::Mat mt;
+    float mfScale;
+};
+
+// Link between the inter-robot loop closers of several robots. The keyframe channels carry the
+// messages encoded by KeyFrameCodec, the measurements go to the distributed mapper.
+// A backend delivers every published message to the other robots, possibly also to the sender.
+// Handlers are called from a thread of the backend, one message at a time per robot, and never
+// from inside Publish, so they can publish themselves.
+class InterRobotTransport
+{
+public:
+
+    enum eChannel{
+        KEYFRAME_SUMMARY=0,
+        KEYFRAME_REQUEST=1,
+        KEYFRAME=2,
+        NUM_CHANNELS=3
+    };
+
+    // Received bytes, kept alive by the backend as long as a copy of the pointer exists
+    typedef std::shared_ptr<const std::vector<unsigned char> > Message;
+
+    typedef std::function<void(const Message&)> MessageHandler;
+    typedef std::function<void(const InterRobotMeasurement&)> MeasurementHandler;
+
+    virtual ~InterRobotTransport() {}
+
+    // Publishes vData, which is left empty
+    virtual void Publish(eChannel channel, std::vector<unsigned char> &vData) = 0;
+    virtual void PublishMeasurement(const InterRobotMeasurement &measurement) = 0;
+
+    // Handlers are registered before the first message is published
+    virtual void Subscribe(eChannel channel, const MessageHandler &handler) = 0;
+    virtual void SubscribeMeasurements(const MeasurementHandler &handler) = 0;
+};
+
+} //namespace ORB_SLAM
+
+#endif // INTERROBOTTRANSPORT_H
@@ -28,6 +28,8 @@
 #include "ORBextractor.h"
 #include "Frame.h"
 #include "KeyFrameDatabase.h"
+#include "FeatureGrid.h"
+#include "WorkSignal.h"
 #include "cvSerialization.h"
 #include <gtsam/inference/Symbol.h>
 #include <mutex>
@@ -66,6 +68,8 @@ namespace ORB_SLAM2
     void EraseConnection(KeyFrame* pKF);
     void UpdateConnections();
     void UpdateBestCovisibles();
+    // Blocks until Local Mapping has connected the keyframe to the covisibility graph
+    void WaitUntilConnected();
     std::set<KeyFrame *> GetConnectedKeyFrames();
     std::vector<KeyFrame* > GetVectorCovisibleKeyFrames();
     std::vector<KeyFrame*> GetBestCovisibilityKeyFrames(const int &N);
@@ -203,6 +207,9 @@ namespace ORB_SLAM2
     // Spanning Tree and Loop Edges
     bool mbFirstConnection;
 
+    // Notified when a keyframe gets its first connections
+    static WorkSignal msConnectionsSignal;
+
     // The following variables need to be accessed trough a mutex to be thread safe.
   protected:
 
@@ -221,7 +228,7 @@ namespace ORB_SLAM2
     ORBVocabulary* mpORBvocabulary;
 
     // Grid over the image to speed up feature matching
-    std::vector< std::vector <std::vector<size_t> > > mGrid;
+    FeatureGrid mGrid;
 
     std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
     std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
@@ -0,0 +1,143 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KEYFRAMECODEC_H
+#define KEYFRAMECODEC_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+#include "Thirdparty/DBoW2/DBoW2/BowVector.h"
+#include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
+
+namespace ORB_SLAM2
+{
+
+class KeyFrame;
+
+// Keyframe of another robot, with what loop detection and the Sim3 computation need.
+// The per keypoint arrays have one entry per keypoint: keypoints without a map point have
+// index -1, world position (-1,-1,-1), distances -1 and a zero descriptor.
+struct RemoteKeyFrame
+{
+    int mnRobotId;
+    char mSymbolChr;
+    uint64_t mnSymbolIndex;
+
+    // Lowest BoW score of the keyframe to its covisible keyframes
+    float mfMinScore;
+
+    // Calibration and pose (3x4, CV_32F)
+    float fx, fy, cx, cy;
+    cv::Mat mK;
+    cv::Mat mTcw;
+
+    // Image bounds and grid
+    float mnMinX, mnMinY, mnMaxX, mnMaxY;
+    float mfGridElementWidthInv, mfGridElementHeightInv;
+
+    // Scale pyramid
+    int mnScaleLevels;
+    float mfLogScaleFactor;
+    std::vector<float> mvScaleFactors;
+    std::vector<float> mvLevelSigma2;
+    std::vector<float> mvInvLevelSigma2;
+
+    // Bag of words
+    DBoW2::BowVector mBowVec;
+    DBoW2::FeatureVector mFeatVec;
+
+    // Undistorted keypoints and their descriptors (N x 32, CV_8U)
+    std::vector<cv::KeyPoint> mvKeysUn;
+    cv::Mat mDescriptors;
+
+    // Map points, by keypoint. The world points (3x1) are rows of mWorldPositions
+    std::vector<int> mvIndices;
+    cv::Mat mWorldPositions;
+    std::vector<cv::Mat> mvWorldPoints;
+    std::vector<float> mvMaxDistanceInvariance;
+    std::vector<float> mvMinDistanceInvariance;
+    std::vector<cv::Mat> mvPointDescriptors;
+
+    // Decompressed payload or map point descriptors the descriptors point into, shared by the
+    // copies of the keyframe
+    cv::Mat mStorage;
+};
+
+// Versioned binary encoding of the messages exchanged between robots: keyframe summaries (identity,
+// minScore and BoW vector), requests for the full keyframe of a summary and full keyframes.
+//
+// An 18 byte header (magic, version, flags, robot id, target robot id, payload size and CRC-32) is
+// followed by the payload, deflated with zlib if COMPRESSED is set. The robot id is the one of the
+// sender, the target robot id the one of the robot a request or a requested keyframe is addressed
+// to (0xFFFF for summaries), so that the other robots can skip it without decoding it.
+// In the payload of a full keyframe keypoints are quantized to 1/8 pixel
+// and 1/65536 turn, BoW word and node ids and feature indices are delta coded varints, and only
+// the keypoints with a map point carry its position. Descriptors are packed 32 byte rows at the
+// end of the payload, so that decoding an uncompressed keyframe references them in place.
+// Multi-byte values are little-endian.
+class KeyFrameCodec
+{
+public:
+    static const uint8_t VERSION = 3;
+    static const size_t HEADER_BYTES = 18;
+
+    enum eFlags{
+        COMPRESSED=1,
+        SUMMARY=2,
+        REQUEST=4
+    };
+
+    // Fills kf from a local keyframe. Descriptors are shared, not copied.
+    // The keyframe must not be erased meanwhile (SetNotErase).
+    static void FromKeyFrame(KeyFrame* pKF, int nRobotId, float minScore, RemoteKeyFrame &kf);
+
+    // Replaces the content of vBuffer with the encoded keyframe, addressed to the robot that
+    // requested it (-1 for none)
+    static void Encode(const RemoteKeyFrame &kf, int nTargetRobotId, bool bCompress, std::vector<unsigned char> &vBuffer);
+
+    // Decodes a buffer produced by Encode. Returns false if it is truncated, corrupted, of
+    // another version or another kind of message. If the payload is not compressed the descriptors of kf reference pData,
+    // which then has to outlive kf.
+    static bool Decode(const unsigned char* pData, size_t nSize, RemoteKeyFrame &kf);
+
+    // Summary of a keyframe: only its identity, minScore and BoW vector, enough for DetectLoop
+    static void EncodeSummary(const RemoteKeyFrame &kf, std::vector<unsigned char> &vBuffer);
+    static bool DecodeSummary(const unsigned char* pData, size_t nSize, RemoteKeyFrame &kf);
+
+    // Request of robot nRobotId for the full keyframe nSymbolIndex of robot nTargetRobotId
+    static void EncodeRequest(int nRobotId, int nTargetRobotId, uint64_t nSymbolIndex, std::vector<unsigned char> &vBuffer);
+    static bool DecodeRequest(const unsigned char* pData, size_t nSize, int &nRobotId, int &nTargetRobotId,
+                              uint64_t &nSymbolIndex);
+
+    // Robot id of an encoded message without decoding the rest, -1 if the header is invalid
+    static int PeekRobotId(const unsigned char* pData, size_t nSize);
+
+    // Robot a message is addressed to without decoding the rest, -1 if it is not addressed to
+    // one or the header is invalid
+    static int PeekTargetRobotId(const unsigned char* pData, size_t nSize);
+};
+
+} //namespace ORB_SLAM
+
+#endif // KEYFRAMECODEC_H
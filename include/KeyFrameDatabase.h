@@ -24,6 +24,8 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <map>
+#include <stdint.h>
 
 #include "KeyFrame.h"
 #include "Frame.h"
@@ -44,6 +46,7 @@ class KeyFrameDatabase
 public:
 
     KeyFrameDatabase(const ORBVocabulary &voc);
+    ~KeyFrameDatabase();
 
    void add(KeyFrame* pKF);
 
@@ -68,13 +71,72 @@ public:
 
 protected:
 
+  // Keyframe stored in the database. Its address is stable while it is in the index.
+  struct Entry
+  {
+      KeyFrame* pKF;
+      // Dense id, reused after erase. Indexes the per query word counters.
+      uint32_t nSlot;
+      // Words of the keyframe when it was added and its position in each posting list
+      std::vector<DBoW2::WordId> vWords;
+      std::vector<uint32_t> vPositions;
+  };
+
+  // Element of a posting list: the keyframe and the index of the word in Entry::vWords
+  struct Posting
+  {
+      Entry* pEntry;
+      uint32_t nWord;
+  };
+
+  // Keyframe sharing words with a query. Kept per query, not in the KeyFrame.
+  struct Candidate
+  {
+      KeyFrame* pKF;
+      uint32_t nSlot;
+      int nWords;
+      float score;
+      bool bScored;
+  };
+
+  // Fills vCandidates with the keyframes sharing words with the queries, counting the shared words.
+  // Only takes the shard mutexes, so queries do not block each other.
+  void SearchSharingWords(const std::vector<const DBoW2::BowVector*> &vpBowVecs, std::vector<Candidate> &vCandidates);
+
+  // Scores the candidates sharing more than 80% of the maximum number of common words.
+  // Returns that minimum number of common words.
+  int ScoreCandidates(const DBoW2::BowVector &bowVec, std::vector<Candidate> &vCandidates);
+
+  // Lookup of candidates by keyframe (sorted index in vCandidates)
+  static void SortCandidates(const std::vector<Candidate> &vCandidates, std::vector<std::pair<KeyFrame*,int> > &vLookup);
+  static const Candidate* FindCandidate(const std::vector<Candidate> &vCandidates,
+                                        const std::vector<std::pair<KeyFrame*,int> > &vLookup, KeyFrame* pKF);
+
+  static const int NUM_SHARDS = 16;
+
+  static int Shard(DBoW2::WordId wordId){
+      return wordId%NUM_SHARDS;
+  }
+
+  // Groups the words by shard in one pass: the indices in vWords of the words of shard s are
+  // vOrder[vBegin[s]] to vOrder[vBegin[s+1]-1]
+  static void BucketByShard(const std::vector<DBoW2::WordId> &vWords, std::vector<uint32_t> &vOrder,
+                            size_t vBegin[NUM_SHARDS+1]);
+
   // Associated vocabulary
   const ORBVocabulary* mpVoc;
 
-  // Inverted file
-  std::vector<list<KeyFrame*> > mvInvertedFile;
+  // Inverted file. Posting lists are contiguous, a keyframe is removed by moving the last
+  // posting of the list into its place. The list of word w is guarded by mMutexShards[Shard(w)].
+  std::vector<std::vector<Posting> > mvInvertedFile;
+  std::mutex mMutexShards[NUM_SHARDS];
+
+  // Entries of the keyframes in the database and free slots
+  std::map<KeyFrame*,Entry*> mmEntries;
+  std::vector<uint32_t> mvFreeSlots;
+  uint32_t mnSlots;
 
-  // Mutex
+  // Mutex for the entries
   std::mutex mMutex;
 };
 
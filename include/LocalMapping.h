@@ -26,6 +26,8 @@
 #include "LoopClosing.h"
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
+#include "WorkSignal.h"
+#include "SPSCQueue.h"
 
 #include <mutex>
 
@@ -51,7 +53,8 @@ public:
     // Main function
     void Run();
 
-    void InsertKeyFrame(KeyFrame* pKF);
+    // Called only from the tracking thread. Returns false if the queue is full
+    bool InsertKeyFrame(KeyFrame* pKF);
 
     // Thread Synch
     void RequestStop();
@@ -69,11 +72,24 @@ public:
     void RequestFinish();
     bool isFinished();
 
+    // Block until the thread has stopped (or finished) after RequestStop, or has finished
+    void WaitUntilStopped();
+    void WaitUntilFinished();
+
+    // Wakeups of the mapping thread and how long keyframes and requests waited for it
+    WorkSignal::Stats GetQueueStats();
+
     int KeyframesInQueue(){
-        unique_lock<std::mutex> lock(mMutexNewKFs);
-        return mlNewKeyFrames.size();
+        return mqNewKeyFrames.Size();
+    }
+
+    bool KeyFrameQueueFull(){
+        return mqNewKeyFrames.Full();
     }
 
+    // Keyframes the loop closers had no room for
+    void GetQueueOverflows(int &nLoopClosing, int &nInterRobot);
+
     // Added by @itzsid
     void SetLoopCloseFlag(bool mbLoopCloseFlag);
     void SetLoopCloseInterRobotFlag(bool mbLoopCloseInterRobotFlag);
@@ -112,7 +128,10 @@ protected:
 
     Tracking* mpTracker;
 
-    std::list<KeyFrame*> mlNewKeyFrames;
+    // Tracking -> Local Mapping. Kept small: a long backlog means the map is falling
+    // behind the camera, and Tracking stops creating keyframes instead. Its capacity is the
+    // only limit on the keyframes waiting: 4, the 3 of ORB-SLAM2 rounded up to a power of two.
+    SPSCQueue<KeyFrame*> mqNewKeyFrames;
 
     KeyFrame* mpCurrentKeyFrame;
 
@@ -122,6 +141,9 @@ protected:
 
     bool mbAbortBA;
 
+    int mnLoopQueueOverflows;
+    int mnInterRobotQueueOverflows;
+
     bool mbStopped;
     bool mbStopRequested;
     bool mbNotStop;
@@ -130,6 +152,9 @@ protected:
     bool mbAcceptKeyFrames;
     std::mutex mMutexAccept;
 
+    // Notified on new keyframes and on every stop, reset and finish state change
+    WorkSignal mSignal;
+
     bool mbLoopClose; // Added by @itzsid
     bool mbLoopCloseInterRobot; // Added by @itzsid
     KeyFrameDatabase* mpKeyFrameDB;
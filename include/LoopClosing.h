@@ -28,6 +28,9 @@
 #include "Tracking.h"
 
 #include "KeyFrameDatabase.h"
+#include "IncrementalBundleAdjustment.h"
+#include "WorkSignal.h"
+#include "SPSCQueue.h"
 
 #include <thread>
 #include <mutex>
@@ -69,10 +72,15 @@ public:
     // Main function
     void Run();
 
-    void InsertKeyFrame(KeyFrame *pKF);
+    // Called only from the local mapping thread. Returns false if the queue is full
+    bool InsertKeyFrame(KeyFrame *pKF);
 
     void RequestReset();
 
+    // Corrected loops are refined by an incremental smoother kept up to date with every keyframe,
+    // instead of a full global BA restarted after each loop. Call before Run
+    void UseIncrementalBundleAdjustment();
+
     // This function will run in a separate thread
     void RunGlobalBundleAdjustment(unsigned long nLoopKF);
 
@@ -89,6 +97,12 @@ public:
 
     bool isFinished();
 
+    // Block until the thread and its global BA have finished
+    void WaitUntilFinished();
+
+    // Wakeups of the thread and how long keyframes and requests waited for it
+    WorkSignal::Stats GetQueueStats();
+
     bool loopClosureRetreived_;
     void setLoopClosureRetrievedToTrue();
     void setLoopClosureRetrievedToFalse();
@@ -118,6 +132,9 @@ protected:
     bool mbFinished;
     std::mutex mMutexFinish;
 
+    // Notified on new keyframes, on reset and finish state changes and when the GBA finishes
+    WorkSignal mSignal;
+
     Map* mpMap;
     Tracking* mpTracker;
 
@@ -126,7 +143,7 @@ protected:
 
     LocalMapping *mpLocalMapper;
 
-    std::list<KeyFrame*> mlpLoopKeyFrameQueue;
+    SPSCQueue<KeyFrame*> mqLoopKeyFrameQueue;
 
     std::mutex mMutexLoopQueue;
 
@@ -156,6 +173,14 @@ protected:
     std::mutex mMutexGBA;
     std::thread* mpThreadGBA;
 
+    // Sets the map to the global BA estimate (mTcwGBA, mPosGBA tagged with nLoopKF) and propagates
+    // the correction to the keyframes and MapPoints it did not include through the spanning tree.
+    // Local Mapping must be stopped and the map mutex held
+    void CorrectMapWithGBA(const unsigned long nLoopKF);
+
+    // NULL unless the incremental smoother is used
+    IncrementalBundleAdjustment* mpIncrementalBA;
+
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
 
@@ -29,22 +29,18 @@
 #include "LoopClosing.h"
 
 #include "KeyFrameDatabase.h"
+#include "WorkSignal.h"
+#include "SPSCQueue.h"
+#include "KeyFrameCodec.h"
+#include "RemoteKeyFrameDatabase.h"
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "Thirdparty/g2o/g2o/types/types_seven_dof_expmap.h"
 
-// ROS
-#include<ros/ros.h>
-#include "std_msgs/String.h"
-
-#include <cv_bridge/cv_bridge.h> // to convert desc to image
-#include <sensor_msgs/image_encodings.h>
-
-#include "distributed_mapper_msgs/Keyframe.h" // Keyframe
-#include "distributed_mapper_msgs/Keypoint.h" // Keypoint
-#include "distributed_mapper_msgs/Indices.h" // Indices
-#include "distributed_mapper_msgs/Measurement.h" // Measurement
+#include "InterRobotTransport.h"
 
 #include <map>
 
@@ -73,23 +69,90 @@ public:
     typedef map<KeyFrame*,g2o::Sim3,std::less<KeyFrame*>,
         Eigen::aligned_allocator<std::pair<const KeyFrame*, g2o::Sim3> > > KeyFrameAndPose;
 
+    // Order in which the requested keyframes waiting in the backlog are matched
+    enum eMatchPriority{
+        NEWEST_FIRST=0,
+        BEST_SCORE_FIRST=1      // highest BoW score of the summary to its loop candidates
+    };
+
+    // Keyframes received from a remote robot and what became of them
+    struct RemoteRobotStats
+    {
+        RemoteRobotStats();
+
+        unsigned long nSummaries;
+        unsigned long nRequests;
+        unsigned long nKeyFrames;
+
+        // Requests sent again after a timeout, and given up after the last attempt timed out
+        unsigned long nResent;
+        unsigned long nExpired;
+
+        // Requested keyframes dropped because the backlog was full
+        unsigned long nDropped;
+
+        // Keyframes matched by a worker, and those that gave a measurement
+        unsigned long nVerified;
+        unsigned long nMatched;
+
+        // Time from the request to the reception of the keyframe, in the backlog and matching (s)
+        double dTotalRequestLatency, dMaxRequestLatency;
+        double dTotalBacklogWait, dMaxBacklogWait;
+        double dTotalMatchTime, dMaxMatchTime;
+    };
+
 public:
 
-    LoopClosingInterRobot(Map* pMap, KeyFrameDatabase* pDB, ORBVocabulary* pVoc,const bool bFixScale, int robotID = 0, char robotName = 'a');
+    // Keyframes and measurements are exchanged through pTransport, which must outlive the loop closer
+    LoopClosingInterRobot(Map* pMap, KeyFrameDatabase* pDB, ORBVocabulary* pVoc,const bool bFixScale, InterRobotTransport* pTransport,
+                          int robotID = 0, char robotName = 'a');
 
     void SetTracker(Tracking* pTracker);
 
     void SetLocalMapper(LocalMapping* pLocalMapper);
 
+    // Deflate the published keyframes (off by default)
+    void SetCompressKeyFrames(bool bCompress);
+
+    // Requested keyframes are matched by nThreads workers. Up to nBacklog of them wait, beyond that
+    // the one with lowest priority is dropped. Call before Publish is launched (default: 1, 16, newest first).
+    void SetMatchingPool(int nThreads, int nBacklog, eMatchPriority priority);
+
+    // Memory for the summaries received from the other robots, the oldest are evicted beyond it
+    // (default: 64 MB)
+    void SetRemoteMemoryBudget(size_t nBytes);
+
+    // A requested keyframe that has not arrived after timeout seconds is requested again, up to
+    // nAttempts requests in total, then its candidates are dropped (default: 2 s, 3 attempts)
+    void SetRequestTimeout(double timeout, int nAttempts);
+
     // Main function
     void Publish();
-    void Subscribe(const distributed_mapper_msgs::Keyframe& keyframe);
-    bool Match(distributed_mapper_msgs::Keyframe keyframe);
+
+    // Keyframes are exchanged in two stages: every keyframe is published as a summary (its BoW
+    // vector), and a robot that finds loop candidates for a summary requests the full keyframe
+    void SubscribeSummary(const InterRobotTransport::Message& msg);
+    void SubscribeRequest(const InterRobotTransport::Message& msg);
+    void Subscribe(const InterRobotTransport::Message& msg);
+
+    // Detects loop candidates for a summary and requests its keyframe if there are any
+    bool Match(const RemoteKeyFrame &keyframe);
+    // Searches the stored summaries similar to a local keyframe and requests their keyframes
+    bool MatchRemoteKeyFrames(KeyFrame* pKF, float minScore);
+    // Computes the Sim3 of a requested keyframe to its loop candidates and publishes the measurement.
+    // Several keyframes can be verified at once.
+    bool Verify(const RemoteKeyFrame &keyframe, const std::vector<KeyFrame*> &vpCandidates);
+    // Matches the stored summaries against the map before it is reset, and waits until the
+    // keyframes it requested are verified or their requests expire.
     void MatchPreviousKeyFrames();
 
-    void InsertKeyFrame(KeyFrame *pKF);
+    // Called only from the local mapping thread. Returns false if the queue is full
+    bool InsertKeyFrame(KeyFrame *pKF);
 
+    // Blocks until the thread has dropped its state and no worker uses a keyframe of the map.
+    // Until FinishReset, called once the map has been cleared, no new matching job is accepted.
     void RequestReset();
+    void FinishReset();
 
     // This function will run in a separate thread
     void RunGlobalBundleAdjustment(unsigned long nLoopKF);
@@ -107,6 +170,18 @@ public:
 
     bool isFinished();
 
+    // Block until the thread and its global BA have finished
+    void WaitUntilFinished();
+
+    // Wakeups of the thread and how long keyframes and requests waited for it
+    WorkSignal::Stats GetQueueStats();
+
+    // By remote robot id
+    std::map<int, RemoteRobotStats> GetRemoteRobotStats();
+
+    // Summaries stored, their approximate memory and the number evicted
+    void GetRemoteKeyFrameUsage(size_t &nKeyFrames, size_t &nBytes, unsigned long &nEvicted);
+
     // added by @itzsid
     bool publishKeyFrame();
     bool loopClosureRetreived_;
@@ -116,19 +191,68 @@ public:
     LoopClosureInterRobot loopClosure_;
 
     char robotName_;
+    bool mbCompressKeyFrames;
     int robotID_;
 
-    
-    cv::Mat estimatedR_;
-    cv::Mat estimatedT_;
-    float estimatedS_;
-    char matchedSymbol_;
-    int matchedIndex_;
-    
 protected:
 
+    // Sim3 found by ComputeSim3, local to each verification
+    struct Sim3Match
+    {
+        KeyFrame* pMatchedKF;
+        cv::Mat R;
+        cv::Mat t;
+        float s;
+    };
+
+    // Requested keyframe waiting for a matching worker, decoded in place from its message
+    struct MatchJob
+    {
+        int robotID;
+        InterRobotTransport::Message msg;
+        RemoteKeyFrame kf;
+        std::vector<KeyFrame*> vpCandidates;
+        float priority;
+        unsigned long nSequence;
+        std::chrono::steady_clock::time_point tQueued;
+    };
+
+    // Higher priority first, then newer first
+    static bool Precedes(const MatchJob &a, const MatchJob &b);
+
+    // Loop candidates of a summary whose keyframe was requested
+    struct PendingRequest
+    {
+        std::vector<KeyFrame*> vpCandidates;
+        float score;
+        // First and last time it was sent
+        std::chrono::steady_clock::time_point tRequested;
+        std::chrono::steady_clock::time_point tSent;
+        int nAttempts;
+    };
+
+    // Requests the keyframe of a remote robot to verify it against vpCandidates. If it was already
+    // requested the candidates are added to the pending request.
+    void RequestKeyFrame(int nRobotId, uint64_t nSymbolIndex, const std::vector<KeyFrame*> &vpCandidates, float score);
+
+    // Sends again the requests that timed out and drops those out of attempts. Returns the time
+    // until the next one times out (s), negative if none is pending.
+    double ExpirePendingRequests();
+
+    // Dropped while the map is being reset
+    void PushMatchJob(MatchJob &job);
+
+    // Keyframes of the map are only used between BeginMapAccess and EndMapAccess. Returns false
+    // while a reset is clearing the map.
+    bool BeginMapAccess();
+    void EndMapAccess();
+
+    // Matching worker
+    void RunMatching();
+
     bool CheckNewKeyFrames();
 
+    // Call with mMutexDetection locked
     bool DetectLoop(const DBoW2::BowVector& keyFrameBoWVec, int mnId,  float minScore);
 
     bool ComputeSim3(const vector<cv::Mat>& mapPoints,
@@ -144,8 +268,9 @@ protected:
                      const vector<cv::Mat> &pointDescriptors, float mnMinX, float mnMinY, float mnMaxX,
                      float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv, float mnGridRows,
                      float mnGridCols, int mnScaleLevels, float mvLogScaleFactor,
-                     const std::vector<std::vector<std::vector<size_t> > >& mGrid,
-                     float fx, float fy, float cx, float cy);
+                     const FeatureGrid &grid,
+                     float fx, float fy, float cx, float cy,
+                     const std::vector<KeyFrame*> &vpCandidates, Sim3Match &match);
 
     void SearchAndFuse(const KeyFrameAndPose &CorrectedPosesMap);
 
@@ -161,6 +286,9 @@ protected:
     bool mbFinished;
     std::mutex mMutexFinish;
 
+    // Notified on new keyframes, on reset and finish state changes and when the GBA finishes
+    WorkSignal mSignal;
+
     Map* mpMap;
     Tracking* mpTracker;
 
@@ -169,18 +297,24 @@ protected:
 
     LocalMapping *mpLocalMapper;
 
-    std::list<KeyFrame*> mlpLoopKeyFrameQueue;
+    SPSCQueue<KeyFrame*> mqLoopKeyFrameQueue;
 
     std::mutex mMutexLoopQueue;
 
     // Loop detector parametersconst distributed_mapper_msgs::Keyframe& keyframe
     float mnCovisibilityConsistencyTh;
 
+    // Most recent summaries of each robot matched again before a reset
+    int mnPreviousKeyFrames;
+
     // Loop detector variables
     KeyFrame* mpCurrentKF;
     KeyFrame* mpMatchedKF;
     std::vector<ConsistentGroup> mvConsistentGroups;
     std::vector<KeyFrame*> mvpEnoughConsistentCandidates;
+    // Summaries are matched on the transport threads and by MatchPreviousKeyFrames on the
+    // tracking thread
+    std::mutex mMutexDetection;
     std::vector<KeyFrame*> mvpCurrentConnectedKFs;
     std::vector<MapPoint*> mvpCurrentMatchedPoints;
     std::vector<MapPoint*> mvpLoopMapPoints;
@@ -204,15 +338,34 @@ protected:
 
     bool mnFullBAIdx;
 
-    // Publishers and subscribers -- added by @itzsid
-    ros::Publisher keyframe_pub_;
-    ros::Subscriber keyframe_sub_;
-
-    // Measurement publisher
-    ros::Publisher measurement_pub_;
-
-    // Vector of keyframes
-    std::map<int, std::vector<distributed_mapper_msgs::Keyframe> > keyframes_;
+    // Keyframe and measurement exchange with the other robots
+    InterRobotTransport* mpTransport;
+
+    // Summaries received from the robots with a higher id. Kept across resets.
+    RemoteKeyFrameDatabase mRemoteKeyFrameDB;
+
+    // Own keyframes whose summary was published, with their minScore, by symbol index
+    std::map<uint64_t, std::pair<KeyFrame*,float> > mmPublishedKeyFrames;
+    // Summaries whose keyframe was requested, by robot and symbol index
+    std::map<std::pair<int,uint64_t>, PendingRequest> mmPendingRequests;
+    double mRequestTimeout;
+    int mnRequestAttempts;
+    std::mutex mMutexExchange;
+
+    // Matching workers and their backlog
+    int mnMatchThreads;
+    size_t mnMatchBacklog;
+    eMatchPriority mMatchPriority;
+    std::vector<std::thread> mvMatchThreads;
+    std::vector<MatchJob> mvMatchBacklog;
+    unsigned long mnMatchJobs;
+    bool mbStopMatching;
+    // Threads using keyframes of the map, and reset in progress
+    int mnMapUsers;
+    bool mbResettingMap;
+    std::map<int, RemoteRobotStats> mmRemoteRobotStats;
+    std::mutex mMutexMatching;
+    std::condition_variable mcvMatching;
 
 };
 
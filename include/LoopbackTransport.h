@@ -0,0 +1,130 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOOPBACKTRANSPORT_H
+#define LOOPBACKTRANSPORT_H
+
+#include "InterRobotTransport.h"
+#include "WorkSignal.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace ORB_SLAM2
+{
+
+class LoopbackTransport;
+
+// Connects the LoopbackTransport of robots running in the same process. Messages are shared
+// between the receivers, not copied.
+class LoopbackHub
+{
+public:
+
+    LoopbackHub();
+
+    struct Stats
+    {
+        Stats();
+
+        // Messages and bytes published per channel, measurements in the last entry (without bytes)
+        unsigned long nMessages[InterRobotTransport::NUM_CHANNELS+1];
+        unsigned long nBytes[InterRobotTransport::NUM_CHANNELS+1];
+    };
+
+    // Blocks until every robot has handled all the messages sent to it, including the ones
+    // published meanwhile by the handlers
+    void Flush();
+
+    Stats GetStats();
+
+protected:
+
+    friend class LoopbackTransport;
+
+    void Attach(LoopbackTransport* pTransport);
+    void Detach(LoopbackTransport* pTransport);
+
+    void Send(LoopbackTransport* pSender, int channel, const InterRobotTransport::Message &msg,
+              const InterRobotMeasurement* pMeasurement);
+
+    std::mutex mMutex;
+    std::vector<LoopbackTransport*> mvpTransports;
+    Stats mStats;
+
+    // Incremented by every Send(), to know if Flush() has to check again
+    unsigned long mnSent;
+};
+
+// In-process backend: each robot has a thread that hands the messages sent to it to its handlers,
+// as a ROS spinner does.
+class LoopbackTransport : public InterRobotTransport
+{
+public:
+
+    LoopbackTransport(LoopbackHub* pHub);
+
+    // Detaches from the hub and drops the messages not handled yet
+    ~LoopbackTransport();
+
+    void Publish(eChannel channel, std::vector<unsigned char> &vData);
+    void PublishMeasurement(const InterRobotMeasurement &measurement);
+
+    void Subscribe(eChannel channel, const MessageHandler &handler);
+    void SubscribeMeasurements(const MeasurementHandler &handler);
+
+    // Returns true if it had nothing to handle, otherwise waits until it has handled everything
+    bool Flush();
+
+protected:
+
+    friend class LoopbackHub;
+
+    struct Delivery
+    {
+        int channel;
+        Message msg;
+        InterRobotMeasurement measurement;
+    };
+
+    void Deliver(const Delivery &delivery);
+
+    void Run();
+
+    LoopbackHub* mpHub;
+
+    std::vector<MessageHandler> mvHandlers[NUM_CHANNELS];
+    std::vector<MeasurementHandler> mvMeasurementHandlers;
+
+    std::mutex mMutex;
+    std::deque<Delivery> mqDeliveries;
+    bool mbBusy;
+    bool mbFinish;
+
+    // Notified on deliveries, when the queue is drained and on finish
+    WorkSignal mSignal;
+
+    std::thread mThread;
+};
+
+} //namespace ORB_SLAM
+
+#endif // LOOPBACKTRANSPORT_H
@@ -55,6 +55,11 @@ public:
 
     long unsigned int GetMaxKFid();
 
+    // Once enabled, the keyframes and MapPoints erased from the map are kept until they are
+    // taken, so that their users do not need to scan the map for bad ones
+    void EnableErasedLog();
+    void TakeErased(std::vector<KeyFrame*> &vpKFs, std::vector<MapPoint*> &vpMPs);
+
     void clear();
 
     vector<KeyFrame*> mvpKeyFrameOrigins;
@@ -72,6 +77,10 @@ protected:
 
     long unsigned int mnMaxKFid;
 
+    bool mbLogErased;
+    std::vector<KeyFrame*> mvpErasedKeyFrames;
+    std::vector<MapPoint*> mvpErasedMapPoints;
+
     std::mutex mMutexMap;
 };
 
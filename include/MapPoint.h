@@ -27,6 +27,9 @@
 
 #include<opencv2/core/core.hpp>
 #include<mutex>
+#include<memory>
+#include<atomic>
+#include<vector>
 
 namespace ORB_SLAM2
 {
@@ -35,6 +38,72 @@ class KeyFrame;
 class Map;
 class Frame;
 
+// Immutable snapshot of the keyframes observing a MapPoint.
+// The MapPoint publishes a new snapshot on every change (read-copy-update), so readers can iterate
+// a snapshot without locking while the point is being modified by another thread. Snapshots are
+// freed through EpochReclaimer, so that taking a reference to the current one does not lock.
+// Entries loaded from an archive, and those of keyframes that stopped observing the point, only
+// know the keyframe id: they can be found with FindByKFId, but they are not iterated (they come
+// after the live entries).
+class MapPointObservations: public std::enable_shared_from_this<MapPointObservations>
+{
+public:
+    // Named like std::map<KeyFrame*,size_t>::value_type
+    struct Observation
+    {
+        KeyFrame* first;
+        size_t second;
+        long unsigned int mnKFId;
+    };
+
+    typedef std::vector<Observation>::const_iterator const_iterator;
+
+    MapPointObservations(): mnLive(0), mnVersion(0), mnObs(0) {}
+
+    const_iterator begin() const {
+        return mvObservations.begin();
+    }
+
+    const_iterator end() const {
+        return mvObservations.begin()+mnLive;
+    }
+
+    size_t size() const {
+        return mnLive;
+    }
+
+    bool empty() const {
+        return mnLive==0;
+    }
+
+    // Index of the keypoint in pKF, -1 if not observed
+    int Find(KeyFrame* pKF) const;
+    // Same for every keyframe id that ever observed the point, the current index first
+    int FindByKFId(long unsigned int nKFId) const;
+
+    // Incremented on every modification of the MapPoint observations
+    long unsigned int Version() const {
+        return mnVersion;
+    }
+
+    // Number of observations, stereo observations count twice
+    int Observations() const {
+        return mnObs;
+    }
+
+protected:
+    friend class MapPoint;
+
+    // Moves the live entry i to the entries that only have a keyframe id
+    void Retire(size_t i);
+
+    // Live entries first, then entries that only have a keyframe id
+    std::vector<Observation> mvObservations;
+    size_t mnLive;
+    long unsigned int mnVersion;
+    int mnObs;
+};
+
 
 class MapPoint
 {
@@ -45,11 +114,16 @@ public:
 
     void SetWorldPos(const cv::Mat &Pos);
     cv::Mat GetWorldPos();
+    // Same as GetWorldPos, without allocating
+    void GetWorldPos(float* pPos);
 
     cv::Mat GetNormal();
     KeyFrame* GetReferenceKeyFrame();
 
-    std::map<KeyFrame*,size_t> GetObservations();
+    typedef std::shared_ptr<const MapPointObservations> ObservationsPtr;
+
+    // Lock-free, the snapshot stays valid while the point keeps changing
+    ObservationsPtr GetObservations() const;
     int Observations();
 
     void AddObservation(KeyFrame* pKF,size_t idx);
@@ -82,7 +156,6 @@ public:
     float GetMaxDistanceInvariance();
     int PredictScale(const float &currentDist, KeyFrame*pKF);
     int PredictScale(const float &currentDist, Frame* pF);
-    void copyMObservations();
 
 public:
     long unsigned int mnId;
@@ -125,9 +198,15 @@ protected:
      // Position in absolute coordinates
      cv::Mat mWorldPos;
 
-     // Keyframes observing the point and associated index in keyframe
-     std::map<KeyFrame*,size_t> mObservations;
-     std::map<long unsigned int,size_t> mObservationsMnID;
+     // Keyframes observing the point and associated index in keyframe, replaced under mMutexFeatures.
+     // Readers load mpCurrentObservations in an EpochReclaimer::Guard, the replaced snapshots are retired.
+     ObservationsPtr mpObservations;
+     std::atomic<const MapPointObservations*> mpCurrentObservations;
+
+     // Copy of the current observations to be modified and published
+     std::shared_ptr<MapPointObservations> CopyObservations();
+     void PublishObservations(const std::shared_ptr<MapPointObservations> &pObs);
+     void ClearObservations();
 
      // Mean viewing direction
      cv::Mat mNormalVector;
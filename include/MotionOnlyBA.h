@@ -0,0 +1,126 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOTIONONLYBA_H
+#define MOTIONONLYBA_H
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+
+
+namespace ORB_SLAM2
+{
+
+// Motion-only bundle adjustment: optimizes the pose of a frame against fixed MapPoints. It is the
+// Levenberg-Marquardt of g2o (same damping schedule and stop criteria, Huber kernel, isotropic
+// information) specialized to a single SE3 vertex, so PoseOptimization keeps its results.
+//
+// Observations are stored in contiguous arrays, one per coordinate, and residuals, Jacobians and
+// the normal equations are evaluated several observations at a time so that the compiler emits
+// SIMD code for them. Outliers stay in the arrays and are masked out.
+//
+// Buffers keep their capacity on Clear, a reused instance does not allocate.
+class MotionOnlyBA
+{
+public:
+
+    enum eObservationType
+    {
+        MONOCULAR=0,
+        STEREO=1
+    };
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    MotionOnlyBA();
+
+    // Removes all observations and sets the calibration of the frame
+    void Clear(const float fx, const float fy, const float cx, const float cy, const float bf);
+
+    // idx is the index of the keypoint in the frame. Observations are added as inliers
+    void AddMonocular(const int idx, const float u, const float v, const float invSigma2, const float* pXw);
+    void AddStereo(const int idx, const float u, const float v, const float ur, const float invSigma2, const float* pXw);
+
+    void SetEstimate(const g2o::SE3Quat &Tcw);
+    const g2o::SE3Quat& GetEstimate() const;
+
+    // Huber kernel on every observation, on by default
+    void SetRobust(const bool bRobust);
+
+    // Runs up to nIterations on the inliers. Afterwards Chi2 is, as for a g2o edge, the error of
+    // the last step tried for inliers and the error at the estimate for outliers
+    void Optimize(const int nIterations);
+
+    size_t Size(const eObservationType type) const;
+    int Index(const eObservationType type, const size_t i) const;
+    double Chi2(const eObservationType type, const size_t i) const;
+    void SetInlier(const eObservationType type, const size_t i, const bool bInlier);
+
+protected:
+
+    struct Observations
+    {
+        // Observations added. The arrays are padded to a multiple of the block size before optimizing
+        size_t n;
+
+        std::vector<double> vX;
+        std::vector<double> vY;
+        std::vector<double> vZ;
+        std::vector<double> vU;
+        std::vector<double> vV;
+        std::vector<double> vUr;
+        std::vector<double> vInvSigma2;
+        std::vector<double> vChi2;
+        std::vector<unsigned char> vbInlier;
+        std::vector<int> vIndex;
+
+        void Clear();
+        void Add(const int idx, const float u, const float v, const float ur, const float invSigma2, const float* pXw);
+        void Pad();
+    };
+
+    // Robust chi2 of the inliers. With bLinearize it also accumulates the normal equations into
+    // H (upper triangle) and b
+    template<bool bStereo, bool bLinearize>
+    double Evaluate(Observations &obs, double* H, double* b);
+
+    template<bool bStereo>
+    void ComputeOutlierErrors(Observations &obs);
+
+    double Linearize(Eigen::Matrix<double,6,6> &H, Eigen::Matrix<double,6,1> &b);
+    double ComputeErrors();
+
+    double fx, fy, cx, cy, bf;
+    bool mbRobust;
+
+    g2o::SE3Quat mTcw;
+    // Pose of the evaluation, as a matrix
+    Eigen::Matrix3d mRcw;
+    Eigen::Vector3d mtcw;
+
+    Observations mObservations[2];
+};
+
+} //namespace ORB_SLAM
+
+#endif // MOTIONONLYBA_H
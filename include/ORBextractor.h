@@ -60,25 +60,31 @@ public:
       std::vector<cv::KeyPoint>& keypoints,
       cv::OutputArray descriptors);
 
+    // Same as above, but the descriptors are written into descriptorsBuffer, which is reused
+    // between calls and only grows when more keypoints are found than it can hold.
+    // descriptors is set to a view of its first rows.
+    void operator()( cv::InputArray image, std::vector<cv::KeyPoint>& keypoints,
+      cv::Mat &descriptorsBuffer, cv::Mat &descriptors);
+
     int inline GetLevels(){
         return nlevels;}
 
     float inline GetScaleFactor(){
         return scaleFactor;}
 
-    std::vector<float> inline GetScaleFactors(){
+    inline const std::vector<float>& GetScaleFactors(){
         return mvScaleFactor;
     }
 
-    std::vector<float> inline GetInverseScaleFactors(){
+    inline const std::vector<float>& GetInverseScaleFactors(){
         return mvInvScaleFactor;
     }
 
-    std::vector<float> inline GetScaleSigmaSquares(){
+    inline const std::vector<float>& GetScaleSigmaSquares(){
         return mvLevelSigma2;
     }
 
-    std::vector<float> inline GetInverseScaleSigmaSquares(){
+    inline const std::vector<float>& GetInverseScaleSigmaSquares(){
         return mvInvLevelSigma2;
     }
 
@@ -88,6 +94,8 @@ protected:
 
     void ComputePyramid(cv::Mat image);
     void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);    
+    void ComputeDescriptorsAndScale(std::vector<std::vector<cv::KeyPoint> >& allKeypoints, cv::Mat &descriptors,
+                                    std::vector<cv::KeyPoint>& keypoints);
     std::vector<cv::KeyPoint> DistributeOctTree(const std::vector<cv::KeyPoint>& vToDistributeKeys, const int &minX,
                                            const int &maxX, const int &minY, const int &maxY, const int &nFeatures, const int &level);
 
@@ -108,6 +116,11 @@ protected:
     std::vector<float> mvInvScaleFactor;    
     std::vector<float> mvLevelSigma2;
     std::vector<float> mvInvLevelSigma2;
+
+    // Buffers reused between images: pyramid levels with border (mvImagePyramid are views
+    // into them) and blurred levels used to compute the descriptors.
+    std::vector<cv::Mat> mvImagePyramidBorder;
+    std::vector<cv::Mat> mvBlurredPyramid;
 };
 
 } //namespace ORB_SLAM
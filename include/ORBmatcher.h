@@ -43,6 +43,13 @@ namespace ORB_SLAM2
     // Computes the Hamming distance between two ORB descriptors
     static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
+    // Computes the Hamming distances between descriptor a and every row of B in one call
+    static void DescriptorDistances(const cv::Mat &a, const cv::Mat &B, std::vector<int> &vDists);
+
+    // Computes the Hamming distances between every row of A and every row of B.
+    // D is a A.rows x B.rows CV_32S matrix
+    static void DescriptorDistances(const cv::Mat &A, const cv::Mat &B, cv::Mat &D);
+
     // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
     // Used to track the local map (Tracking)
     int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th=3);
@@ -61,7 +68,7 @@ namespace ORB_SLAM2
 
     int SearchByProjectionInterRobot( const vector<cv::KeyPoint>& keypoints,                                            const vector<float>& mvScaleFactors,
                                       float mnMinX, float mnMinY, float mnMaxX, float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv,
-                                      float mnGridRows, float mnGridCols, int mnScaleLevels,  float mfLogScaleFactor, std::vector< std::vector <std::vector<size_t> > > mGrid,
+                                      float mnGridRows, float mnGridCols, int mnScaleLevels,  float mfLogScaleFactor, const FeatureGrid &grid,
                                       const cv::Mat &Descriptors1,
                                       float fx, float fy, float cx, float cy,
                                       cv::Mat Scw, const vector<MapPoint*> &vpPoints, vector<MapPoint*> &vpMatched, int th);
@@ -73,9 +80,9 @@ namespace ORB_SLAM2
     int SearchByBoW(KeyFrame *pKF1, KeyFrame* pKF2, std::vector<MapPoint*> &vpMatches12);
 
 
-    vector<size_t> GetFeaturesInArea(float mnMinX, float mnMinY, float mfGridElementWidthInv, float mfGridElementHeightInv, float mnGridRows, float mnGridCols,
-                                     const vector<cv::KeyPoint>& keypoints,     std::vector< std::vector <std::vector<size_t> > > mGrid,
-                                     const float &x, const float &y, const float &r);
+    // Radius search in the grid of a keyframe received from another robot
+    vector<size_t> GetFeaturesInArea(const FeatureGrid &grid, const float &x, const float &y, const float &r,
+                                     const int minLevel=-1, const int maxLevel=-1);
 
     int PredictScale(const float &currentDist, float mfMaxDistance, int mnScaleLevels, float mfLogScaleFactor);
 
@@ -88,7 +95,7 @@ namespace ORB_SLAM2
                                const vector<float>& mvScaleFactors,
                                const vector<cv::Mat>& pointDescriptors,
                                float mnMinX, float mnMinY, float mnMaxX, float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv,
-                               float mnGridRows, float mnGridCols, int mnScaleLevels, float mvLogScaleFactor, std::vector< std::vector <std::vector<size_t> > > mGrid,
+                               float mnGridRows, float mnGridCols, int mnScaleLevels, float mvLogScaleFactor, const FeatureGrid &grid,
                                const cv::Mat &Descriptors1,
                                cv::Mat pose, cv::Mat K,
                                float fx, float fy, float cx, float cy,
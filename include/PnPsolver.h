@@ -52,6 +52,7 @@
 #define PNPSOLVER_H
 
 #include <opencv2/core/core.hpp>
+#include <Eigen/Core>
 #include "MapPoint.h"
 #include "Frame.h"
 
@@ -62,6 +63,10 @@ class PnPsolver {
  public:
   PnPsolver(const Frame &F, const vector<MapPoint*> &vpMapPointMatches);
 
+  // Raw 3D-2D correspondences (recorded data, benchmarks). Inlier flags are indexed as the input
+  PnPsolver(const vector<cv::Point3f> &vP3Dw, const vector<cv::Point2f> &vP2D, const vector<float> &vSigma2,
+            const float fx, const float fy, const float cx, const float cy);
+
   ~PnPsolver();
 
   void SetRansacParameters(double probability = 0.99, int minInliers = 8 , int maxIterations = 300, int minSet = 4, float epsilon = 0.4,
@@ -76,6 +81,13 @@ class PnPsolver {
   void CheckInliers();
   bool Refine();
 
+  // Fixed-size types used by the EPnP solver, row-major as the original buffers
+  typedef Eigen::Matrix<double,12,12,Eigen::RowMajor> Matrix12d;
+  typedef Eigen::Matrix<double,6,10,Eigen::RowMajor> Matrix6x10d;
+  typedef Eigen::Matrix<double,6,4,Eigen::RowMajor> Matrix6x4d;
+  typedef Eigen::Matrix<double,6,1> Vector6d;
+  typedef Eigen::Matrix<double,4,1> Vector4d;
+
   // Functions from the original EPnP code
   void set_maximum_number_of_correspondences(const int n);
   void reset_correspondences(void);
@@ -93,16 +105,16 @@ class PnPsolver {
 
   void choose_control_points(void);
   void compute_barycentric_coordinates(void);
-  void fill_M(CvMat * M, const int row, const double * alphas, const double u, const double v);
+  void fill_M(Matrix12d & MtM, const double * alphas, const double u, const double v);
   void compute_ccs(const double * betas, const double * ut);
   void compute_pcs(void);
 
   void solve_for_sign(void);
 
-  void find_betas_approx_1(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void find_betas_approx_2(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void find_betas_approx_3(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void qr_solve(CvMat * A, CvMat * b, CvMat * X);
+  void find_betas_approx_1(const Matrix6x10d & L_6x10, const Vector6d & Rho, double * betas);
+  void find_betas_approx_2(const Matrix6x10d & L_6x10, const Vector6d & Rho, double * betas);
+  void find_betas_approx_3(const Matrix6x10d & L_6x10, const Vector6d & Rho, double * betas);
+  void qr_solve(Matrix6x4d & A, Vector6d & b, Vector4d & X);
 
   double dot(const double * v1, const double * v2);
   double dist2(const double * p1, const double * p2);
@@ -110,9 +122,9 @@ class PnPsolver {
   void compute_rho(double * rho);
   void compute_L_6x10(const double * ut, double * l_6x10);
 
-  void gauss_newton(const CvMat * L_6x10, const CvMat * Rho, double current_betas[4]);
+  void gauss_newton(const Matrix6x10d & L_6x10, const Vector6d & Rho, double current_betas[4]);
   void compute_A_and_b_gauss_newton(const double * l_6x10, const double * rho,
-				    double cb[4], CvMat * A, CvMat * b);
+				    double cb[4], Matrix6x4d & A, Vector6d & b);
 
   double compute_R_and_t(const double * ut, const double * betas,
 			 double R[3][3], double t[3]);
@@ -134,14 +146,18 @@ class PnPsolver {
   double cws[4][3], ccs[4][3];
   double cws_determinant;
 
-  vector<MapPoint*> mvpMapPointMatches;
+  // Size of the inlier vector returned to the caller
+  size_t mnMatches;
 
-  // 2D Points
-  vector<cv::Point2f> mvP2D;
+  // 2D Points (structure of arrays, so that CheckInliers vectorizes)
+  vector<float> mvU, mvV;
   vector<float> mvSigma2;
 
   // 3D Points
-  vector<cv::Point3f> mvP3Dw;
+  vector<float> mvX, mvY, mvZ;
+
+  // Squared reprojection errors of the current hypothesis
+  vector<float> mvError2;
 
   // Index in Frame
   vector<size_t> mvKeyPointIndices;
@@ -170,6 +186,10 @@ class PnPsolver {
   // Indices for random selection [0 .. N-1]
   vector<size_t> mvAllIndices;
 
+  // Preallocated per-hypothesis buffers
+  vector<size_t> mvAvailableIndices;
+  vector<int> mvRefineIndices;
+
   // RANSAC probability
   double mRansacProb;
 
@@ -0,0 +1,155 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+namespace ORB_SLAM2
+{
+
+// Latency histograms and event counters for the stages of the pipeline.
+// Every thread records into its own histograms (no locks, no shared cache lines), which are
+// merged when read. Timing is on by default and costs two steady_clock reads per scope.
+class Profiler
+{
+public:
+
+    enum Stage
+    {
+        FRAME_EXTRACT_ORB=0,
+        FRAME_UNDISTORT,
+        FRAME_STEREO_MATCH,
+        FRAME_BOW,
+        TRACK,
+        TRACK_INITIALIZATION,
+        TRACK_REFERENCE_KF,
+        TRACK_MOTION_MODEL,
+        TRACK_RELOCALIZATION,
+        TRACK_LOCAL_MAP,
+        TRACK_NEW_KEYFRAME,
+        LOCAL_MAPPING_PROCESS_KF,
+        LOCAL_MAPPING_MAPPOINT_CULLING,
+        LOCAL_MAPPING_CREATE_MAPPOINTS,
+        LOCAL_MAPPING_SEARCH_NEIGHBORS,
+        LOCAL_MAPPING_KEYFRAME_CULLING,
+        OPTIMIZER_POSE,
+        OPTIMIZER_LOCAL_BA,
+        OPTIMIZER_GLOBAL_BA,
+        OPTIMIZER_ESSENTIAL_GRAPH,
+        OPTIMIZER_SIM3,
+        LOOP_DETECT,
+        LOOP_COMPUTE_SIM3,
+        LOOP_CORRECT,
+        N_STAGES
+    };
+
+    enum Counter
+    {
+        FRAMES=0,
+        KEYFRAMES_CREATED,
+        KEYFRAMES_REFUSED,
+        KEYFRAMES_CULLED,
+        MAPPOINTS_CREATED,
+        MAPPOINTS_CULLED,
+        LOOPS_DETECTED,
+        N_COUNTERS
+    };
+
+    struct StageStats
+    {
+        std::string name;
+        unsigned long count;
+
+        // Milliseconds. Percentiles are accurate to the histogram resolution (12.5%)
+        double total;
+        double mean;
+        double p50;
+        double p90;
+        double p99;
+        double max;
+    };
+
+    struct CounterStats
+    {
+        std::string name;
+        unsigned long value;
+    };
+
+    static void SetEnabled(bool bEnabled);
+    static bool Enabled();
+
+    static void Record(Stage stage, std::chrono::steady_clock::duration duration);
+    static void Count(Counter counter, unsigned long n = 1);
+
+    // Label for the calling thread in the per-thread output. When a thread exits its samples are
+    // merged with those of the finished threads with the same label (unlabeled ones together).
+    static void SetThreadName(const std::string &name);
+
+    // Merged over all threads
+    static std::vector<StageStats> GetStageStats();
+    static std::vector<CounterStats> GetCounterStats();
+
+    // Stage and counter totals, plus the stages recorded by each thread
+    static void WriteJSON(std::ostream &os);
+
+    // One line per stage: stage,count,total_ms,mean_ms,p50_ms,p90_ms,p99_ms,max_ms
+    static void WriteCSV(std::ostream &os);
+
+    // Clears all histograms and counters. Samples recorded concurrently may be lost
+    static void Reset();
+
+    static const char* StageName(Stage stage);
+    static const char* CounterName(Counter counter);
+};
+
+// Records the lifetime of the scope in the histogram of a stage
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Profiler::Stage stage): mStage(stage), mbEnabled(Profiler::Enabled())
+    {
+        if(mbEnabled)
+            mtStart = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedTimer()
+    {
+        if(mbEnabled)
+            Profiler::Record(mStage,std::chrono::steady_clock::now()-mtStart);
+    }
+
+private:
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+
+    Profiler::Stage mStage;
+    bool mbEnabled;
+    std::chrono::steady_clock::time_point mtStart;
+};
+
+} //namespace ORB_SLAM
+
+#endif // PROFILER_H
@@ -0,0 +1,127 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REMOTEKEYFRAMEDATABASE_H
+#define REMOTEKEYFRAMEDATABASE_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+
+#include "ORBVocabulary.h"
+#include "KeyFrameCodec.h"
+
+namespace ORB_SLAM2
+{
+
+// Summaries of the keyframes of other robots (identity, minScore and BoW vector), kept in a
+// compact form and indexed by word, so that they can be retried and queried by local keyframes.
+// When the memory used exceeds the budget the oldest summaries are evicted.
+class RemoteKeyFrameDatabase
+{
+public:
+
+    RemoteKeyFrameDatabase(const ORBVocabulary &voc, size_t nMaxBytes);
+    ~RemoteKeyFrameDatabase();
+
+    // Remote keyframe similar to a query
+    struct Candidate
+    {
+        int nRobotId;
+        uint64_t nSymbolIndex;
+        float score;
+    };
+
+    void SetMemoryBudget(size_t nMaxBytes);
+
+    // Adds a summary, returns false if it is already in the database
+    bool add(const RemoteKeyFrame &kf);
+
+    void clear();
+
+    // Remote keyframes with a score of at least minScore to bowVec and higher than 0.75 times the
+    // best one, best first
+    std::vector<Candidate> DetectCandidates(const DBoW2::BowVector &bowVec, float minScore);
+
+    // The nMaxPerRobot most recent summaries in the database of each robot, oldest first
+    void GetSummaries(std::map<int, std::vector<RemoteKeyFrame> > &mSummaries, size_t nMaxPerRobot);
+
+    void GetUsage(size_t &nKeyFrames, size_t &nBytes, unsigned long &nEvicted);
+
+protected:
+
+    // Summary stored in the database, sorted words with their weights
+    struct Entry
+    {
+        int nRobotId;
+        char mSymbolChr;
+        uint64_t mnSymbolIndex;
+        float mfMinScore;
+        // Dense id, reused after eviction. Indexes the per query word counters.
+        uint32_t nSlot;
+        std::vector<DBoW2::WordId> vWords;
+        std::vector<float> vWeights;
+        // Position of the entry in the posting list of each word
+        std::vector<uint32_t> vPositions;
+    };
+
+    // Element of a posting list: the entry and the index of the word in Entry::vWords
+    struct Posting
+    {
+        Entry* pEntry;
+        uint32_t nWord;
+    };
+
+    static size_t EntryBytes(const Entry* pEntry);
+
+    void EvictOldest();
+
+    static void ToBowVector(const Entry* pEntry, DBoW2::BowVector &bowVec);
+
+    // Associated vocabulary
+    const ORBVocabulary* mpVoc;
+
+    // Inverted file. Posting lists are contiguous, an entry is removed by moving the last
+    // posting of the list into its place.
+    std::vector<std::vector<Posting> > mvInvertedFile;
+
+    // Entries by robot and symbol index, and in insertion order
+    std::map<std::pair<int,uint64_t>, Entry*> mmEntries;
+    std::deque<Entry*> mdEntries;
+    std::vector<uint32_t> mvFreeSlots;
+    uint32_t mnSlots;
+
+    // Number of words shared with the query and L1 score accumulated over them by slot, reset
+    // after each query
+    std::vector<int> mvSlotWords;
+    std::vector<float> mvSlotScores;
+
+    size_t mnMaxBytes;
+    size_t mnBytes;
+    unsigned long mnEvicted;
+
+    std::mutex mMutex;
+};
+
+} //namespace ORB_SLAM
+
+#endif // REMOTEKEYFRAMEDATABASE_H
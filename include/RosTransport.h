@@ -0,0 +1,61 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ROSTRANSPORT_H
+#define ROSTRANSPORT_H
+
+#include "InterRobotTransport.h"
+
+#include<ros/ros.h>
+#include "std_msgs/UInt8MultiArray.h" // Encoded keyframe messages
+#include "distributed_mapper_msgs/Measurement.h" // Measurement
+
+namespace ORB_SLAM2
+{
+
+// ROS backend: every channel is a global std_msgs/UInt8MultiArray topic (/keyframe_summary,
+// /keyframe_request and /keyframe) and measurements are distributed_mapper_msgs/Measurement on
+// /measurement. ros::init must have been called, the handlers run in the ROS spinner.
+class RosTransport : public InterRobotTransport
+{
+public:
+
+    // The node handle lives in the namespace of the robot
+    RosTransport(char robotName);
+
+    void Publish(eChannel channel, std::vector<unsigned char> &vData);
+    void PublishMeasurement(const InterRobotMeasurement &measurement);
+
+    void Subscribe(eChannel channel, const MessageHandler &handler);
+    void SubscribeMeasurements(const MeasurementHandler &handler);
+
+protected:
+
+    ros::NodeHandle mNodeHandle;
+
+    ros::Publisher mvPublishers[NUM_CHANNELS];
+    ros::Publisher mMeasurementPublisher;
+
+    std::vector<ros::Subscriber> mvSubscribers;
+};
+
+} //namespace ORB_SLAM
+
+#endif // ROSTRANSPORT_H
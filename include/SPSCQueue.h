@@ -0,0 +1,121 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+
+namespace ORB_SLAM2
+{
+
+// Bounded lock-free ring buffer between one producer thread and one consumer thread.
+// Push fails when the queue is full, so that the producer decides what to do with the
+// item (backpressure) instead of the queue growing without limit.
+// Consumer operations (Pop, Clear) may also be called from another thread while the
+// consumer thread is parked, as long as the handover is synchronized (e.g. with a mutex).
+template<class T>
+class SPSCQueue
+{
+public:
+
+    // Capacity is rounded up to a power of two
+    explicit SPSCQueue(std::size_t capacity): mnHead(0), mnTail(0)
+    {
+        std::size_t n = 1;
+        while(n<capacity)
+            n <<= 1;
+        mvBuffer.resize(n);
+        mnMask = n-1;
+    }
+
+    // Producer. Returns false if the queue is full
+    bool Push(const T &item)
+    {
+        const std::size_t tail = mnTail.load(std::memory_order_relaxed);
+        if(tail-mnHead.load(std::memory_order_acquire) > mnMask)
+            return false;
+
+        mvBuffer[tail & mnMask] = item;
+        mnTail.store(tail+1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer. Returns false if the queue is empty
+    bool Pop(T &item)
+    {
+        const std::size_t head = mnHead.load(std::memory_order_relaxed);
+        if(head==mnTail.load(std::memory_order_acquire))
+            return false;
+
+        item = mvBuffer[head & mnMask];
+        mnHead.store(head+1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer
+    void Clear()
+    {
+        mnHead.store(mnTail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Exact when called from the producer or consumer thread, a snapshot otherwise
+    std::size_t Size() const
+    {
+        const std::size_t head = mnHead.load(std::memory_order_acquire);
+        const std::size_t tail = mnTail.load(std::memory_order_acquire);
+        return tail-head;
+    }
+
+    bool Empty() const
+    {
+        return Size()==0;
+    }
+
+    bool Full() const
+    {
+        return Size()>mnMask;
+    }
+
+    std::size_t Capacity() const
+    {
+        return mnMask+1;
+    }
+
+private:
+
+    std::vector<T> mvBuffer;
+    std::size_t mnMask;
+
+    // Consumer and producer positions on separate cache lines. Padding instead of alignas,
+    // since queues are members of heap-allocated thread objects (no aligned new in C++11)
+    char mPadding0[64];
+    std::atomic<std::size_t> mnHead;
+    char mPadding1[64];
+    std::atomic<std::size_t> mnTail;
+    char mPadding2[64];
+};
+
+} //namespace ORB_SLAM
+
+#endif // SPSCQUEUE_H
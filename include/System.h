@@ -36,6 +36,7 @@
 #include "KeyFrameDatabase.h"
 #include "ORBVocabulary.h"
 #include "Viewer.h"
+#include "Profiler.h"
 
 // GTSAM
 #include <gtsam/inference/Symbol.h>
@@ -47,6 +48,7 @@ class Viewer;
 class FrameDrawer;
 class Map;
 class Tracking;
+class TrackingPipeline;
 class LocalMapping;
 class LoopClosing;
 class LoopClosingInterRobot;
@@ -65,7 +67,10 @@ public:
 public:
 
     // Initialize the SLAM system. It launches the Local Mapping, Loop Closing and Viewer threads.
-    System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor, const bool bUseViewer = true, const bool bUseLoopClosure = true, const bool bUseInterRobotLoopCloser = false, int robotID = 0, char robotName = 'a', bool correctLoop = false);
+    // The inter-robot loop closer exchanges keyframes through pTransport if given (it must outlive
+    // the system), otherwise through ROS if the library was built with it.
+    System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor, const bool bUseViewer = true, const bool bUseLoopClosure = true, const bool bUseInterRobotLoopCloser = false, int robotID = 0, char robotName = 'a', bool correctLoop = false,
+           InterRobotTransport* pTransport = NULL);
 
     // Proccess the given stereo frame. Images must be synchronized and rectified.
     // Input images: RGB (CV_8UC3) or grayscale (CV_8U). RGB is converted to grayscale.
@@ -84,6 +89,17 @@ public:
     // Returns the camera pose (empty if tracking fails).
     cv::Mat TrackMonocular(const cv::Mat &im, const double &timestamp);
 
+    // Pipelined alternative to Track*: the features of the next frame are extracted while the
+    // current one is tracked (see TrackingPipeline). Submit* returns false if two frames are
+    // already in flight; their poses are then returned in order by PollPose (non-blocking) or
+    // WaitPose. Images must not be modified until their pose is returned.
+    // Do not mix with Track* calls.
+    bool SubmitStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp);
+    bool SubmitRGBD(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, gtsam::Key key = gtsam::Symbol('x', 999999));
+    bool SubmitMonocular(const cv::Mat &im, const double &timestamp);
+    bool PollPose(cv::Mat &Tcw, double &timestamp);
+    bool WaitPose(cv::Mat &Tcw, double &timestamp);
+
     // This stops local mapping thread (map building) and performs only camera tracking.
     void ActivateLocalizationMode();
     // This resumes local mapping thread and performs SLAM again.
@@ -115,6 +131,18 @@ public:
     // See format details at: http://www.cvlibs.net/datasets/kitti/eval_odometry.php
     void SaveTrajectoryKITTI(const string &filename);
 
+    // Latency of the pipeline stages (frame construction, tracking, local mapping, optimization,
+    // loop closing) over all threads, and event counters. Can be called while the system runs.
+    vector<Profiler::StageStats> GetStageStats();
+    vector<Profiler::CounterStats> GetCounterStats();
+
+    // JSON if the filename ends in .json, CSV otherwise
+    void SaveStageStats(const string &filename);
+
+    // Current size of the map
+    long unsigned int KeyFramesInMap();
+    long unsigned int MapPointsInMap();
+
     // TODO: Save/Load functions
     // SaveMap(const string &filename);
     // LoadMap(const string &filename);
@@ -147,6 +175,11 @@ public:
 
 private:
 
+    // Applies pending localization mode changes and reset requests before tracking a frame
+    void CheckModeAndReset();
+
+    TrackingPipeline* GetTrackingPipeline();
+
     // Input sensor
     eSensor mSensor;
 
@@ -188,6 +221,12 @@ private:
     std::mutex mMutexMode;
     bool mbActivateLocalizationMode;
     bool mbDeactivateLocalizationMode;
+
+    // Created by the first Submit* call
+    TrackingPipeline* mpTrackingPipeline;
+
+    // Inter-robot transport created by the system when none was given
+    InterRobotTransport* mpOwnTransport;
 };
 
 }// namespace ORB_SLAM
@@ -0,0 +1,70 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+namespace ORB_SLAM2
+{
+
+// Persistent pool with a bounded number of worker threads.
+// ParallelFor can be nested (e.g. the left and right extractors of a stereo frame each
+// parallelize over pyramid levels): the calling thread also executes iterations, so it never
+// waits for work that no thread is able to pick up.
+class ThreadPool
+{
+public:
+    ThreadPool(int nThreads);
+    ~ThreadPool();
+
+    // Pool shared by the whole process, with one worker per hardware thread (minus the caller)
+    static ThreadPool* Global();
+
+    // Runs f(i) for i in [0,n) on the calling thread and the workers.
+    // Returns when all iterations have finished.
+    void ParallelFor(int n, const std::function<void(int)> &f);
+
+    int GetNumThreads(){
+        return mvThreads.size();
+    }
+
+protected:
+
+    void Run();
+
+    std::vector<std::thread> mvThreads;
+
+    std::list<std::function<void()> > mlTasks;
+    std::mutex mMutexTasks;
+    std::condition_variable mcvTasks;
+    bool mbFinish;
+};
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOL_H
@@ -37,8 +37,11 @@
 #include "Initializer.h"
 #include "MapDrawer.h"
 #include "System.h"
+#include "AllocationCounter.h"
 
 #include <mutex>
+#include <atomic>
+#include <chrono>
 
 namespace ORB_SLAM2
 {
@@ -63,6 +66,18 @@ public:
     cv::Mat GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp,  gtsam::Key key = gtsam::Symbol('x', 999999));
     cv::Mat GrabImageMonocular(const cv::Mat &im, const double &timestamp);
 
+    // The two halves of GrabImage*, to build the next frame while the current one is tracked
+    // (see TrackingPipeline). PrepareFrame converts the image(s) to grayscale and builds the frame
+    // (ORB extraction, stereo matching or depth association). It may run on another thread than
+    // Track(), one frame ahead. im2 is the right image (stereo), the depthmap (RGB-D) or empty.
+    // Returns the number of resets when the frame was prepared: a frame prepared before a reset has to
+    // be prepared again. Frame ids are assigned by TrackFrame, in tracking order.
+    unsigned long PrepareFrame(const cv::Mat &im1, const cv::Mat &im2, const double &timestamp, gtsam::Key key,
+                               Frame &frame, cv::Mat &imGray);
+    cv::Mat TrackFrame(const Frame &frame, const cv::Mat &imGray);
+
+    unsigned long GetResetCount();
+
     void SetLocalMapper(LocalMapping* pLocalMapper);
     void SetLoopClosing(LoopClosing* pLoopClosing);
     void SetLoopClosingInterRobot(LoopClosingInterRobot* pLoopClosingInterRobot);
@@ -77,6 +92,31 @@ public:
     // Use this function if you have deactivated local mapping and you only want to localize the camera.
     void InformOnlyTracking(const bool &flag);
 
+    // Heap allocations made while processing the last image (see AllocationCounter).
+    // Always 0 unless the library is built with COUNT_ALLOCATIONS.
+    unsigned long GetAllocationsLastFrame(){
+        return mnAllocationsLastFrame;
+    }
+
+    // Seconds and frames from the first relocalization attempt after tracking was lost to the
+    // last successful relocalization. Negative if the tracking has never been recovered.
+    double GetTimeToRelocalize(){
+        return mdTimeToRelocalize;
+    }
+    int GetFramesToRelocalize(){
+        return mnFramesToRelocalize;
+    }
+
+    // Seconds spent in the last relocalization attempt
+    double GetLastRelocalizationTime(){
+        return mdLastRelocalizationTime;
+    }
+
+    // Keyframes not created because the Local Mapping queue was full
+    int GetRefusedKeyFrames(){
+        return mnRefusedKeyFrames;
+    }
+
 
 public:
 
@@ -117,6 +157,9 @@ public:
     // True if local mapping is deactivated and we are performing only localization
     bool mbOnlyTracking;
 
+    // Heap allocations made while processing the last image
+    unsigned long mnAllocationsLastFrame;
+
     void Reset();
 
     // Added by @itzsid
@@ -146,6 +189,9 @@ protected:
     // Main tracking function. It is independent of the input sensor.
     void Track();
 
+    // Grayscale conversion of an input image, in place
+    void ConvertToGray(cv::Mat &im);
+
     // Map initialization for stereo and RGB-D
     void StereoInitialization();
 
@@ -159,6 +205,7 @@ protected:
     bool TrackWithMotionModel();
 
     bool Relocalization();
+    void UpdateRelocalizationMetrics(const std::chrono::steady_clock::time_point &tStart, bool bRelocalized);
 
     void UpdateLocalMap();
     void UpdateLocalPoints();
@@ -235,6 +282,22 @@ protected:
     unsigned int mnLastKeyFrameId;
     unsigned int mnLastRelocFrameId;
 
+    // Relocalization metrics
+    bool mbLostSinceSet;
+    std::chrono::steady_clock::time_point mtLostSince;
+    long unsigned int mnLostSinceFrameId;
+    double mdTimeToRelocalize;
+    int mnFramesToRelocalize;
+    double mdLastRelocalizationTime;
+
+    int mnRefusedKeyFrames;
+
+    // Monocular uses more features until the map is initialized. Read when preparing frames
+    std::atomic<bool> mbWaitingInitialization;
+    std::mutex mMutexPrepareFrame;
+    // Resets so far, guarded by mMutexPrepareFrame
+    unsigned long mnResetCount;
+
     //Motion Model
     cv::Mat mVelocity;
 
@@ -0,0 +1,130 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACKINGPIPELINE_H
+#define TRACKINGPIPELINE_H
+
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+#include <gtsam/inference/Key.h>
+
+#include "Frame.h"
+#include "SPSCQueue.h"
+#include "WorkSignal.h"
+
+
+namespace ORB_SLAM2
+{
+
+class Tracking;
+
+// Two stage tracking: one thread prepares frame N+1 (grayscale conversion, ORB extraction, stereo
+// matching) while another tracks frame N. Frames are still tracked one at a time and in order.
+// Frames prepared before a reset of the tracker are prepared again on the tracking thread.
+//
+// Throughput goes from 1/(prepare+track) to 1/max(prepare,track) frames per second. The latency
+// of a single frame does not improve (it grows by the handoffs between threads), and a frame
+// may wait for the previous one to be tracked.
+//
+// Submit and Poll must be called from the same thread.
+class TrackingPipeline
+{
+public:
+
+    struct Result
+    {
+        double timestamp;
+        // Empty if tracking failed
+        cv::Mat Tcw;
+        // Tracking::eTrackingState after tracking the frame
+        int nState;
+    };
+
+    // beforeTrack is called on the tracking thread before each frame (mode changes and reset).
+    // nDepth is the number of frames that can be submitted and not yet polled
+    TrackingPipeline(Tracking* pTracker, const std::function<void()> &beforeTrack, int nDepth = 2);
+
+    // Frames in flight are tracked, their results discarded
+    ~TrackingPipeline();
+
+    // Returns false, without copying anything, if nDepth frames are already in flight.
+    // The images are not copied and must not be modified until the result of the frame is returned.
+    bool Submit(const cv::Mat &im1, const cv::Mat &im2, const double &timestamp, gtsam::Key key);
+
+    // Result of the oldest frame in flight. Poll returns false if it is not ready, Wait blocks
+    // until it is and returns false only if no frame is in flight.
+    bool Poll(Result &result);
+    bool Wait(Result &result);
+
+    int FramesInFlight();
+
+protected:
+
+    struct Input
+    {
+        cv::Mat im1;
+        cv::Mat im2;
+        double timestamp;
+        gtsam::Key key;
+    };
+
+    struct PreparedFrame
+    {
+        Input input;
+        Frame frame;
+        cv::Mat imGray;
+        // Tracker resets when it was prepared
+        unsigned long nResetCount;
+    };
+
+    void RunPrepare();
+    void RunTrack();
+
+    Tracking* mpTracker;
+    std::function<void()> mBeforeTrack;
+
+    // Frames submitted and not polled. Only used by the caller thread
+    int mnDepth;
+    int mnInFlight;
+
+    // Caller -> prepare -> track -> caller. Prepared frames go back to the prepare thread once
+    // tracked, so their buffers are reused
+    std::vector<PreparedFrame> mvPreparedFrames;
+    SPSCQueue<Input> mqInput;
+    SPSCQueue<PreparedFrame*> mqPrepared;
+    SPSCQueue<PreparedFrame*> mqFree;
+    SPSCQueue<Result> mqResults;
+
+    WorkSignal mPrepareSignal;
+    WorkSignal mTrackSignal;
+    WorkSignal mResultSignal;
+
+    std::atomic<bool> mbStop;
+
+    std::thread mtPrepare;
+    std::thread mtTrack;
+};
+
+} //namespace ORB_SLAM
+
+#endif // TRACKINGPIPELINE_H
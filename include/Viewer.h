@@ -26,6 +26,7 @@
 #include "MapDrawer.h"
 #include "Tracking.h"
 #include "System.h"
+#include "WorkSignal.h"
 
 #include <mutex>
 
@@ -52,6 +53,8 @@ public:
 
     bool isFinished();
 
+    void WaitUntilFinished();
+
     bool isStopped();
 
     void Release();
@@ -81,6 +84,9 @@ private:
     bool mbStopRequested;
     std::mutex mMutexStop;
 
+    // Notified on release and finish
+    WorkSignal mSignal;
+
 };
 
 }
@@ -0,0 +1,98 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORKSIGNAL_H
+#define WORKSIGNAL_H
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+namespace ORB_SLAM2
+{
+
+// Handoff between threads without polling. Producers call Notify() after changing the state
+// a thread waits for (new keyframe in a queue, stop/reset/finish request, GBA finished...).
+// - Wait() blocks the consumer until something was notified. A notification sent while the
+//   consumer is busy is kept, so the next Wait() returns immediately.
+// - WaitUntil(pred) blocks any number of threads until pred() holds. pred is checked again
+//   after every Notify(), so the state it reads may be protected by other mutexes.
+class WorkSignal
+{
+public:
+
+    struct Stats
+    {
+        Stats(): nWakeups(0), dTotalQueueWait(0), dMaxQueueWait(0), dTotalIdle(0) {}
+
+        // Number of times Wait() returned because of a notification
+        unsigned long nWakeups;
+
+        // Time between the first pending notification and the consumer picking it up (s)
+        double dTotalQueueWait;
+        double dMaxQueueWait;
+
+        // Time the consumer spent blocked in Wait() (s)
+        double dTotalIdle;
+    };
+
+    WorkSignal();
+
+    void Notify();
+
+    // Returns false if timeout (in seconds, negative to wait forever) expired without notification
+    bool Wait(double timeout = -1.0);
+
+    template<class Predicate>
+    void WaitUntil(Predicate pred)
+    {
+        while(1)
+        {
+            const unsigned long nSequence = GetSequence();
+            if(pred())
+                return;
+            WaitSequenceChange(nSequence);
+        }
+    }
+
+    Stats GetStats();
+
+protected:
+
+    unsigned long GetSequence();
+    void WaitSequenceChange(unsigned long nSequence);
+
+    std::mutex mMutex;
+    std::condition_variable mcv;
+
+    // Incremented by every Notify()
+    unsigned long mnSequence;
+
+    // A notification has not been consumed by Wait() yet
+    bool mbPending;
+    std::chrono::steady_clock::time_point mtPending;
+
+    Stats mStats;
+};
+
+} //namespace ORB_SLAM
+
+#endif // WORKSIGNAL_H
@@ -0,0 +1,113 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AllocationCounter.h"
+
+#include <stddef.h>
+#include <errno.h>
+
+namespace
+{
+
+// initial-exec avoids __tls_get_addr, which may itself allocate
+__thread unsigned long tnAllocations __attribute__((tls_model("initial-exec"))) = 0;
+
+}
+
+#ifdef ORB_SLAM2_COUNT_ALLOCATIONS
+
+// glibc allocator entry points, the replacements below count and forward to them
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size)
+{
+    ++tnAllocations;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    ++tnAllocations;
+    return __libc_calloc(n,size);
+}
+
+void* realloc(void* p, size_t size)
+{
+    ++tnAllocations;
+    return __libc_realloc(p,size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    ++tnAllocations;
+    return __libc_memalign(alignment,size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    ++tnAllocations;
+    return __libc_memalign(alignment,size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size)
+{
+    if(alignment%sizeof(void*)!=0 || (alignment & (alignment-1))!=0)
+        return EINVAL;
+
+    ++tnAllocations;
+    void* ptr = __libc_memalign(alignment,size);
+    if(!ptr)
+        return ENOMEM;
+
+    *p = ptr;
+    return 0;
+}
+}
+
+#endif
+
+namespace ORB_SLAM2
+{
+
+bool AllocationCounter::Enabled()
+{
+#ifdef ORB_SLAM2_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+unsigned long AllocationCounter::ThreadAllocations()
+{
+    return tnAllocations;
+}
+
+void AllocationCounter::AddThreadAllocations(unsigned long n)
+{
+    tnAllocations += n;
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,143 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EpochReclaimer.h"
+
+#include <vector>
+#include <thread>
+#include <climits>
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// Epoch a thread entered its Guard in, 0 outside a Guard
+struct alignas(64) Slot
+{
+    std::atomic<bool> mbUsed;
+    std::atomic<unsigned long> mnEpoch;
+};
+
+Slot gvSlots[EpochReclaimer::MAX_THREADS];
+
+// Advanced by every reclamation. Readers in a Guard entered before the advance may hold the
+// snapshots retired until then.
+std::atomic<unsigned long> gnEpoch(1);
+
+// Readers in a Guard without a slot
+std::atomic<int> gnUnslottedReaders(0);
+
+// Slot of a thread and the snapshots it retired, in retirement order
+class ThreadState
+{
+public:
+    ThreadState(): mpSlot(NULL)
+    {
+        for(int i=0; i<EpochReclaimer::MAX_THREADS; i++)
+        {
+            bool bUsed = false;
+            if(gvSlots[i].mbUsed.compare_exchange_strong(bUsed,true))
+            {
+                mpSlot = &gvSlots[i];
+                break;
+            }
+        }
+    }
+
+    ~ThreadState()
+    {
+        // Guards are short, wait for the readers that may still use the retired snapshots
+        while(!mvRetired.empty())
+        {
+            Reclaim();
+            if(!mvRetired.empty())
+                std::this_thread::yield();
+        }
+        if(mpSlot)
+            mpSlot->mbUsed = false;
+    }
+
+    void Reclaim()
+    {
+        if(gnUnslottedReaders.load()>0)
+            return;
+
+        // Snapshots retired before the oldest Guard still entered are not referenced anymore
+        gnEpoch.fetch_add(1);
+        unsigned long nOldest = ULONG_MAX;
+        for(int i=0; i<EpochReclaimer::MAX_THREADS; i++)
+        {
+            const unsigned long nEpoch = gvSlots[i].mnEpoch.load();
+            if(nEpoch!=0 && nEpoch<nOldest)
+                nOldest = nEpoch;
+        }
+
+        size_t nFree = 0;
+        while(nFree<mvRetired.size() && mvRetired[nFree].first<nOldest)
+            nFree++;
+        mvRetired.erase(mvRetired.begin(),mvRetired.begin()+nFree);
+    }
+
+    Slot* mpSlot;
+    std::vector<std::pair<unsigned long,std::shared_ptr<const void> > > mvRetired;
+};
+
+ThreadState& GetThreadState()
+{
+    static thread_local ThreadState state;
+    return state;
+}
+
+}
+
+EpochReclaimer::Guard::Guard()
+{
+    Slot* pSlot = GetThreadState().mpSlot;
+    if(pSlot)
+    {
+        mpSlot = &pSlot->mnEpoch;
+        mpSlot->store(gnEpoch.load());
+    }
+    else
+    {
+        mpSlot = NULL;
+        gnUnslottedReaders.fetch_add(1);
+    }
+}
+
+EpochReclaimer::Guard::~Guard()
+{
+    if(mpSlot)
+        mpSlot->store(0,std::memory_order_release);
+    else
+        gnUnslottedReaders.fetch_sub(1,std::memory_order_release);
+}
+
+void EpochReclaimer::Retire(std::shared_ptr<const void> pObject)
+{
+    ThreadState &state = GetThreadState();
+    state.mvRetired.push_back(std::make_pair(gnEpoch.load(),pObject));
+    if(state.mvRetired.size()>=RECLAIM_PERIOD)
+        state.Reclaim();
+}
+
+} //namespace ORB_SLAM
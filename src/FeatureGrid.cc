@@ -0,0 +1,180 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FeatureGrid.h"
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+FeatureGrid::FeatureGrid():
+    mnCols(0), mnRows(0), mfMinX(0), mfMinY(0), mfCellWidthInv(0), mfCellHeightInv(0)
+{
+}
+
+void FeatureGrid::Build(const vector<cv::KeyPoint> &vKeys, int nCols, int nRows,
+                        float fMinX, float fMinY, float fCellWidthInv, float fCellHeightInv)
+{
+    mnCols = nCols;
+    mnRows = nRows;
+    mfMinX = fMinX;
+    mfMinY = fMinY;
+    mfCellWidthInv = fCellWidthInv;
+    mfCellHeightInv = fCellHeightInv;
+
+    const int N = vKeys.size();
+    const int nCells = nCols*nRows;
+
+    // Counting sort of the keypoints by cell. mvCellStart first holds the cell sizes.
+    static thread_local vector<int> vKeyCell;
+    vKeyCell.resize(N);
+    mvCellStart.assign(nCells+1,0);
+
+    for(int i=0;i<N;i++)
+    {
+        const cv::KeyPoint &kp = vKeys[i];
+        const int posX = round((kp.pt.x-mfMinX)*mfCellWidthInv);
+        const int posY = round((kp.pt.y-mfMinY)*mfCellHeightInv);
+
+        //Keypoint's coordinates are undistorted, which could cause to go out of the image
+        if(posX<0 || posX>=nCols || posY<0 || posY>=nRows)
+        {
+            vKeyCell[i] = -1;
+            continue;
+        }
+
+        vKeyCell[i] = posY*nCols+posX;
+        mvCellStart[vKeyCell[i]+1]++;
+    }
+
+    for(int c=0; c<nCells; c++)
+        mvCellStart[c+1] += mvCellStart[c];
+
+    const uint32_t nInGrid = mvCellStart[nCells];
+    const bool b16 = N<=65536;
+    mvIndices16.resize(b16 ? nInGrid : 0);
+    mvIndices32.resize(b16 ? 0 : nInGrid);
+    mvX.resize(nInGrid);
+    mvY.resize(nInGrid);
+    mvOctave.resize(nInGrid);
+
+    // Scatter, advancing the start of each cell; keeps the keypoint order inside a cell
+    for(int i=0;i<N;i++)
+    {
+        if(vKeyCell[i]<0)
+            continue;
+
+        const uint32_t pos = mvCellStart[vKeyCell[i]]++;
+        if(b16)
+            mvIndices16[pos] = i;
+        else
+            mvIndices32[pos] = i;
+        mvX[pos] = vKeys[i].pt.x;
+        mvY[pos] = vKeys[i].pt.y;
+        mvOctave[pos] = vKeys[i].octave;
+    }
+
+    // Every start has moved to the start of the next cell, shift them back
+    for(int c=nCells; c>0; c--)
+        mvCellStart[c] = mvCellStart[c-1];
+    mvCellStart[0] = 0;
+}
+
+void FeatureGrid::Clear()
+{
+    mvCellStart.assign(mvCellStart.size(),0);
+    mvIndices16.clear();
+    mvIndices32.clear();
+    mvX.clear();
+    mvY.clear();
+    mvOctave.clear();
+}
+
+vector<size_t> FeatureGrid::GetFeaturesInArea(const float &x, const float &y, const float &r,
+                                              const int minLevel, const int maxLevel) const
+{
+    vector<size_t> vIndices;
+    GetFeaturesInArea(x,y,r,minLevel,maxLevel,vIndices);
+    return vIndices;
+}
+
+void FeatureGrid::GetFeaturesInArea(const float &x, const float &y, const float &r, const int minLevel, const int maxLevel,
+                                    vector<size_t> &vIndices) const
+{
+    vIndices.clear();
+
+    if(mvCellStart.empty())
+        return;
+
+    const int nMinCellX = max(0,(int)floor((x-mfMinX-r)*mfCellWidthInv));
+    if(nMinCellX>=mnCols)
+        return;
+
+    const int nMaxCellX = min(mnCols-1,(int)ceil((x-mfMinX+r)*mfCellWidthInv));
+    if(nMaxCellX<0)
+        return;
+
+    const int nMinCellY = max(0,(int)floor((y-mfMinY-r)*mfCellHeightInv));
+    if(nMinCellY>=mnRows)
+        return;
+
+    const int nMaxCellY = min(mnRows-1,(int)ceil((y-mfMinY+r)*mfCellHeightInv));
+    if(nMaxCellY<0)
+        return;
+
+    if(!mvIndices32.empty())
+        Query(mvIndices32,x,y,r,minLevel,maxLevel,nMinCellX,nMaxCellX,nMinCellY,nMaxCellY,vIndices);
+    else
+        Query(mvIndices16,x,y,r,minLevel,maxLevel,nMinCellX,nMaxCellX,nMinCellY,nMaxCellY,vIndices);
+}
+
+template<typename T>
+void FeatureGrid::Query(const vector<T> &vCellIndices, float x, float y, float r, int minLevel, int maxLevel,
+                        int nMinCellX, int nMaxCellX, int nMinCellY, int nMaxCellY, vector<size_t> &vIndices) const
+{
+    // Octaves are never negative, so a non positive minLevel does not filter anything
+    const int nMaxLevel = maxLevel>=0 ? maxLevel : INT_MAX;
+
+    const uint32_t nMaxEntries = mvCellStart[nMaxCellY*mnCols+nMaxCellX+1]-mvCellStart[nMinCellY*mnCols+nMinCellX];
+    vIndices.reserve(nMaxEntries);
+
+    for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
+    {
+        const uint32_t begin = mvCellStart[iy*mnCols+nMinCellX];
+        const uint32_t end = mvCellStart[iy*mnCols+nMaxCellX+1];
+
+        for(uint32_t j=begin; j<end; j++)
+        {
+            const int octave = mvOctave[j];
+            if(octave<minLevel || octave>nMaxLevel)
+                continue;
+
+            if(fabs(mvX[j]-x)<r && fabs(mvY[j]-y)<r)
+                vIndices.push_back(vCellIndices[j]);
+        }
+    }
+}
+
+} //namespace ORB_SLAM
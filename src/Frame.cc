@@ -22,6 +22,8 @@
 #include "Converter.h"
 #include "ORBmatcher.h"
 #include <thread>
+#include "ThreadPool.h"
+#include "Profiler.h"
 
 namespace ORB_SLAM2
 {
@@ -43,42 +45,93 @@ Frame::Frame(const Frame &frame)
      mvKeysRight(frame.mvKeysRight), mvKeysUn(frame.mvKeysUn),  mvuRight(frame.mvuRight),
      mvDepth(frame.mvDepth), mBowVec(frame.mBowVec), mFeatVec(frame.mFeatVec),
      mDescriptors(frame.mDescriptors.clone()), mDescriptorsRight(frame.mDescriptorsRight.clone()),
-     mvpMapPoints(frame.mvpMapPoints), mvbOutlier(frame.mvbOutlier), mnId(frame.mnId),
+     mvpMapPoints(frame.mvpMapPoints), mvbOutlier(frame.mvbOutlier), mGrid(frame.mGrid), mnId(frame.mnId),
      mpReferenceKF(frame.mpReferenceKF), mnScaleLevels(frame.mnScaleLevels),
      mfScaleFactor(frame.mfScaleFactor), mfLogScaleFactor(frame.mfLogScaleFactor),
      mvScaleFactors(frame.mvScaleFactors), mvInvScaleFactors(frame.mvInvScaleFactors),
      mvLevelSigma2(frame.mvLevelSigma2), mvInvLevelSigma2(frame.mvInvLevelSigma2)
 {
-    for(int i=0;i<FRAME_GRID_COLS;i++)
-        for(int j=0; j<FRAME_GRID_ROWS; j++)
-            mGrid[i][j]=frame.mGrid[i][j];
-
     if(!frame.mTcw.empty())
         SetPose(frame.mTcw);
 }
 
 
 Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
-    :mpORBvocabulary(voc),mpORBextractorLeft(extractorLeft),mpORBextractorRight(extractorRight), mTimeStamp(timeStamp), mK(K.clone()),mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
-     mpReferenceKF(static_cast<KeyFrame*>(NULL))
 {
-    // Frame ID
-    mnId=nNextId++;
+    CreateStereo(imLeft,imRight,timeStamp,extractorLeft,extractorRight,voc,K,distCoef,bf,thDepth);
+}
 
-    // Scale Level Info
-    mnScaleLevels = mpORBextractorLeft->GetLevels();
-    mfScaleFactor = mpORBextractorLeft->GetScaleFactor();
-    mfLogScaleFactor = log(mfScaleFactor);
-    mvScaleFactors = mpORBextractorLeft->GetScaleFactors();
-    mvInvScaleFactors = mpORBextractorLeft->GetInverseScaleFactors();
-    mvLevelSigma2 = mpORBextractorLeft->GetScaleSigmaSquares();
-    mvInvLevelSigma2 = mpORBextractorLeft->GetInverseScaleSigmaSquares();
+Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, gtsam::Key key)
+{
+    CreateRGBD(imGray,imDepth,timeStamp,extractor,voc,K,distCoef,bf,thDepth,key);
+}
 
-    // ORB extraction
-    thread threadLeft(&Frame::ExtractORB,this,0,imLeft);
-    thread threadRight(&Frame::ExtractORB,this,1,imRight);
-    threadLeft.join();
-    threadRight.join();
+Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
+{
+    CreateMonocular(imGray,timeStamp,extractor,voc,K,distCoef,bf,thDepth);
+}
+
+Frame& Frame::operator=(const Frame &frame)
+{
+    CopyFrom(frame);
+    return *this;
+}
+
+void Frame::CopyFrom(const Frame &frame)
+{
+    if(&frame==this)
+        return;
+
+    mpORBvocabulary = frame.mpORBvocabulary;
+    mpORBextractorLeft = frame.mpORBextractorLeft;
+    mpORBextractorRight = frame.mpORBextractorRight;
+    mTimeStamp = frame.mTimeStamp;
+    // Not copied into the current buffers: KeyFrames share mK with the Frame they were created from
+    mK = frame.mK.clone();
+    mDistCoef = frame.mDistCoef.clone();
+    mbf = frame.mbf;
+    mb = frame.mb;
+    mThDepth = frame.mThDepth;
+    N = frame.N;
+    mvKeys = frame.mvKeys;
+    mvKeysRight = frame.mvKeysRight;
+    mvKeysUn = frame.mvKeysUn;
+    mvuRight = frame.mvuRight;
+    mvDepth = frame.mvDepth;
+    mBowVec = frame.mBowVec;
+    mFeatVec = frame.mFeatVec;
+    CopyToBuffer(frame.mDescriptors,mDescriptorsBuffer,mDescriptors);
+    CopyToBuffer(frame.mDescriptorsRight,mDescriptorsRightBuffer,mDescriptorsRight);
+    mvpMapPoints = frame.mvpMapPoints;
+    mvbOutlier = frame.mvbOutlier;
+    mnId = frame.mnId;
+    mpReferenceKF = frame.mpReferenceKF;
+    key_ = frame.key_;
+    mnScaleLevels = frame.mnScaleLevels;
+    mfScaleFactor = frame.mfScaleFactor;
+    mfLogScaleFactor = frame.mfLogScaleFactor;
+    mvScaleFactors = frame.mvScaleFactors;
+    mvInvScaleFactors = frame.mvInvScaleFactors;
+    mvLevelSigma2 = frame.mvLevelSigma2;
+    mvInvLevelSigma2 = frame.mvInvLevelSigma2;
+    mGrid = frame.mGrid;
+
+    if(!frame.mTcw.empty())
+        SetPose(frame.mTcw);
+    else
+        ResetPose();
+}
+
+void Frame::CreateStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor* extractorLeft, ORBextractor* extractorRight, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
+{
+    Initialize(voc,extractorLeft,extractorRight,timeStamp,K,distCoef,bf,thDepth);
+
+    // ORB extraction. Left and right images are tasks on the shared pool, which the
+    // extractors also use to parallelize over pyramid levels.
+    ThreadPool::Global()->ParallelFor(2, [&](int i)
+    {
+        ExtractORB(i, i==0 ? imLeft : imRight);
+    });
 
     N = mvKeys.size();
 
@@ -89,8 +142,8 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 
     ComputeStereoMatches();
 
-    mvpMapPoints = vector<MapPoint*>(N,static_cast<MapPoint*>(NULL));    
-    mvbOutlier = vector<bool>(N,false);
+    mvpMapPoints.assign(N,static_cast<MapPoint*>(NULL));
+    mvbOutlier.assign(N,false);
 
 
     // This is done only for the first Frame (or after a change in the calibration)
@@ -116,21 +169,10 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
     AssignFeaturesToGrid();
 }
 
-Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, gtsam::Key key)
-    :mpORBvocabulary(voc),mpORBextractorLeft(extractor),mpORBextractorRight(static_cast<ORBextractor*>(NULL)),
-     mTimeStamp(timeStamp), mK(K.clone()),mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth), key_(key)
+void Frame::CreateRGBD(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, gtsam::Key key)
 {
-    // Frame ID
-    mnId=nNextId++;
-
-    // Scale Level Info
-    mnScaleLevels = mpORBextractorLeft->GetLevels();
-    mfScaleFactor = mpORBextractorLeft->GetScaleFactor();    
-    mfLogScaleFactor = log(mfScaleFactor);
-    mvScaleFactors = mpORBextractorLeft->GetScaleFactors();
-    mvInvScaleFactors = mpORBextractorLeft->GetInverseScaleFactors();
-    mvLevelSigma2 = mpORBextractorLeft->GetScaleSigmaSquares();
-    mvInvLevelSigma2 = mpORBextractorLeft->GetInverseScaleSigmaSquares();
+    Initialize(voc,extractor,static_cast<ORBextractor*>(NULL),timeStamp,K,distCoef,bf,thDepth);
+    key_ = key;
 
     // ORB extraction
     ExtractORB(0,imGray);
@@ -144,8 +186,8 @@ Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeSt
 
     ComputeStereoFromRGBD(imDepth);
 
-    mvpMapPoints = vector<MapPoint*>(N,static_cast<MapPoint*>(NULL));
-    mvbOutlier = vector<bool>(N,false);
+    mvpMapPoints.assign(N,static_cast<MapPoint*>(NULL));
+    mvbOutlier.assign(N,false);
 
     // This is done only for the first Frame (or after a change in the calibration)
     if(mbInitialComputations)
@@ -170,22 +212,9 @@ Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeSt
     AssignFeaturesToGrid();
 }
 
-
-Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
-    :mpORBvocabulary(voc),mpORBextractorLeft(extractor),mpORBextractorRight(static_cast<ORBextractor*>(NULL)),
-     mTimeStamp(timeStamp), mK(K.clone()),mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth)
+void Frame::CreateMonocular(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extractor,ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
 {
-    // Frame ID
-    mnId=nNextId++;
-
-    // Scale Level Info
-    mnScaleLevels = mpORBextractorLeft->GetLevels();
-    mfScaleFactor = mpORBextractorLeft->GetScaleFactor();
-    mfLogScaleFactor = log(mfScaleFactor);
-    mvScaleFactors = mpORBextractorLeft->GetScaleFactors();
-    mvInvScaleFactors = mpORBextractorLeft->GetInverseScaleFactors();
-    mvLevelSigma2 = mpORBextractorLeft->GetScaleSigmaSquares();
-    mvInvLevelSigma2 = mpORBextractorLeft->GetInverseScaleSigmaSquares();
+    Initialize(voc,extractor,static_cast<ORBextractor*>(NULL),timeStamp,K,distCoef,bf,thDepth);
 
     // ORB extraction
     ExtractORB(0,imGray);
@@ -198,11 +227,11 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
     UndistortKeyPoints();
 
     // Set no stereo information
-    mvuRight = vector<float>(N,-1);
-    mvDepth = vector<float>(N,-1);
+    mvuRight.assign(N,-1);
+    mvDepth.assign(N,-1);
 
-    mvpMapPoints = vector<MapPoint*>(N,static_cast<MapPoint*>(NULL));
-    mvbOutlier = vector<bool>(N,false);
+    mvpMapPoints.assign(N,static_cast<MapPoint*>(NULL));
+    mvbOutlier.assign(N,false);
 
     // This is done only for the first Frame (or after a change in the calibration)
     if(mbInitialComputations)
@@ -227,29 +256,84 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp, ORBextractor* extra
     AssignFeaturesToGrid();
 }
 
-void Frame::AssignFeaturesToGrid()
+void Frame::Initialize(ORBVocabulary* voc, ORBextractor* extractorLeft, ORBextractor* extractorRight, const double &timeStamp,
+                       cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth)
 {
-    int nReserve = 0.5f*N/(FRAME_GRID_COLS*FRAME_GRID_ROWS);
-    for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-        for (unsigned int j=0; j<FRAME_GRID_ROWS;j++)
-            mGrid[i][j].reserve(nReserve);
+    mpORBvocabulary = voc;
+    mpORBextractorLeft = extractorLeft;
+    mpORBextractorRight = extractorRight;
+    mTimeStamp = timeStamp;
+    mK = K.clone();
+    mDistCoef = distCoef.clone();
+    mbf = bf;
+    mThDepth = thDepth;
+    mpReferenceKF = static_cast<KeyFrame*>(NULL);
+
+    // Frame ID, assigned by Tracking::TrackFrame in tracking order
+    mnId=0;
 
-    for(int i=0;i<N;i++)
-    {
-        const cv::KeyPoint &kp = mvKeysUn[i];
+    // Scale Level Info
+    mnScaleLevels = mpORBextractorLeft->GetLevels();
+    mfScaleFactor = mpORBextractorLeft->GetScaleFactor();
+    mfLogScaleFactor = log(mfScaleFactor);
+    mvScaleFactors = mpORBextractorLeft->GetScaleFactors();
+    mvInvScaleFactors = mpORBextractorLeft->GetInverseScaleFactors();
+    mvLevelSigma2 = mpORBextractorLeft->GetScaleSigmaSquares();
+    mvInvLevelSigma2 = mpORBextractorLeft->GetInverseScaleSigmaSquares();
+
+    // Clear what a previous frame built in this object, keeping the capacity of the buffers
+    N = 0;
+    mvKeys.clear();
+    mvKeysRight.clear();
+    mvKeysUn.clear();
+    mvuRight.clear();
+    mvDepth.clear();
+    mBowVec.clear();
+    mFeatVec.clear();
+    mDescriptors = cv::Mat();
+    mDescriptorsRight = cv::Mat();
+    mvpMapPoints.clear();
+    mvbOutlier.clear();
+    mGrid.Clear();
+    ResetPose();
+}
+
+void Frame::ResetPose()
+{
+    mTcw = cv::Mat();
+    mRcw = cv::Mat();
+    mtcw = cv::Mat();
+    mRwc = cv::Mat();
+    mOw = cv::Mat();
+}
 
-        int nGridPosX, nGridPosY;
-        if(PosInGrid(kp,nGridPosX,nGridPosY))
-            mGrid[nGridPosX][nGridPosY].push_back(i);
+void Frame::CopyToBuffer(const cv::Mat &src, cv::Mat &buffer, cv::Mat &dst)
+{
+    if(src.empty())
+    {
+        dst = cv::Mat();
+        return;
     }
+
+    if(buffer.rows<src.rows || buffer.cols!=src.cols || buffer.type()!=src.type())
+        buffer.create(max(src.rows,buffer.rows),src.cols,src.type());
+
+    dst = buffer.rowRange(0,src.rows);
+    src.copyTo(dst);
+}
+
+void Frame::AssignFeaturesToGrid()
+{
+    mGrid.Build(mvKeysUn,FRAME_GRID_COLS,FRAME_GRID_ROWS,mnMinX,mnMinY,mfGridElementWidthInv,mfGridElementHeightInv);
 }
 
 void Frame::ExtractORB(int flag, const cv::Mat &im)
 {
+    ScopedTimer timer(Profiler::FRAME_EXTRACT_ORB);
     if(flag==0)
-        (*mpORBextractorLeft)(im,cv::Mat(),mvKeys,mDescriptors);
+        (*mpORBextractorLeft)(im,mvKeys,mDescriptorsBuffer,mDescriptors);
     else
-        (*mpORBextractorRight)(im,cv::Mat(),mvKeysRight,mDescriptorsRight);
+        (*mpORBextractorRight)(im,mvKeysRight,mDescriptorsRightBuffer,mDescriptorsRight);
 }
 
 void Frame::SetPose(cv::Mat Tcw)
@@ -326,57 +410,7 @@ bool Frame::isInFrustum(MapPoint *pMP, float viewingCosLimit)
 
 vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const float  &r, const int minLevel, const int maxLevel) const
 {
-    vector<size_t> vIndices;
-    vIndices.reserve(N);
-
-    const int nMinCellX = max(0,(int)floor((x-mnMinX-r)*mfGridElementWidthInv));
-    if(nMinCellX>=FRAME_GRID_COLS)
-        return vIndices;
-
-    const int nMaxCellX = min((int)FRAME_GRID_COLS-1,(int)ceil((x-mnMinX+r)*mfGridElementWidthInv));
-    if(nMaxCellX<0)
-        return vIndices;
-
-    const int nMinCellY = max(0,(int)floor((y-mnMinY-r)*mfGridElementHeightInv));
-    if(nMinCellY>=FRAME_GRID_ROWS)
-        return vIndices;
-
-    const int nMaxCellY = min((int)FRAME_GRID_ROWS-1,(int)ceil((y-mnMinY+r)*mfGridElementHeightInv));
-    if(nMaxCellY<0)
-        return vIndices;
-
-    const bool bCheckLevels = (minLevel>0) || (maxLevel>=0);
-
-    for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
-    {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
-        {
-            const vector<size_t> vCell = mGrid[ix][iy];
-            if(vCell.empty())
-                continue;
-
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
-            {
-                const cv::KeyPoint &kpUn = mvKeysUn[vCell[j]];
-                if(bCheckLevels)
-                {
-                    if(kpUn.octave<minLevel)
-                        continue;
-                    if(maxLevel>=0)
-                        if(kpUn.octave>maxLevel)
-                            continue;
-                }
-
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
-
-                if(fabs(distx)<r && fabs(disty)<r)
-                    vIndices.push_back(vCell[j]);
-            }
-        }
-    }
-
-    return vIndices;
+    return mGrid.GetFeaturesInArea(x,y,r,minLevel,maxLevel);
 }
 
 bool Frame::PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY)
@@ -396,6 +430,7 @@ void Frame::ComputeBoW()
 {
     if(mBowVec.empty())
     {
+        ScopedTimer timer(Profiler::FRAME_BOW);
         vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
         mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
     }
@@ -403,6 +438,7 @@ void Frame::ComputeBoW()
 
 void Frame::UndistortKeyPoints()
 {
+    ScopedTimer timer(Profiler::FRAME_UNDISTORT);
     if(mDistCoef.at<float>(0)==0.0)
     {
         mvKeysUn=mvKeys;
@@ -465,8 +501,9 @@ void Frame::ComputeImageBounds(const cv::Mat &imLeft)
 
 void Frame::ComputeStereoMatches()
 {
-    mvuRight = vector<float>(N,-1.0f);
-    mvDepth = vector<float>(N,-1.0f);
+    ScopedTimer timer(Profiler::FRAME_STEREO_MATCH);
+    mvuRight.assign(N,-1.0f);
+    mvDepth.assign(N,-1.0f);
 
     const int thOrbDist = (ORBmatcher::TH_HIGH+ORBmatcher::TH_LOW)/2;
 
@@ -642,8 +679,9 @@ void Frame::ComputeStereoMatches()
 
 void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth)
 {
-    mvuRight = vector<float>(N,-1);
-    mvDepth = vector<float>(N,-1);
+    ScopedTimer timer(Profiler::FRAME_STEREO_MATCH);
+    mvuRight.assign(N,-1);
+    mvDepth.assign(N,-1);
 
     for(int i=0; i<N; i++)
     {
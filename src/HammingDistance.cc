@@ -0,0 +1,315 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HammingDistance.h"
+
+#include<string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include<immintrin.h>
+#define HAMMING_X86
+#if defined(__GNUC__) && (__GNUC__ >= 8 || defined(__clang__))
+#define HAMMING_AVX512
+#endif
+#elif defined(__aarch64__)
+#include<arm_neon.h>
+#define HAMMING_NEON
+#endif
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// Bit set count operation from
+// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+int DistanceScalar(const uint8_t *a, const uint8_t *b)
+{
+    int dist=0;
+
+    for(int i=0; i<8; i++)
+    {
+        uint32_t wa, wb;
+        memcpy(&wa,a+4*i,4);
+        memcpy(&wb,b+4*i,4);
+
+        unsigned int v = wa ^ wb;
+        v = v - ((v >> 1) & 0x55555555);
+        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+    }
+
+    return dist;
+}
+
+void OneToManyScalar(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+{
+    for(size_t i=0; i<nB; i++, pB+=strideB)
+        pDists[i] = DistanceScalar(q,pB);
+}
+
+#ifdef HAMMING_X86
+
+__attribute__((target("popcnt")))
+int DistancePopcnt(const uint8_t *a, const uint8_t *b)
+{
+    uint64_t wa[4], wb[4];
+    memcpy(wa,a,32);
+    memcpy(wb,b,32);
+
+    return __builtin_popcountll(wa[0]^wb[0]) + __builtin_popcountll(wa[1]^wb[1]) +
+           __builtin_popcountll(wa[2]^wb[2]) + __builtin_popcountll(wa[3]^wb[3]);
+}
+
+__attribute__((target("popcnt")))
+void OneToManyPopcnt(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+{
+    uint64_t wq[4];
+    memcpy(wq,q,32);
+
+    for(size_t i=0; i<nB; i++, pB+=strideB)
+    {
+        uint64_t wb[4];
+        memcpy(wb,pB,32);
+        pDists[i] = __builtin_popcountll(wq[0]^wb[0]) + __builtin_popcountll(wq[1]^wb[1]) +
+                    __builtin_popcountll(wq[2]^wb[2]) + __builtin_popcountll(wq[3]^wb[3]);
+    }
+}
+
+// Per-byte popcount with a nibble lookup table (Mula et al.)
+__attribute__((target("avx2")))
+inline __m256i PopcountBytesAVX2(const __m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                         0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    const __m256i lo = _mm256_and_si256(v,low);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v,4),low);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lut,lo),_mm256_shuffle_epi8(lut,hi));
+}
+
+// Sums the four 64-bit lanes produced by _mm256_sad_epu8
+__attribute__((target("avx2")))
+inline int HorizontalSumAVX2(const __m256i v)
+{
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v),_mm256_extracti128_si256(v,1));
+    return _mm_cvtsi128_si32(s) + _mm_extract_epi32(s,2);
+}
+
+__attribute__((target("avx2")))
+int DistanceAVX2(const uint8_t *a, const uint8_t *b)
+{
+    const __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)a),
+                                       _mm256_loadu_si256((const __m256i*)b));
+    return HorizontalSumAVX2(_mm256_sad_epu8(PopcountBytesAVX2(x),_mm256_setzero_si256()));
+}
+
+__attribute__((target("avx2")))
+void OneToManyAVX2(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+{
+    const __m256i vq = _mm256_loadu_si256((const __m256i*)q);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i=0;
+
+    // Two descriptors per iteration: the byte counts are reduced with a single unpack
+    for(; i+2<=nB; i+=2, pB+=2*strideB)
+    {
+        const __m256i x0 = _mm256_xor_si256(vq,_mm256_loadu_si256((const __m256i*)pB));
+        const __m256i x1 = _mm256_xor_si256(vq,_mm256_loadu_si256((const __m256i*)(pB+strideB)));
+        const __m256i s0 = _mm256_sad_epu8(PopcountBytesAVX2(x0),zero);
+        const __m256i s1 = _mm256_sad_epu8(PopcountBytesAVX2(x1),zero);
+        // [s0_0 s1_0 s0_2 s1_2] + [s0_1 s1_1 s0_3 s1_3]
+        const __m256i s = _mm256_add_epi64(_mm256_unpacklo_epi64(s0,s1),_mm256_unpackhi_epi64(s0,s1));
+        const __m128i t = _mm_add_epi64(_mm256_castsi256_si128(s),_mm256_extracti128_si256(s,1));
+        pDists[i] = _mm_cvtsi128_si32(t);
+        pDists[i+1] = _mm_extract_epi32(t,2);
+    }
+
+    if(i<nB)
+        pDists[i] = DistanceAVX2(q,pB);
+}
+
+#ifdef HAMMING_AVX512
+
+__attribute__((target("avx512f,avx512vl,avx512vpopcntdq")))
+int DistanceAVX512(const uint8_t *a, const uint8_t *b)
+{
+    const __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)a),
+                                       _mm256_loadu_si256((const __m256i*)b));
+    const __m256i c = _mm256_popcnt_epi64(x);
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(c),_mm256_extracti128_si256(c,1));
+    return _mm_cvtsi128_si32(s) + _mm_extract_epi32(s,2);
+}
+
+__attribute__((target("avx512f,avx512vl,avx512vpopcntdq")))
+void OneToManyAVX512(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+{
+    const __m256i vq = _mm256_loadu_si256((const __m256i*)q);
+
+    size_t i=0;
+
+    // Two descriptors per iteration: the lane counts are reduced with a single unpack
+    for(; i+2<=nB; i+=2, pB+=2*strideB)
+    {
+        const __m256i c0 = _mm256_popcnt_epi64(_mm256_xor_si256(vq,_mm256_loadu_si256((const __m256i*)pB)));
+        const __m256i c1 = _mm256_popcnt_epi64(_mm256_xor_si256(vq,_mm256_loadu_si256((const __m256i*)(pB+strideB))));
+        const __m256i s = _mm256_add_epi64(_mm256_unpacklo_epi64(c0,c1),_mm256_unpackhi_epi64(c0,c1));
+        const __m128i t = _mm_add_epi64(_mm256_castsi256_si128(s),_mm256_extracti128_si256(s,1));
+        pDists[i] = _mm_cvtsi128_si32(t);
+        pDists[i+1] = _mm_extract_epi32(t,2);
+    }
+
+    if(i<nB)
+        pDists[i] = DistanceAVX512(q,pB);
+}
+
+#endif // HAMMING_AVX512
+
+#endif // HAMMING_X86
+
+#ifdef HAMMING_NEON
+
+int DistanceNEON(const uint8_t *a, const uint8_t *b)
+{
+    const uint8x16_t x0 = veorq_u8(vld1q_u8(a),vld1q_u8(b));
+    const uint8x16_t x1 = veorq_u8(vld1q_u8(a+16),vld1q_u8(b+16));
+    return vaddlvq_u8(vaddq_u8(vcntq_u8(x0),vcntq_u8(x1)));
+}
+
+void OneToManyNEON(const uint8_t *q, const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+{
+    const uint8x16_t q0 = vld1q_u8(q);
+    const uint8x16_t q1 = vld1q_u8(q+16);
+
+    for(size_t i=0; i<nB; i++, pB+=strideB)
+    {
+        const uint8x16_t x0 = veorq_u8(q0,vld1q_u8(pB));
+        const uint8x16_t x1 = veorq_u8(q1,vld1q_u8(pB+16));
+        pDists[i] = vaddlvq_u8(vaddq_u8(vcntq_u8(x0),vcntq_u8(x1)));
+    }
+}
+
+#endif // HAMMING_NEON
+
+struct Kernel
+{
+    const char* name;
+    HammingDistance::DistanceFunction distance;
+    HammingDistance::OneToManyFunction oneToMany;
+};
+
+// Kernels supported by the running CPU, from slowest to fastest
+std::vector<Kernel> SupportedKernels()
+{
+    std::vector<Kernel> vKernels;
+    Kernel scalar = {"scalar", DistanceScalar, OneToManyScalar};
+    vKernels.push_back(scalar);
+
+#ifdef HAMMING_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("popcnt"))
+    {
+        Kernel popcnt = {"popcnt", DistancePopcnt, OneToManyPopcnt};
+        vKernels.push_back(popcnt);
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        Kernel avx2 = {"avx2", DistanceAVX2, OneToManyAVX2};
+        vKernels.push_back(avx2);
+    }
+#ifdef HAMMING_AVX512
+    if(__builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512vpopcntdq"))
+    {
+        Kernel avx512 = {"avx512", DistanceAVX512, OneToManyAVX512};
+        vKernels.push_back(avx512);
+    }
+#endif
+#endif
+
+#ifdef HAMMING_NEON
+    Kernel neon = {"neon", DistanceNEON, OneToManyNEON};
+    vKernels.push_back(neon);
+#endif
+
+    return vKernels;
+}
+
+// Single descriptor distances are dominated by the load latency, POPCNT is as fast as the
+// vector kernels there. The vector kernels pay off in the batched calls.
+bool SelectDefaultKernel()
+{
+    const std::vector<Kernel> vKernels = SupportedKernels();
+    return HammingDistance::SetKernel(vKernels.back().name);
+}
+
+} // namespace
+
+// Statically initialized to the scalar kernel so that they are valid before SelectDefaultKernel runs
+HammingDistance::DistanceFunction HammingDistance::mpDistance = DistanceScalar;
+HammingDistance::OneToManyFunction HammingDistance::mpOneToMany = OneToManyScalar;
+const char* HammingDistance::mpKernelName = "scalar";
+
+static const bool bDefaultKernelSelected = SelectDefaultKernel();
+
+void HammingDistance::ManyToMany(const uint8_t *pA, size_t strideA, size_t nA,
+                                 const uint8_t *pB, size_t strideB, size_t nB, int *pDists)
+{
+    for(size_t i=0; i<nA; i++, pA+=strideA, pDists+=nB)
+        mpOneToMany(pA,pB,strideB,nB,pDists);
+}
+
+std::vector<std::string> HammingDistance::AvailableKernels()
+{
+    const std::vector<Kernel> vKernels = SupportedKernels();
+    std::vector<std::string> vNames;
+    for(size_t i=0; i<vKernels.size(); i++)
+        vNames.push_back(vKernels[i].name);
+    return vNames;
+}
+
+bool HammingDistance::SetKernel(const std::string &name)
+{
+    const std::vector<Kernel> vKernels = SupportedKernels();
+    for(size_t i=0; i<vKernels.size(); i++)
+    {
+        if(name==vKernels[i].name)
+        {
+            mpDistance = vKernels[i].distance;
+            mpOneToMany = vKernels[i].oneToMany;
+            mpKernelName = vKernels[i].name;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string HammingDistance::KernelName()
+{
+    return mpKernelName;
+}
+
+HammingDistance::DistanceFunction HammingDistance::KernelDistance()
+{
+    return mpDistance;
+}
+
+} //namespace ORB_SLAM
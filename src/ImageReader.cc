@@ -0,0 +1,141 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageReader.h"
+
+#include <opencv2/highgui/highgui.hpp>
+
+
+namespace ORB_SLAM2
+{
+
+ImageReader::ImageReader(const std::vector<std::string> &vstrImages1, const std::vector<std::string> &vstrImages2,
+                         int nPrefetch, int nThreads, const PostProcess &postProcess):
+    mvstrImages1(vstrImages1), mvstrImages2(vstrImages2), mPostProcess(postProcess),
+    mvSlots(std::max(nPrefetch,1)), mnNextToLoad(0), mnNextToRead(0), mnErrorIndex(-1), mbStop(false)
+{
+    for(int i=0; i<std::max(nThreads,1); i++)
+        mvThreads.push_back(std::thread(&ImageReader::Run,this));
+}
+
+ImageReader::~ImageReader()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mbStop = true;
+    }
+    mcv.notify_all();
+
+    for(size_t i=0; i<mvThreads.size(); i++)
+        mvThreads[i].join();
+}
+
+void ImageReader::Run()
+{
+    while(1)
+    {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mcv.wait(lock,[this]{
+                return mbStop || mnNextToLoad>=mvstrImages1.size() || mnNextToLoad<mnNextToRead+mvSlots.size();
+            });
+            if(mbStop || mnNextToLoad>=mvstrImages1.size())
+                return;
+            i = mnNextToLoad++;
+        }
+
+        Slot slot;
+        slot.nIndex = i;
+        slot.im1 = cv::imread(mvstrImages1[i],CV_LOAD_IMAGE_UNCHANGED);
+        if(!mvstrImages2.empty())
+            slot.im2 = cv::imread(mvstrImages2[i],CV_LOAD_IMAGE_UNCHANGED);
+
+        std::string strError;
+        if(slot.im1.empty())
+            strError = mvstrImages1[i];
+        else if(!mvstrImages2.empty() && slot.im2.empty())
+            strError = mvstrImages2[i];
+        else if(mPostProcess)
+            mPostProcess(slot.im1,slot.im2);
+        slot.bFailed = !strError.empty();
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if(slot.bFailed && (mnErrorIndex<0 || slot.nIndex<mnErrorIndex))
+            {
+                mstrError = strError;
+                mnErrorIndex = slot.nIndex;
+            }
+            mvSlots[i%mvSlots.size()] = slot;
+        }
+        mcv.notify_all();
+
+        // Frames after a missing image would never be read
+        if(slot.bFailed)
+            return;
+    }
+}
+
+bool ImageReader::Read(cv::Mat &im1, cv::Mat &im2)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(mnNextToRead>=mvstrImages1.size())
+        return false;
+
+    Slot &slot = mvSlots[mnNextToRead%mvSlots.size()];
+    mcv.wait(lock,[&]{return slot.nIndex==(long)mnNextToRead;});
+    if(slot.bFailed)
+        return false;
+
+    im1 = slot.im1;
+    im2 = slot.im2;
+    slot = Slot();
+    mnNextToRead++;
+
+    lock.unlock();
+    mcv.notify_all();
+    return true;
+}
+
+bool ImageReader::Read(cv::Mat &im)
+{
+    cv::Mat im2;
+    return Read(im,im2);
+}
+
+size_t ImageReader::Position()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mnNextToRead;
+}
+
+size_t ImageReader::Size()
+{
+    return mvstrImages1.size();
+}
+
+std::string ImageReader::GetError()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mstrError;
+}
+
+} //namespace ORB_SLAM
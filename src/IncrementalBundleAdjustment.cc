@@ -0,0 +1,490 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IncrementalBundleAdjustment.h"
+
+#include <gtsam/inference/Symbol.h>
+#include <gtsam/slam/PriorFactor.h>
+#include <gtsam/slam/ProjectionFactor.h>
+#include <gtsam/slam/StereoFactor.h>
+
+#include "Map.h"
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "Converter.h"
+#include "Profiler.h"
+
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// Index of a factor added and not committed yet
+const size_t kPendingFactor = static_cast<size_t>(-1);
+
+// Updates run by a loop correction at most, to relinearize the variables the loop moved
+const int kLoopUpdates = 5;
+
+gtsam::Key PoseKey(KeyFrame* pKF)
+{
+    return gtsam::Symbol('k',pKF->mnId);
+}
+
+gtsam::Key PointKey(MapPoint* pMP)
+{
+    return gtsam::Symbol('p',pMP->mnId);
+}
+
+// Projection factors take the pose of the camera in the world, Twc
+gtsam::Pose3 ToPose3(const cv::Mat &Tcw)
+{
+    cv::Mat Rwc = Tcw.rowRange(0,3).colRange(0,3).t();
+    cv::Mat Ow = -Rwc*Tcw.rowRange(0,3).col(3);
+    return gtsam::Pose3(gtsam::Rot3(Converter::toMatrix3d(Rwc)),gtsam::Point3(Converter::toVector3d(Ow)));
+}
+
+cv::Mat ToCvTcw(const gtsam::Pose3 &Twc)
+{
+    return Converter::toCvMat(Eigen::Matrix<double,4,4>(Twc.inverse().matrix()));
+}
+
+gtsam::Point3 ToPoint3(const cv::Mat &x3Dw)
+{
+    return gtsam::Point3(Converter::toVector3d(x3Dw));
+}
+
+cv::Mat ToCvPoint(const gtsam::Point3 &x3Dw)
+{
+    return Converter::toCvMat(Eigen::Matrix<double,3,1>(x3Dw.x(),x3Dw.y(),x3Dw.z()));
+}
+
+} // namespace
+
+IncrementalBundleAdjustment::IncrementalBundleAdjustment(Map* pMap, const bool bMonocular):
+    mpMap(pMap), mbMonocular(bMonocular), mpIsam(NULL), mbRebuild(true)
+{
+    mpMap->EnableErasedLog();
+    Reset();
+}
+
+IncrementalBundleAdjustment::~IncrementalBundleAdjustment()
+{
+    delete mpIsam;
+}
+
+void IncrementalBundleAdjustment::Reset()
+{
+    // Relinearization is checked on every update, only the variables whose estimate moved past
+    // the threshold are relinearized, so that a loop settles in a few updates
+    gtsam::ISAM2Params params;
+    params.relinearizeThreshold = 0.05;
+    params.relinearizeSkip = 1;
+    params.findUnusedFactorSlots = true;
+
+    delete mpIsam;
+    mpIsam = new gtsam::ISAM2(params);
+    mbRebuild = true;
+
+    mNewFactors = gtsam::NonlinearFactorGraph();
+    mNewValues.clear();
+    mvRemovedFactors.clear();
+    mvNewFactorObservations.clear();
+    mmKeyFrameFactors.clear();
+    mmPointFactors.clear();
+    msAnchored.clear();
+}
+
+size_t IncrementalBundleAdjustment::KeyFramesInGraph()
+{
+    return mmKeyFrameFactors.size();
+}
+
+size_t IncrementalBundleAdjustment::MapPointsInGraph()
+{
+    return mmPointFactors.size();
+}
+
+bool IncrementalBundleAdjustment::AddKeyFrame(KeyFrame* pKF)
+{
+    ScopedTimer timer(Profiler::OPTIMIZER_GLOBAL_BA);
+
+    try
+    {
+        if(mbRebuild)
+            Rebuild();
+        else
+        {
+            // Culling and fusion may have made keyframes and MapPoints anywhere bad
+            vector<KeyFrame*> vpKFs;
+            Prune(vpKFs);
+
+            // Local BA and the MapPoint fusion of Local Mapping changed the neighbourhood too
+            const vector<KeyFrame*> vpCovKFs = pKF->GetVectorCovisibleKeyFrames();
+            vpKFs.insert(vpKFs.end(),vpCovKFs.begin(),vpCovKFs.end());
+            vpKFs.push_back(pKF);
+            Sync(vpKFs);
+        }
+
+        Update();
+    }
+    catch(const std::exception &e)
+    {
+        cerr << "Incremental BA failed, it will be rebuilt: " << e.what() << endl;
+        Reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool IncrementalBundleAdjustment::CorrectLoop(KeyFrame* pLoopKF)
+{
+    ScopedTimer timer(Profiler::OPTIMIZER_GLOBAL_BA);
+
+    const unsigned long nLoopKF = pLoopKF->mnId;
+
+    try
+    {
+        if(mbRebuild)
+            Rebuild();
+        else
+        {
+            // The MapPoints replaced by the fusion leave the graph, their keyframes now observe
+            // the MapPoints of the other side of the loop
+            vector<KeyFrame*> vpKFs;
+            Prune(vpKFs);
+
+            // The loop keyframe and its neighbours got the matched MapPoints
+            const vector<KeyFrame*> vpCovKFs = pLoopKF->GetVectorCovisibleKeyFrames();
+            vpKFs.insert(vpKFs.end(),vpCovKFs.begin(),vpCovKFs.end());
+            vpKFs.push_back(pLoopKF);
+            Sync(vpKFs);
+        }
+
+        // Relinearize until the variables moved by the loop stay within the threshold
+        gtsam::ISAM2Result result = Update();
+        for(int i=1; i<kLoopUpdates && result.variablesRelinearized>0; i++)
+            result = Update();
+
+        const gtsam::Values estimate = mpIsam->calculateEstimate();
+
+        for(map<KeyFrame*,map<MapPoint*,size_t> >::iterator mit=mmKeyFrameFactors.begin(), mend=mmKeyFrameFactors.end(); mit!=mend; mit++)
+        {
+            KeyFrame* pKF = mit->first;
+            if(pKF->isBad())
+                continue;
+            pKF->mTcwGBA = ToCvTcw(estimate.at<gtsam::Pose3>(PoseKey(pKF)));
+            pKF->mnBAGlobalForKF = nLoopKF;
+        }
+
+        for(map<MapPoint*,set<KeyFrame*> >::iterator mit=mmPointFactors.begin(), mend=mmPointFactors.end(); mit!=mend; mit++)
+        {
+            MapPoint* pMP = mit->first;
+            if(pMP->isBad())
+                continue;
+            pMP->mPosGBA = ToCvPoint(estimate.at<gtsam::Point3>(PointKey(pMP)));
+            pMP->mnBAGlobalForKF = nLoopKF;
+        }
+
+        cout << "Incremental BA: " << KeyFramesInGraph() << " keyframes and "
+             << MapPointsInGraph() << " points in the graph" << endl;
+    }
+    catch(const std::exception &e)
+    {
+        cerr << "Incremental BA failed, it will be rebuilt: " << e.what() << endl;
+        Reset();
+        return false;
+    }
+
+    return true;
+}
+
+void IncrementalBundleAdjustment::Rebuild()
+{
+    Reset();
+    mbRebuild = false;
+
+    // The graph starts from the keyframes and MapPoints still in the map
+    vector<KeyFrame*> vpErasedKFs;
+    vector<MapPoint*> vpErasedMPs;
+    mpMap->TakeErased(vpErasedKFs,vpErasedMPs);
+
+    // The first keyframe fixes the gauge
+    vector<KeyFrame*> vpKFs = mpMap->GetAllKeyFrames();
+    sort(vpKFs.begin(),vpKFs.end(),KeyFrame::lId);
+    Sync(vpKFs);
+}
+
+void IncrementalBundleAdjustment::Sync(const vector<KeyFrame*> &vpKFs)
+{
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        if(!vpKFs[i]->isBad())
+            AddPose(vpKFs[i]);
+    }
+
+    // Once each, the keyframes may come from several neighbourhoods
+    set<KeyFrame*> spSynced;
+
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        if(!vpKFs[i]->isBad() && spSynced.insert(vpKFs[i]).second)
+            SyncObservations(vpKFs[i]);
+    }
+
+    // A pose needs three points
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        if(!vpKFs[i]->isBad() && mmKeyFrameFactors[vpKFs[i]].size()<3)
+            AnchorPose(vpKFs[i]);
+    }
+}
+
+void IncrementalBundleAdjustment::SyncObservations(KeyFrame* pKF)
+{
+    map<MapPoint*,size_t> &factors = mmKeyFrameFactors[pKF];
+
+    const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
+    map<MapPoint*,size_t> matches;
+    for(size_t i=0; i<vpMPs.size(); i++)
+    {
+        MapPoint* pMP = vpMPs[i];
+        if(pMP && !pMP->isBad())
+            matches.insert(make_pair(pMP,i));
+    }
+
+    // Observations erased from the keyframe: outliers, culled and replaced MapPoints
+    vector<MapPoint*> vpErased;
+    for(map<MapPoint*,size_t>::iterator mit=factors.begin(), mend=factors.end(); mit!=mend; mit++)
+    {
+        if(mit->second!=kPendingFactor && !matches.count(mit->first))
+            vpErased.push_back(mit->first);
+    }
+    for(size_t i=0; i<vpErased.size(); i++)
+        RemoveObservation(pKF,vpErased[i]);
+
+    for(map<MapPoint*,size_t>::iterator mit=matches.begin(), mend=matches.end(); mit!=mend; mit++)
+    {
+        MapPoint* pMP = mit->first;
+        if(factors.count(pMP))
+            continue;
+
+        if(mmPointFactors.count(pMP))
+        {
+            AddObservation(pKF,pMP,mit->second);
+            continue;
+        }
+
+        // The MapPoint enters the graph with the observations of two or more keyframes in it
+        const MapPoint::ObservationsPtr observations = pMP->GetObservations();
+        int nInGraph = 0;
+        for(MapPointObservations::const_iterator oit=observations->begin(); oit!=observations->end(); oit++)
+        {
+            if(mmKeyFrameFactors.count(oit->first) && !oit->first->isBad())
+                nInGraph++;
+        }
+        if(nInGraph<2)
+            continue;
+
+        mNewValues.insert(PointKey(pMP),ToPoint3(pMP->GetWorldPos()));
+        mmPointFactors[pMP];
+
+        for(MapPointObservations::const_iterator oit=observations->begin(); oit!=observations->end(); oit++)
+        {
+            KeyFrame* pKFi = oit->first;
+            if(pKFi->isBad() || !mmKeyFrameFactors.count(pKFi) || mmKeyFrameFactors[pKFi].count(pMP))
+                continue;
+            AddObservation(pKFi,pMP,oit->second);
+        }
+    }
+}
+
+void IncrementalBundleAdjustment::Prune(vector<KeyFrame*> &vpKFs)
+{
+    vector<KeyFrame*> vpBadKFs;
+    vector<MapPoint*> vpBadMPs;
+    mpMap->TakeErased(vpBadKFs,vpBadMPs);
+
+    // Bad MapPoints, replaced ones included, leave the graph held by their prior
+    for(size_t i=0; i<vpBadMPs.size(); i++)
+    {
+        MapPoint* pMP = vpBadMPs[i];
+        map<MapPoint*,set<KeyFrame*> >::iterator mit = mmPointFactors.find(pMP);
+        if(mit==mmPointFactors.end())
+            continue;
+        const set<KeyFrame*> spKFs = mit->second;
+        for(set<KeyFrame*>::const_iterator sit=spKFs.begin(); sit!=spKFs.end(); sit++)
+        {
+            RemoveObservation(*sit,pMP);
+            vpKFs.push_back(*sit);
+        }
+        AnchorPoint(pMP);
+        mmPointFactors.erase(pMP);
+    }
+
+    // Culled keyframes too
+    for(size_t i=0; i<vpBadKFs.size(); i++)
+    {
+        KeyFrame* pKF = vpBadKFs[i];
+        if(!mmKeyFrameFactors.count(pKF))
+            continue;
+        vector<MapPoint*> vpMPs;
+        for(map<MapPoint*,size_t>::iterator mit=mmKeyFrameFactors[pKF].begin(); mit!=mmKeyFrameFactors[pKF].end(); mit++)
+            vpMPs.push_back(mit->first);
+        for(size_t j=0; j<vpMPs.size(); j++)
+            RemoveObservation(pKF,vpMPs[j]);
+        AnchorPose(pKF);
+        mmKeyFrameFactors.erase(pKF);
+    }
+}
+
+void IncrementalBundleAdjustment::AddPose(KeyFrame* pKF)
+{
+    if(mmKeyFrameFactors.count(pKF))
+        return;
+
+    if(!mK)
+    {
+        mK = gtsam::Cal3_S2::shared_ptr(new gtsam::Cal3_S2(pKF->fx,pKF->fy,0,pKF->cx,pKF->cy));
+        if(!mbMonocular)
+            mKStereo = gtsam::Cal3_S2Stereo::shared_ptr(new gtsam::Cal3_S2Stereo(pKF->fx,pKF->fy,0,pKF->cx,pKF->cy,pKF->mb));
+
+        const double thHuber2D = sqrt(5.99);
+        const double thHuber3D = sqrt(7.815);
+        for(size_t i=0; i<pKF->mvLevelSigma2.size(); i++)
+        {
+            const double sigma = sqrt(pKF->mvLevelSigma2[i]);
+            mvMonoNoise.push_back(gtsam::noiseModel::Robust::Create(gtsam::noiseModel::mEstimator::Huber::Create(thHuber2D),
+                                                                    gtsam::noiseModel::Isotropic::Sigma(2,sigma)));
+            mvStereoNoise.push_back(gtsam::noiseModel::Robust::Create(gtsam::noiseModel::mEstimator::Huber::Create(thHuber3D),
+                                                                      gtsam::noiseModel::Isotropic::Sigma(3,sigma)));
+        }
+    }
+
+    const gtsam::Key key = PoseKey(pKF);
+    const gtsam::Pose3 Twc = ToPose3(pKF->GetPose());
+    mNewValues.insert(key,Twc);
+    mmKeyFrameFactors[pKF];
+
+    if(mmKeyFrameFactors.size()==1)
+    {
+        // Fixed, like the first keyframe in the full global BA
+        AddFactor(gtsam::NonlinearFactor::shared_ptr(new gtsam::PriorFactor<gtsam::Pose3>(key,Twc,gtsam::noiseModel::Isotropic::Sigma(6,1e-6))),NULL,NULL);
+    }
+    else if(mmKeyFrameFactors.size()==2 && mbMonocular)
+    {
+        // Without metric scale Gauss-Newton needs the scale pinned too, keep the one of the initialization
+        gtsam::Vector6 sigmas;
+        sigmas << 1.0, 1.0, 1.0, 0.1, 0.1, 0.1;
+        AddFactor(gtsam::NonlinearFactor::shared_ptr(new gtsam::PriorFactor<gtsam::Pose3>(key,Twc,gtsam::noiseModel::Diagonal::Sigmas(sigmas))),NULL,NULL);
+    }
+}
+
+void IncrementalBundleAdjustment::AddObservation(KeyFrame* pKF, MapPoint* pMP, const size_t idx)
+{
+    const cv::KeyPoint &kpUn = pKF->mvKeysUn[idx];
+    const float kp_ur = pKF->mvuRight[idx];
+
+    gtsam::NonlinearFactor::shared_ptr factor;
+    if(kp_ur<0 || !mKStereo)
+    {
+        factor.reset(new gtsam::GenericProjectionFactor<gtsam::Pose3,gtsam::Point3,gtsam::Cal3_S2>(
+                         gtsam::Point2(kpUn.pt.x,kpUn.pt.y),mvMonoNoise[kpUn.octave],PoseKey(pKF),PointKey(pMP),mK));
+    }
+    else
+    {
+        factor.reset(new gtsam::GenericStereoFactor<gtsam::Pose3,gtsam::Point3>(
+                         gtsam::StereoPoint2(kpUn.pt.x,kp_ur,kpUn.pt.y),mvStereoNoise[kpUn.octave],PoseKey(pKF),PointKey(pMP),mKStereo));
+    }
+
+    AddFactor(factor,pKF,pMP);
+    mmKeyFrameFactors[pKF][pMP] = kPendingFactor;
+    mmPointFactors[pMP].insert(pKF);
+}
+
+void IncrementalBundleAdjustment::RemoveObservation(KeyFrame* pKF, MapPoint* pMP)
+{
+    // Pending factors are committed by every update, before anything is removed
+    map<MapPoint*,size_t> &factors = mmKeyFrameFactors[pKF];
+    mvRemovedFactors.push_back(factors[pMP]);
+    factors.erase(pMP);
+
+    // Two observations are needed to triangulate
+    set<KeyFrame*> &spKFs = mmPointFactors[pMP];
+    spKFs.erase(pKF);
+    if(spKFs.size()<2)
+        AnchorPoint(pMP);
+}
+
+void IncrementalBundleAdjustment::AddFactor(const gtsam::NonlinearFactor::shared_ptr &factor, KeyFrame* pKF, MapPoint* pMP)
+{
+    mNewFactors.push_back(factor);
+    mvNewFactorObservations.push_back(make_pair(pKF,pMP));
+}
+
+void IncrementalBundleAdjustment::AnchorPose(KeyFrame* pKF)
+{
+    const gtsam::Key key = PoseKey(pKF);
+    if(!msAnchored.insert(key).second)
+        return;
+
+    const gtsam::Pose3 Twc = mNewValues.exists(key) ? mNewValues.at<gtsam::Pose3>(key) : mpIsam->calculateEstimate<gtsam::Pose3>(key);
+    AddFactor(gtsam::NonlinearFactor::shared_ptr(new gtsam::PriorFactor<gtsam::Pose3>(key,Twc,gtsam::noiseModel::Isotropic::Sigma(6,1.0))),NULL,NULL);
+}
+
+void IncrementalBundleAdjustment::AnchorPoint(MapPoint* pMP)
+{
+    const gtsam::Key key = PointKey(pMP);
+    if(!msAnchored.insert(key).second)
+        return;
+
+    const gtsam::Point3 x3Dw = mNewValues.exists(key) ? mNewValues.at<gtsam::Point3>(key) : mpIsam->calculateEstimate<gtsam::Point3>(key);
+    AddFactor(gtsam::NonlinearFactor::shared_ptr(new gtsam::PriorFactor<gtsam::Point3>(key,x3Dw,gtsam::noiseModel::Isotropic::Sigma(3,1.0))),NULL,NULL);
+}
+
+gtsam::ISAM2Result IncrementalBundleAdjustment::Update()
+{
+    gtsam::ISAM2UpdateParams updateParams;
+    updateParams.removeFactorIndices = mvRemovedFactors;
+
+    gtsam::ISAM2Result result = mpIsam->update(mNewFactors,mNewValues,updateParams);
+
+    for(size_t i=0; i<mvNewFactorObservations.size(); i++)
+    {
+        KeyFrame* pKF = mvNewFactorObservations[i].first;
+        if(pKF)
+            mmKeyFrameFactors[pKF][mvNewFactorObservations[i].second] = result.newFactorsIndices[i];
+    }
+
+    mNewFactors = gtsam::NonlinearFactorGraph();
+    mNewValues.clear();
+    mvRemovedFactors.clear();
+    mvNewFactorObservations.clear();
+
+    return result;
+}
+
+} //namespace ORB_SLAM
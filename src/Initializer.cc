@@ -24,8 +24,10 @@
 
 #include "Optimizer.h"
 #include "ORBmatcher.h"
+#include "Converter.h"
+#include "ThreadPool.h"
 
-#include<thread>
+#include<Eigen/Dense>
 
 namespace ORB_SLAM2
 {
@@ -35,6 +37,7 @@ Initializer::Initializer(const Frame &ReferenceFrame, float sigma, int iteration
     mK = ReferenceFrame.mK.clone();
 
     mvKeys1 = ReferenceFrame.mvKeysUn;
+    Normalize(mvKeys1,mvPn1,mT1);
 
     mSigma = sigma;
     mSigma2 = sigma*sigma;
@@ -47,6 +50,7 @@ bool Initializer::Initialize(const Frame &CurrentFrame, const vector<int> &vMatc
     // Fill structures with current keypoints and matches with reference frame
     // Reference Frame: 1, Current Frame: 2
     mvKeys2 = CurrentFrame.mvKeysUn;
+    Normalize(mvKeys2,mvPn2,mT2);
 
     mvMatches12.clear();
     mvMatches12.reserve(mvKeys2.size());
@@ -64,6 +68,20 @@ bool Initializer::Initialize(const Frame &CurrentFrame, const vector<int> &vMatc
 
     const int N = mvMatches12.size();
 
+    mvU1.resize(N);
+    mvV1.resize(N);
+    mvU2.resize(N);
+    mvV2.resize(N);
+    for(int i=0; i<N; i++)
+    {
+        const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
+        const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
+        mvU1[i] = kp1.pt.x;
+        mvV1[i] = kp1.pt.y;
+        mvU2[i] = kp2.pt.x;
+        mvV2[i] = kp2.pt.y;
+    }
+
     // Indices for minimum set selection
     vector<size_t> vAllIndices;
     vAllIndices.reserve(N);
@@ -96,138 +114,116 @@ bool Initializer::Initialize(const Frame &CurrentFrame, const vector<int> &vMatc
         }
     }
 
-    // Launch threads to compute in parallel a fundamental matrix and a homography
-    vector<bool> vbMatchesInliersH, vbMatchesInliersF;
-    float SH, SF;
-    cv::Mat H, F;
+    // Score the homography and fundamental hypotheses of all iterations in parallel,
+    // interleaved so that both models progress at the same time
+    vector<float> vScoresH(mMaxIterations), vScoresF(mMaxIterations);
+    vector<Eigen::Matrix3f> vH21(mMaxIterations), vF21(mMaxIterations);
 
-    thread threadH(&Initializer::FindHomography,this,ref(vbMatchesInliersH), ref(SH), ref(H));
-    thread threadF(&Initializer::FindFundamental,this,ref(vbMatchesInliersF), ref(SF), ref(F));
+    ThreadPool::Global()->ParallelFor(2*mMaxIterations,[&](int i)
+    {
+        static thread_local vector<float> vBuffer;
 
-    // Wait until both threads have finished
-    threadH.join();
-    threadF.join();
+        const int it = i/2;
+        if(i%2==0)
+            vScoresH[it] = FindHomography(it,vH21[it],vBuffer);
+        else
+            vScoresF[it] = FindFundamental(it,vF21[it],vBuffer);
+    });
+
+    // Save the solution with highest score, the first one on ties as the sequential search
+    int bestH = -1, bestF = -1;
+    float SH = 0.0, SF = 0.0;
+    for(int it=0; it<mMaxIterations; it++)
+    {
+        if(vScoresH[it]>SH)
+        {
+            SH = vScoresH[it];
+            bestH = it;
+        }
+        if(vScoresF[it]>SF)
+        {
+            SF = vScoresF[it];
+            bestF = it;
+        }
+    }
 
     // Compute ratio of scores
     float RH = SH/(SH+SF);
 
+    // Inliers are only computed for the selected model
+    vector<float> vBuffer;
+
     // Try to reconstruct from homography or fundamental depending on the ratio (0.40-0.45)
     if(RH>0.40)
+    {
+        if(bestH<0)
+            return false;
+
+        vector<bool> vbMatchesInliersH;
+        CheckHomography(vH21[bestH],vH21[bestH].inverse(),&vbMatchesInliersH,mSigma,vBuffer);
+        cv::Mat H = Converter::toCvMat(Eigen::Matrix3d(vH21[bestH].cast<double>()));
         return ReconstructH(vbMatchesInliersH,H,mK,R21,t21,vP3D,vbTriangulated,1.0,50);
+    }
     else //if(pF_HF>0.6)
+    {
+        if(bestF<0)
+            return false;
+
+        vector<bool> vbMatchesInliersF;
+        CheckFundamental(vF21[bestF],&vbMatchesInliersF,mSigma,vBuffer);
+        cv::Mat F = Converter::toCvMat(Eigen::Matrix3d(vF21[bestF].cast<double>()));
         return ReconstructF(vbMatchesInliersF,F,mK,R21,t21,vP3D,vbTriangulated,1.0,50);
+    }
 
     return false;
 }
 
 
-void Initializer::FindHomography(vector<bool> &vbMatchesInliers, float &score, cv::Mat &H21)
+float Initializer::FindHomography(const int it, Eigen::Matrix3f &H21, vector<float> &vBuffer)
 {
-    // Number of putative matches
-    const int N = mvMatches12.size();
-
-    // Normalize coordinates
-    vector<cv::Point2f> vPn1, vPn2;
-    cv::Mat T1, T2;
-    Normalize(mvKeys1,vPn1, T1);
-    Normalize(mvKeys2,vPn2, T2);
-    cv::Mat T2inv = T2.inv();
-
-    // Best Results variables
-    score = 0.0;
-    vbMatchesInliers = vector<bool>(N,false);
-
-    // Iteration variables
-    vector<cv::Point2f> vPn1i(8);
-    vector<cv::Point2f> vPn2i(8);
-    cv::Mat H21i, H12i;
-    vector<bool> vbCurrentInliers(N,false);
-    float currentScore;
-
-    // Perform all RANSAC iterations and save the solution with highest score
-    for(int it=0; it<mMaxIterations; it++)
+    // Select a minimum set
+    cv::Point2f vPn1i[8], vPn2i[8];
+    for(size_t j=0; j<8; j++)
     {
-        // Select a minimum set
-        for(size_t j=0; j<8; j++)
-        {
-            int idx = mvSets[it][j];
+        int idx = mvSets[it][j];
 
-            vPn1i[j] = vPn1[mvMatches12[idx].first];
-            vPn2i[j] = vPn2[mvMatches12[idx].second];
-        }
-
-        cv::Mat Hn = ComputeH21(vPn1i,vPn2i);
-        H21i = T2inv*Hn*T1;
-        H12i = H21i.inv();
+        vPn1i[j] = mvPn1[mvMatches12[idx].first];
+        vPn2i[j] = mvPn2[mvMatches12[idx].second];
+    }
 
-        currentScore = CheckHomography(H21i, H12i, vbCurrentInliers, mSigma);
+    Eigen::Matrix3f Hn = ComputeH21(vPn1i,vPn2i);
+    H21 = mT2.inverse()*Hn*mT1;
+    Eigen::Matrix3f H12 = H21.inverse();
 
-        if(currentScore>score)
-        {
-            H21 = H21i.clone();
-            vbMatchesInliers = vbCurrentInliers;
-            score = currentScore;
-        }
-    }
+    return CheckHomography(H21, H12, NULL, mSigma, vBuffer);
 }
 
 
-void Initializer::FindFundamental(vector<bool> &vbMatchesInliers, float &score, cv::Mat &F21)
+float Initializer::FindFundamental(const int it, Eigen::Matrix3f &F21, vector<float> &vBuffer)
 {
-    // Number of putative matches
-    const int N = vbMatchesInliers.size();
-
-    // Normalize coordinates
-    vector<cv::Point2f> vPn1, vPn2;
-    cv::Mat T1, T2;
-    Normalize(mvKeys1,vPn1, T1);
-    Normalize(mvKeys2,vPn2, T2);
-    cv::Mat T2t = T2.t();
-
-    // Best Results variables
-    score = 0.0;
-    vbMatchesInliers = vector<bool>(N,false);
-
-    // Iteration variables
-    vector<cv::Point2f> vPn1i(8);
-    vector<cv::Point2f> vPn2i(8);
-    cv::Mat F21i;
-    vector<bool> vbCurrentInliers(N,false);
-    float currentScore;
-
-    // Perform all RANSAC iterations and save the solution with highest score
-    for(int it=0; it<mMaxIterations; it++)
+    // Select a minimum set
+    cv::Point2f vPn1i[8], vPn2i[8];
+    for(int j=0; j<8; j++)
     {
-        // Select a minimum set
-        for(int j=0; j<8; j++)
-        {
-            int idx = mvSets[it][j];
-
-            vPn1i[j] = vPn1[mvMatches12[idx].first];
-            vPn2i[j] = vPn2[mvMatches12[idx].second];
-        }
+        int idx = mvSets[it][j];
 
-        cv::Mat Fn = ComputeF21(vPn1i,vPn2i);
+        vPn1i[j] = mvPn1[mvMatches12[idx].first];
+        vPn2i[j] = mvPn2[mvMatches12[idx].second];
+    }
 
-        F21i = T2t*Fn*T1;
+    Eigen::Matrix3f Fn = ComputeF21(vPn1i,vPn2i);
 
-        currentScore = CheckFundamental(F21i, vbCurrentInliers, mSigma);
+    F21 = mT2.transpose()*Fn*mT1;
 
-        if(currentScore>score)
-        {
-            F21 = F21i.clone();
-            vbMatchesInliers = vbCurrentInliers;
-            score = currentScore;
-        }
-    }
+    return CheckFundamental(F21, NULL, mSigma, vBuffer);
 }
 
 
-cv::Mat Initializer::ComputeH21(const vector<cv::Point2f> &vP1, const vector<cv::Point2f> &vP2)
+Eigen::Matrix3f Initializer::ComputeH21(const cv::Point2f *vP1, const cv::Point2f *vP2)
 {
-    const int N = vP1.size();
+    const int N = 8;
 
-    cv::Mat A(2*N,9,CV_32F);
+    Eigen::Matrix<float,2*N,9> A;
 
     for(int i=0; i<N; i++)
     {
@@ -236,40 +232,44 @@ cv::Mat Initializer::ComputeH21(const vector<cv::Point2f> &vP1, const vector<cv:
         const float u2 = vP2[i].x;
         const float v2 = vP2[i].y;
 
-        A.at<float>(2*i,0) = 0.0;
-        A.at<float>(2*i,1) = 0.0;
-        A.at<float>(2*i,2) = 0.0;
-        A.at<float>(2*i,3) = -u1;
-        A.at<float>(2*i,4) = -v1;
-        A.at<float>(2*i,5) = -1;
-        A.at<float>(2*i,6) = v2*u1;
-        A.at<float>(2*i,7) = v2*v1;
-        A.at<float>(2*i,8) = v2;
-
-        A.at<float>(2*i+1,0) = u1;
-        A.at<float>(2*i+1,1) = v1;
-        A.at<float>(2*i+1,2) = 1;
-        A.at<float>(2*i+1,3) = 0.0;
-        A.at<float>(2*i+1,4) = 0.0;
-        A.at<float>(2*i+1,5) = 0.0;
-        A.at<float>(2*i+1,6) = -u2*u1;
-        A.at<float>(2*i+1,7) = -u2*v1;
-        A.at<float>(2*i+1,8) = -u2;
+        A(2*i,0) = 0.0;
+        A(2*i,1) = 0.0;
+        A(2*i,2) = 0.0;
+        A(2*i,3) = -u1;
+        A(2*i,4) = -v1;
+        A(2*i,5) = -1;
+        A(2*i,6) = v2*u1;
+        A(2*i,7) = v2*v1;
+        A(2*i,8) = v2;
+
+        A(2*i+1,0) = u1;
+        A(2*i+1,1) = v1;
+        A(2*i+1,2) = 1;
+        A(2*i+1,3) = 0.0;
+        A(2*i+1,4) = 0.0;
+        A(2*i+1,5) = 0.0;
+        A(2*i+1,6) = -u2*u1;
+        A(2*i+1,7) = -u2*v1;
+        A(2*i+1,8) = -u2;
 
     }
 
-    cv::Mat u,w,vt;
+    Eigen::JacobiSVD<Eigen::Matrix<float,2*N,9> > svd(A, Eigen::ComputeFullV);
+    const Eigen::Matrix<float,9,1> h = svd.matrixV().col(8);
 
-    cv::SVDecomp(A,w,u,vt,cv::SVD::MODIFY_A | cv::SVD::FULL_UV);
+    Eigen::Matrix3f H;
+    H << h(0), h(1), h(2),
+         h(3), h(4), h(5),
+         h(6), h(7), h(8);
 
-    return vt.row(8).reshape(0, 3);
+    return H;
 }
 
-cv::Mat Initializer::ComputeF21(const vector<cv::Point2f> &vP1,const vector<cv::Point2f> &vP2)
+Eigen::Matrix3f Initializer::ComputeF21(const cv::Point2f *vP1, const cv::Point2f *vP2)
 {
-    const int N = vP1.size();
+    const int N = 8;
 
-    cv::Mat A(N,9,CV_32F);
+    Eigen::Matrix<float,N,9> A;
 
     for(int i=0; i<N; i++)
     {
@@ -278,78 +278,83 @@ cv::Mat Initializer::ComputeF21(const vector<cv::Point2f> &vP1,const vector<cv::
         const float u2 = vP2[i].x;
         const float v2 = vP2[i].y;
 
-        A.at<float>(i,0) = u2*u1;
-        A.at<float>(i,1) = u2*v1;
-        A.at<float>(i,2) = u2;
-        A.at<float>(i,3) = v2*u1;
-        A.at<float>(i,4) = v2*v1;
-        A.at<float>(i,5) = v2;
-        A.at<float>(i,6) = u1;
-        A.at<float>(i,7) = v1;
-        A.at<float>(i,8) = 1;
+        A(i,0) = u2*u1;
+        A(i,1) = u2*v1;
+        A(i,2) = u2;
+        A(i,3) = v2*u1;
+        A(i,4) = v2*v1;
+        A(i,5) = v2;
+        A(i,6) = u1;
+        A(i,7) = v1;
+        A(i,8) = 1;
     }
 
-    cv::Mat u,w,vt;
-
-    cv::SVDecomp(A,w,u,vt,cv::SVD::MODIFY_A | cv::SVD::FULL_UV);
+    Eigen::JacobiSVD<Eigen::Matrix<float,N,9> > svd(A, Eigen::ComputeFullV);
+    const Eigen::Matrix<float,9,1> f = svd.matrixV().col(8);
 
-    cv::Mat Fpre = vt.row(8).reshape(0, 3);
+    Eigen::Matrix3f Fpre;
+    Fpre << f(0), f(1), f(2),
+            f(3), f(4), f(5),
+            f(6), f(7), f(8);
 
-    cv::SVDecomp(Fpre,w,u,vt,cv::SVD::MODIFY_A | cv::SVD::FULL_UV);
+    // Enforce rank 2
+    Eigen::JacobiSVD<Eigen::Matrix3f> svdF(Fpre, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Vector3f w = svdF.singularValues();
 
-    w.at<float>(2)=0;
+    w(2)=0;
 
-    return  u*cv::Mat::diag(w)*vt;
+    return svdF.matrixU()*w.asDiagonal()*svdF.matrixV().transpose();
 }
 
-float Initializer::CheckHomography(const cv::Mat &H21, const cv::Mat &H12, vector<bool> &vbMatchesInliers, float sigma)
+float Initializer::CheckHomography(const Eigen::Matrix3f &H21, const Eigen::Matrix3f &H12, vector<bool> *pvbMatchesInliers, float sigma, vector<float> &vBuffer)
 {   
     const int N = mvMatches12.size();
 
-    const float h11 = H21.at<float>(0,0);
-    const float h12 = H21.at<float>(0,1);
-    const float h13 = H21.at<float>(0,2);
-    const float h21 = H21.at<float>(1,0);
-    const float h22 = H21.at<float>(1,1);
-    const float h23 = H21.at<float>(1,2);
-    const float h31 = H21.at<float>(2,0);
-    const float h32 = H21.at<float>(2,1);
-    const float h33 = H21.at<float>(2,2);
-
-    const float h11inv = H12.at<float>(0,0);
-    const float h12inv = H12.at<float>(0,1);
-    const float h13inv = H12.at<float>(0,2);
-    const float h21inv = H12.at<float>(1,0);
-    const float h22inv = H12.at<float>(1,1);
-    const float h23inv = H12.at<float>(1,2);
-    const float h31inv = H12.at<float>(2,0);
-    const float h32inv = H12.at<float>(2,1);
-    const float h33inv = H12.at<float>(2,2);
-
-    vbMatchesInliers.resize(N);
-
-    float score = 0;
+    const float h11 = H21(0,0);
+    const float h12 = H21(0,1);
+    const float h13 = H21(0,2);
+    const float h21 = H21(1,0);
+    const float h22 = H21(1,1);
+    const float h23 = H21(1,2);
+    const float h31 = H21(2,0);
+    const float h32 = H21(2,1);
+    const float h33 = H21(2,2);
+
+    const float h11inv = H12(0,0);
+    const float h12inv = H12(0,1);
+    const float h13inv = H12(0,2);
+    const float h21inv = H12(1,0);
+    const float h22inv = H12(1,1);
+    const float h23inv = H12(1,2);
+    const float h31inv = H12(2,0);
+    const float h32inv = H12(2,1);
+    const float h33inv = H12(2,2);
 
     const float th = 5.991;
 
     const float invSigmaSquare = 1.0/(sigma*sigma);
 
+    // Score contribution of each match in each image, negative if above the threshold.
+    // Branch-free over the coordinate arrays so that it is vectorized.
+    vBuffer.resize(2*N);
+    float * __restrict pScore1 = vBuffer.data();
+    float * __restrict pScore2 = pScore1+N;
+    const float * __restrict pU1 = mvU1.data();
+    const float * __restrict pV1 = mvV1.data();
+    const float * __restrict pU2 = mvU2.data();
+    const float * __restrict pV2 = mvV2.data();
+
     for(int i=0; i<N; i++)
     {
-        bool bIn = true;
-
-        const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
-        const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
-
-        const float u1 = kp1.pt.x;
-        const float v1 = kp1.pt.y;
-        const float u2 = kp2.pt.x;
-        const float v2 = kp2.pt.y;
+        const float u1 = pU1[i];
+        const float v1 = pV1[i];
+        const float u2 = pU2[i];
+        const float v2 = pV2[i];
 
         // Reprojection error in first image
         // x2in1 = H12*x2
 
-        const float w2in1inv = 1.0/(h31inv*u2+h32inv*v2+h33inv);
+        const float w2in1inv = 1.0f/(h31inv*u2+h32inv*v2+h33inv);
         const float u2in1 = (h11inv*u2+h12inv*v2+h13inv)*w2in1inv;
         const float v2in1 = (h21inv*u2+h22inv*v2+h23inv)*w2in1inv;
 
@@ -357,15 +362,12 @@ float Initializer::CheckHomography(const cv::Mat &H21, const cv::Mat &H12, vecto
 
         const float chiSquare1 = squareDist1*invSigmaSquare;
 
-        if(chiSquare1>th)
-            bIn = false;
-        else
-            score += th - chiSquare1;
+        pScore1[i] = chiSquare1>th ? -1.0f : th - chiSquare1;
 
         // Reprojection error in second image
         // x1in2 = H21*x1
 
-        const float w1in2inv = 1.0/(h31*u1+h32*v1+h33);
+        const float w1in2inv = 1.0f/(h31*u1+h32*v1+h33);
         const float u1in2 = (h11*u1+h12*v1+h13)*w1in2inv;
         const float v1in2 = (h21*u1+h22*v1+h23)*w1in2inv;
 
@@ -373,54 +375,71 @@ float Initializer::CheckHomography(const cv::Mat &H21, const cv::Mat &H12, vecto
 
         const float chiSquare2 = squareDist2*invSigmaSquare;
 
-        if(chiSquare2>th)
+        pScore2[i] = chiSquare2>th ? -1.0f : th - chiSquare2;
+    }
+
+    // Accumulated in the original order, so that the score does not depend on vectorization
+    float score = 0;
+
+    if(pvbMatchesInliers)
+        pvbMatchesInliers->resize(N);
+
+    for(int i=0; i<N; i++)
+    {
+        bool bIn = true;
+
+        if(pScore1[i]<0)
             bIn = false;
         else
-            score += th - chiSquare2;
+            score += pScore1[i];
 
-        if(bIn)
-            vbMatchesInliers[i]=true;
+        if(pScore2[i]<0)
+            bIn = false;
         else
-            vbMatchesInliers[i]=false;
+            score += pScore2[i];
+
+        if(pvbMatchesInliers)
+            (*pvbMatchesInliers)[i]=bIn;
     }
 
     return score;
 }
 
-float Initializer::CheckFundamental(const cv::Mat &F21, vector<bool> &vbMatchesInliers, float sigma)
+float Initializer::CheckFundamental(const Eigen::Matrix3f &F21, vector<bool> *pvbMatchesInliers, float sigma, vector<float> &vBuffer)
 {
     const int N = mvMatches12.size();
 
-    const float f11 = F21.at<float>(0,0);
-    const float f12 = F21.at<float>(0,1);
-    const float f13 = F21.at<float>(0,2);
-    const float f21 = F21.at<float>(1,0);
-    const float f22 = F21.at<float>(1,1);
-    const float f23 = F21.at<float>(1,2);
-    const float f31 = F21.at<float>(2,0);
-    const float f32 = F21.at<float>(2,1);
-    const float f33 = F21.at<float>(2,2);
-
-    vbMatchesInliers.resize(N);
-
-    float score = 0;
+    const float f11 = F21(0,0);
+    const float f12 = F21(0,1);
+    const float f13 = F21(0,2);
+    const float f21 = F21(1,0);
+    const float f22 = F21(1,1);
+    const float f23 = F21(1,2);
+    const float f31 = F21(2,0);
+    const float f32 = F21(2,1);
+    const float f33 = F21(2,2);
 
     const float th = 3.841;
     const float thScore = 5.991;
 
     const float invSigmaSquare = 1.0/(sigma*sigma);
 
+    // Score contribution of each match in each image, negative if above the threshold.
+    // Branch-free over the coordinate arrays so that it is vectorized.
+    vBuffer.resize(2*N);
+    float * __restrict pScore1 = vBuffer.data();
+    float * __restrict pScore2 = pScore1+N;
+    const float * __restrict pU1 = mvU1.data();
+    const float * __restrict pV1 = mvV1.data();
+    const float * __restrict pU2 = mvU2.data();
+    const float * __restrict pV2 = mvV2.data();
+
     for(int i=0; i<N; i++)
     {
-        bool bIn = true;
-
-        const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
-        const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
-
-        const float u1 = kp1.pt.x;
-        const float v1 = kp1.pt.y;
-        const float u2 = kp2.pt.x;
-        const float v2 = kp2.pt.y;
+        const float u1 = pU1[i];
+        const float v1 = pV1[i];
+        const float u2 = pU2[i];
+        const float v2 = pV2[i];
 
         // Reprojection error in second image
         // l2=F21x1=(a2,b2,c2)
@@ -435,10 +454,7 @@ float Initializer::CheckFundamental(const cv::Mat &F21, vector<bool> &vbMatchesI
 
         const float chiSquare1 = squareDist1*invSigmaSquare;
 
-        if(chiSquare1>th)
-            bIn = false;
-        else
-            score += thScore - chiSquare1;
+        pScore1[i] = chiSquare1>th ? -1.0f : thScore - chiSquare1;
 
         // Reprojection error in second image
         // l1 =x2tF21=(a1,b1,c1)
@@ -453,15 +469,31 @@ float Initializer::CheckFundamental(const cv::Mat &F21, vector<bool> &vbMatchesI
 
         const float chiSquare2 = squareDist2*invSigmaSquare;
 
-        if(chiSquare2>th)
+        pScore2[i] = chiSquare2>th ? -1.0f : thScore - chiSquare2;
+    }
+
+    // Accumulated in the original order, so that the score does not depend on vectorization
+    float score = 0;
+
+    if(pvbMatchesInliers)
+        pvbMatchesInliers->resize(N);
+
+    for(int i=0; i<N; i++)
+    {
+        bool bIn = true;
+
+        if(pScore1[i]<0)
             bIn = false;
         else
-            score += thScore - chiSquare2;
+            score += pScore1[i];
 
-        if(bIn)
-            vbMatchesInliers[i]=true;
+        if(pScore2[i]<0)
+            bIn = false;
         else
-            vbMatchesInliers[i]=false;
+            score += pScore2[i];
+
+        if(pvbMatchesInliers)
+            (*pvbMatchesInliers)[i]=bIn;
     }
 
     return score;
@@ -746,7 +778,7 @@ void Initializer::Triangulate(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2,
     x3D = x3D.rowRange(0,3)/x3D.at<float>(3);
 }
 
-void Initializer::Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2f> &vNormalizedPoints, cv::Mat &T)
+void Initializer::Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2f> &vNormalizedPoints, Eigen::Matrix3f &T)
 {
     float meanX = 0;
     float meanY = 0;
@@ -787,11 +819,11 @@ void Initializer::Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2
         vNormalizedPoints[i].y = vNormalizedPoints[i].y * sY;
     }
 
-    T = cv::Mat::eye(3,3,CV_32F);
-    T.at<float>(0,0) = sX;
-    T.at<float>(1,1) = sY;
-    T.at<float>(0,2) = -meanX*sX;
-    T.at<float>(1,2) = -meanY*sY;
+    T.setIdentity();
+    T(0,0) = sX;
+    T(1,1) = sY;
+    T(0,2) = -meanX*sX;
+    T(1,2) = -meanY*sY;
 }
 
 
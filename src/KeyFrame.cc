@@ -40,6 +40,7 @@ namespace ORB_SLAM2
 {
 
   long unsigned int KeyFrame::nNextId=0;
+  WorkSignal KeyFrame::msConnectionsSignal;
 
   KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB):
     mnFrameId(F.mnId),  mTimeStamp(F.mTimeStamp), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
@@ -58,13 +59,7 @@ namespace ORB_SLAM2
   {
     mnId=nNextId++;
 
-    mGrid.resize(mnGridCols);
-    for(int i=0; i<mnGridCols;i++)
-      {
-        mGrid[i].resize(mnGridRows);
-        for(int j=0; j<mnGridRows; j++)
-          mGrid[i][j] = F.mGrid[i][j];
-      }
+    mGrid = F.mGrid;
 
     SetPose(F.mTcw);
   }
@@ -338,9 +333,9 @@ namespace ORB_SLAM2
         if(pMP->isBad())
           continue;
 
-        map<KeyFrame*,size_t> observations = pMP->GetObservations();
+        MapPoint::ObservationsPtr observations = pMP->GetObservations();
 
-        for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPointObservations::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
           {
             if(mit->first->mnId==mnId)
               continue;
@@ -391,6 +386,7 @@ namespace ORB_SLAM2
         lWs.push_front(vPairs[i].first);
       }
 
+    bool bFirstConnection = false;
     {
       unique_lock<mutex> lockCon(mMutexConnections);
 
@@ -404,14 +400,26 @@ namespace ORB_SLAM2
           mpParent = mvpOrderedConnectedKeyFrames.front();
           mpParent->AddChild(this);
           mbFirstConnection = false;
+          bFirstConnection = true;
         }
 
     }
 
+    if(bFirstConnection)
+      msConnectionsSignal.Notify();
+
     //cout << "Updated connection for: "  << gtsam::symbolChr(key_) <<  gtsam::symbolIndex(key_) << endl;
 
   }
 
+  void KeyFrame::WaitUntilConnected()
+  {
+    msConnectionsSignal.WaitUntil([this]{
+        unique_lock<mutex> lockCon(mMutexConnections);
+        return mnId==0 || !mbFirstConnection;
+      });
+  }
+
   void KeyFrame::AddChild(KeyFrame *pKF)
   {
     unique_lock<mutex> lockCon(mMutexConnections);
@@ -602,43 +610,7 @@ namespace ORB_SLAM2
 
   vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const float &r) const
   {
-    vector<size_t> vIndices;
-    vIndices.reserve(N);
-
-    const int nMinCellX = max(0,(int)floor((x-mnMinX-r)*mfGridElementWidthInv));
-    if(nMinCellX>=mnGridCols)
-      return vIndices;
-
-    const int nMaxCellX = min((int)mnGridCols-1,(int)ceil((x-mnMinX+r)*mfGridElementWidthInv));
-    if(nMaxCellX<0)
-      return vIndices;
-
-    const int nMinCellY = max(0,(int)floor((y-mnMinY-r)*mfGridElementHeightInv));
-    if(nMinCellY>=mnGridRows)
-      return vIndices;
-
-    const int nMaxCellY = min((int)mnGridRows-1,(int)ceil((y-mnMinY+r)*mfGridElementHeightInv));
-    if(nMaxCellY<0)
-      return vIndices;
-
-    for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
-      {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
-          {
-            const vector<size_t> vCell = mGrid[ix][iy];
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
-              {
-                const cv::KeyPoint &kpUn = mvKeysUn[vCell[j]];
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
-
-                if(fabs(distx)<r && fabs(disty)<r)
-                  vIndices.push_back(vCell[j]);
-              }
-          }
-      }
-
-    return vIndices;
+    return mGrid.GetFeaturesInArea(x,y,r);
   }
 
   bool KeyFrame::IsInImage(const float &x, const float &y) const
@@ -787,7 +759,7 @@ namespace ORB_SLAM2
     ar & const_cast<cv::Mat &> (Twc);
     ar & const_cast<cv::Mat &> (Ow);
     ar & const_cast<cv::Mat &> (Cw);
-    ar & const_cast<std::vector< std::vector <std::vector<size_t> > > &> (mGrid);
+    ar & const_cast<FeatureGrid &> (mGrid);
     ar & const_cast<float &> (minScoreStored);
     ar & const_cast<std::set<long unsigned int> &>(neighboringMnIDs);
     ar & const_cast<gtsam::Key &>(key_);
@@ -831,7 +803,6 @@ namespace ORB_SLAM2
             is_id = true;
             ar & const_cast<int &>(is_id);
             MapPoint* mapPoint = *it;
-            mapPoint->copyMObservations();
             ar & const_cast<MapPoint &>(*mapPoint);
           }
       }
@@ -903,7 +874,7 @@ namespace ORB_SLAM2
     ar & const_cast<cv::Mat &> (Twc);
     ar & const_cast<cv::Mat &> (Ow);
     ar & const_cast<cv::Mat &> (Cw);
-    ar & const_cast<std::vector< std::vector <std::vector<size_t> > > &> (mGrid);
+    ar & const_cast<FeatureGrid &> (mGrid);
     ar & const_cast<float &> (minScoreStored);
     ar & const_cast<std::set<long unsigned int> &>(neighboringMnIDs);
     ar & const_cast<gtsam::Key &>(key_);
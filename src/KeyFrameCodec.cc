@@ -0,0 +1,662 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "KeyFrameCodec.h"
+
+#include "KeyFrame.h"
+#include "MapPoint.h"
+
+#include <zlib.h>
+
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "KeyFrameCodec writes the host representation of little-endian values"
+#endif
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+const uint32_t kMagic = 0x464B424F; // "OBKF"
+const int kDescriptorBytes = 32;
+
+// Target robot id of the messages addressed to no robot in particular
+const uint16_t kNoTarget = 0xFFFF;
+
+// Keypoint coordinates in 1/8 pixel
+const float kPositionScale = 8.f;
+// Keypoint angles in 1/65536 turn
+const float kAngleScale = 65536.f/360.f;
+// Keypoint size of the ORB extractor (PATCH_SIZE)
+const int kPatchSize = 31;
+// Largest payload accepted, far above a keyframe of the ORB extractor
+const uint32_t kMaxPayloadBytes = 16 << 20;
+// Largest expansion of deflate
+const size_t kMaxDeflateRatio = 1032;
+
+class Writer
+{
+public:
+    Writer(std::vector<unsigned char> &vBuffer): mvBuffer(vBuffer) {}
+
+    template<typename T> void Put(const T &value)
+    {
+        const size_t n = mvBuffer.size();
+        mvBuffer.resize(n+sizeof(T));
+        memcpy(&mvBuffer[n],&value,sizeof(T));
+    }
+
+    void PutBytes(const void* pData, size_t nBytes)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(pData);
+        mvBuffer.insert(mvBuffer.end(),p,p+nBytes);
+    }
+
+    void PutVarint(uint64_t value)
+    {
+        while(value>=0x80)
+        {
+            mvBuffer.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        mvBuffer.push_back(static_cast<unsigned char>(value));
+    }
+
+    // Zigzag coded, for deltas that may be negative
+    void PutSignedVarint(int64_t value)
+    {
+        PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void PutFloats(const std::vector<float> &v)
+    {
+        PutVarint(v.size());
+        if(!v.empty())
+            PutBytes(&v[0],v.size()*sizeof(float));
+    }
+
+protected:
+    std::vector<unsigned char> &mvBuffer;
+};
+
+// Reads from a buffer, failing once instead of reading past its end
+class Reader
+{
+public:
+    Reader(const unsigned char* pData, size_t nSize): mp(pData), mpEnd(pData+nSize), mbOk(true) {}
+
+    bool Ok() const { return mbOk; }
+
+    template<typename T> T Get()
+    {
+        T value = T();
+        const unsigned char* p = Take(sizeof(T));
+        if(p)
+            memcpy(&value,p,sizeof(T));
+        return value;
+    }
+
+    // Pointer to the next nBytes bytes, NULL if there are not as many left
+    const unsigned char* Take(size_t nBytes)
+    {
+        if(!mbOk || static_cast<size_t>(mpEnd-mp)<nBytes)
+        {
+            mbOk = false;
+            return NULL;
+        }
+        const unsigned char* p = mp;
+        mp += nBytes;
+        return p;
+    }
+
+    uint64_t GetVarint()
+    {
+        uint64_t value = 0;
+        for(int shift=0; shift<64; shift+=7)
+        {
+            const unsigned char* p = Take(1);
+            if(!p)
+                return 0;
+            value |= static_cast<uint64_t>(*p & 0x7F) << shift;
+            if(!(*p & 0x80))
+                return value;
+        }
+        mbOk = false;
+        return 0;
+    }
+
+    int64_t GetSignedVarint()
+    {
+        const uint64_t value = GetVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Count of a following array of elements of nElementBytes, bounded by the bytes left
+    size_t GetCount(size_t nElementBytes)
+    {
+        const uint64_t n = GetVarint();
+        if(!mbOk || n>static_cast<uint64_t>(mpEnd-mp)/nElementBytes)
+        {
+            mbOk = false;
+            return 0;
+        }
+        return n;
+    }
+
+    void GetFloats(std::vector<float> &v)
+    {
+        v.resize(GetCount(sizeof(float)));
+        const unsigned char* p = Take(v.size()*sizeof(float));
+        if(p && !v.empty())
+            memcpy(&v[0],p,v.size()*sizeof(float));
+    }
+
+protected:
+    const unsigned char* mp;
+    const unsigned char* mpEnd;
+    bool mbOk;
+};
+
+int16_t QuantizePosition(float x)
+{
+    const float q = std::round(x*kPositionScale);
+    return static_cast<int16_t>(std::max(-32768.f,std::min(32767.f,q)));
+}
+
+// Word ids are sorted, their values follow as floats to keep the scores exact
+void PutBowVector(Writer &w, const DBoW2::BowVector &bowVec)
+{
+    w.PutVarint(bowVec.size());
+    DBoW2::WordId lastWord = 0;
+    for(DBoW2::BowVector::const_iterator it=bowVec.begin(); it!=bowVec.end(); it++)
+    {
+        w.PutVarint(it->first-lastWord);
+        lastWord = it->first;
+    }
+    for(DBoW2::BowVector::const_iterator it=bowVec.begin(); it!=bowVec.end(); it++)
+        w.Put<float>(it->second);
+}
+
+void GetBowVector(Reader &r, DBoW2::BowVector &bowVec)
+{
+    bowVec.clear();
+    const size_t nWords = r.GetCount(1);
+    std::vector<DBoW2::WordId> vWords(nWords);
+    DBoW2::WordId word = 0;
+    for(size_t i=0; i<nWords; i++)
+    {
+        word += r.GetVarint();
+        vWords[i] = word;
+    }
+    // Ids are increasing, so every insertion goes at the end
+    for(size_t i=0; i<nWords && r.Ok(); i++)
+        bowVec.insert(bowVec.end(),std::make_pair(vWords[i],static_cast<DBoW2::WordValue>(r.Get<float>())));
+}
+
+// Writes the header in front of the payload, deflated if requested and smaller
+void Seal(const std::vector<unsigned char> &vPayload, uint8_t flags, int nRobotId, int nTargetRobotId, bool bCompress,
+          std::vector<unsigned char> &vBuffer)
+{
+    const size_t nHeader = KeyFrameCodec::HEADER_BYTES;
+    vBuffer.resize(nHeader);
+    if(bCompress)
+    {
+        uLongf nCompressed = compressBound(vPayload.size());
+        vBuffer.resize(nHeader+nCompressed);
+        if(compress2(&vBuffer[nHeader],&nCompressed,vPayload.data(),vPayload.size(),Z_BEST_SPEED)==Z_OK &&
+           nCompressed<vPayload.size())
+        {
+            vBuffer.resize(nHeader+nCompressed);
+            flags |= KeyFrameCodec::COMPRESSED;
+        }
+        else
+            vBuffer.resize(nHeader);
+    }
+    if(!(flags & KeyFrameCodec::COMPRESSED))
+        vBuffer.insert(vBuffer.end(),vPayload.begin(),vPayload.end());
+
+    const uint32_t nPayload = vPayload.size();
+    const uint16_t nId = nRobotId;
+    const uint16_t nTargetId = nTargetRobotId<0 ? kNoTarget : nTargetRobotId;
+    const uint32_t crc = crc32(0,&vBuffer[nHeader],vBuffer.size()-nHeader);
+    unsigned char* pHeader = &vBuffer[0];
+    memcpy(pHeader,&kMagic,4);
+    pHeader[4] = KeyFrameCodec::VERSION;
+    pHeader[5] = flags;
+    memcpy(pHeader+6,&nId,2);
+    memcpy(pHeader+8,&nTargetId,2);
+    memcpy(pHeader+10,&nPayload,4);
+    memcpy(pHeader+14,&crc,4);
+}
+
+// Checks the header of a message of the given kind and returns its payload, inflated into storage
+// if it is compressed. Returns NULL if the message is invalid.
+const unsigned char* Open(const unsigned char* pData, size_t nSize, uint8_t kind, cv::Mat &storage, uint32_t &nPayload)
+{
+    if(KeyFrameCodec::PeekRobotId(pData,nSize)<0)
+        return NULL;
+
+    const uint8_t flags = pData[5];
+    if((flags & (KeyFrameCodec::SUMMARY | KeyFrameCodec::REQUEST))!=kind)
+        return NULL;
+
+    const size_t nHeader = KeyFrameCodec::HEADER_BYTES;
+    uint32_t crc;
+    memcpy(&nPayload,pData+10,4);
+    memcpy(&crc,pData+14,4);
+    if(nPayload>kMaxPayloadBytes || crc!=crc32(0,pData+nHeader,nSize-nHeader))
+        return NULL;
+
+    if(flags & KeyFrameCodec::COMPRESSED)
+    {
+        // Check the claimed size before allocating it
+        if(nPayload>(nSize-nHeader)*kMaxDeflateRatio)
+            return NULL;
+        storage.create(1,nPayload,CV_8U);
+        uLongf nInflated = nPayload;
+        if(uncompress(storage.data,&nInflated,pData+nHeader,nSize-nHeader)!=Z_OK || nInflated!=nPayload)
+            return NULL;
+        return storage.data;
+    }
+
+    if(nPayload!=nSize-nHeader)
+        return NULL;
+    storage.release();
+    return pData+nHeader;
+}
+
+} // namespace
+
+void KeyFrameCodec::FromKeyFrame(KeyFrame* pKF, int nRobotId, float minScore, RemoteKeyFrame &kf)
+{
+    kf.mnRobotId = nRobotId;
+    kf.mSymbolChr = gtsam::symbolChr(pKF->key_);
+    kf.mnSymbolIndex = gtsam::symbolIndex(pKF->key_);
+    kf.mfMinScore = minScore;
+
+    kf.fx = pKF->fx;
+    kf.fy = pKF->fy;
+    kf.cx = pKF->cx;
+    kf.cy = pKF->cy;
+    kf.mK = pKF->mK;
+    kf.mTcw = pKF->GetPose().rowRange(0,3).clone();
+
+    kf.mnMinX = pKF->mnMinX;
+    kf.mnMinY = pKF->mnMinY;
+    kf.mnMaxX = pKF->mnMaxX;
+    kf.mnMaxY = pKF->mnMaxY;
+    kf.mfGridElementWidthInv = pKF->mfGridElementWidthInv;
+    kf.mfGridElementHeightInv = pKF->mfGridElementHeightInv;
+
+    kf.mnScaleLevels = pKF->mnScaleLevels;
+    kf.mfLogScaleFactor = pKF->mfLogScaleFactor;
+    kf.mvScaleFactors = pKF->mvScaleFactors;
+    kf.mvLevelSigma2 = pKF->mvLevelSigma2;
+    kf.mvInvLevelSigma2 = pKF->mvInvLevelSigma2;
+
+    kf.mBowVec = pKF->mBowVec;
+    kf.mFeatVec = pKF->mFeatVec;
+
+    kf.mvKeysUn = pKF->mvKeysUn;
+    kf.mDescriptors = pKF->mDescriptors;
+
+    const std::vector<MapPoint*> vpMapPoints = pKF->GetMapPointMatches();
+    const int N = vpMapPoints.size();
+    kf.mvIndices.assign(N,-1);
+    kf.mWorldPositions = cv::Mat(N,3,CV_32F,cv::Scalar(-1));
+    kf.mvWorldPoints.resize(N);
+    kf.mvMaxDistanceInvariance.assign(N,-1);
+    kf.mvMinDistanceInvariance.assign(N,-1);
+    kf.mStorage = cv::Mat::zeros(N,kDescriptorBytes,CV_8U);
+    kf.mvPointDescriptors.resize(N);
+    for(int i=0; i<N; i++)
+    {
+        MapPoint* pMP = vpMapPoints[i];
+        if(pMP && !pMP->isBad())
+        {
+            kf.mvIndices[i] = pMP->GetIndexInKeyFrame(pKF);
+            pMP->GetWorldPos(kf.mWorldPositions.ptr<float>(i));
+            kf.mvMaxDistanceInvariance[i] = pMP->GetMaxDistanceInvariance();
+            kf.mvMinDistanceInvariance[i] = pMP->GetMinDistanceInvariance();
+            pMP->GetDescriptor().copyTo(kf.mStorage.row(i));
+        }
+        kf.mvWorldPoints[i] = cv::Mat(3,1,CV_32F,kf.mWorldPositions.ptr<float>(i));
+        kf.mvPointDescriptors[i] = kf.mStorage.row(i);
+    }
+}
+
+void KeyFrameCodec::Encode(const RemoteKeyFrame &kf, int nTargetRobotId, bool bCompress, std::vector<unsigned char> &vBuffer)
+{
+    static thread_local std::vector<unsigned char> vPayload;
+    vPayload.clear();
+    Writer w(vPayload);
+
+    w.Put<uint8_t>(kf.mSymbolChr);
+    w.PutVarint(kf.mnSymbolIndex);
+    w.Put<float>(kf.mfMinScore);
+
+    w.Put<float>(kf.fx);
+    w.Put<float>(kf.fy);
+    w.Put<float>(kf.cx);
+    w.Put<float>(kf.cy);
+    for(int r=0; r<3; r++)
+        for(int c=0; c<4; c++)
+            w.Put<float>(kf.mTcw.at<float>(r,c));
+
+    w.Put<float>(kf.mnMinX);
+    w.Put<float>(kf.mnMinY);
+    w.Put<float>(kf.mnMaxX);
+    w.Put<float>(kf.mnMaxY);
+    w.Put<float>(kf.mfGridElementWidthInv);
+    w.Put<float>(kf.mfGridElementHeightInv);
+
+    w.PutVarint(kf.mnScaleLevels);
+    w.Put<float>(kf.mfLogScaleFactor);
+    w.PutFloats(kf.mvScaleFactors);
+    w.PutFloats(kf.mvLevelSigma2);
+    w.PutFloats(kf.mvInvLevelSigma2);
+
+    PutBowVector(w,kf.mBowVec);
+
+    w.PutVarint(kf.mFeatVec.size());
+    DBoW2::NodeId lastNode = 0;
+    for(DBoW2::FeatureVector::const_iterator it=kf.mFeatVec.begin(); it!=kf.mFeatVec.end(); it++)
+    {
+        w.PutVarint(it->first-lastNode);
+        lastNode = it->first;
+        const std::vector<unsigned int> &vFeatures = it->second;
+        w.PutVarint(vFeatures.size());
+        int64_t lastFeature = 0;
+        for(size_t i=0; i<vFeatures.size(); i++)
+        {
+            w.PutSignedVarint(static_cast<int64_t>(vFeatures[i])-lastFeature);
+            lastFeature = vFeatures[i];
+        }
+    }
+
+    // Keypoints, one array per field
+    const int N = kf.mvKeysUn.size();
+    w.PutVarint(N);
+    for(int i=0; i<N; i++)
+    {
+        w.Put<int16_t>(QuantizePosition(kf.mvKeysUn[i].pt.x));
+        w.Put<int16_t>(QuantizePosition(kf.mvKeysUn[i].pt.y));
+    }
+    for(int i=0; i<N; i++)
+    {
+        const float angle = kf.mvKeysUn[i].angle<0 ? 0 : kf.mvKeysUn[i].angle;
+        w.Put<uint16_t>(static_cast<uint16_t>(static_cast<long>(std::round(angle*kAngleScale)) & 0xFFFF));
+    }
+    for(int i=0; i<N; i++)
+        w.Put<uint8_t>(kf.mvKeysUn[i].octave);
+
+    // Map points: a bitmap of the keypoints that have one, then their fields
+    std::vector<unsigned char> vValid((N+7)/8,0);
+    int nValid = 0;
+    for(int i=0; i<N; i++)
+    {
+        if(kf.mvIndices[i]>=0)
+        {
+            vValid[i/8] |= 1 << (i%8);
+            nValid++;
+        }
+    }
+    w.PutBytes(vValid.data(),vValid.size());
+    for(int i=0; i<N; i++)
+        if(kf.mvIndices[i]>=0)
+            w.PutBytes(kf.mvWorldPoints[i].ptr<float>(),3*sizeof(float));
+    for(int i=0; i<N; i++)
+        if(kf.mvIndices[i]>=0)
+            w.Put<float>(kf.mvMaxDistanceInvariance[i]);
+    for(int i=0; i<N; i++)
+        if(kf.mvIndices[i]>=0)
+            w.Put<float>(kf.mvMinDistanceInvariance[i]);
+
+    // Descriptors last, decoded in place
+    for(int i=0; i<N; i++)
+        w.PutBytes(kf.mDescriptors.ptr<unsigned char>(i),kDescriptorBytes);
+    for(int i=0; i<N; i++)
+        if(kf.mvIndices[i]>=0)
+            w.PutBytes(kf.mvPointDescriptors[i].ptr<unsigned char>(),kDescriptorBytes);
+
+    Seal(vPayload,0,kf.mnRobotId,nTargetRobotId,bCompress,vBuffer);
+}
+
+void KeyFrameCodec::EncodeSummary(const RemoteKeyFrame &kf, std::vector<unsigned char> &vBuffer)
+{
+    static thread_local std::vector<unsigned char> vPayload;
+    vPayload.clear();
+    Writer w(vPayload);
+
+    w.Put<uint8_t>(kf.mSymbolChr);
+    w.PutVarint(kf.mnSymbolIndex);
+    w.Put<float>(kf.mfMinScore);
+    PutBowVector(w,kf.mBowVec);
+
+    Seal(vPayload,SUMMARY,kf.mnRobotId,-1,false,vBuffer);
+}
+
+void KeyFrameCodec::EncodeRequest(int nRobotId, int nTargetRobotId, uint64_t nSymbolIndex, std::vector<unsigned char> &vBuffer)
+{
+    static thread_local std::vector<unsigned char> vPayload;
+    vPayload.clear();
+    Writer w(vPayload);
+
+    w.PutVarint(nSymbolIndex);
+
+    Seal(vPayload,REQUEST,nRobotId,nTargetRobotId,false,vBuffer);
+}
+
+int KeyFrameCodec::PeekRobotId(const unsigned char* pData, size_t nSize)
+{
+    uint32_t magic;
+    if(nSize<HEADER_BYTES)
+        return -1;
+    memcpy(&magic,pData,4);
+    if(magic!=kMagic || pData[4]!=VERSION)
+        return -1;
+    uint16_t nRobotId;
+    memcpy(&nRobotId,pData+6,2);
+    return nRobotId;
+}
+
+int KeyFrameCodec::PeekTargetRobotId(const unsigned char* pData, size_t nSize)
+{
+    if(PeekRobotId(pData,nSize)<0)
+        return -1;
+    uint16_t nTargetRobotId;
+    memcpy(&nTargetRobotId,pData+8,2);
+    return nTargetRobotId==kNoTarget ? -1 : nTargetRobotId;
+}
+
+bool KeyFrameCodec::Decode(const unsigned char* pData, size_t nSize, RemoteKeyFrame &kf)
+{
+    uint32_t nPayload;
+    const unsigned char* pPayload = Open(pData,nSize,0,kf.mStorage,nPayload);
+    if(!pPayload)
+        return false;
+
+    Reader r(pPayload,nPayload);
+
+    kf.mnRobotId = PeekRobotId(pData,nSize);
+    kf.mSymbolChr = r.Get<uint8_t>();
+    kf.mnSymbolIndex = r.GetVarint();
+    kf.mfMinScore = r.Get<float>();
+
+    kf.fx = r.Get<float>();
+    kf.fy = r.Get<float>();
+    kf.cx = r.Get<float>();
+    kf.cy = r.Get<float>();
+    kf.mK = cv::Mat::eye(3,3,CV_32F);
+    kf.mK.at<float>(0,0) = kf.fx;
+    kf.mK.at<float>(1,1) = kf.fy;
+    kf.mK.at<float>(0,2) = kf.cx;
+    kf.mK.at<float>(1,2) = kf.cy;
+    kf.mTcw.create(3,4,CV_32F);
+    for(int row=0; row<3; row++)
+        for(int col=0; col<4; col++)
+            kf.mTcw.at<float>(row,col) = r.Get<float>();
+
+    kf.mnMinX = r.Get<float>();
+    kf.mnMinY = r.Get<float>();
+    kf.mnMaxX = r.Get<float>();
+    kf.mnMaxY = r.Get<float>();
+    kf.mfGridElementWidthInv = r.Get<float>();
+    kf.mfGridElementHeightInv = r.Get<float>();
+
+    kf.mnScaleLevels = r.GetVarint();
+    kf.mfLogScaleFactor = r.Get<float>();
+    r.GetFloats(kf.mvScaleFactors);
+    r.GetFloats(kf.mvLevelSigma2);
+    r.GetFloats(kf.mvInvLevelSigma2);
+    if(!r.Ok() || kf.mnScaleLevels<=0 || static_cast<int>(kf.mvScaleFactors.size())!=kf.mnScaleLevels ||
+       static_cast<int>(kf.mvLevelSigma2.size())!=kf.mnScaleLevels ||
+       static_cast<int>(kf.mvInvLevelSigma2.size())!=kf.mnScaleLevels)
+        return false;
+
+    GetBowVector(r,kf.mBowVec);
+
+    kf.mFeatVec.clear();
+    const size_t nNodes = r.GetCount(2);
+    DBoW2::NodeId node = 0;
+    for(size_t i=0; i<nNodes && r.Ok(); i++)
+    {
+        node += r.GetVarint();
+        std::vector<unsigned int> &vFeatures = kf.mFeatVec.insert(kf.mFeatVec.end(),std::make_pair(node,std::vector<unsigned int>()))->second;
+        vFeatures.resize(r.GetCount(1));
+        int64_t feature = 0;
+        for(size_t j=0; j<vFeatures.size(); j++)
+        {
+            feature += r.GetSignedVarint();
+            vFeatures[j] = feature;
+        }
+    }
+
+    const int N = r.GetCount(2*sizeof(int16_t)+sizeof(uint16_t)+sizeof(uint8_t)+kDescriptorBytes);
+    const unsigned char* pPositions = r.Take(N*2*sizeof(int16_t));
+    const unsigned char* pAngles = r.Take(N*sizeof(uint16_t));
+    const unsigned char* pOctaves = r.Take(N);
+    const unsigned char* pValid = r.Take((N+7)/8);
+    if(!r.Ok())
+        return false;
+
+    // Feature indices are keypoints
+    for(DBoW2::FeatureVector::const_iterator it=kf.mFeatVec.begin(); it!=kf.mFeatVec.end(); it++)
+        for(size_t j=0; j<it->second.size(); j++)
+            if(it->second[j]>=static_cast<unsigned int>(N))
+                return false;
+
+    kf.mvKeysUn.resize(N);
+    for(int i=0; i<N; i++)
+    {
+        int16_t xy[2];
+        uint16_t angle;
+        memcpy(xy,pPositions+4*i,4);
+        memcpy(&angle,pAngles+2*i,2);
+        cv::KeyPoint &kp = kf.mvKeysUn[i];
+        kp.pt.x = xy[0]/kPositionScale;
+        kp.pt.y = xy[1]/kPositionScale;
+        kp.angle = angle/kAngleScale;
+        kp.octave = std::min<int>(pOctaves[i],kf.mnScaleLevels-1);
+        kp.size = static_cast<int>(kPatchSize*kf.mvScaleFactors[kp.octave]);
+        kp.response = 0;
+        kp.class_id = -1;
+    }
+
+    int nValid = 0;
+    for(int i=0; i<N; i++)
+        if(pValid[i/8] & (1 << (i%8)))
+            nValid++;
+
+    const unsigned char* pWorldPositions = r.Take(nValid*3*sizeof(float));
+    const unsigned char* pMaxDistances = r.Take(nValid*sizeof(float));
+    const unsigned char* pMinDistances = r.Take(nValid*sizeof(float));
+    const unsigned char* pDescriptors = r.Take(N*kDescriptorBytes);
+    const unsigned char* pPointDescriptors = r.Take(nValid*kDescriptorBytes);
+    if(!r.Ok())
+        return false;
+
+    kf.mDescriptors = cv::Mat(N,kDescriptorBytes,CV_8U,const_cast<unsigned char*>(pDescriptors));
+
+    // The indices of the map points are the keypoints observing them
+    kf.mvIndices.assign(N,-1);
+    kf.mWorldPositions = cv::Mat(N,3,CV_32F,cv::Scalar(-1));
+    kf.mvWorldPoints.resize(N);
+    kf.mvMaxDistanceInvariance.assign(N,-1);
+    kf.mvMinDistanceInvariance.assign(N,-1);
+    kf.mvPointDescriptors.resize(N);
+    const cv::Mat zeroDescriptor = cv::Mat::zeros(1,kDescriptorBytes,CV_8U);
+    for(int i=0, iValid=0; i<N; i++)
+    {
+        if(pValid[i/8] & (1 << (i%8)))
+        {
+            kf.mvIndices[i] = i;
+            memcpy(kf.mWorldPositions.ptr<float>(i),pWorldPositions+iValid*3*sizeof(float),3*sizeof(float));
+            memcpy(&kf.mvMaxDistanceInvariance[i],pMaxDistances+iValid*sizeof(float),sizeof(float));
+            memcpy(&kf.mvMinDistanceInvariance[i],pMinDistances+iValid*sizeof(float),sizeof(float));
+            kf.mvPointDescriptors[i] = cv::Mat(1,kDescriptorBytes,CV_8U,const_cast<unsigned char*>(pPointDescriptors+iValid*kDescriptorBytes));
+            iValid++;
+        }
+        else
+            kf.mvPointDescriptors[i] = zeroDescriptor;
+        kf.mvWorldPoints[i] = cv::Mat(3,1,CV_32F,kf.mWorldPositions.ptr<float>(i));
+    }
+
+    return true;
+}
+
+bool KeyFrameCodec::DecodeSummary(const unsigned char* pData, size_t nSize, RemoteKeyFrame &kf)
+{
+    uint32_t nPayload;
+    const unsigned char* pPayload = Open(pData,nSize,SUMMARY,kf.mStorage,nPayload);
+    if(!pPayload)
+        return false;
+
+    Reader r(pPayload,nPayload);
+    kf.mnRobotId = PeekRobotId(pData,nSize);
+    kf.mSymbolChr = r.Get<uint8_t>();
+    kf.mnSymbolIndex = r.GetVarint();
+    kf.mfMinScore = r.Get<float>();
+    GetBowVector(r,kf.mBowVec);
+    return r.Ok();
+}
+
+bool KeyFrameCodec::DecodeRequest(const unsigned char* pData, size_t nSize, int &nRobotId, int &nTargetRobotId,
+                                  uint64_t &nSymbolIndex)
+{
+    cv::Mat storage;
+    uint32_t nPayload;
+    const unsigned char* pPayload = Open(pData,nSize,REQUEST,storage,nPayload);
+    if(!pPayload)
+        return false;
+
+    Reader r(pPayload,nPayload);
+    nRobotId = PeekRobotId(pData,nSize);
+    nTargetRobotId = PeekTargetRobotId(pData,nSize);
+    nSymbolIndex = r.GetVarint();
+    return r.Ok();
+}
+
+} //namespace ORB_SLAM
@@ -24,6 +24,7 @@
 #include "Thirdparty/DBoW2/DBoW2/BowVector.h"
 
 #include<mutex>
+#include<algorithm>
 
 using namespace std;
 
@@ -31,46 +32,234 @@ namespace ORB_SLAM2
 {
 
   KeyFrameDatabase::KeyFrameDatabase (const ORBVocabulary &voc):
-    mpVoc(&voc)
+    mpVoc(&voc), mnSlots(0)
   {
     mvInvertedFile.resize(voc.size());
   }
 
+  KeyFrameDatabase::~KeyFrameDatabase()
+  {
+    for(map<KeyFrame*,Entry*>::iterator mit=mmEntries.begin(), mend=mmEntries.end(); mit!=mend; mit++)
+      delete mit->second;
+  }
+
 
   void KeyFrameDatabase::add(KeyFrame *pKF)
   {
     //cout << "Adding keyframe: " << endl;
     unique_lock<mutex> lock(mMutex);
 
+    if(mmEntries.count(pKF))
+      return;
+
+    Entry* pEntry = new Entry();
+    pEntry->pKF = pKF;
+    pEntry->vWords.reserve(pKF->mBowVec.size());
     for(DBoW2::BowVector::const_iterator vit= pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
-      mvInvertedFile[vit->first].push_back(pKF);
+      if(vit->first<mpVoc->size())
+        pEntry->vWords.push_back(vit->first);
+    pEntry->vPositions.resize(pEntry->vWords.size());
+
+    if(!mvFreeSlots.empty())
+      {
+        pEntry->nSlot = mvFreeSlots.back();
+        mvFreeSlots.pop_back();
+      }
+    else
+      pEntry->nSlot = mnSlots++;
+
+    mmEntries[pKF] = pEntry;
+
+    vector<uint32_t> vOrder;
+    size_t vBegin[NUM_SHARDS+1];
+    BucketByShard(pEntry->vWords,vOrder,vBegin);
+    for(int s=0; s<NUM_SHARDS; s++)
+      {
+        if(vBegin[s]==vBegin[s+1])
+          continue;
+
+        unique_lock<mutex> lockShard(mMutexShards[s]);
+        for(size_t j=vBegin[s]; j<vBegin[s+1]; j++)
+          {
+            const uint32_t k = vOrder[j];
+            vector<Posting> &vPostings = mvInvertedFile[pEntry->vWords[k]];
+            pEntry->vPositions[k] = vPostings.size();
+            Posting posting = {pEntry, static_cast<uint32_t>(k)};
+            vPostings.push_back(posting);
+          }
+      }
   }
 
   void KeyFrameDatabase::erase(KeyFrame* pKF)
   {
     unique_lock<mutex> lock(mMutex);
 
+    map<KeyFrame*,Entry*>::iterator mit = mmEntries.find(pKF);
+    if(mit==mmEntries.end())
+      return;
+
+    Entry* pEntry = mit->second;
+    mmEntries.erase(mit);
+
     // Erase elements in the Inverse File for the entry
-    for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
+    vector<uint32_t> vOrder;
+    size_t vBegin[NUM_SHARDS+1];
+    BucketByShard(pEntry->vWords,vOrder,vBegin);
+    for(int s=0; s<NUM_SHARDS; s++)
       {
-        // List of keyframes that share the word
-        list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        if(vBegin[s]==vBegin[s+1])
+          continue;
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+        unique_lock<mutex> lockShard(mMutexShards[s]);
+        for(size_t j=vBegin[s]; j<vBegin[s+1]; j++)
           {
-            if(pKF==*lit)
-              {
-                lKFs.erase(lit);
-                break;
-              }
+            const uint32_t k = vOrder[j];
+
+            // Move the last posting of the list into the erased one
+            vector<Posting> &vPostings = mvInvertedFile[pEntry->vWords[k]];
+            const uint32_t pos = pEntry->vPositions[k];
+            const Posting last = vPostings.back();
+            vPostings[pos] = last;
+            last.pEntry->vPositions[last.nWord] = pos;
+            vPostings.pop_back();
           }
       }
+
+    mvFreeSlots.push_back(pEntry->nSlot);
+    delete pEntry;
   }
 
   void KeyFrameDatabase::clear()
   {
+    unique_lock<mutex> lock(mMutex);
+
+    for(int s=0; s<NUM_SHARDS; s++)
+      mMutexShards[s].lock();
+
     mvInvertedFile.clear();
     mvInvertedFile.resize(mpVoc->size());
+
+    for(int s=0; s<NUM_SHARDS; s++)
+      mMutexShards[s].unlock();
+
+    for(map<KeyFrame*,Entry*>::iterator mit=mmEntries.begin(), mend=mmEntries.end(); mit!=mend; mit++)
+      delete mit->second;
+    mmEntries.clear();
+    mvFreeSlots.clear();
+    mnSlots = 0;
+  }
+
+  void KeyFrameDatabase::SearchSharingWords(const vector<const DBoW2::BowVector*> &vpBowVecs, vector<Candidate> &vCandidates)
+  {
+    // Candidate of each slot, -1 if none. Per thread, reset before returning.
+    static thread_local vector<int> vSlotCandidate;
+
+    // Words of all the queries grouped by shard. Words out of the vocabulary (of a remote BoW
+    // vector) are skipped.
+    static thread_local vector<DBoW2::WordId> vWords;
+    static thread_local vector<uint32_t> vOrder;
+    size_t vBegin[NUM_SHARDS+1];
+
+    vCandidates.clear();
+
+    vWords.clear();
+    for(size_t i=0; i<vpBowVecs.size(); i++)
+      for(DBoW2::BowVector::const_iterator vit=vpBowVecs[i]->begin(), vend=vpBowVecs[i]->end(); vit != vend; vit++)
+        if(vit->first<mpVoc->size())
+          vWords.push_back(vit->first);
+    BucketByShard(vWords,vOrder,vBegin);
+
+    for(int s=0; s<NUM_SHARDS; s++)
+      {
+        if(vBegin[s]==vBegin[s+1])
+          continue;
+
+        unique_lock<mutex> lock(mMutexShards[s]);
+
+        for(size_t j=vBegin[s]; j<vBegin[s+1]; j++)
+          {
+            const vector<Posting> &vPostings = mvInvertedFile[vWords[vOrder[j]]];
+            for(vector<Posting>::const_iterator pit=vPostings.begin(), pend=vPostings.end(); pit!=pend; pit++)
+              {
+                const Entry* pEntry = pit->pEntry;
+                if(pEntry->nSlot>=vSlotCandidate.size())
+                  vSlotCandidate.resize(pEntry->nSlot+1,-1);
+
+                // The slot can be reused by another keyframe while the query runs
+                int &idx = vSlotCandidate[pEntry->nSlot];
+                if(idx<0 || vCandidates[idx].pKF!=pEntry->pKF)
+                  {
+                    Candidate candidate = {pEntry->pKF, pEntry->nSlot, 0, 0.0f, false};
+                    idx = vCandidates.size();
+                    vCandidates.push_back(candidate);
+                  }
+                vCandidates[idx].nWords++;
+              }
+          }
+      }
+
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      vSlotCandidate[vit->nSlot] = -1;
+  }
+
+  void KeyFrameDatabase::BucketByShard(const vector<DBoW2::WordId> &vWords, vector<uint32_t> &vOrder,
+                                       size_t vBegin[NUM_SHARDS+1])
+  {
+    // Counting sort on the shard
+    for(int s=0; s<=NUM_SHARDS; s++)
+      vBegin[s] = 0;
+    for(size_t k=0; k<vWords.size(); k++)
+      vBegin[Shard(vWords[k])+1]++;
+    for(int s=0; s<NUM_SHARDS; s++)
+      vBegin[s+1] += vBegin[s];
+
+    size_t vNext[NUM_SHARDS];
+    copy(vBegin,vBegin+NUM_SHARDS,vNext);
+    vOrder.resize(vWords.size());
+    for(size_t k=0; k<vWords.size(); k++)
+      vOrder[vNext[Shard(vWords[k])]++] = k;
+  }
+
+  int KeyFrameDatabase::ScoreCandidates(const DBoW2::BowVector &bowVec, vector<Candidate> &vCandidates)
+  {
+    // Only compare against those keyframes that share enough words
+    int maxCommonWords=0;
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      {
+        if(vit->nWords>maxCommonWords)
+          maxCommonWords=vit->nWords;
+      }
+
+    int minCommonWords = maxCommonWords*0.8f;
+
+    // Compute similarity score.
+    for(vector<Candidate>::iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      {
+        if(vit->nWords>minCommonWords)
+          {
+            vit->score = mpVoc->score(bowVec,vit->pKF->mBowVec);
+            vit->bScored = true;
+          }
+      }
+
+    return minCommonWords;
+  }
+
+  void KeyFrameDatabase::SortCandidates(const vector<Candidate> &vCandidates, vector<pair<KeyFrame*,int> > &vLookup)
+  {
+    vLookup.resize(vCandidates.size());
+    for(size_t i=0; i<vCandidates.size(); i++)
+      vLookup[i] = make_pair(vCandidates[i].pKF,static_cast<int>(i));
+    sort(vLookup.begin(),vLookup.end());
+  }
+
+  const KeyFrameDatabase::Candidate* KeyFrameDatabase::FindCandidate(const vector<Candidate> &vCandidates,
+                                                                     const vector<pair<KeyFrame*,int> > &vLookup, KeyFrame* pKF)
+  {
+    vector<pair<KeyFrame*,int> >::const_iterator it = lower_bound(vLookup.begin(),vLookup.end(),make_pair(pKF,-1));
+    if(it==vLookup.end() || it->first!=pKF)
+      return NULL;
+    return &vCandidates[it->second];
   }
 
 
@@ -78,55 +267,33 @@ namespace ORB_SLAM2
   {
 
     set<KeyFrame*>::iterator it1, it2;
-    set<KeyFrame*> lKFsSharingWords;
 
     cout << "kFs1.size(): " << kFs1.size() << " kFs2.size(): " << kFs2.size() << endl;
 
-    {
-      unique_lock<mutex> lock(mMutex);
-
-      for(it1 = kFs1.begin(); it1!=kFs1.end(); it1++){
-          KeyFrame* kF1 = *it1;
-
-      // Search all keyframes that share a word with current keyframes
-      // Discard keyframes connected to the query keyframe
-      for(DBoW2::BowVector::const_iterator vit=kF1->mBowVec.begin(), vend=kF1->mBowVec.end(); vit != vend; vit++)
-        {
-          list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
-
-          for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-              KeyFrame* pKFi=*lit;
-              if(kFs2.count(pKFi)){ // present in kFs2
-
-                  if(pKFi->mnLoopQuery!=kF1->mnId)
-                    {
-                     if(!lKFsSharingWords.count(pKFi))
-                        pKFi->mnLoopWords=0;
-
-                      if(!kFs1.count(pKFi))
-                        {
-                          pKFi->mnLoopQuery=kF1->mnId;
-                          if(!lKFsSharingWords.count(pKFi))
-                            lKFsSharingWords.insert(pKFi);
-                        }
-                    }
-                  pKFi->mnLoopWords++;
-                }
-            }
-          }
-        }
-    }
+    // Search all keyframes of kFs2 that share a word with keyframes of kFs1, counting the words
+    // shared with all of them
+    vector<const DBoW2::BowVector*> vpBowVecs;
+    vpBowVecs.reserve(kFs1.size());
+    for(it1 = kFs1.begin(); it1!=kFs1.end(); it1++)
+      vpBowVecs.push_back(&(*it1)->mBowVec);
 
-    cout << "lKFsSharingWords.size(): " << lKFsSharingWords.size() << endl;
+    vector<Candidate> vCandidates;
+    SearchSharingWords(vpBowVecs,vCandidates);
+
+    vector<Candidate> vSharingWords;
+    vSharingWords.reserve(vCandidates.size());
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      if(kFs2.count(vit->pKF) && !kFs1.count(vit->pKF))
+        vSharingWords.push_back(*vit);
+
+    cout << "lKFsSharingWords.size(): " << vSharingWords.size() << endl;
     int maxCommonWords=0;
 
-    for(it1 = lKFsSharingWords.begin(); it1!=lKFsSharingWords.end(); it1++){
-        KeyFrame* kF = *it1;
-        if(kF->mnLoopWords>maxCommonWords)
-            maxCommonWords=kF->mnLoopWords;
+    for(vector<Candidate>::const_iterator vit=vSharingWords.begin(), vend=vSharingWords.end(); vit!=vend; vit++){
+        if(vit->nWords>maxCommonWords)
+            maxCommonWords=vit->nWords;
 
-        cout << kF->mnId << " : " << kF->mnLoopWords << endl;
+        cout << vit->pKF->mnId << " : " << vit->nWords << endl;
       }
     int minCommonWords = maxCommonWords*0.8f;
 
@@ -135,11 +302,11 @@ namespace ORB_SLAM2
     set<KeyFrame*>  lKFsSharingWords2;
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(it1=lKFsSharingWords.begin(); it1!=lKFsSharingWords.end(); it1++)
+    for(vector<Candidate>::const_iterator vit=vSharingWords.begin(), vend=vSharingWords.end(); vit!=vend; vit++)
       {
-        KeyFrame* kF = *it1;
+        KeyFrame* kF = vit->pKF;
 
-        if(kF->mnLoopWords>minCommonWords)
+        if(vit->nWords>minCommonWords)
           {
             nscores++;
 
@@ -151,7 +318,6 @@ namespace ORB_SLAM2
                 if(si > maxScore){
                     maxScore = si;
                   }
-                //pKFi->mLoopScore = si;
               }
 
             if(maxScore>=minScore)
@@ -165,93 +331,37 @@ namespace ORB_SLAM2
 
   vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidatesInterRobotOffline(KeyFrame* pKF, float minScore)
   {
-    list<KeyFrame*> lKFsSharingWords;
-
     // Search all keyframes that share a word with current keyframes
-    // Discard keyframes connected to the query keyframe
-    {
-      unique_lock<mutex> lock(mMutex);
-
-      for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-        {
-          list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
-
-          for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-              KeyFrame* pKFi=*lit;
-              if(pKFi->mnLoopQuery!=pKF->mnId)
-                {
-                  pKFi->mnLoopWords=0;
-                  pKFi->mnLoopQuery=pKF->mnId;
-                  lKFsSharingWords.push_back(pKFi);
-
-                }
-              pKFi->mnLoopWords++;
-            }
-        }
-    }
-
-    if(lKFsSharingWords.empty())
-      return vector<KeyFrame*>();
-
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
-
-    // Only compare against those keyframes that share enough words
-    int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        if((*lit)->mnLoopWords>maxCommonWords)
-          maxCommonWords=(*lit)->mnLoopWords;
-      }
+    vector<Candidate> vCandidates;
+    SearchSharingWords(vector<const DBoW2::BowVector*>(1,&pKF->mBowVec),vCandidates);
 
-    int minCommonWords = maxCommonWords*0.8f;
-
-    int nscores=0;
+    if(vCandidates.empty())
+      return vector<KeyFrame*>();
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        KeyFrame* pKFi = *lit;
-
-        if(pKFi->mnLoopWords>minCommonWords)
-          {
-            nscores++;
-
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
+    ScoreCandidates(pKF->mBowVec,vCandidates);
 
-            pKFi->mLoopScore = si;
-            if(si>=minScore)
-              lScoreAndMatch.push_back(make_pair(si,pKFi));
-          }
-      }
+    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      if(vit->bScored && vit->score>=minScore)
+        lScoreAndMatch.push_back(make_pair(vit->score,vit->pKF));
 
     if(lScoreAndMatch.empty())
       return vector<KeyFrame*>();
 
-    list<pair<float,KeyFrame*> > lAccScoreAndMatch;
     float bestAccScore = minScore;
-
-    // Lets now accumulate score by covisibility
     for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
-      {
-        KeyFrame* pKFi = it->second;
-
-        float bestScore = it->first;
-        float accScore = it->first;
-        KeyFrame* pBestKF = pKFi;
-        lAccScoreAndMatch.push_back(make_pair(accScore,pBestKF));
-        if(accScore>bestAccScore)
-          bestAccScore=accScore;
-      }
+      if(it->first>bestAccScore)
+        bestAccScore=it->first;
 
     // Return all those keyframes with a score higher than 0.75*bestScore
     float minScoreToRetain = 0.75f*bestAccScore;
 
     set<KeyFrame*> spAlreadyAddedKF;
     vector<KeyFrame*> vpLoopCandidates;
-    vpLoopCandidates.reserve(lAccScoreAndMatch.size());
+    vpLoopCandidates.reserve(lScoreAndMatch.size());
 
-    for(list<pair<float,KeyFrame*> >::iterator it=lAccScoreAndMatch.begin(), itend=lAccScoreAndMatch.end(); it!=itend; it++)
+    for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
       {
         if(it->first>minScoreToRetain)
           {
@@ -269,95 +379,44 @@ namespace ORB_SLAM2
 
   vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, std::set<long unsigned int> neighboringMnIDs, float minScore)
   {
-    list<KeyFrame*> lKFsSharingWords;
-
     // Search all keyframes that share a word with current keyframes
     // Discard keyframes connected to the query keyframe
-    {
-      unique_lock<mutex> lock(mMutex);
-
-      for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-        {
-          list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
-
-          for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-              KeyFrame* pKFi=*lit;
-              if(pKFi->mnLoopQuery!=pKF->mnId)
-                {
-                  pKFi->mnLoopWords=0;
-                  if(!neighboringMnIDs.count(pKFi->mnId) && pKF->mnId != pKFi->mnId)
-                    {
-                      pKFi->mnLoopQuery=pKF->mnId;
-                      lKFsSharingWords.push_back(pKFi);
-                    }
-                }
-              pKFi->mnLoopWords++;
-            }
-        }
-    }
-
-    if(lKFsSharingWords.empty())
-      return vector<KeyFrame*>();
-
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
-
-    // Only compare against those keyframes that share enough words
-    int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        if((*lit)->mnLoopWords>maxCommonWords)
-          maxCommonWords=(*lit)->mnLoopWords;
-      }
+    vector<Candidate> vCandidates;
+    SearchSharingWords(vector<const DBoW2::BowVector*>(1,&pKF->mBowVec),vCandidates);
 
-    int minCommonWords = maxCommonWords*0.8f;
+    vector<Candidate> vSharingWords;
+    vSharingWords.reserve(vCandidates.size());
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      if(!neighboringMnIDs.count(vit->pKF->mnId) && pKF->mnId != vit->pKF->mnId)
+        vSharingWords.push_back(*vit);
 
-    int nscores=0;
+    if(vSharingWords.empty())
+      return vector<KeyFrame*>();
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        KeyFrame* pKFi = *lit;
+    ScoreCandidates(pKF->mBowVec,vSharingWords);
 
-        if(pKFi->mnLoopWords>minCommonWords)
-          {
-            nscores++;
-
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-
-            pKFi->mLoopScore = si;
-            if(si>=minScore)
-              lScoreAndMatch.push_back(make_pair(si,pKFi));
-          }
-      }
+    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    for(vector<Candidate>::const_iterator vit=vSharingWords.begin(), vend=vSharingWords.end(); vit!=vend; vit++)
+      if(vit->bScored && vit->score>=minScore)
+        lScoreAndMatch.push_back(make_pair(vit->score,vit->pKF));
 
     if(lScoreAndMatch.empty())
       return vector<KeyFrame*>();
 
-    list<pair<float,KeyFrame*> > lAccScoreAndMatch;
     float bestAccScore = minScore;
-
-    // Lets now accumulate score by covisibility
     for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
-      {
-        KeyFrame* pKFi = it->second;
-        float bestScore = it->first;
-        float accScore = it->first;
-        KeyFrame* pBestKF = pKFi;
-
-        lAccScoreAndMatch.push_back(make_pair(accScore,pBestKF));
-        if(accScore>bestAccScore)
-          bestAccScore=accScore;
-      }
+      if(it->first>bestAccScore)
+        bestAccScore=it->first;
 
     // Return all those keyframes with a score higher than 0.75*bestScore
     float minScoreToRetain = 0.75f*bestAccScore;
 
     set<KeyFrame*> spAlreadyAddedKF;
     vector<KeyFrame*> vpLoopCandidates;
-    vpLoopCandidates.reserve(lAccScoreAndMatch.size());
+    vpLoopCandidates.reserve(lScoreAndMatch.size());
 
-    for(list<pair<float,KeyFrame*> >::iterator it=lAccScoreAndMatch.begin(), itend=lAccScoreAndMatch.end(); it!=itend; it++)
+    for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
       {
         if(it->first>minScoreToRetain)
           {
@@ -375,71 +434,35 @@ namespace ORB_SLAM2
   vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore)
   {
     set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
-    list<KeyFrame*> lKFsSharingWords;
 
     // Search all keyframes that share a word with current keyframes
     // Discard keyframes connected to the query keyframe
-    {
-      unique_lock<mutex> lock(mMutex);
-
-      for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
-        {
-          list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
-
-          for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-              KeyFrame* pKFi=*lit;
-              if(pKFi->mnLoopQuery!=pKF->mnId)
-                {
-                  pKFi->mnLoopWords=0;
-                  if(!spConnectedKeyFrames.count(pKFi))
-                    {
-                      pKFi->mnLoopQuery=pKF->mnId;
-                      lKFsSharingWords.push_back(pKFi);
-                    }
-                }
-              pKFi->mnLoopWords++;
-            }
-        }
-    }
-
-    if(lKFsSharingWords.empty())
-      return vector<KeyFrame*>();
+    vector<Candidate> vCandidates;
+    SearchSharingWords(vector<const DBoW2::BowVector*>(1,&pKF->mBowVec),vCandidates);
 
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    vector<Candidate> vSharingWords;
+    vSharingWords.reserve(vCandidates.size());
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      if(!spConnectedKeyFrames.count(vit->pKF))
+        vSharingWords.push_back(*vit);
 
-    // Only compare against those keyframes that share enough words
-    int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        if((*lit)->mnLoopWords>maxCommonWords)
-          maxCommonWords=(*lit)->mnLoopWords;
-      }
-
-    int minCommonWords = maxCommonWords*0.8f;
-
-    int nscores=0;
+    if(vSharingWords.empty())
+      return vector<KeyFrame*>();
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        KeyFrame* pKFi = *lit;
-
-        if(pKFi->mnLoopWords>minCommonWords)
-          {
-            nscores++;
+    const int minCommonWords = ScoreCandidates(pKF->mBowVec,vSharingWords);
 
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-
-            pKFi->mLoopScore = si;
-            if(si>=minScore)
-              lScoreAndMatch.push_back(make_pair(si,pKFi));
-          }
-      }
+    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    for(vector<Candidate>::const_iterator vit=vSharingWords.begin(), vend=vSharingWords.end(); vit!=vend; vit++)
+      if(vit->bScored && vit->score>=minScore)
+        lScoreAndMatch.push_back(make_pair(vit->score,vit->pKF));
 
     if(lScoreAndMatch.empty())
       return vector<KeyFrame*>();
 
+    vector<pair<KeyFrame*,int> > vLookup;
+    SortCandidates(vSharingWords,vLookup);
+
     list<pair<float,KeyFrame*> > lAccScoreAndMatch;
     float bestAccScore = minScore;
 
@@ -454,14 +477,14 @@ namespace ORB_SLAM2
         KeyFrame* pBestKF = pKFi;
         for(vector<KeyFrame*>::iterator vit=vpNeighs.begin(), vend=vpNeighs.end(); vit!=vend; vit++)
           {
-            KeyFrame* pKF2 = *vit;
-            if(pKF2->mnLoopQuery==pKF->mnId && pKF2->mnLoopWords>minCommonWords)
+            const Candidate* pCandidate = FindCandidate(vSharingWords,vLookup,*vit);
+            if(pCandidate && pCandidate->nWords>minCommonWords)
               {
-                accScore+=pKF2->mLoopScore;
-                if(pKF2->mLoopScore>bestScore)
+                accScore+=pCandidate->score;
+                if(pCandidate->score>bestScore)
                   {
-                    pBestKF=pKF2;
-                    bestScore = pKF2->mLoopScore;
+                    pBestKF=pCandidate->pKF;
+                    bestScore = pCandidate->score;
                   }
               }
           }
@@ -495,70 +518,30 @@ namespace ORB_SLAM2
 
   vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidatesInterRobot(const DBoW2::BowVector& keyFrameBoWVec, int mnId,  float minScore)
   {
-    list<KeyFrame*> lKFsSharingWords;
-
     // Search all keyframes that share a word with current keyframes
-    {
-      unique_lock<mutex> lock(mMutex);
-     // cout << "mvInvertedFile.size(): " << mvInvertedFile.size() << endl;
-      for(DBoW2::BowVector::const_iterator vit=keyFrameBoWVec.begin(), vend=keyFrameBoWVec.end(); vit != vend; vit++)
-        {
-          list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
-          //cout << "#Keyframes: " << lKFs.size() << endl;
-          for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-              KeyFrame* pKFi=*lit;
-              if(pKFi->mnLoopQueryInterRobot!=mnId)
-                {
-                  pKFi->mnLoopWordsInterRobot=0;
-                  pKFi->mnLoopQueryInterRobot=mnId;
-                  lKFsSharingWords.push_back(pKFi);
-                }
-              pKFi->mnLoopWordsInterRobot++;
-            }
-        }
-    }
-
-    //cout << endl << "[LoopClosingInterRobot::KeyFrameDatabase]lKFsSharingWords.size(): " << lKFsSharingWords.size()  << endl;
-    if(lKFsSharingWords.empty())
-      return vector<KeyFrame*>();
-
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    vector<Candidate> vCandidates;
+    SearchSharingWords(vector<const DBoW2::BowVector*>(1,&keyFrameBoWVec),vCandidates);
 
-    // Only compare against those keyframes that share enough words
-    int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        if((*lit)->mnLoopWords>maxCommonWords)
-          maxCommonWords=(*lit)->mnLoopWords;
-      }
-
-    int minCommonWords = maxCommonWords*0.8f;
-
-    int nscores=0;
+    //cout << endl << "[LoopClosingInterRobot::KeyFrameDatabase]lKFsSharingWords.size(): " << vCandidates.size()  << endl;
+    if(vCandidates.empty())
+      return vector<KeyFrame*>();
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        KeyFrame* pKFi = *lit;
-
-        if(pKFi->mnLoopWordsInterRobot>minCommonWords)
-          {
-            nscores++;
+    const int minCommonWords = ScoreCandidates(keyFrameBoWVec,vCandidates);
 
-            float si = mpVoc->score(keyFrameBoWVec,pKFi->mBowVec);
-
-            pKFi->mLoopScoreInterRobot = si;
-            if(si>=minScore)
-              lScoreAndMatch.push_back(make_pair(si,pKFi));
-          }
-      }
+    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      if(vit->bScored && vit->score>=minScore)
+        lScoreAndMatch.push_back(make_pair(vit->score,vit->pKF));
 
    // cout << endl << "[LoopClosingInterRobot::KeyFrameDatabase]lScoreAndMatch.size(): " << lScoreAndMatch.size()  << endl;
 
     if(lScoreAndMatch.empty())
       return vector<KeyFrame*>();
 
+    vector<pair<KeyFrame*,int> > vLookup;
+    SortCandidates(vCandidates,vLookup);
+
     list<pair<float,KeyFrame*> > lAccScoreAndMatch;
     float bestAccScore = minScore;
 
@@ -573,14 +556,14 @@ namespace ORB_SLAM2
         KeyFrame* pBestKF = pKFi;
         for(vector<KeyFrame*>::iterator vit=vpNeighs.begin(), vend=vpNeighs.end(); vit!=vend; vit++)
           {
-            KeyFrame* pKF2 = *vit;
-            if(pKF2->mnLoopQueryInterRobot==mnId && pKF2->mnLoopWordsInterRobot>minCommonWords)
+            const Candidate* pCandidate = FindCandidate(vCandidates,vLookup,*vit);
+            if(pCandidate && pCandidate->nWords>minCommonWords)
               {
-                accScore+=pKF2->mLoopScoreInterRobot;
-                if(pKF2->mLoopScoreInterRobot>bestScore)
+                accScore+=pCandidate->score;
+                if(pCandidate->score>bestScore)
                   {
-                    pBestKF=pKF2;
-                    bestScore = pKF2->mLoopScoreInterRobot;
+                    pBestKF=pCandidate->pKF;
+                    bestScore = pCandidate->score;
                   }
               }
           }
@@ -616,63 +599,27 @@ namespace ORB_SLAM2
 
   vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
   {
-    list<KeyFrame*> lKFsSharingWords;
-
     // Search all keyframes that share a word with current frame
-    {
-      unique_lock<mutex> lock(mMutex);
-
-      for(DBoW2::BowVector::const_iterator vit=F->mBowVec.begin(), vend=F->mBowVec.end(); vit != vend; vit++)
-        {
-          list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
-
-          for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-              KeyFrame* pKFi=*lit;
-              if(pKFi->mnRelocQuery!=F->mnId)
-                {
-                  pKFi->mnRelocWords=0;
-                  pKFi->mnRelocQuery=F->mnId;
-                  lKFsSharingWords.push_back(pKFi);
-                }
-              pKFi->mnRelocWords++;
-            }
-        }
-    }
-    if(lKFsSharingWords.empty())
-      return vector<KeyFrame*>();
+    vector<Candidate> vCandidates;
+    SearchSharingWords(vector<const DBoW2::BowVector*>(1,&F->mBowVec),vCandidates);
 
-    // Only compare against those keyframes that share enough words
-    int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        if((*lit)->mnRelocWords>maxCommonWords)
-          maxCommonWords=(*lit)->mnRelocWords;
-      }
-
-    int minCommonWords = maxCommonWords*0.8f;
-
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
-
-    int nscores=0;
+    if(vCandidates.empty())
+      return vector<KeyFrame*>();
 
     // Compute similarity score.
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
-      {
-        KeyFrame* pKFi = *lit;
+    ScoreCandidates(F->mBowVec,vCandidates);
 
-        if(pKFi->mnRelocWords>minCommonWords)
-          {
-            nscores++;
-            float si = mpVoc->score(F->mBowVec,pKFi->mBowVec);
-            pKFi->mRelocScore=si;
-            lScoreAndMatch.push_back(make_pair(si,pKFi));
-          }
-      }
+    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    for(vector<Candidate>::const_iterator vit=vCandidates.begin(), vend=vCandidates.end(); vit!=vend; vit++)
+      if(vit->bScored)
+        lScoreAndMatch.push_back(make_pair(vit->score,vit->pKF));
 
     if(lScoreAndMatch.empty())
       return vector<KeyFrame*>();
 
+    vector<pair<KeyFrame*,int> > vLookup;
+    SortCandidates(vCandidates,vLookup);
+
     list<pair<float,KeyFrame*> > lAccScoreAndMatch;
     float bestAccScore = 0;
 
@@ -687,15 +634,15 @@ namespace ORB_SLAM2
         KeyFrame* pBestKF = pKFi;
         for(vector<KeyFrame*>::iterator vit=vpNeighs.begin(), vend=vpNeighs.end(); vit!=vend; vit++)
           {
-            KeyFrame* pKF2 = *vit;
-            if(pKF2->mnRelocQuery!=F->mnId)
+            const Candidate* pCandidate = FindCandidate(vCandidates,vLookup,*vit);
+            if(!pCandidate || !pCandidate->bScored)
               continue;
 
-            accScore+=pKF2->mRelocScore;
-            if(pKF2->mRelocScore>bestScore)
+            accScore+=pCandidate->score;
+            if(pCandidate->score>bestScore)
               {
-                pBestKF=pKF2;
-                bestScore = pKF2->mRelocScore;
+                pBestKF=pCandidate->pKF;
+                bestScore = pCandidate->score;
               }
 
           }
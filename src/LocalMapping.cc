@@ -22,6 +22,7 @@
 #include "LoopClosing.h"
 #include "ORBmatcher.h"
 #include "Optimizer.h"
+#include "Profiler.h"
 
 #include<mutex>
 
@@ -30,7 +31,7 @@ namespace ORB_SLAM2
 
 LocalMapping::LocalMapping(Map *pMap, KeyFrameDatabase* pDB, const float bMonocular):
     mbMonocular(bMonocular), mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
-    mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true),
+    mqNewKeyFrames(4), mbAbortBA(false), mnLoopQueueOverflows(0), mnInterRobotQueueOverflows(0), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true),
     mbLoopClose(true), mpKeyFrameDB(pDB) // mbLoopClose() added by @itzsid
 {
 }
@@ -65,6 +66,7 @@ void LocalMapping::Run()
 {
 
     mbFinished = false;
+    Profiler::SetThreadName("Local Mapping");
 
     while(1)
     {
@@ -101,24 +103,26 @@ void LocalMapping::Run()
                 KeyFrameCulling();
             }
 
+            // If the loop closer is behind, the keyframe is not checked for loops but still
+            // goes to the database, so later keyframes can close a loop with it
+            bool bLoopQueued = false;
             if(mbLoopClose){
-              mpLoopCloser->InsertKeyFrame(mpCurrentKeyFrame);
+              bLoopQueued = mpLoopCloser->InsertKeyFrame(mpCurrentKeyFrame);
+              if(!bLoopQueued)
+                mnLoopQueueOverflows++;
               }
-            else{
+            if(!bLoopQueued){
                 mpKeyFrameDB->add(mpCurrentKeyFrame);
                 mpCurrentKeyFrame->SetNotErase(); // do not erase the keyframe
               }
 
-            if(mbLoopCloseInterRobot)
-              mpLoopCloserInterRobot->InsertKeyFrame(mpCurrentKeyFrame);
+            if(mbLoopCloseInterRobot && !mpLoopCloserInterRobot->InsertKeyFrame(mpCurrentKeyFrame))
+              mnInterRobotQueueOverflows++;
         }
         else if(Stop())
         {
             // Safe area to stop
-            while(isStopped() && !CheckFinish())
-            {
-                usleep(3000);
-            }
+            mSignal.WaitUntil([this]{return !isStopped() || CheckFinish();});
             if(CheckFinish())
                 break;
         }
@@ -131,33 +135,38 @@ void LocalMapping::Run()
         if(CheckFinish())
             break;
 
-        usleep(3000);
+        // Sleep until a keyframe is inserted or a stop, reset or finish is requested
+        if(!CheckNewKeyFrames())
+            mSignal.Wait();
     }
 
     SetFinish();
 }
 
-void LocalMapping::InsertKeyFrame(KeyFrame *pKF)
+bool LocalMapping::InsertKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexNewKFs);
-    mlNewKeyFrames.push_back(pKF);
-    mbAbortBA=true;
+    if(!mqNewKeyFrames.Push(pKF))
+        return false;
+
+    {
+        unique_lock<mutex> lock(mMutexNewKFs);
+        mbAbortBA=true;
+    }
+    mSignal.Notify();
+    return true;
 }
 
 
 bool LocalMapping::CheckNewKeyFrames()
 {
-    unique_lock<mutex> lock(mMutexNewKFs);
-    return(!mlNewKeyFrames.empty());
+    return !mqNewKeyFrames.Empty();
 }
 
 void LocalMapping::ProcessNewKeyFrame()
 {
-    {
-        unique_lock<mutex> lock(mMutexNewKFs);
-        mpCurrentKeyFrame = mlNewKeyFrames.front();
-        mlNewKeyFrames.pop_front();
-    }
+    ScopedTimer timer(Profiler::LOCAL_MAPPING_PROCESS_KF);
+
+    mqNewKeyFrames.Pop(mpCurrentKeyFrame);
 
     // Compute Bags of Words structures
     mpCurrentKeyFrame->ComputeBoW();
@@ -195,6 +204,8 @@ void LocalMapping::ProcessNewKeyFrame()
 
 void LocalMapping::MapPointCulling()
 {
+    ScopedTimer timer(Profiler::LOCAL_MAPPING_MAPPOINT_CULLING);
+
     // Check Recent Added MapPoints
     list<MapPoint*>::iterator lit = mlpRecentAddedMapPoints.begin();
     const unsigned long int nCurrentKFid = mpCurrentKeyFrame->mnId;
@@ -216,11 +227,13 @@ void LocalMapping::MapPointCulling()
         else if(pMP->GetFoundRatio()<0.25f )
         {
             pMP->SetBadFlag();
+            Profiler::Count(Profiler::MAPPOINTS_CULLED);
             lit = mlpRecentAddedMapPoints.erase(lit);
         }
         else if(((int)nCurrentKFid-(int)pMP->mnFirstKFid)>=2 && pMP->Observations()<=cnThObs)
         {
             pMP->SetBadFlag();
+            Profiler::Count(Profiler::MAPPOINTS_CULLED);
             lit = mlpRecentAddedMapPoints.erase(lit);
         }
         else if(((int)nCurrentKFid-(int)pMP->mnFirstKFid)>=3)
@@ -232,6 +245,8 @@ void LocalMapping::MapPointCulling()
 
 void LocalMapping::CreateNewMapPoints()
 {
+    ScopedTimer timer(Profiler::LOCAL_MAPPING_CREATE_MAPPOINTS);
+
     // Retrieve neighbor keyframes in covisibility graph
     int nn = 10;
     if(mbMonocular)
@@ -475,10 +490,14 @@ void LocalMapping::CreateNewMapPoints()
             nnew++;
         }
     }
+
+    Profiler::Count(Profiler::MAPPOINTS_CREATED,nnew);
 }
 
 void LocalMapping::SearchInNeighbors()
 {
+    ScopedTimer timer(Profiler::LOCAL_MAPPING_SEARCH_NEIGHBORS);
+
     // Retrieve neighbor keyframes
     int nn = 10;
     if(mbMonocular)
@@ -580,23 +599,34 @@ cv::Mat LocalMapping::ComputeF12(KeyFrame *&pKF1, KeyFrame *&pKF2)
 
 void LocalMapping::RequestStop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopRequested = true;
-    unique_lock<mutex> lock2(mMutexNewKFs);
-    mbAbortBA = true;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopRequested = true;
+        unique_lock<mutex> lock2(mMutexNewKFs);
+        mbAbortBA = true;
+    }
+    mSignal.Notify();
 }
 
 bool LocalMapping::Stop()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    if(mbStopRequested && !mbNotStop)
     {
+        unique_lock<mutex> lock(mMutexStop);
+        if(!mbStopRequested || mbNotStop)
+            return false;
+
         mbStopped = true;
         cout << "Local Mapping STOP" << endl;
-        return true;
     }
 
-    return false;
+    // Wake up threads waiting in WaitUntilStopped
+    mSignal.Notify();
+    return true;
+}
+
+void LocalMapping::WaitUntilStopped()
+{
+    mSignal.WaitUntil([this]{return isStopped();});
 }
 
 bool LocalMapping::isStopped()
@@ -613,17 +643,21 @@ bool LocalMapping::stopRequested()
 
 void LocalMapping::Release()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    unique_lock<mutex> lock2(mMutexFinish);
-    if(mbFinished)
-        return;
-    mbStopped = false;
-    mbStopRequested = false;
-    for(list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend=mlNewKeyFrames.end(); lit!=lend; lit++)
-        delete *lit;
-    mlNewKeyFrames.clear();
-
-    cout << "Local Mapping RELEASE" << endl;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        unique_lock<mutex> lock2(mMutexFinish);
+        if(mbFinished)
+            return;
+        mbStopped = false;
+        mbStopRequested = false;
+        // The mapping thread is stopped, so the queue can be drained from here
+        KeyFrame* pKF;
+        while(mqNewKeyFrames.Pop(pKF))
+            delete pKF;
+
+        cout << "Local Mapping RELEASE" << endl;
+    }
+    mSignal.Notify();
 }
 
 bool LocalMapping::AcceptKeyFrames()
@@ -640,12 +674,18 @@ void LocalMapping::SetAcceptKeyFrames(bool flag)
 
 bool LocalMapping::SetNotStop(bool flag)
 {
-    unique_lock<mutex> lock(mMutexStop);
+    {
+        unique_lock<mutex> lock(mMutexStop);
 
-    if(flag && mbStopped)
-        return false;
+        if(flag && mbStopped)
+            return false;
+
+        mbNotStop = flag;
+    }
 
-    mbNotStop = flag;
+    // A pending stop request can now be served
+    if(!flag)
+        mSignal.Notify();
 
     return true;
 }
@@ -657,6 +697,8 @@ void LocalMapping::InterruptBA()
 
 void LocalMapping::KeyFrameCulling()
 {
+    ScopedTimer timer(Profiler::LOCAL_MAPPING_KEYFRAME_CULLING);
+
     // Check redundant keyframes (only local keyframes)
     // A keyframe is considered redundant if the 90% of the MapPoints it sees, are seen
     // in at least other 3 keyframes (in the same or finer scale)
@@ -691,9 +733,9 @@ void LocalMapping::KeyFrameCulling()
                     if(pMP->Observations()>thObs)
                     {
                         const int &scaleLevel = pKF->mvKeysUn[i].octave;
-                        const map<KeyFrame*, size_t> observations = pMP->GetObservations();
+                        const MapPoint::ObservationsPtr observations = pMP->GetObservations();
                         int nObs=0;
-                        for(map<KeyFrame*, size_t>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+                        for(MapPointObservations::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
                         {
                             KeyFrame* pKFi = mit->first;
                             if(pKFi==pKF)
@@ -717,7 +759,10 @@ void LocalMapping::KeyFrameCulling()
         }  
 
         if(nRedundantObservations>0.9*nMPs)
+        {
             pKF->SetBadFlag();
+            Profiler::Count(Profiler::KEYFRAMES_CULLED);
+        }
     }
 }
 
@@ -734,33 +779,35 @@ void LocalMapping::RequestReset()
         unique_lock<mutex> lock(mMutexReset);
         mbResetRequested = true;
     }
+    mSignal.Notify();
 
-    while(1)
-    {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetRequested)
-                break;
-        }
-        usleep(3000);
-    }
+    mSignal.WaitUntil([this]{
+        unique_lock<mutex> lock2(mMutexReset);
+        return !mbResetRequested;
+    });
 }
 
 void LocalMapping::ResetIfRequested()
 {
-    unique_lock<mutex> lock(mMutexReset);
-    if(mbResetRequested)
     {
-        mlNewKeyFrames.clear();
+        unique_lock<mutex> lock(mMutexReset);
+        if(!mbResetRequested)
+            return;
+
+        mqNewKeyFrames.Clear();
         mlpRecentAddedMapPoints.clear();
         mbResetRequested=false;
     }
+    mSignal.Notify();
 }
 
 void LocalMapping::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    mSignal.Notify();
 }
 
 bool LocalMapping::CheckFinish()
@@ -771,10 +818,13 @@ bool LocalMapping::CheckFinish()
 
 void LocalMapping::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;    
-    unique_lock<mutex> lock2(mMutexStop);
-    mbStopped = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+        unique_lock<mutex> lock2(mMutexStop);
+        mbStopped = true;
+    }
+    mSignal.Notify();
 }
 
 bool LocalMapping::isFinished()
@@ -783,4 +833,20 @@ bool LocalMapping::isFinished()
     return mbFinished;
 }
 
+void LocalMapping::WaitUntilFinished()
+{
+    mSignal.WaitUntil([this]{return isFinished();});
+}
+
+WorkSignal::Stats LocalMapping::GetQueueStats()
+{
+    return mSignal.GetStats();
+}
+
+void LocalMapping::GetQueueOverflows(int &nLoopClosing, int &nInterRobot)
+{
+    nLoopClosing = mnLoopQueueOverflows;
+    nInterRobot = mnInterRobotQueueOverflows;
+}
+
 } //namespace ORB_SLAM
@@ -28,6 +28,10 @@
 
 #include "ORBmatcher.h"
 
+#include "Profiler.h"
+
+#include "ThreadPool.h"
+
 #include<mutex>
 #include<thread>
 
@@ -37,8 +41,8 @@ namespace ORB_SLAM2
 
   LoopClosing::LoopClosing(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale, const bool correctLoop):
     mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
-    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
-    mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0), loopClosureRetreived_(true), loopClosure_(), correctLoop_(correctLoop)
+    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mqLoopKeyFrameQueue(64), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
+    mbStopGBA(false), mpThreadGBA(NULL), mpIncrementalBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0), loopClosureRetreived_(true), loopClosure_(), correctLoop_(correctLoop)
   {
     mnCovisibilityConsistencyTh = 3;
   }
@@ -53,10 +57,17 @@ namespace ORB_SLAM2
     mpLocalMapper=pLocalMapper;
   }
 
+  void LoopClosing::UseIncrementalBundleAdjustment()
+  {
+    if(!mpIncrementalBA)
+      mpIncrementalBA = new IncrementalBundleAdjustment(mpMap, !mbFixScale);
+  }
+
 
   void LoopClosing::Run()
   {
     mbFinished =false;
+    Profiler::SetThreadName("Loop Closing");
 
     while(1)
       {
@@ -73,6 +84,8 @@ namespace ORB_SLAM2
                     // In the stereo/RGBD case s=1
                     if(ComputeSim3())
                       {
+                        Profiler::Count(Profiler::LOOPS_DETECTED);
+
                         // Perform loop fusion and pose graph optimization
                         if(correctLoop_)
                          CorrectLoop();  //-- do not correct loop in this case -- backend pose graph optimization will do it
@@ -89,6 +102,10 @@ namespace ORB_SLAM2
 
                       }
                   }
+
+                // Keep the smoother up to date, a loop then only costs the part of the map it changes
+                if(mpIncrementalBA)
+                  mpIncrementalBA->AddKeyFrame(mpCurrentKF);
               }
           }
 
@@ -97,7 +114,9 @@ namespace ORB_SLAM2
         if(CheckFinish())
           break;
 
-        usleep(5000);
+        // Sleep until a keyframe is inserted, the last loop is retrieved or a reset or finish is requested
+        if(!LoopClosureIsRetrieved() || !CheckNewKeyFrames())
+          mSignal.Wait();
       }
 
     SetFinish();
@@ -105,8 +124,11 @@ namespace ORB_SLAM2
 
   void LoopClosing::setLoopClosureRetrievedToTrue()
 {
-  unique_lock<mutex> lock(mMutexLoopQueue);
-  loopClosureRetreived_ = true;
+  {
+    unique_lock<mutex> lock(mMutexLoopQueue);
+    loopClosureRetreived_ = true;
+  }
+  mSignal.Notify();
 }
 
     void LoopClosing::setLoopClosureRetrievedToFalse()
@@ -121,28 +143,30 @@ namespace ORB_SLAM2
     return loopClosureRetreived_;
   }
 
-  void LoopClosing::InsertKeyFrame(KeyFrame *pKF)
+  bool LoopClosing::InsertKeyFrame(KeyFrame *pKF)
   {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    if(pKF->mnId!=0)
-      mlpLoopKeyFrameQueue.push_back(pKF);
+    if(pKF->mnId==0)
+      return true;
+
+    if(!mqLoopKeyFrameQueue.Push(pKF))
+      return false;
+
+    mSignal.Notify();
+    return true;
   }
 
   bool LoopClosing::CheckNewKeyFrames()
   {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    return(!mlpLoopKeyFrameQueue.empty());
+    return !mqLoopKeyFrameQueue.Empty();
   }
 
   bool LoopClosing::DetectLoop()
   {
-    {
-      unique_lock<mutex> lock(mMutexLoopQueue);
-      mpCurrentKF = mlpLoopKeyFrameQueue.front();
-      mlpLoopKeyFrameQueue.pop_front();
-      // Avoid that a keyframe can be erased while it is being process by this thread
-      mpCurrentKF->SetNotErase();
-    }
+    ScopedTimer timer(Profiler::LOOP_DETECT);
+
+    mqLoopKeyFrameQueue.Pop(mpCurrentKF);
+    // Avoid that a keyframe can be erased while it is being process by this thread
+    mpCurrentKF->SetNotErase();
 
     //If the map contains less than 10 KF or less than 10 KF have passed from last loop detection
     if(mpCurrentKF->mnId<mLastLoopKFid+10)
@@ -264,6 +288,8 @@ namespace ORB_SLAM2
 
   bool LoopClosing::ComputeSim3()
   {
+    ScopedTimer timer(Profiler::LOOP_COMPUTE_SIM3);
+
     // For each consistent loop candidate we try to compute a Sim3
 
     const int nInitialCandidates = mvpEnoughConsistentCandidates.size();
@@ -436,6 +462,8 @@ namespace ORB_SLAM2
 
   void LoopClosing::CorrectLoop()
   {
+    ScopedTimer timer(Profiler::LOOP_CORRECT);
+
     cout << "Loop detected!" << endl;
 
     // Send a stop signal to Local Mapping
@@ -458,10 +486,7 @@ namespace ORB_SLAM2
       }
 
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-      {
-        usleep(1000);
-      }
+    mpLocalMapper->WaitUntilStopped();
 
     // Ensure current keyframe is updated
     mpCurrentKF->UpdateConnections();
@@ -479,9 +504,12 @@ namespace ORB_SLAM2
       // Get Map Mutex
       unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
 
-      for(vector<KeyFrame*>::iterator vit=mvpCurrentConnectedKFs.begin(), vend=mvpCurrentConnectedKFs.end(); vit!=vend; vit++)
+      // The corrected and non-corrected poses of the connected keyframes are independent
+      const int nConnected = mvpCurrentConnectedKFs.size();
+      vector<g2o::Sim3,Eigen::aligned_allocator<g2o::Sim3> > vCorrectedSiw(nConnected), vSiw(nConnected);
+      ThreadPool::Global()->ParallelFor(nConnected, [&](int i)
         {
-          KeyFrame* pKFi = *vit;
+          KeyFrame* pKFi = mvpCurrentConnectedKFs[i];
 
           cv::Mat Tiw = pKFi->GetPose();
 
@@ -491,26 +519,30 @@ namespace ORB_SLAM2
               cv::Mat Ric = Tic.rowRange(0,3).colRange(0,3);
               cv::Mat tic = Tic.rowRange(0,3).col(3);
               g2o::Sim3 g2oSic(Converter::toMatrix3d(Ric),Converter::toVector3d(tic),1.0);
-              g2o::Sim3 g2oCorrectedSiw = g2oSic*mg2oScw;
               //Pose corrected with the Sim3 of the loop closure
-              CorrectedSim3[pKFi]=g2oCorrectedSiw;
+              vCorrectedSiw[i] = g2oSic*mg2oScw;
             }
+          else
+            vCorrectedSiw[i] = mg2oScw;
 
           cv::Mat Riw = Tiw.rowRange(0,3).colRange(0,3);
           cv::Mat tiw = Tiw.rowRange(0,3).col(3);
-          g2o::Sim3 g2oSiw(Converter::toMatrix3d(Riw),Converter::toVector3d(tiw),1.0);
           //Pose without correction
-          NonCorrectedSim3[pKFi]=g2oSiw;
-        }
+          vSiw[i] = g2o::Sim3(Converter::toMatrix3d(Riw),Converter::toVector3d(tiw),1.0);
+        });
 
-      // Correct all MapPoints obsrved by current keyframe and neighbors, so that they align with the other side of the loop
-      for(KeyFrameAndPose::iterator mit=CorrectedSim3.begin(), mend=CorrectedSim3.end(); mit!=mend; mit++)
+      for(int i=0; i<nConnected; i++)
         {
-          KeyFrame* pKFi = mit->first;
-          g2o::Sim3 g2oCorrectedSiw = mit->second;
-          g2o::Sim3 g2oCorrectedSwi = g2oCorrectedSiw.inverse();
+          CorrectedSim3[mvpCurrentConnectedKFs[i]]=vCorrectedSiw[i];
+          NonCorrectedSim3[mvpCurrentConnectedKFs[i]]=vSiw[i];
+        }
 
-          g2o::Sim3 g2oSiw =NonCorrectedSim3[pKFi];
+      // A MapPoint seen by several keyframes is corrected by the first one that observes it.
+      // Claim them here so that the keyframes can be corrected in parallel
+      vector<vector<MapPoint*> > vvpCorrectedMPs(nConnected);
+      for(int i=0; i<nConnected; i++)
+        {
+          KeyFrame* pKFi = mvpCurrentConnectedKFs[i];
 
           vector<MapPoint*> vpMPsi = pKFi->GetMapPointMatches();
           for(size_t iMP=0, endMPi = vpMPsi.size(); iMP<endMPi; iMP++)
@@ -523,6 +555,25 @@ namespace ORB_SLAM2
               if(pMPi->mnCorrectedByKF==mpCurrentKF->mnId)
                 continue;
 
+              pMPi->mnCorrectedByKF = mpCurrentKF->mnId;
+              pMPi->mnCorrectedReference = pKFi->mnId;
+              vvpCorrectedMPs[i].push_back(pMPi);
+            }
+        }
+
+      // Correct all MapPoints obsrved by current keyframe and neighbors, so that they align with the other side of the loop
+      ThreadPool::Global()->ParallelFor(nConnected, [&](int i)
+        {
+          KeyFrame* pKFi = mvpCurrentConnectedKFs[i];
+          const g2o::Sim3 &g2oCorrectedSiw = vCorrectedSiw[i];
+          const g2o::Sim3 g2oCorrectedSwi = g2oCorrectedSiw.inverse();
+          const g2o::Sim3 &g2oSiw = vSiw[i];
+
+          const vector<MapPoint*> &vpMPsi = vvpCorrectedMPs[i];
+          for(size_t iMP=0, endMPi = vpMPsi.size(); iMP<endMPi; iMP++)
+            {
+              MapPoint* pMPi = vpMPsi[iMP];
+
               // Project with non-corrected pose and project back with corrected pose
               cv::Mat P3Dw = pMPi->GetWorldPos();
               Eigen::Matrix<double,3,1> eigP3Dw = Converter::toVector3d(P3Dw);
@@ -530,9 +581,6 @@ namespace ORB_SLAM2
 
               cv::Mat cvCorrectedP3Dw = Converter::toCvMat(eigCorrectedP3Dw);
               pMPi->SetWorldPos(cvCorrectedP3Dw);
-              pMPi->mnCorrectedByKF = mpCurrentKF->mnId;
-              pMPi->mnCorrectedReference = pKFi->mnId;
-              pMPi->UpdateNormalAndDepth();
             }
 
           // Update keyframe pose with corrected Sim3. First transform Sim3 to SE3 (scale translation)
@@ -545,10 +593,19 @@ namespace ORB_SLAM2
           cv::Mat correctedTiw = Converter::toCvSE3(eigR,eigt);
 
           pKFi->SetPose(correctedTiw);
+        });
 
-          // Make sure connections are updated
-          pKFi->UpdateConnections();
-        }
+      // Normals and depths use the corrected poses of all the observing keyframes
+      ThreadPool::Global()->ParallelFor(nConnected, [&](int i)
+        {
+          const vector<MapPoint*> &vpMPsi = vvpCorrectedMPs[i];
+          for(size_t iMP=0, endMPi = vpMPsi.size(); iMP<endMPi; iMP++)
+            vpMPsi[iMP]->UpdateNormalAndDepth();
+        });
+
+      // Make sure connections are updated. This changes the covisibility of the neighbors, so it stays sequential
+      for(int i=0; i<nConnected; i++)
+        mvpCurrentConnectedKFs[i]->UpdateConnections();
 
       // Start Loop Fusion
       // Update matched map points and replace if duplicated
@@ -605,11 +662,24 @@ namespace ORB_SLAM2
     mpMatchedKF->AddLoopEdge(mpCurrentKF);
     mpCurrentKF->AddLoopEdge(mpMatchedKF);
 
-    // Launch a new thread to perform Global Bundle Adjustment
-    mbRunningGBA = true;
-    mbFinishedGBA = false;
-    mbStopGBA = false;
-    mpThreadGBA = new thread(&LoopClosing::RunGlobalBundleAdjustment,this,mpCurrentKF->mnId);
+    // Refine the corrected map with the incremental smoother while Local Mapping is still stopped.
+    // Fall back to the full Global Bundle Adjustment if it fails
+    bool bCorrected = false;
+    if(mpIncrementalBA && mpIncrementalBA->CorrectLoop(mpCurrentKF))
+      {
+        unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+        CorrectMapWithGBA(mpCurrentKF->mnId);
+        bCorrected = true;
+      }
+
+    if(!bCorrected)
+      {
+        // Launch a new thread to perform Global Bundle Adjustment
+        mbRunningGBA = true;
+        mbFinishedGBA = false;
+        mbStopGBA = false;
+        mpThreadGBA = new thread(&LoopClosing::RunGlobalBundleAdjustment,this,mpCurrentKF->mnId);
+      }
 
     // Loop closed. Release Local Mapping.
     mpLocalMapper->Release();
@@ -621,25 +691,35 @@ namespace ORB_SLAM2
 
   void LoopClosing::SearchAndFuse(const KeyFrameAndPose &CorrectedPosesMap)
   {
-    ORBmatcher matcher(0.8);
-
+    vector<KeyFrame*> vpKFs;
+    vector<cv::Mat> vScw;
+    vpKFs.reserve(CorrectedPosesMap.size());
+    vScw.reserve(CorrectedPosesMap.size());
     for(KeyFrameAndPose::const_iterator mit=CorrectedPosesMap.begin(), mend=CorrectedPosesMap.end(); mit!=mend;mit++)
       {
-        KeyFrame* pKF = mit->first;
-
-        g2o::Sim3 g2oScw = mit->second;
-        cv::Mat cvScw = Converter::toCvMat(g2oScw);
+        vpKFs.push_back(mit->first);
+        vScw.push_back(Converter::toCvMat(mit->second));
+      }
 
-        vector<MapPoint*> vpReplacePoints(mvpLoopMapPoints.size(),static_cast<MapPoint*>(NULL));
-        matcher.Fuse(pKF,cvScw,mvpLoopMapPoints,4,vpReplacePoints);
+    // Each keyframe is searched on its own, only adding observations of the loop MapPoints to itself
+    const int nLP = mvpLoopMapPoints.size();
+    vector<vector<MapPoint*> > vvpReplacePoints(vpKFs.size(),vector<MapPoint*>(nLP,static_cast<MapPoint*>(NULL)));
+    ThreadPool::Global()->ParallelFor(vpKFs.size(), [&](int i)
+      {
+        ORBmatcher matcher(0.8);
+        matcher.Fuse(vpKFs[i],vScw[i],mvpLoopMapPoints,4,vvpReplacePoints[i]);
+      });
 
-        // Get Map Mutex
-        unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
-        const int nLP = mvpLoopMapPoints.size();
+    // Get Map Mutex
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+    for(size_t iKF=0; iKF<vpKFs.size(); iKF++)
+      {
+        const vector<MapPoint*> &vpReplacePoints = vvpReplacePoints[iKF];
         for(int i=0; i<nLP;i++)
           {
             MapPoint* pRep = vpReplacePoints[i];
-            if(pRep)
+            // Several keyframes may have found the same duplicate
+            if(pRep && !pRep->isBad())
               {
                 pRep->Replace(mvpLoopMapPoints[i]);
               }
@@ -654,16 +734,12 @@ namespace ORB_SLAM2
       unique_lock<mutex> lock(mMutexReset);
       mbResetRequested = true;
     }
+    mSignal.Notify();
 
-    while(1)
-      {
-        {
-          unique_lock<mutex> lock2(mMutexReset);
-          if(!mbResetRequested)
-            break;
-        }
-        usleep(5000);
-      }
+    mSignal.WaitUntil([this]{
+        unique_lock<mutex> lock2(mMutexReset);
+        return !mbResetRequested;
+      });
   }
 
   void LoopClosing::ResetIfRequested()
@@ -671,14 +747,19 @@ namespace ORB_SLAM2
     unique_lock<mutex> lock(mMutexReset);
     if(mbResetRequested)
       {
-        mlpLoopKeyFrameQueue.clear();
+        mqLoopKeyFrameQueue.Clear();
         mLastLoopKFid=0;
+        if(mpIncrementalBA)
+          mpIncrementalBA->Reset();
         mbResetRequested=false;
+        mSignal.Notify();
       }
   }
 
   void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
   {
+    Profiler::SetThreadName("Global BA");
+
     cout << "Starting Global Bundle Adjustment" << endl;
 
     int idx =  mnFullBAIdx;
@@ -698,93 +779,100 @@ namespace ORB_SLAM2
           cout << "Global Bundle Adjustment finished" << endl;
           cout << "Updating map ..." << endl;
           mpLocalMapper->RequestStop();
-          // Wait until Local Mapping has effectively stopped
-
-          while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
-            {
-              usleep(1000);
-            }
+          // Wait until Local Mapping has effectively stopped (a finished mapper is also stopped)
+          mpLocalMapper->WaitUntilStopped();
 
           // Get Map Mutex
           unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
 
-          // Correct keyframes starting at map first keyframe
-          list<KeyFrame*> lpKFtoCheck(mpMap->mvpKeyFrameOrigins.begin(),mpMap->mvpKeyFrameOrigins.end());
+          CorrectMapWithGBA(nLoopKF);
 
-          while(!lpKFtoCheck.empty())
-            {
-              KeyFrame* pKF = lpKFtoCheck.front();
-              const set<KeyFrame*> sChilds = pKF->GetChilds();
-              cv::Mat Twc = pKF->GetPoseInverse();
-              for(set<KeyFrame*>::const_iterator sit=sChilds.begin();sit!=sChilds.end();sit++)
-                {
-                  KeyFrame* pChild = *sit;
-                  if(pChild->mnBAGlobalForKF!=nLoopKF)
-                    {
-                      cv::Mat Tchildc = pChild->GetPose()*Twc;
-                      pChild->mTcwGBA = Tchildc*pKF->mTcwGBA;//*Tcorc*pKF->mTcwGBA;
-                      pChild->mnBAGlobalForKF=nLoopKF;
-
-                    }
-                  lpKFtoCheck.push_back(pChild);
-                }
+          mpLocalMapper->Release();
 
-              pKF->mTcwBefGBA = pKF->GetPose();
-              pKF->SetPose(pKF->mTcwGBA);
-              lpKFtoCheck.pop_front();
-            }
+          cout << "Map updated!" << endl;
+        }
 
-          // Correct MapPoints
-          const vector<MapPoint*> vpMPs = mpMap->GetAllMapPoints();
+      mbFinishedGBA = true;
+      mbRunningGBA = false;
+    }
 
-          for(size_t i=0; i<vpMPs.size(); i++)
-            {
-              MapPoint* pMP = vpMPs[i];
+    // Shutdown may be waiting for the GBA to finish
+    mSignal.Notify();
+  }
 
-              if(pMP->isBad())
-                continue;
+  void LoopClosing::CorrectMapWithGBA(const unsigned long nLoopKF)
+  {
+    // Correct keyframes starting at map first keyframe
+    list<KeyFrame*> lpKFtoCheck(mpMap->mvpKeyFrameOrigins.begin(),mpMap->mvpKeyFrameOrigins.end());
 
-              if(pMP->mnBAGlobalForKF==nLoopKF)
-                {
-                  // If optimized by Global BA, just update
-                  pMP->SetWorldPos(pMP->mPosGBA);
-                }
-              else
-                {
-                  // Update according to the correction of its reference keyframe
-                  KeyFrame* pRefKF = pMP->GetReferenceKeyFrame();
+    while(!lpKFtoCheck.empty())
+      {
+        KeyFrame* pKF = lpKFtoCheck.front();
+        const set<KeyFrame*> sChilds = pKF->GetChilds();
+        cv::Mat Twc = pKF->GetPoseInverse();
+        for(set<KeyFrame*>::const_iterator sit=sChilds.begin();sit!=sChilds.end();sit++)
+          {
+            KeyFrame* pChild = *sit;
+            if(pChild->mnBAGlobalForKF!=nLoopKF)
+              {
+                cv::Mat Tchildc = pChild->GetPose()*Twc;
+                pChild->mTcwGBA = Tchildc*pKF->mTcwGBA;//*Tcorc*pKF->mTcwGBA;
+                pChild->mnBAGlobalForKF=nLoopKF;
 
-                  if(pRefKF->mnBAGlobalForKF!=nLoopKF)
-                    continue;
+              }
+            lpKFtoCheck.push_back(pChild);
+          }
 
-                  // Map to non-corrected camera
-                  cv::Mat Rcw = pRefKF->mTcwBefGBA.rowRange(0,3).colRange(0,3);
-                  cv::Mat tcw = pRefKF->mTcwBefGBA.rowRange(0,3).col(3);
-                  cv::Mat Xc = Rcw*pMP->GetWorldPos()+tcw;
+        pKF->mTcwBefGBA = pKF->GetPose();
+        pKF->SetPose(pKF->mTcwGBA);
+        lpKFtoCheck.pop_front();
+      }
 
-                  // Backproject using corrected camera
-                  cv::Mat Twc = pRefKF->GetPoseInverse();
-                  cv::Mat Rwc = Twc.rowRange(0,3).colRange(0,3);
-                  cv::Mat twc = Twc.rowRange(0,3).col(3);
+    // Correct MapPoints
+    const vector<MapPoint*> vpMPs = mpMap->GetAllMapPoints();
 
-                  pMP->SetWorldPos(Rwc*Xc+twc);
-                }
-            }
+    for(size_t i=0; i<vpMPs.size(); i++)
+      {
+        MapPoint* pMP = vpMPs[i];
 
-          mpLocalMapper->Release();
+        if(pMP->isBad())
+          continue;
 
-          cout << "Map updated!" << endl;
-        }
+        if(pMP->mnBAGlobalForKF==nLoopKF)
+          {
+            // If optimized by Global BA, just update
+            pMP->SetWorldPos(pMP->mPosGBA);
+          }
+        else
+          {
+            // Update according to the correction of its reference keyframe
+            KeyFrame* pRefKF = pMP->GetReferenceKeyFrame();
 
-      mbFinishedGBA = true;
-      mbRunningGBA = false;
-    }
+            if(pRefKF->mnBAGlobalForKF!=nLoopKF)
+              continue;
+
+            // Map to non-corrected camera
+            cv::Mat Rcw = pRefKF->mTcwBefGBA.rowRange(0,3).colRange(0,3);
+            cv::Mat tcw = pRefKF->mTcwBefGBA.rowRange(0,3).col(3);
+            cv::Mat Xc = Rcw*pMP->GetWorldPos()+tcw;
+
+            // Backproject using corrected camera
+            cv::Mat Twc = pRefKF->GetPoseInverse();
+            cv::Mat Rwc = Twc.rowRange(0,3).colRange(0,3);
+            cv::Mat twc = Twc.rowRange(0,3).col(3);
+
+            pMP->SetWorldPos(Rwc*Xc+twc);
+          }
+      }
   }
 
   void LoopClosing::RequestFinish()
   {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+      unique_lock<mutex> lock(mMutexFinish);
+      mbFinishRequested = true;
+    }
+    mSignal.Notify();
   }
 
   bool LoopClosing::CheckFinish()
@@ -795,8 +883,11 @@ namespace ORB_SLAM2
 
   void LoopClosing::SetFinish()
   {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+      unique_lock<mutex> lock(mMutexFinish);
+      mbFinished = true;
+    }
+    mSignal.Notify();
   }
 
   bool LoopClosing::isFinished()
@@ -805,5 +896,15 @@ namespace ORB_SLAM2
     return mbFinished;
   }
 
+  void LoopClosing::WaitUntilFinished()
+  {
+    mSignal.WaitUntil([this]{return isFinished() && !isRunningGBA();});
+  }
+
+  WorkSignal::Stats LoopClosing::GetQueueStats()
+  {
+    return mSignal.GetStats();
+  }
+
 
 } //namespace ORB_SLAM
@@ -28,32 +28,34 @@
 
 #include "ORBmatcher.h"
 
+#include "ThreadPool.h"
+
 #include<mutex>
 #include<thread>
+#include<set>
+#include<algorithm>
 
 
 namespace ORB_SLAM2
 {
 
-LoopClosingInterRobot::LoopClosingInterRobot(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale, int robotID, char robotName):
+LoopClosingInterRobot::LoopClosingInterRobot(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale, InterRobotTransport *pTransport,
+                                             int robotID, char robotName):
     mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
-    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
+    mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mqLoopKeyFrameQueue(64), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
     mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0), loopClosureRetreived_(true), loopClosure_(),
-    robotID_(robotID), robotName_(robotName), keyframes_()
+    robotID_(robotID), robotName_(robotName), mbCompressKeyFrames(false), mpTransport(pTransport), mRemoteKeyFrameDB(*pVoc, 64<<20),
+    mRequestTimeout(2.0), mnRequestAttempts(3),
+    mnMatchThreads(1), mnMatchBacklog(16), mMatchPriority(NEWEST_FIRST), mnMatchJobs(0), mbStopMatching(false),
+    mnMapUsers(0), mbResettingMap(false)
 {
     mnCovisibilityConsistencyTh = 3;
+    mnPreviousKeyFrames = 10;
 
-    // Start keyframe publisher
-    char robotString[100];
-    sprintf(robotString, "%c", robotName);
-    ros::NodeHandle n(robotString); // all messages will be published in this name space
-
-    // Start the publisher
-    keyframe_pub_ = n.advertise<distributed_mapper_msgs::Keyframe>("/keyframe", 1000); // Publish in global space
-    measurement_pub_ = n.advertise<distributed_mapper_msgs::Measurement>("/measurement", 1000); // pubilsh relative pose
-
-    // Start the subscriber
-    keyframe_sub_ = n.subscribe("/keyframe", 1000, &LoopClosingInterRobot::Subscribe, this); // queue of 1000 keyframes
+    // Start the subscribers
+    mpTransport->Subscribe(InterRobotTransport::KEYFRAME_SUMMARY, std::bind(&LoopClosingInterRobot::SubscribeSummary, this, std::placeholders::_1));
+    mpTransport->Subscribe(InterRobotTransport::KEYFRAME_REQUEST, std::bind(&LoopClosingInterRobot::SubscribeRequest, this, std::placeholders::_1));
+    mpTransport->Subscribe(InterRobotTransport::KEYFRAME, std::bind(&LoopClosingInterRobot::Subscribe, this, std::placeholders::_1));
     cout << "Started loop closing between robots" << endl;
 }
 
@@ -67,264 +69,493 @@ void LoopClosingInterRobot::SetLocalMapper(LocalMapping *pLocalMapper)
     mpLocalMapper=pLocalMapper;
 }
 
-bool LoopClosingInterRobot::Match(distributed_mapper_msgs::Keyframe keyframe){
-    // Received message
-    // Convert wordIds and weights to BoW vector
-    DBoW2::BowVector mBowVec;
-    for(int wordId_i = 0; wordId_i < keyframe.wordIds.size(); wordId_i++){
-        DBoW2::WordId wordId = keyframe.wordIds.at(wordId_i);
-        DBoW2::WordValue wordValue = keyframe.wordValues.at(wordId_i);
-        mBowVec.addWeight(wordId, wordValue);
+void LoopClosingInterRobot::SetCompressKeyFrames(bool bCompress)
+{
+    mbCompressKeyFrames=bCompress;
+}
+
+void LoopClosingInterRobot::SetMatchingPool(int nThreads, int nBacklog, eMatchPriority priority)
+{
+    unique_lock<mutex> lock(mMutexMatching);
+    mnMatchThreads = max(nThreads,1);
+    mnMatchBacklog = max(nBacklog,1);
+    mMatchPriority = priority;
+}
+
+void LoopClosingInterRobot::SetRemoteMemoryBudget(size_t nBytes)
+{
+    mRemoteKeyFrameDB.SetMemoryBudget(nBytes);
+}
+
+void LoopClosingInterRobot::SetRequestTimeout(double timeout, int nAttempts)
+{
+    unique_lock<mutex> lock(mMutexExchange);
+    mRequestTimeout = timeout;
+    mnRequestAttempts = max(nAttempts,1);
+}
+
+LoopClosingInterRobot::RemoteRobotStats::RemoteRobotStats():
+    nSummaries(0), nRequests(0), nKeyFrames(0), nResent(0), nExpired(0), nDropped(0), nVerified(0), nMatched(0),
+    dTotalRequestLatency(0), dMaxRequestLatency(0), dTotalBacklogWait(0), dMaxBacklogWait(0),
+    dTotalMatchTime(0), dMaxMatchTime(0)
+{
+}
+
+bool LoopClosingInterRobot::Match(const RemoteKeyFrame &keyframe){
+    // Detect loop candidates on the summary (todo: check covisibility consistency)
+    vector<KeyFrame*> vpCandidates;
+    {
+        unique_lock<mutex> lock(mMutexDetection);
+        if(!DetectLoop(keyframe.mBowVec, keyframe.mnSymbolIndex, keyframe.mfMinScore))
+            return false;
+        vpCandidates = mvpEnoughConsistentCandidates;
     }
 
-    // Min score
-    float minScore = keyframe.minScore;
-
-    // mnId
-    int mnId = keyframe.symbolIndex;
-
-    // Detect loop candidates (todo: check covisibility consistency)
-    if(DetectLoop(mBowVec, mnId, minScore)){
-
-        // extract keypoints and desc for further processing
-        vector<cv::KeyPoint> keypoints;
-        for(size_t keypoint_i = 0; keypoint_i < keyframe.keypoints.size(); keypoint_i++){
-            distributed_mapper_msgs::Keypoint keypointMsg = keyframe.keypoints.at(keypoint_i);
-            cv::KeyPoint keypoint;
-            keypoint.pt.x = keypointMsg.x;
-            keypoint.pt.y = keypointMsg.y;
-            keypoint.angle = keypointMsg.angle;
-            keypoint.octave = keypointMsg.octave ;
-            keypoint.response = keypointMsg.response ;
-            keypoint.size = keypointMsg.size;
-            keypoint.class_id = keypointMsg.class_id;
-            keypoints.push_back(keypoint); // Push to keypoints
-        }
+    // Keep the candidates until the full keyframe arrives and request it from its robot
+    float score = 0;
+    for(size_t i=0; i<vpCandidates.size(); i++)
+        score = max(score, static_cast<float>(mpORBVocabulary->score(keyframe.mBowVec, vpCandidates[i]->mBowVec)));
+    RequestKeyFrame(keyframe.mnRobotId, keyframe.mnSymbolIndex, vpCandidates, score);
+    return true;
+}
 
-        float mfGridElementWidthInv = keyframe.mfGridElementWidthInv;
-        float mfGridElementHeightInv = keyframe.mfGridElementHeightInv;
-        float mnMinX = keyframe.mnMinX;
-        float mnMinY = keyframe.mnMinY;
-        float mnMaxX = keyframe.mnMaxX;
-        float mnMaxY = keyframe.mnMaxY;
-
-        // Assign features to grid
-        std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
-        int N = keypoints.size();
-        int nReserve = 0.5f*N/(FRAME_GRID_COLS*FRAME_GRID_ROWS);
-        for(unsigned int i=0; i<FRAME_GRID_COLS;i++)
-            for (unsigned int j=0; j<FRAME_GRID_ROWS;j++)
-                mGrid[i][j].reserve(nReserve);
-
-        for(int i=0;i<N;i++)
-        {
-            const cv::KeyPoint &kp = keypoints[i];
-            int nGridPosX, nGridPosY;
+bool LoopClosingInterRobot::MatchRemoteKeyFrames(KeyFrame* pKF, float minScore){
+    vector<RemoteKeyFrameDatabase::Candidate> vCandidates = mRemoteKeyFrameDB.DetectCandidates(pKF->mBowVec, minScore);
 
-            nGridPosX = round((kp.pt.x-mnMinX)*mfGridElementWidthInv);
-            nGridPosY = round((kp.pt.y-mnMinY)*mfGridElementHeightInv);
-            //Keypoint's coordinates are undistorted, which could cause to go out of the image
-            if(nGridPosX<0 || nGridPosX>=FRAME_GRID_COLS || nGridPosY<0 || nGridPosY>=FRAME_GRID_ROWS)
-                continue;
-            mGrid[nGridPosX][nGridPosY].push_back(i);
-        }
+    // Request only the best keyframe of each robot, they are sorted by score
+    set<int> sRequestedRobots;
+    for(size_t i=0; i<vCandidates.size(); i++)
+    {
+        const RemoteKeyFrameDatabase::Candidate &candidate = vCandidates[i];
+        if(!sRequestedRobots.insert(candidate.nRobotId).second)
+            continue;
+        RequestKeyFrame(candidate.nRobotId, candidate.nSymbolIndex, vector<KeyFrame*>(1,pKF), candidate.score);
+    }
+    return !sRequestedRobots.empty();
+}
 
-        std::vector< std::vector <std::vector<size_t> > > mGridVec;
-        mGridVec.resize(FRAME_GRID_COLS);
-        for(int i=0; i<FRAME_GRID_COLS;i++){
-            mGridVec[i].resize(FRAME_GRID_ROWS);
-            for(int j=0; j<FRAME_GRID_ROWS; j++)
-                mGridVec[i][j] = mGrid[i][j];
+void LoopClosingInterRobot::RequestKeyFrame(int nRobotId, uint64_t nSymbolIndex, const std::vector<KeyFrame*> &vpCandidates, float score)
+{
+    {
+        unique_lock<mutex> lock(mMutexExchange);
+        std::map<std::pair<int,uint64_t>, PendingRequest>::iterator it = mmPendingRequests.find(make_pair(nRobotId, nSymbolIndex));
+        if(it != mmPendingRequests.end()){
+            PendingRequest &request = it->second;
+            for(size_t i=0; i<vpCandidates.size(); i++)
+                if(find(request.vpCandidates.begin(), request.vpCandidates.end(), vpCandidates[i]) == request.vpCandidates.end())
+                    request.vpCandidates.push_back(vpCandidates[i]);
+            request.score = max(request.score, score);
+            return;
         }
 
-        // Create descriptor mat
-        cv_bridge::CvImagePtr descriptorPtr = cv_bridge::toCvCopy(keyframe.desc, sensor_msgs::image_encodings::TYPE_8UC1);
-        cv::Mat descriptors = descriptorPtr->image;
-
-        // Create point descriptor mat
-        cv_bridge::CvImagePtr pointDescriptorPtr = cv_bridge::toCvCopy(keyframe.pointDesc, sensor_msgs::image_encodings::TYPE_8UC1);
-        cv::Mat pointDescriptors = pointDescriptorPtr->image;
-
-        // Bag of words feature vector
-        DBoW2::FeatureVector mFeatVec;
-        for(int node_i = 0; node_i < keyframe.nodeIds.size(); node_i++){
-            DBoW2::NodeId nodeID = keyframe.nodeIds.at(node_i);
-            distributed_mapper_msgs::Indices indicesMsg = keyframe.indicesVec.at(node_i);
-            for(int feat_i = 0; feat_i < indicesMsg.indices.size(); feat_i++){
-                mFeatVec.addFeature(nodeID, indicesMsg.indices.at(feat_i));
-            }
-        }
+        PendingRequest &request = mmPendingRequests[make_pair(nRobotId, nSymbolIndex)];
+        request.vpCandidates = vpCandidates;
+        request.score = score;
+        request.tRequested = chrono::steady_clock::now();
+        request.tSent = request.tRequested;
+        request.nAttempts = 1;
+    }
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+        mmRemoteRobotStats[nRobotId].nRequests++;
+    }
 
-        // nrMappoints
-        int nrMapPoints = keyframe.nrMapPoints;
-
-        // map point -> feature indices, maxDistInvariance, minDistInvariance, point descriptor vec
-        vector<int> indices; vector<float> maxDistInvariance; vector<float> minDistInvariance; vector<cv::Mat> pointDescVec;
-        for(int indices_i = 0; indices_i < keyframe.indices.size(); indices_i++){
-            indices.push_back(keyframe.indices.at(indices_i));
-            maxDistInvariance.push_back(keyframe.maxDistInvariance.at(indices_i));
-            minDistInvariance.push_back(keyframe.minDistInvariance.at(indices_i));
-            cv::Mat descriptor(1, 32, CV_8UC1);
-            pointDescriptors.row(indices_i).copyTo(descriptor);
-            pointDescVec.push_back(descriptor);
-        }
+    std::vector<unsigned char> requestMsg;
+    KeyFrameCodec::EncodeRequest(robotID_, nRobotId, nSymbolIndex, requestMsg);
+    mpTransport->Publish(InterRobotTransport::KEYFRAME_REQUEST, requestMsg);
+
+    // Wake up the publisher to watch its timeout
+    mSignal.Notify();
+}
 
-        // Point locations
-        vector<cv::Mat> worldPoints;
-        for(int point_i = 0; point_i < nrMapPoints; point_i++){
-            cv::Mat worldPoint(3, 1, CV_32F);
-            for(int dim = 0; dim < 3; dim++){
-                worldPoint.at<float>(dim, 0) = keyframe.worldPoints.at(point_i*3 + dim);
+double LoopClosingInterRobot::ExpirePendingRequests()
+{
+    const chrono::steady_clock::time_point tNow = chrono::steady_clock::now();
+    vector<pair<int,uint64_t> > vResend;
+    vector<int> vExpiredRobots;
+    double nextTimeout = -1.0;
+    {
+        unique_lock<mutex> lock(mMutexExchange);
+        std::map<std::pair<int,uint64_t>, PendingRequest>::iterator it = mmPendingRequests.begin();
+        while(it != mmPendingRequests.end())
+        {
+            PendingRequest &request = it->second;
+            double remaining = mRequestTimeout - chrono::duration_cast<chrono::duration<double> >(tNow-request.tSent).count();
+            if(remaining <= 0)
+            {
+                if(request.nAttempts >= mnRequestAttempts)
+                {
+                    vExpiredRobots.push_back(it->first.first);
+                    mmPendingRequests.erase(it++);
+                    continue;
+                }
+                vResend.push_back(it->first);
+                request.tSent = tNow;
+                request.nAttempts++;
+                remaining = mRequestTimeout;
             }
-            worldPoints.push_back(worldPoint);
+            if(nextTimeout < 0 || remaining < nextTimeout)
+                nextTimeout = remaining;
+            it++;
         }
+    }
+
+    if(vResend.empty() && vExpiredRobots.empty())
+        return nextTimeout;
+
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+        for(size_t i=0; i<vResend.size(); i++)
+            mmRemoteRobotStats[vResend[i].first].nResent++;
+        for(size_t i=0; i<vExpiredRobots.size(); i++)
+            mmRemoteRobotStats[vExpiredRobots[i]].nExpired++;
+    }
+    if(!vExpiredRobots.empty())
+        mcvMatching.notify_all();
+
+    for(size_t i=0; i<vResend.size(); i++)
+    {
+        std::vector<unsigned char> requestMsg;
+        KeyFrameCodec::EncodeRequest(robotID_, vResend[i].first, vResend[i].second, requestMsg);
+        mpTransport->Publish(InterRobotTransport::KEYFRAME_REQUEST, requestMsg);
+    }
+    return nextTimeout;
+}
+
+bool LoopClosingInterRobot::Verify(const RemoteKeyFrame &keyframe, const std::vector<KeyFrame*> &vpCandidates){
+    // Assign features to grid
+    FeatureGrid grid;
+    grid.Build(keyframe.mvKeysUn, FRAME_GRID_COLS, FRAME_GRID_ROWS, keyframe.mnMinX, keyframe.mnMinY,
+               keyframe.mfGridElementWidthInv, keyframe.mfGridElementHeightInv);
+
+    // Compute similarity transformation [sR|t]
+    // In the stereo/RGBD case s=1
+    Sim3Match match;
+    if(ComputeSim3(keyframe.mvWorldPoints, keyframe.mvKeysUn, keyframe.mvIndices, keyframe.mvLevelSigma2, keyframe.mvInvLevelSigma2,
+                   keyframe.mTcw, keyframe.mK, keyframe.mDescriptors, keyframe.mFeatVec, keyframe.mvIndices.size(),
+                   keyframe.mvMaxDistanceInvariance, keyframe.mvMinDistanceInvariance, keyframe.mvScaleFactors,
+                   keyframe.mvPointDescriptors, keyframe.mnMinX, keyframe.mnMinY, keyframe.mnMaxX, keyframe.mnMaxY,
+                   keyframe.mfGridElementWidthInv, keyframe.mfGridElementHeightInv,
+                   FRAME_GRID_ROWS, FRAME_GRID_COLS, keyframe.mnScaleLevels, keyframe.mfLogScaleFactor, grid,
+                   keyframe.fx, keyframe.fy, keyframe.cx, keyframe.cy, vpCandidates, match))
+    {
+        // Publish it
+        InterRobotMeasurement measurement;
+        measurement.mSymbolChr1 = keyframe.mSymbolChr;
+        measurement.mnSymbolIndex1 = keyframe.mnSymbolIndex;
+        measurement.mSymbolChr2 = gtsam::symbolChr(match.pMatchedKF->key_);
+        measurement.mnSymbolIndex2 = gtsam::symbolIndex(match.pMatchedKF->key_);
+        measurement.mR = match.R;
+        measurement.mt = match.t;
+        measurement.mfScale = match.s;
+        mpTransport->PublishMeasurement(measurement);
+        return true;
+    }
+    else{
+        return false;
+    }
+}
+
+
+void LoopClosingInterRobot::SubscribeSummary(const InterRobotTransport::Message& msg)
+{
+    // Only receive keyframe message from higher robotID
+    const int robotID = KeyFrameCodec::PeekRobotId(msg->data(), msg->size());
+    if(robotID > robotID_){
 
-        // Write mvLevelSigma2
-        vector<float> mvLevelSigma2;
-        for(size_t i = 0; i < keyframe.mvLevelSigma2.size(); i++){
-            mvLevelSigma2.push_back(keyframe.mvLevelSigma2.at(i));
+        RemoteKeyFrame keyframe;
+        if(!KeyFrameCodec::DecodeSummary(msg->data(), msg->size(), keyframe)){
+            cout << "[----LoopClosingInterRobot] Dropped invalid keyframe from: " << robotID << endl;
+            return;
         }
 
-        vector<float> mvInvLevelSigma2;
-        for(size_t i = 0; i < keyframe.mvInvLevelSigma2.size(); i++){
-            mvInvLevelSigma2.push_back(keyframe.mvInvLevelSigma2.at(i));
+        {
+            unique_lock<mutex> lock(mMutexMatching);
+            mmRemoteRobotStats[robotID].nSummaries++;
         }
 
+        // Index it, so that it can be retried and matched by later local keyframes
+        if(!mRemoteKeyFrameDB.add(keyframe))
+            return;
+
+        // Match it, unless the map is being cleared
+        if(!BeginMapAccess())
+            return;
+        cout << endl << "[----LoopClosingInterRobot] Received message from: " << robotID << " id: " << keyframe.mnSymbolIndex << endl;
+        Match(keyframe);
+        EndMapAccess();
+    }
+}
+
+void LoopClosingInterRobot::SubscribeRequest(const InterRobotTransport::Message& msg)
+{
+    // Requests to other robots are skipped before checking them
+    if(KeyFrameCodec::PeekTargetRobotId(msg->data(), msg->size()) != robotID_)
+        return;
+
+    int robotID, targetRobotID;
+    uint64_t symbolIndex;
+    if(!KeyFrameCodec::DecodeRequest(msg->data(), msg->size(), robotID, targetRobotID, symbolIndex))
+        return;
 
-        // Write mvScaleFactors
-        vector<float> mvScaleFactors;
-        for(size_t i = 0; i < keyframe.mvScaleFactors.size(); i++){
-            mvScaleFactors.push_back(keyframe.mvScaleFactors.at(i));
+    // The keyframe must not be deleted by a reset until it is encoded
+    if(!BeginMapAccess())
+        return;
+
+    KeyFrame* pKF = NULL;
+    float minScore = 0;
+    {
+        unique_lock<mutex> lock(mMutexExchange);
+        std::map<uint64_t, std::pair<KeyFrame*,float> >::const_iterator it = mmPublishedKeyFrames.find(symbolIndex);
+        if(it != mmPublishedKeyFrames.end()){
+            pKF = it->second.first;
+            minScore = it->second.second;
         }
+    }
+    if(!pKF || pKF->isBad()){
+        EndMapAccess();
+        return;
+    }
 
-        // Write  pose
-        cv::Mat pose(3, 4, CV_32F);
-        for(size_t row_i = 0; row_i < 3; row_i ++){
-            for(size_t col_i = 0; col_i < 4; col_i ++){
-                pose.at<float>(row_i, col_i) =keyframe.pose.at(row_i*4 + col_i);
-            }
+    // Encode the keyframe, sharing its descriptors until it is written
+    RemoteKeyFrame keyframe;
+    KeyFrameCodec::FromKeyFrame(pKF, robotID_, minScore, keyframe);
+    EndMapAccess();
+
+    std::vector<unsigned char> keyFrameMsg;
+    KeyFrameCodec::Encode(keyframe, robotID, mbCompressKeyFrames, keyFrameMsg);
+
+    // Publish it
+    cout << "[----LoopClosingInterRobot] Sending keyframe " << symbolIndex << " to: " << robotID << endl;
+    mpTransport->Publish(InterRobotTransport::KEYFRAME, keyFrameMsg);
+}
+
+void LoopClosingInterRobot::Subscribe(const InterRobotTransport::Message& msg)
+{
+    // Only receive keyframe message from higher robotID, keyframes requested by other robots are
+    // skipped before decoding them
+    const int robotID = KeyFrameCodec::PeekRobotId(msg->data(), msg->size());
+    if(robotID > robotID_ && KeyFrameCodec::PeekTargetRobotId(msg->data(), msg->size()) == robotID_){
+
+        // Decode in place, the job keeps the message
+        MatchJob job;
+        job.robotID = robotID;
+        job.msg = msg;
+        if(!KeyFrameCodec::Decode(msg->data(), msg->size(), job.kf)){
+            cout << "[----LoopClosingInterRobot] Dropped invalid keyframe from: " << robotID << endl;
+            return;
         }
 
-        // Write calibration
-        cv::Mat K(3, 3, CV_32F);
-        for(size_t row_i = 0; row_i < 3; row_i ++){
-            for(size_t col_i = 0; col_i < 3; col_i ++){
-                K.at<float>(row_i, col_i) =keyframe.K.at(row_i*3 + col_i);
+        // Keyframes not requested anymore are ignored, the candidates of the request are kept
+        // until the job is in the backlog, which a reset drops
+        if(!BeginMapAccess())
+            return;
+        PendingRequest request;
+        {
+            unique_lock<mutex> lock(mMutexExchange);
+            std::map<std::pair<int,uint64_t>, PendingRequest>::iterator it =
+                    mmPendingRequests.find(make_pair(robotID, job.kf.mnSymbolIndex));
+            if(it == mmPendingRequests.end()){
+                lock.unlock();
+                EndMapAccess();
+                return;
             }
+            request = it->second;
+            mmPendingRequests.erase(it);
         }
 
-        float fx = keyframe.fx;
-        float fy = keyframe.fy;
-        float cx = keyframe.cx;
-        float cy = keyframe.cy;
-        float mfLogScaleFactor = keyframe.mfLogScaleFactor;
-        int mnScaleLevels = keyframe.mnScaleLevels;
-
-        //cout << "Extracted information: " << endl;
-
-        // Compute similarity transformation [sR|t]
-        // In the stereo/RGBD case s=1
-
-        /*
-          bool ComputeSim3(const vector<cv::Mat>& mapPoints,
-                                                    const vector<cv::KeyPoint>& keypoints,
-                                                    vector<int> indices,
-                                                    const vector<float>& mvLevelSigma2,
-                                                    const vector<float>& mvInvLevelSigma2,
-                                                    cv::Mat pose, cv::Mat K,
-                                                    const cv::Mat& descriptors,
-                                                    const DBoW2::FeatureVector& mFeatVec,
-                                                    int nrMapPoints, const vector<float> &maxDistanceInvariance,
-                           const vector<float> &minDistanceInvariance, const vector<float> &mvScaleFactors,
-                           const vector<cv::Mat> &pointDescriptors, float mnMinX, float mnMinY, float mnMaxX,
-                           float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv, float mnGridRows,
-                           float mnGridCols, int mnScaleLevels, float mvLogScaleFactor,
-                           std::vector<std::vector<std::vector<size_t> > > mGrid,
-                           float fx, float fy, float cx, float cy);
-
-                           */
-        if(ComputeSim3(worldPoints, keypoints, indices, mvLevelSigma2, mvInvLevelSigma2,
-                       pose, K, descriptors, mFeatVec, nrMapPoints, maxDistInvariance,
-                       minDistInvariance, mvScaleFactors,
-                       pointDescVec,mnMinX, mnMinY, mnMaxX, mnMaxY, mfGridElementWidthInv, mfGridElementHeightInv,
-                       FRAME_GRID_ROWS, FRAME_GRID_COLS, mnScaleLevels, mfLogScaleFactor, mGridVec,
-                       fx, fy, cx, cy))
+        // Verify the loop candidates found with its summary on a matching worker
+        cout << endl << "[----LoopClosingInterRobot] Received keyframe from: " << robotID << " id: " << job.kf.mnSymbolIndex << endl;
+        job.vpCandidates.swap(request.vpCandidates);
+        job.tQueued = chrono::steady_clock::now();
+        job.priority = mMatchPriority==BEST_SCORE_FIRST ? request.score : 0;
         {
-            // Publish it
-            distributed_mapper_msgs::Measurement measurementMsg; // key frame message
-            measurementMsg.symbolChr1 = keyframe.symbolChr;
-            measurementMsg.symbolIndex1 = keyframe.symbolIndex;
-            measurementMsg.symbolChr2 = matchedSymbol_;
-            measurementMsg.symbolIndex2 = matchedIndex_;
-            for(int i =0; i < estimatedR_.rows*estimatedR_.cols; i++)
-                measurementMsg.relativeRotation.push_back(estimatedR_.at<float>(i));
-            for(int i =0; i < estimatedT_.rows*estimatedT_.cols; i++)
-                measurementMsg.relativeTranslation.push_back(estimatedT_.at<float>(i));
-            measurementMsg.relativeScale = estimatedS_;
-            measurement_pub_.publish(measurementMsg);
-            return true;
-        }
-        else{
-            return false;
+            unique_lock<mutex> lock(mMutexMatching);
+            RemoteRobotStats &stats = mmRemoteRobotStats[robotID];
+            const double latency = chrono::duration_cast<chrono::duration<double> >(job.tQueued-request.tRequested).count();
+            stats.nKeyFrames++;
+            stats.dTotalRequestLatency += latency;
+            stats.dMaxRequestLatency = max(stats.dMaxRequestLatency, latency);
         }
-    }
-    else{
-        return false;
+        PushMatchJob(job);
+        EndMapAccess();
     }
 }
 
+bool LoopClosingInterRobot::Precedes(const MatchJob &a, const MatchJob &b)
+{
+    if(a.priority != b.priority)
+        return a.priority > b.priority;
+    return a.nSequence > b.nSequence;
+}
 
-void LoopClosingInterRobot::Subscribe(const distributed_mapper_msgs::Keyframe& keyframe)
+void LoopClosingInterRobot::PushMatchJob(MatchJob &job)
 {
-    // Only receive keyframe message from higher robotID
-    if(keyframe.robotID > robotID_){
-
-        // Add to keyframes vector
-        int robotID = keyframe.robotID;
-        if(!keyframes_.count(robotID)){
-            std::vector<distributed_mapper_msgs::Keyframe> keyframeVec;
-            keyframeVec.push_back(keyframe);
-            keyframes_.insert(std::pair<int, std::vector<distributed_mapper_msgs::Keyframe> >(robotID, keyframeVec));
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+
+        // The candidates may be about to be deleted
+        if(mbResettingMap)
+            return;
+
+        job.nSequence = ++mnMatchJobs;
+
+        // Drop the job with lowest priority when the backlog is full
+        if(mvMatchBacklog.size() >= mnMatchBacklog){
+            size_t iWorst = 0;
+            for(size_t i=1; i<mvMatchBacklog.size(); i++)
+                if(Precedes(mvMatchBacklog[iWorst], mvMatchBacklog[i]))
+                    iWorst = i;
+
+            if(Precedes(mvMatchBacklog[iWorst], job)){
+                mmRemoteRobotStats[job.robotID].nDropped++;
+                return;
+            }
+            mmRemoteRobotStats[mvMatchBacklog[iWorst].robotID].nDropped++;
+            mvMatchBacklog.erase(mvMatchBacklog.begin()+iWorst);
         }
-        else{
-            keyframes_[robotID].push_back(keyframe);
+        mvMatchBacklog.push_back(MatchJob());
+        std::swap(mvMatchBacklog.back(), job);
+    }
+    // A reset may be waiting on the same condition
+    mcvMatching.notify_all();
+}
+
+void LoopClosingInterRobot::RunMatching()
+{
+    while(1)
+    {
+        MatchJob job;
+        {
+            unique_lock<mutex> lock(mMutexMatching);
+            mcvMatching.wait(lock, [this]{ return (!mvMatchBacklog.empty() && !mbResettingMap) || mbStopMatching; });
+            if(mbStopMatching)
+                break;
+
+            size_t iBest = 0;
+            for(size_t i=1; i<mvMatchBacklog.size(); i++)
+                if(Precedes(mvMatchBacklog[i], mvMatchBacklog[iBest]))
+                    iBest = i;
+            std::swap(job, mvMatchBacklog[iBest]);
+            mvMatchBacklog.erase(mvMatchBacklog.begin()+iBest);
+            mnMapUsers++;
         }
 
-        // Match it
-        cout << endl << "[----LoopClosingInterRobot] Received message from: " << keyframe.robotID << " id: " << keyframe.symbolIndex << endl;
-        Match(keyframe);
+        const chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+        const bool bMatched = Verify(job.kf, job.vpCandidates);
+        const chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+        EndMapAccess();
+
+        unique_lock<mutex> lock(mMutexMatching);
+        RemoteRobotStats &stats = mmRemoteRobotStats[job.robotID];
+        const double wait = chrono::duration_cast<chrono::duration<double> >(t1-job.tQueued).count();
+        const double time = chrono::duration_cast<chrono::duration<double> >(t2-t1).count();
+        stats.nVerified++;
+        if(bMatched)
+            stats.nMatched++;
+        stats.dTotalBacklogWait += wait;
+        stats.dMaxBacklogWait = max(stats.dMaxBacklogWait, wait);
+        stats.dTotalMatchTime += time;
+        stats.dMaxMatchTime = max(stats.dMaxMatchTime, time);
+    }
+}
+
+bool LoopClosingInterRobot::BeginMapAccess()
+{
+    unique_lock<mutex> lock(mMutexMatching);
+    if(mbResettingMap)
+        return false;
+    mnMapUsers++;
+    return true;
+}
+
+void LoopClosingInterRobot::EndMapAccess()
+{
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+        mnMapUsers--;
     }
+    mcvMatching.notify_all();
+}
+
+std::map<int, LoopClosingInterRobot::RemoteRobotStats> LoopClosingInterRobot::GetRemoteRobotStats()
+{
+    unique_lock<mutex> lock(mMutexMatching);
+    return mmRemoteRobotStats;
+}
+
+void LoopClosingInterRobot::GetRemoteKeyFrameUsage(size_t &nKeyFrames, size_t &nBytes, unsigned long &nEvicted)
+{
+    mRemoteKeyFrameDB.GetUsage(nKeyFrames, nBytes, nEvicted);
 }
 
 // Match a window of keyframes
 void LoopClosingInterRobot::MatchPreviousKeyFrames(){
     std::cout << "Matching previous keyframes: " << std::endl;
 
-       std::map<int, std::vector<distributed_mapper_msgs::Keyframe> >::iterator it;
+       std::map<int, std::vector<RemoteKeyFrame> > keyframes;
+       mRemoteKeyFrameDB.GetSummaries(keyframes, mnPreviousKeyFrames);
+       std::map<int, std::vector<RemoteKeyFrame> >::iterator it;
+       std::vector<std::pair<int,uint64_t> > vRequested;
 
        // Iterate over robotIDs and match current keyframes
-       for(it = keyframes_.begin(); it!=keyframes_.end(); it++){
+       for(it = keyframes.begin(); it!=keyframes.end(); it++){
            int robotID = it->first;
-           std::vector<distributed_mapper_msgs::Keyframe> keyframes = it->second;
-           mvConsistentGroups.clear();
+           const std::vector<RemoteKeyFrame> &keyframes = it->second;
+           {
+               unique_lock<mutex> lock(mMutexDetection);
+               mvConsistentGroups.clear();
+           }
 
            // Iterate over keyframes and match
-           for(int keyframe_i = 0; keyframe_i < keyframes.size(); keyframe_i++){
+           for(size_t keyframe_i = 0; keyframe_i < keyframes.size(); keyframe_i++){
                std::cout << " (" << robotID << "," << keyframe_i << ") " << std::endl;
                bool matched = Match(keyframes[keyframe_i]);
-               if(matched)
+               if(matched){
+                   vRequested.push_back(make_pair(robotID, keyframes[keyframe_i].mnSymbolIndex));
                    break;
+               }
            }
        }
 
-       // Clear the keyframes
-       keyframes_.clear();
+       if(vRequested.empty())
+           return;
+
+       // The candidates are deleted by the reset, so wait for the requested keyframes to be
+       // verified. Requests that are not answered expire after all their attempts.
+       chrono::steady_clock::time_point tDeadline;
+       {
+           unique_lock<mutex> lock(mMutexExchange);
+           tDeadline = chrono::steady_clock::now() +
+                   chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>((mnRequestAttempts+1)*mRequestTimeout));
+       }
+
+       unique_lock<mutex> lock(mMutexMatching);
+       const bool bDone = mcvMatching.wait_until(lock, tDeadline, [this,&vRequested]{
+           if(!mvMatchBacklog.empty() || mnMapUsers>0)
+               return false;
+           unique_lock<mutex> lock2(mMutexExchange);
+           for(size_t i=0; i<vRequested.size(); i++)
+               if(mmPendingRequests.count(vRequested[i]))
+                   return false;
+           return true;
+       });
+       if(!bDone)
+           std::cout << "Timed out matching previous keyframes" << std::endl;
 }
 
 void LoopClosingInterRobot::Publish()
 {
     mbFinished =false;
 
+    // Start the matching workers
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+        mbStopMatching = false;
+        for(int i=0; i<mnMatchThreads; i++)
+            mvMatchThreads.push_back(thread(&LoopClosingInterRobot::RunMatching, this));
+    }
+
     while(1)
     {
         // Check if there are keyframes in the queue
@@ -334,20 +565,39 @@ void LoopClosingInterRobot::Publish()
             publishKeyFrame();
         }
 
+        // Request again the keyframes that did not arrive
+        const double nextTimeout = ExpirePendingRequests();
+
         ResetIfRequested();
 
         if(CheckFinish())
             break;
 
-        usleep(5000);
+        // Sleep until a keyframe is inserted, a reset or finish is requested or a request times out
+        if(!CheckNewKeyFrames())
+            mSignal.Wait(nextTimeout);
+    }
+
+    // Stop the matching workers, dropping the backlog
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+        mbStopMatching = true;
     }
+    mcvMatching.notify_all();
+    for(size_t i=0; i<mvMatchThreads.size(); i++)
+        mvMatchThreads[i].join();
+    mvMatchThreads.clear();
+
     SetFinish();
 }
 
 void LoopClosingInterRobot::setLoopClosureRetrievedToTrue()
 {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    loopClosureRetreived_ = true;
+    {
+        unique_lock<mutex> lock(mMutexLoopQueue);
+        loopClosureRetreived_ = true;
+    }
+    mSignal.Notify();
 }
 
 void LoopClosingInterRobot::setLoopClosureRetrievedToFalse()
@@ -362,31 +612,29 @@ bool LoopClosingInterRobot::LoopClosureIsRetrieved()
     return loopClosureRetreived_;
 }
 
-void LoopClosingInterRobot::InsertKeyFrame(KeyFrame *pKF)
+bool LoopClosingInterRobot::InsertKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    if(pKF->mnId!=0)
-        mlpLoopKeyFrameQueue.push_back(pKF);
+    if(pKF->mnId==0)
+        return true;
+
+    if(!mqLoopKeyFrameQueue.Push(pKF))
+        return false;
+
+    mSignal.Notify();
+    return true;
 }
 
 bool LoopClosingInterRobot::CheckNewKeyFrames()
 {
-    unique_lock<mutex> lock(mMutexLoopQueue);
-    return(!mlpLoopKeyFrameQueue.empty());
+    return !mqLoopKeyFrameQueue.Empty();
 }
 
 bool LoopClosingInterRobot::publishKeyFrame()
 {
-    {
-        unique_lock<mutex> lock(mMutexLoopQueue);
-        mpCurrentKF = mlpLoopKeyFrameQueue.front();
-        mlpLoopKeyFrameQueue.pop_front();
-        // Avoid that a keyframe can be erased while it is being process by this thread
-        std::cout << "New keyframe added: " << std::endl;
-        mpCurrentKF->SetNotErase();
-    }
-
-    distributed_mapper_msgs::Keyframe keyFrameMsg; // key frame message
+    mqLoopKeyFrameQueue.Pop(mpCurrentKF);
+    // Avoid that a keyframe can be erased while it is being process by this thread
+    std::cout << "New keyframe added: " << std::endl;
+    mpCurrentKF->SetNotErase();
 
     // Compute reference BoW similarity score
     // This is the lowest score to a connected keyframe in the covisibility graph
@@ -406,139 +654,28 @@ bool LoopClosingInterRobot::publishKeyFrame()
         if(score<minScore)
             minScore = score;
     }
-    keyFrameMsg.minScore=minScore;
-
-    // Misc
-    keyFrameMsg.mfLogScaleFactor= mpCurrentKF->mfLogScaleFactor;
-    keyFrameMsg.mnScaleLevels = mpCurrentKF->mnScaleLevels;
-    keyFrameMsg.mfGridElementWidthInv = mpCurrentKF->mfGridElementWidthInv;
-    keyFrameMsg.mfGridElementHeightInv = mpCurrentKF->mfGridElementHeightInv;
-    keyFrameMsg.mnMinX = mpCurrentKF->mnMinX;
-    keyFrameMsg.mnMinY = mpCurrentKF->mnMinY;
-    keyFrameMsg.mnMaxX = mpCurrentKF->mnMaxX;
-    keyFrameMsg.mnMaxY = mpCurrentKF->mnMaxY;
-
-    // Extract bag of words vector
-    for(DBoW2::BowVector::const_iterator vit=mpCurrentKF->mBowVec.begin(), vend=mpCurrentKF->mBowVec.end(); vit != vend; vit++)
-    {
-        keyFrameMsg.wordIds.push_back(vit->first);
-        keyFrameMsg.wordValues.push_back(vit->second);
-    }
 
-    // Set header
-    gtsam::Key key = mpCurrentKF->key_;
-    keyFrameMsg.symbolChr= gtsam::symbolChr(key);
-    keyFrameMsg.symbolIndex= gtsam::symbolIndex(key);
-    keyFrameMsg.robotID = robotID_;
-
-    // Add keypoints
-    const vector<cv::KeyPoint> &keypoints = mpCurrentKF->mvKeysUn;
-    for(int keypoint_i = 0; keypoint_i < keypoints.size(); keypoint_i++){
-        distributed_mapper_msgs::Keypoint keypointMsg;
-        cv::KeyPoint keypoint = keypoints.at(keypoint_i);
-        keypointMsg.x = keypoint.pt.x;
-        keypointMsg.y = keypoint.pt.y;
-        keypointMsg.angle = keypoint.angle;
-        keypointMsg.octave = keypoint.octave;
-        keypointMsg.response = keypoint.response;
-        keypointMsg.size = keypoint.size;
-        keypointMsg.class_id = keypoint.class_id;
-        keyFrameMsg.keypoints.push_back(keypointMsg); // Push to keyframe
-    }
-
-    // Extract feature vector
-    for(DBoW2::FeatureVector::const_iterator vit=mpCurrentKF->mFeatVec.begin(), vend=mpCurrentKF->mFeatVec.end(); vit != vend; vit++)
+    // Only the summary is sent, the full keyframe is sent to the robots that request it
+    RemoteKeyFrame summary;
+    summary.mnRobotId = robotID_;
+    summary.mSymbolChr = gtsam::symbolChr(mpCurrentKF->key_);
+    summary.mnSymbolIndex = gtsam::symbolIndex(mpCurrentKF->key_);
+    summary.mfMinScore = minScore;
+    summary.mBowVec = mpCurrentKF->mBowVec;
     {
-        keyFrameMsg.nodeIds.push_back(vit->first);
-
-        // Indices
-        distributed_mapper_msgs::Indices indicesMsg;
-        std::vector<unsigned int> features = vit->second;
-        for(int feature_i = 0; feature_i < features.size(); feature_i++){
-            indicesMsg.indices.push_back(features.at(feature_i));
-        }
-        keyFrameMsg.indicesVec.push_back(indicesMsg);
-    }
-
-    // Write descriptor
-    const cv::Mat &Descriptors = mpCurrentKF->mDescriptors;
-    cv_bridge::CvImage desc;
-    desc.encoding = sensor_msgs::image_encodings::TYPE_8UC1;
-    desc.image = Descriptors;
-    keyFrameMsg.desc = *(desc.toImageMsg());
-
-    // Write valid map points
-    const vector<MapPoint*> vpMapPoints = mpCurrentKF->GetMapPointMatches();
-    cv::Mat pointDescriptors = cv::Mat::zeros(vpMapPoints.size(), 32, CV_8UC1); // map point descriptors
-    for(size_t i = 0; i < vpMapPoints.size(); i++){
-        MapPoint* mapPoint = vpMapPoints[i];
-        if(!mapPoint || mapPoint->isBad()){
-            keyFrameMsg.indices.push_back(-1);
-            for(size_t pos_i = 0; pos_i < 3; pos_i++){
-                keyFrameMsg.worldPoints.push_back(-1);
-            }
-            keyFrameMsg.maxDistInvariance.push_back(-1);
-            keyFrameMsg.minDistInvariance.push_back(-1);
-            keyFrameMsg.mfMaxDistance.push_back(-1);
-        }
-        else{
-            int index = mapPoint->GetIndexInKeyFrame(mpCurrentKF);
-            keyFrameMsg.indices.push_back(index);
-
-            cv::Mat worldPos = mapPoint->GetWorldPos();
-            for(size_t pos_i = 0; pos_i < worldPos.rows*worldPos.cols; pos_i++){
-                keyFrameMsg.worldPoints.push_back(worldPos.at<float>(pos_i));
-            }
-
-            float maxDistInvariance = mapPoint->GetMaxDistanceInvariance();
-            float minDistInvariance = mapPoint->GetMinDistanceInvariance();
-            keyFrameMsg.mfMaxDistance.push_back(mapPoint->mfMaxDistance);
-            keyFrameMsg.maxDistInvariance.push_back(maxDistInvariance);
-            keyFrameMsg.minDistInvariance.push_back(minDistInvariance);
-            const cv::Mat dMP = mapPoint->GetDescriptor();
-            dMP.copyTo(pointDescriptors.row(i));
-        }
+        unique_lock<mutex> lock(mMutexExchange);
+        mmPublishedKeyFrames[summary.mnSymbolIndex] = make_pair(mpCurrentKF, minScore);
     }
-    keyFrameMsg.nrMapPoints = vpMapPoints.size();
 
-    cv_bridge::CvImage pointDesc;
-    pointDesc.encoding = sensor_msgs::image_encodings::TYPE_8UC1;
-    pointDesc.image = pointDescriptors;
-    keyFrameMsg.pointDesc = *(pointDesc.toImageMsg());
-
-    // Write mvLevelSigma2
-    for(size_t i = 0; i < mpCurrentKF->mvLevelSigma2.size(); i++){
-        keyFrameMsg.mvLevelSigma2.push_back(mpCurrentKF->mvLevelSigma2.at(i));
-    }
-
-    // Write mvLevelSigma2
-    for(size_t i = 0; i < mpCurrentKF->mvInvLevelSigma2.size(); i++){
-        keyFrameMsg.mvInvLevelSigma2.push_back(mpCurrentKF->mvInvLevelSigma2.at(i));
-    }
-
-    // Write mvScaleFactors
-    for(size_t i = 0; i < mpCurrentKF->mvScaleFactors.size(); i++){
-        keyFrameMsg.mvScaleFactors.push_back(mpCurrentKF->mvScaleFactors.at(i));
-    }
-
-    // Write  pose
-    cv::Mat pose = mpCurrentKF->GetPose();
-    for(size_t i = 0; i < pose.rows*pose.cols; i++){
-        keyFrameMsg.pose.push_back(pose.at<float>(i));
-    }
-
-    // Write  calibration
-    cv::Mat K = mpCurrentKF->mK;
-    for(size_t i = 0; i < K.rows*K.cols; i++){
-        keyFrameMsg.K.push_back(K.at<float>(i));
-    }
-    keyFrameMsg.fx = mpCurrentKF->fx;
-    keyFrameMsg.fy = mpCurrentKF->fy;
-    keyFrameMsg.cx = mpCurrentKF->cx;
-    keyFrameMsg.cy = mpCurrentKF->cy;
+    std::vector<unsigned char> summaryMsg;
+    KeyFrameCodec::EncodeSummary(summary, summaryMsg);
 
     // Publish it
-    keyframe_pub_.publish(keyFrameMsg);
+    mpTransport->Publish(InterRobotTransport::KEYFRAME_SUMMARY, summaryMsg);
+
+    // The other robots match it against their keyframes, match it against the stored summaries of theirs
+    MatchRemoteKeyFrames(mpCurrentKF, minScore);
+    return true;
 }
 
 bool LoopClosingInterRobot::DetectLoop(const DBoW2::BowVector& keyFrameBoWVec, int mnId,  float minScore)
@@ -641,11 +778,12 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
                                         const vector<float> &mvScaleFactors, const vector<cv::Mat>& pointDescriptors,
                                         float mnMinX, float mnMinY, float mnMaxX, float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv,
                                         float mnGridRows, float mnGridCols, int mnScaleLevels, float mfLogScaleFactor,
-                                        const std::vector< std::vector <std::vector<size_t> > >& mGrid,
-                                        float fx, float fy, float cx, float cy){
+                                        const FeatureGrid &grid,
+                                        float fx, float fy, float cx, float cy,
+                                        const vector<KeyFrame*> &vpCandidates, Sim3Match &match){
 
     // For each consistent loop candidate we try to compute a Sim3
-    const int nInitialCandidates = mvpEnoughConsistentCandidates.size();
+    const int nInitialCandidates = vpCandidates.size();
 
     // We compute first ORB matches for each candidate
     // If enough matches are found, we setup a Sim3Solver
@@ -666,7 +804,7 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
     // Sort according to #common keywords
     for(int i=0; i<nInitialCandidates; i++)
     {
-        KeyFrame* pKF = mvpEnoughConsistentCandidates[i];
+        KeyFrame* pKF = vpCandidates[i];
 
         // avoid that local mapping erase it while it is being processed in this thread
         pKF->SetNotErase();
@@ -698,6 +836,8 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
 
 
     bool bMatch = false;
+    cv::Mat Scw;
+    vector<MapPoint*> vpCurrentMatchedPoints;
 
     // Perform alternatively RANSAC iterations for each candidate starting from the candidate having maximum number of BoW matches
     // until one is succesful or all fail
@@ -711,7 +851,7 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
             if(vbDiscarded[i])
                 continue;
 
-            KeyFrame* pKF = mvpEnoughConsistentCandidates[i];
+            KeyFrame* pKF = vpCandidates[i];
 
             // Perform 5 Ransac Iterations
             vector<bool> vbInliers;
@@ -748,7 +888,7 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
 
                 matcher.SearchBySim3InterRobot(nrMapPoints, mapPoints, keypoints, indices, maxDistanceInvariance, minDistanceInvariance, mvScaleFactors,
                                                pointDescriptors,  mnMinX,  mnMinY,  mnMaxX,  mnMaxY,  mfGridElementWidthInv,  mfGridElementHeightInv,
-                                               mnGridRows,  mnGridCols,  mnScaleLevels,  mfLogScaleFactor,  mGrid,
+                                               mnGridRows,  mnGridCols,  mnScaleLevels,  mfLogScaleFactor,  grid,
                                                descriptors,   pose,  K, fx,  fy,  cx,  cy,  pKF,vpMapPointMatches,s,R,t,7.5);
                 // matcher.SearchBySim3(mpCurrentKF,pKF,vpMapPointMatches,s,R,t,7.5);
 
@@ -771,18 +911,15 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
                 if(nInliers>=20)
                 {
                     bMatch = true;
-                    mpMatchedKF = pKF;
                     g2o::Sim3 gSmw(Converter::toMatrix3d(pKF->GetRotation()),Converter::toVector3d(pKF->GetTranslation()),1.0);
-                    mg2oScw = gScm*gSmw;
-                    mScw = Converter::toCvMat(mg2oScw);
-                    mScm = Converter::toCvMat(gScm);
-
-                    estimatedR_ = mScm.rowRange(0,3).colRange(0,3).clone();;
-                    estimatedT_ = mScm.rowRange(0,3).col(3).clone();
-                    estimatedS_ = 1.0f;
-                    matchedSymbol_ = gtsam::symbolChr(pKF->key_);
-                    matchedIndex_ = gtsam::symbolIndex(pKF->key_);
-                    mvpCurrentMatchedPoints = vpMapPointMatches;
+                    Scw = Converter::toCvMat(gScm*gSmw);
+                    const cv::Mat Scm = Converter::toCvMat(gScm);
+
+                    match.pMatchedKF = pKF;
+                    match.R = Scm.rowRange(0,3).colRange(0,3).clone();
+                    match.t = Scm.rowRange(0,3).col(3).clone();
+                    match.s = 1.0f;
+                    vpCurrentMatchedPoints = vpMapPointMatches;
                     break;
                 }
             }
@@ -791,6 +928,9 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
     }
 
 
+    for(int i=0; i<nInitialCandidates; i++)
+        delete vpSim3Solvers[i];
+
     if(!bMatch)
     {
         //        for(int i=0; i<nInitialCandidates; i++)
@@ -799,10 +939,12 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
         return false;
     }
 
-    // Retrieve MapPoints seen in Loop Keyframe and neighbors
-    vector<KeyFrame*> vpLoopConnectedKFs = mpMatchedKF->GetVectorCovisibleKeyFrames();
-    vpLoopConnectedKFs.push_back(mpMatchedKF);
-    mvpLoopMapPoints.clear();
+    // Retrieve MapPoints seen in Loop Keyframe and neighbors. Matching workers run concurrently,
+    // so they are deduplicated with a set rather than a mark on the map point
+    vector<KeyFrame*> vpLoopConnectedKFs = match.pMatchedKF->GetVectorCovisibleKeyFrames();
+    vpLoopConnectedKFs.push_back(match.pMatchedKF);
+    vector<MapPoint*> vpLoopMapPoints;
+    set<MapPoint*> spLoopMapPoints;
     for(vector<KeyFrame*>::iterator vit=vpLoopConnectedKFs.begin(); vit!=vpLoopConnectedKFs.end(); vit++)
     {
         KeyFrame* pKF = *vit;
@@ -812,11 +954,8 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
             MapPoint* pMP = vpMapPoints[i];
             if(pMP)
             {
-                if(!pMP->isBad() && pMP->mnLoopPointForKFInterRobot!=mpCurrentKF->mnId)
-                {
-                    mvpLoopMapPoints.push_back(pMP);
-                    pMP->mnLoopPointForKFInterRobot=mpCurrentKF->mnId;
-                }
+                if(!pMP->isBad() && spLoopMapPoints.insert(pMP).second)
+                    vpLoopMapPoints.push_back(pMP);
             }
         }
     }
@@ -825,15 +964,15 @@ bool LoopClosingInterRobot::ComputeSim3(const vector<cv::Mat>& mapPoints,
     // Find more matches projecting with the computed Sim3
     matcher.SearchByProjectionInterRobot(keypoints, mvScaleFactors,
                                          mnMinX,  mnMinY,  mnMaxX,  mnMaxY,  mfGridElementWidthInv,  mfGridElementHeightInv,
-                                         mnGridRows,  mnGridCols,  mnScaleLevels, mfLogScaleFactor, mGrid,
-                                         descriptors,  fx,  fy,  cx,  cy, mScw, mvpLoopMapPoints, mvpCurrentMatchedPoints,10);
+                                         mnGridRows,  mnGridCols,  mnScaleLevels, mfLogScaleFactor, grid,
+                                         descriptors,  fx,  fy,  cx,  cy, Scw, vpLoopMapPoints, vpCurrentMatchedPoints,10);
 
 
     // If enough matches accept Loop
     int nTotalMatches = 0;
-    for(size_t i=0; i<mvpCurrentMatchedPoints.size(); i++)
+    for(size_t i=0; i<vpCurrentMatchedPoints.size(); i++)
     {
-        if(mvpCurrentMatchedPoints[i])
+        if(vpCurrentMatchedPoints[i])
             nTotalMatches++;
     }
 
@@ -879,10 +1018,7 @@ void LoopClosingInterRobot::CorrectLoop()
     }
 
     // Wait until Local Mapping has effectively stopped
-    while(!mpLocalMapper->isStopped())
-    {
-        usleep(1000);
-    }
+    mpLocalMapper->WaitUntilStopped();
 
     // Ensure current keyframe is updated
     mpCurrentKF->UpdateConnections();
@@ -900,9 +1036,12 @@ void LoopClosingInterRobot::CorrectLoop()
         // Get Map Mutex
         unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
 
-        for(vector<KeyFrame*>::iterator vit=mvpCurrentConnectedKFs.begin(), vend=mvpCurrentConnectedKFs.end(); vit!=vend; vit++)
+        // The corrected and non-corrected poses of the connected keyframes are independent
+        const int nConnected = mvpCurrentConnectedKFs.size();
+        vector<g2o::Sim3,Eigen::aligned_allocator<g2o::Sim3> > vCorrectedSiw(nConnected), vSiw(nConnected);
+        ThreadPool::Global()->ParallelFor(nConnected, [&](int i)
         {
-            KeyFrame* pKFi = *vit;
+            KeyFrame* pKFi = mvpCurrentConnectedKFs[i];
 
             cv::Mat Tiw = pKFi->GetPose();
 
@@ -912,26 +1051,30 @@ void LoopClosingInterRobot::CorrectLoop()
                 cv::Mat Ric = Tic.rowRange(0,3).colRange(0,3);
                 cv::Mat tic = Tic.rowRange(0,3).col(3);
                 g2o::Sim3 g2oSic(Converter::toMatrix3d(Ric),Converter::toVector3d(tic),1.0);
-                g2o::Sim3 g2oCorrectedSiw = g2oSic*mg2oScw;
                 //Pose corrected with the Sim3 of the loop closure
-                CorrectedSim3[pKFi]=g2oCorrectedSiw;
+                vCorrectedSiw[i] = g2oSic*mg2oScw;
             }
+            else
+                vCorrectedSiw[i] = mg2oScw;
 
             cv::Mat Riw = Tiw.rowRange(0,3).colRange(0,3);
             cv::Mat tiw = Tiw.rowRange(0,3).col(3);
-            g2o::Sim3 g2oSiw(Converter::toMatrix3d(Riw),Converter::toVector3d(tiw),1.0);
             //Pose without correction
-            NonCorrectedSim3[pKFi]=g2oSiw;
-        }
+            vSiw[i] = g2o::Sim3(Converter::toMatrix3d(Riw),Converter::toVector3d(tiw),1.0);
+        });
 
-        // Correct all MapPoints obsrved by current keyframe and neighbors, so that they align with the other side of the loop
-        for(KeyFrameAndPose::iterator mit=CorrectedSim3.begin(), mend=CorrectedSim3.end(); mit!=mend; mit++)
+        for(int i=0; i<nConnected; i++)
         {
-            KeyFrame* pKFi = mit->first;
-            g2o::Sim3 g2oCorrectedSiw = mit->second;
-            g2o::Sim3 g2oCorrectedSwi = g2oCorrectedSiw.inverse();
+            CorrectedSim3[mvpCurrentConnectedKFs[i]]=vCorrectedSiw[i];
+            NonCorrectedSim3[mvpCurrentConnectedKFs[i]]=vSiw[i];
+        }
 
-            g2o::Sim3 g2oSiw =NonCorrectedSim3[pKFi];
+        // A MapPoint seen by several keyframes is corrected by the first one that observes it.
+        // Claim them here so that the keyframes can be corrected in parallel
+        vector<vector<MapPoint*> > vvpCorrectedMPs(nConnected);
+        for(int i=0; i<nConnected; i++)
+        {
+            KeyFrame* pKFi = mvpCurrentConnectedKFs[i];
 
             vector<MapPoint*> vpMPsi = pKFi->GetMapPointMatches();
             for(size_t iMP=0, endMPi = vpMPsi.size(); iMP<endMPi; iMP++)
@@ -944,6 +1087,25 @@ void LoopClosingInterRobot::CorrectLoop()
                 if(pMPi->mnCorrectedByKF==mpCurrentKF->mnId)
                     continue;
 
+                pMPi->mnCorrectedByKF = mpCurrentKF->mnId;
+                pMPi->mnCorrectedReference = pKFi->mnId;
+                vvpCorrectedMPs[i].push_back(pMPi);
+            }
+        }
+
+        // Correct all MapPoints obsrved by current keyframe and neighbors, so that they align with the other side of the loop
+        ThreadPool::Global()->ParallelFor(nConnected, [&](int i)
+        {
+            KeyFrame* pKFi = mvpCurrentConnectedKFs[i];
+            const g2o::Sim3 &g2oCorrectedSiw = vCorrectedSiw[i];
+            const g2o::Sim3 g2oCorrectedSwi = g2oCorrectedSiw.inverse();
+            const g2o::Sim3 &g2oSiw = vSiw[i];
+
+            const vector<MapPoint*> &vpMPsi = vvpCorrectedMPs[i];
+            for(size_t iMP=0, endMPi = vpMPsi.size(); iMP<endMPi; iMP++)
+            {
+                MapPoint* pMPi = vpMPsi[iMP];
+
                 // Project with non-corrected pose and project back with corrected pose
                 cv::Mat P3Dw = pMPi->GetWorldPos();
                 Eigen::Matrix<double,3,1> eigP3Dw = Converter::toVector3d(P3Dw);
@@ -951,9 +1113,6 @@ void LoopClosingInterRobot::CorrectLoop()
 
                 cv::Mat cvCorrectedP3Dw = Converter::toCvMat(eigCorrectedP3Dw);
                 pMPi->SetWorldPos(cvCorrectedP3Dw);
-                pMPi->mnCorrectedByKF = mpCurrentKF->mnId;
-                pMPi->mnCorrectedReference = pKFi->mnId;
-                pMPi->UpdateNormalAndDepth();
             }
 
             // Update keyframe pose with corrected Sim3. First transform Sim3 to SE3 (scale translation)
@@ -966,10 +1125,19 @@ void LoopClosingInterRobot::CorrectLoop()
             cv::Mat correctedTiw = Converter::toCvSE3(eigR,eigt);
 
             pKFi->SetPose(correctedTiw);
+        });
 
-            // Make sure connections are updated
-            pKFi->UpdateConnections();
-        }
+        // Normals and depths use the corrected poses of all the observing keyframes
+        ThreadPool::Global()->ParallelFor(nConnected, [&](int i)
+        {
+            const vector<MapPoint*> &vpMPsi = vvpCorrectedMPs[i];
+            for(size_t iMP=0, endMPi = vpMPsi.size(); iMP<endMPi; iMP++)
+                vpMPsi[iMP]->UpdateNormalAndDepth();
+        });
+
+        // Make sure connections are updated. This changes the covisibility of the neighbors, so it stays sequential
+        for(int i=0; i<nConnected; i++)
+            mvpCurrentConnectedKFs[i]->UpdateConnections();
 
         // Start Loop Fusion
         // Update matched map points and replace if duplicated
@@ -1042,25 +1210,35 @@ void LoopClosingInterRobot::CorrectLoop()
 
 void LoopClosingInterRobot::SearchAndFuse(const KeyFrameAndPose &CorrectedPosesMap)
 {
-    ORBmatcher matcher(0.8);
-
+    vector<KeyFrame*> vpKFs;
+    vector<cv::Mat> vScw;
+    vpKFs.reserve(CorrectedPosesMap.size());
+    vScw.reserve(CorrectedPosesMap.size());
     for(KeyFrameAndPose::const_iterator mit=CorrectedPosesMap.begin(), mend=CorrectedPosesMap.end(); mit!=mend;mit++)
     {
-        KeyFrame* pKF = mit->first;
-
-        g2o::Sim3 g2oScw = mit->second;
-        cv::Mat cvScw = Converter::toCvMat(g2oScw);
+        vpKFs.push_back(mit->first);
+        vScw.push_back(Converter::toCvMat(mit->second));
+    }
 
-        vector<MapPoint*> vpReplacePoints(mvpLoopMapPoints.size(),static_cast<MapPoint*>(NULL));
-        matcher.Fuse(pKF,cvScw,mvpLoopMapPoints,4,vpReplacePoints);
+    // Each keyframe is searched on its own, only adding observations of the loop MapPoints to itself
+    const int nLP = mvpLoopMapPoints.size();
+    vector<vector<MapPoint*> > vvpReplacePoints(vpKFs.size(),vector<MapPoint*>(nLP,static_cast<MapPoint*>(NULL)));
+    ThreadPool::Global()->ParallelFor(vpKFs.size(), [&](int i)
+    {
+        ORBmatcher matcher(0.8);
+        matcher.Fuse(vpKFs[i],vScw[i],mvpLoopMapPoints,4,vvpReplacePoints[i]);
+    });
 
-        // Get Map Mutex
-        unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
-        const int nLP = mvpLoopMapPoints.size();
+    // Get Map Mutex
+    unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+    for(size_t iKF=0; iKF<vpKFs.size(); iKF++)
+    {
+        const vector<MapPoint*> &vpReplacePoints = vvpReplacePoints[iKF];
         for(int i=0; i<nLP;i++)
         {
             MapPoint* pRep = vpReplacePoints[i];
-            if(pRep)
+            // Several keyframes may have found the same duplicate
+            if(pRep && !pRep->isBad())
             {
                 pRep->Replace(mvpLoopMapPoints[i]);
             }
@@ -1075,16 +1253,12 @@ void LoopClosingInterRobot::RequestReset()
         unique_lock<mutex> lock(mMutexReset);
         mbResetRequested = true;
     }
+    mSignal.Notify();
 
-    while(1)
-    {
-        {
-            unique_lock<mutex> lock2(mMutexReset);
-            if(!mbResetRequested)
-                break;
-        }
-        usleep(5000);
-    }
+    mSignal.WaitUntil([this]{
+        unique_lock<mutex> lock2(mMutexReset);
+        return !mbResetRequested;
+    });
 }
 
 
@@ -1094,11 +1268,37 @@ void LoopClosingInterRobot::ResetIfRequested()
     unique_lock<mutex> lock(mMutexReset);
     if(mbResetRequested)
     {
-        mvConsistentGroups.clear();
-        mlpLoopKeyFrameQueue.clear();
+        {
+            // Wait for the matching jobs and transport callbacks using keyframes of the map, which
+            // is cleared once the reset returns. They are refused until FinishReset.
+            unique_lock<mutex> lock2(mMutexMatching);
+            mbResettingMap = true;
+            mcvMatching.wait(lock2, [this]{ return mnMapUsers==0; });
+            mvMatchBacklog.clear();
+        }
+        {
+            unique_lock<mutex> lock2(mMutexDetection);
+            mvConsistentGroups.clear();
+        }
+        mqLoopKeyFrameQueue.Clear();
         mLastLoopKFid=0;
+        {
+            unique_lock<mutex> lock2(mMutexExchange);
+            mmPublishedKeyFrames.clear();
+            mmPendingRequests.clear();
+        }
         mbResetRequested=false;
+        mSignal.Notify();
+    }
+}
+
+void LoopClosingInterRobot::FinishReset()
+{
+    {
+        unique_lock<mutex> lock(mMutexMatching);
+        mbResettingMap = false;
     }
+    mcvMatching.notify_all();
 }
 
 void LoopClosingInterRobot::RunGlobalBundleAdjustment(unsigned long nLoopKF)
@@ -1122,12 +1322,8 @@ void LoopClosingInterRobot::RunGlobalBundleAdjustment(unsigned long nLoopKF)
             cout << "Global Bundle Adjustment finished" << endl;
             cout << "Updating map ..." << endl;
             mpLocalMapper->RequestStop();
-            // Wait until Local Mapping has effectively stopped
-
-            while(!mpLocalMapper->isStopped() && !mpLocalMapper->isFinished())
-            {
-                usleep(1000);
-            }
+            // Wait until Local Mapping has effectively stopped (a finished mapper is also stopped)
+            mpLocalMapper->WaitUntilStopped();
 
             // Get Map Mutex
             unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
@@ -1203,12 +1399,18 @@ void LoopClosingInterRobot::RunGlobalBundleAdjustment(unsigned long nLoopKF)
         mbFinishedGBA = true;
         mbRunningGBA = false;
     }
+
+    // Shutdown may be waiting for the GBA to finish
+    mSignal.Notify();
 }
 
 void LoopClosingInterRobot::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    mSignal.Notify();
 }
 
 bool LoopClosingInterRobot::CheckFinish()
@@ -1219,8 +1421,11 @@ bool LoopClosingInterRobot::CheckFinish()
 
 void LoopClosingInterRobot::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    mSignal.Notify();
 }
 
 bool LoopClosingInterRobot::isFinished()
@@ -1229,5 +1434,15 @@ bool LoopClosingInterRobot::isFinished()
     return mbFinished;
 }
 
+void LoopClosingInterRobot::WaitUntilFinished()
+{
+    mSignal.WaitUntil([this]{return isFinished() && !isRunningGBA();});
+}
+
+WorkSignal::Stats LoopClosingInterRobot::GetQueueStats()
+{
+    return mSignal.GetStats();
+}
+
 
 } //namespace ORB_SLAM
@@ -0,0 +1,221 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoopbackTransport.h"
+
+namespace ORB_SLAM2
+{
+
+LoopbackHub::Stats::Stats()
+{
+    for(int i=0; i<=InterRobotTransport::NUM_CHANNELS; i++)
+    {
+        nMessages[i] = 0;
+        nBytes[i] = 0;
+    }
+}
+
+LoopbackHub::LoopbackHub(): mnSent(0)
+{
+}
+
+void LoopbackHub::Attach(LoopbackTransport* pTransport)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mvpTransports.push_back(pTransport);
+}
+
+void LoopbackHub::Detach(LoopbackTransport* pTransport)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for(size_t i=0; i<mvpTransports.size(); i++)
+    {
+        if(mvpTransports[i]==pTransport)
+        {
+            mvpTransports.erase(mvpTransports.begin()+i);
+            break;
+        }
+    }
+}
+
+void LoopbackHub::Send(LoopbackTransport* pSender, int channel, const InterRobotTransport::Message &msg,
+                       const InterRobotMeasurement* pMeasurement)
+{
+    LoopbackTransport::Delivery delivery;
+    delivery.channel = channel;
+    delivery.msg = msg;
+    if(pMeasurement)
+        delivery.measurement = *pMeasurement;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStats.nMessages[channel]++;
+    if(msg)
+        mStats.nBytes[channel] += msg->size();
+    mnSent++;
+
+    for(size_t i=0; i<mvpTransports.size(); i++)
+        if(mvpTransports[i]!=pSender)
+            mvpTransports[i]->Deliver(delivery);
+}
+
+void LoopbackHub::Flush()
+{
+    // Handlers may publish while other robots are checked, so repeat until a whole pass finds
+    // every robot idle and nothing was sent
+    while(1)
+    {
+        std::vector<LoopbackTransport*> vpTransports;
+        unsigned long nSent;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            vpTransports = mvpTransports;
+            nSent = mnSent;
+        }
+
+        bool bIdle = true;
+        for(size_t i=0; i<vpTransports.size(); i++)
+            bIdle = vpTransports[i]->Flush() && bIdle;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(bIdle && nSent==mnSent)
+            break;
+    }
+}
+
+LoopbackHub::Stats LoopbackHub::GetStats()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+LoopbackTransport::LoopbackTransport(LoopbackHub* pHub):
+    mpHub(pHub), mbBusy(false), mbFinish(false), mThread(&LoopbackTransport::Run,this)
+{
+    mpHub->Attach(this);
+}
+
+LoopbackTransport::~LoopbackTransport()
+{
+    mpHub->Detach(this);
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mbFinish = true;
+    }
+    mSignal.Notify();
+    mThread.join();
+}
+
+void LoopbackTransport::Publish(eChannel channel, std::vector<unsigned char> &vData)
+{
+    std::shared_ptr<std::vector<unsigned char> > pData = std::make_shared<std::vector<unsigned char> >();
+    pData->swap(vData);
+    mpHub->Send(this,channel,pData,NULL);
+}
+
+void LoopbackTransport::PublishMeasurement(const InterRobotMeasurement &measurement)
+{
+    mpHub->Send(this,NUM_CHANNELS,Message(),&measurement);
+}
+
+void LoopbackTransport::Subscribe(eChannel channel, const MessageHandler &handler)
+{
+    mvHandlers[channel].push_back(handler);
+}
+
+void LoopbackTransport::SubscribeMeasurements(const MeasurementHandler &handler)
+{
+    mvMeasurementHandlers.push_back(handler);
+}
+
+void LoopbackTransport::Deliver(const Delivery &delivery)
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mqDeliveries.push_back(delivery);
+    }
+    mSignal.Notify();
+}
+
+bool LoopbackTransport::Flush()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(mqDeliveries.empty() && !mbBusy)
+            return true;
+    }
+
+    mSignal.WaitUntil([this]{
+        std::unique_lock<std::mutex> lock(mMutex);
+        return (mqDeliveries.empty() && !mbBusy) || mbFinish;
+    });
+    return false;
+}
+
+void LoopbackTransport::Run()
+{
+    while(1)
+    {
+        Delivery delivery;
+        bool bDelivery = false;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if(mbFinish)
+                break;
+            if(!mqDeliveries.empty())
+            {
+                delivery = mqDeliveries.front();
+                mqDeliveries.pop_front();
+                mbBusy = true;
+                bDelivery = true;
+            }
+        }
+
+        // Sleep until a message is delivered or finish is requested
+        if(!bDelivery)
+        {
+            mSignal.Wait();
+            continue;
+        }
+
+        if(delivery.channel<NUM_CHANNELS)
+        {
+            const std::vector<MessageHandler> &vHandlers = mvHandlers[delivery.channel];
+            for(size_t i=0; i<vHandlers.size(); i++)
+                vHandlers[i](delivery.msg);
+        }
+        else
+        {
+            for(size_t i=0; i<mvMeasurementHandlers.size(); i++)
+                mvMeasurementHandlers[i](delivery.measurement);
+        }
+
+        // Wake up Flush() once everything is handled
+        bool bDrained;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mbBusy = false;
+            bDrained = mqDeliveries.empty();
+        }
+        if(bDrained)
+            mSignal.Notify();
+    }
+}
+
+} //namespace ORB_SLAM
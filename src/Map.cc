@@ -25,7 +25,7 @@
 namespace ORB_SLAM2
 {
 
-Map::Map():mnMaxKFid(0)
+Map::Map():mnMaxKFid(0), mbLogErased(false)
 {
 }
 
@@ -46,7 +46,8 @@ void Map::AddMapPoint(MapPoint *pMP)
 void Map::EraseMapPoint(MapPoint *pMP)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspMapPoints.erase(pMP);
+    if(mspMapPoints.erase(pMP) && mbLogErased)
+        mvpErasedMapPoints.push_back(pMP);
 
     // TODO: This only erase the pointer.
     // Delete the MapPoint
@@ -55,7 +56,8 @@ void Map::EraseMapPoint(MapPoint *pMP)
 void Map::EraseKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspKeyFrames.erase(pKF);
+    if(mspKeyFrames.erase(pKF) && mbLogErased)
+        mvpErasedKeyFrames.push_back(pKF);
 
     // TODO: This only erase the pointer.
     // Delete the MapPoint
@@ -103,6 +105,21 @@ long unsigned int Map::GetMaxKFid()
     return mnMaxKFid;
 }
 
+void Map::EnableErasedLog()
+{
+    unique_lock<mutex> lock(mMutexMap);
+    mbLogErased = true;
+}
+
+void Map::TakeErased(vector<KeyFrame*> &vpKFs, vector<MapPoint*> &vpMPs)
+{
+    unique_lock<mutex> lock(mMutexMap);
+    vpKFs.swap(mvpErasedKeyFrames);
+    vpMPs.swap(mvpErasedMapPoints);
+    mvpErasedKeyFrames.clear();
+    mvpErasedMapPoints.clear();
+}
+
 void Map::clear()
 {
     for(set<MapPoint*>::iterator sit=mspMapPoints.begin(), send=mspMapPoints.end(); sit!=send; sit++)
@@ -113,6 +130,8 @@ void Map::clear()
 
     mspMapPoints.clear();
     mspKeyFrames.clear();
+    mvpErasedKeyFrames.clear();
+    mvpErasedMapPoints.clear();
     mnMaxKFid = 0;
     mvpReferenceMapPoints.clear();
     mvpKeyFrameOrigins.clear();
@@ -20,6 +20,7 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "EpochReclaimer.h"
 
 #include<mutex>
 
@@ -38,6 +39,35 @@
 namespace ORB_SLAM2
 {
 
+int MapPointObservations::Find(KeyFrame* pKF) const
+{
+    for(size_t i=0; i<mnLive; i++)
+        if(mvObservations[i].first==pKF)
+            return mvObservations[i].second;
+    return -1;
+}
+
+int MapPointObservations::FindByKFId(long unsigned int nKFId) const
+{
+    for(size_t i=0, iend=mvObservations.size(); i<iend; i++)
+        if(mvObservations[i].mnKFId==nKFId)
+            return mvObservations[i].second;
+    return -1;
+}
+
+void MapPointObservations::Retire(size_t i)
+{
+    Observation obs = mvObservations[i];
+    mvObservations.erase(mvObservations.begin()+i);
+    mnLive--;
+
+    for(size_t j=mnLive, jend=mvObservations.size(); j<jend; j++)
+        if(mvObservations[j].mnKFId==obs.mnKFId)
+            return;
+    obs.first = static_cast<KeyFrame*>(NULL);
+    mvObservations.push_back(obs);
+}
+
 long unsigned int MapPoint::nNextId=0;
 mutex MapPoint::mGlobalMutex;
 MapPoint::MapPoint():
@@ -46,6 +76,8 @@ MapPoint::MapPoint():
     mnCorrectedReference(0), mnBAGlobalForKF(0),mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0)
  {
+    mpObservations = make_shared<MapPointObservations>();
+    mpCurrentObservations = mpObservations.get();
     //mNormalVector = cv::Mat::zeros(3,1,CV_32F);
     //unique_lock<recursive_mutex> lock(mpMap->mMutexPointCreation);
     //mpMap = new Map();
@@ -59,6 +91,8 @@ MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map* pMap):
     mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
     mpReplaced(static_cast<MapPoint*>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap)
 {
+    mpObservations = make_shared<MapPointObservations>();
+    mpCurrentObservations = mpObservations.get();
     Pos.copyTo(mWorldPos);
     mNormalVector = cv::Mat::zeros(3,1,CV_32F);
 
@@ -73,6 +107,8 @@ MapPoint::MapPoint(const cv::Mat &Pos, Map* pMap, Frame* pFrame, const int &idxF
     mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
     mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap)
 {
+    mpObservations = make_shared<MapPointObservations>();
+    mpCurrentObservations = mpObservations.get();
     Pos.copyTo(mWorldPos);
     cv::Mat Ow = pFrame->GetCameraCenter();
     mNormalVector = mWorldPos - Ow;
@@ -107,6 +143,14 @@ cv::Mat MapPoint::GetWorldPos()
     return mWorldPos.clone();
 }
 
+void MapPoint::GetWorldPos(float* pPos)
+{
+    unique_lock<mutex> lock(mMutexPos);
+    pPos[0] = mWorldPos.at<float>(0);
+    pPos[1] = mWorldPos.at<float>(1);
+    pPos[2] = mWorldPos.at<float>(2);
+}
+
 cv::Mat MapPoint::GetNormal()
 {
     unique_lock<mutex> lock(mMutexPos);
@@ -119,17 +163,38 @@ KeyFrame* MapPoint::GetReferenceKeyFrame()
     return mpRefKF;
 }
 
+shared_ptr<MapPointObservations> MapPoint::CopyObservations()
+{
+    return make_shared<MapPointObservations>(*mpObservations);
+}
+
+void MapPoint::PublishObservations(const shared_ptr<MapPointObservations> &pObs)
+{
+    pObs->mnVersion = mpObservations->mnVersion+1;
+    pObs->mnObs = nObs;
+    ObservationsPtr pPrevious = mpObservations;
+    mpObservations = pObs;
+    mpCurrentObservations = pObs.get();
+    EpochReclaimer::Retire(pPrevious);
+}
+
 void MapPoint::AddObservation(KeyFrame* pKF, size_t idx)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservations.count(pKF))
+    if(mpObservations->Find(pKF)>=0)
         return;
-    mObservations[pKF]=idx;
+
+    shared_ptr<MapPointObservations> pObs = CopyObservations();
+    MapPointObservations::Observation obs = {pKF, idx, pKF->mnId};
+    pObs->mvObservations.insert(pObs->mvObservations.begin()+pObs->mnLive,obs);
+    pObs->mnLive++;
 
     if(pKF->mvuRight[idx]>=0)
         nObs+=2;
     else
         nObs++;
+
+    PublishObservations(pObs);
 }
 
 void MapPoint::EraseObservation(KeyFrame* pKF)
@@ -137,18 +202,28 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
     bool bBad=false;
     {
         unique_lock<mutex> lock(mMutexFeatures);
-        if(mObservations.count(pKF))
+        const int idx = mpObservations->Find(pKF);
+        if(idx>=0)
         {
-            int idx = mObservations[pKF];
             if(pKF->mvuRight[idx]>=0)
                 nObs-=2;
             else
                 nObs--;
 
-            mObservations.erase(pKF);
+            shared_ptr<MapPointObservations> pObs = CopyObservations();
+            for(size_t i=0; i<pObs->mnLive; i++)
+            {
+                if(pObs->mvObservations[i].first==pKF)
+                {
+                    pObs->Retire(i);
+                    break;
+                }
+            }
 
             if(mpRefKF==pKF)
-                mpRefKF=mObservations.begin()->first;
+                mpRefKF=pObs->empty() ? static_cast<KeyFrame*>(NULL) : pObs->begin()->first;
+
+            PublishObservations(pObs);
 
             // If only 2 observations or less, discard point
             if(nObs<=2)
@@ -160,29 +235,29 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
         SetBadFlag();
 }
 
-map<KeyFrame*, size_t> MapPoint::GetObservations()
+MapPoint::ObservationsPtr MapPoint::GetObservations() const
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    return mObservations;
+    // The snapshot cannot be freed before the guard is left
+    EpochReclaimer::Guard guard;
+    return mpCurrentObservations.load()->shared_from_this();
 }
 
 int MapPoint::Observations()
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    return nObs;
+    return GetObservations()->Observations();
 }
 
 void MapPoint::SetBadFlag()
 {
-    map<KeyFrame*,size_t> obs;
+    ObservationsPtr obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         mbBad=true;
-        obs = mObservations;
-        mObservations.clear();
+        obs = mpObservations;
+        ClearObservations();
     }
-    for(map<KeyFrame*,size_t>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(MapPointObservations::const_iterator mit=obs->begin(), mend=obs->end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
         pKF->EraseMapPointMatch(mit->second);
@@ -204,19 +279,19 @@ void MapPoint::Replace(MapPoint* pMP)
         return;
 
     int nvisible, nfound;
-    map<KeyFrame*,size_t> obs;
+    ObservationsPtr obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
-        obs=mObservations;
-        mObservations.clear();
+        obs=mpObservations;
+        ClearObservations();
         mbBad=true;
         nvisible = mnVisible;
         nfound = mnFound;
         mpReplaced = pMP;
     }
 
-    for(map<KeyFrame*,size_t>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(MapPointObservations::const_iterator mit=obs->begin(), mend=obs->end(); mit!=mend; mit++)
     {
         // Replace measurement in keyframe
         KeyFrame* pKF = mit->first;
@@ -268,21 +343,21 @@ void MapPoint::ComputeDistinctiveDescriptors()
     // Retrieve all observed descriptors
     vector<cv::Mat> vDescriptors;
 
-    map<KeyFrame*,size_t> observations;
+    ObservationsPtr observations;
 
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         if(mbBad)
             return;
-        observations=mObservations;
+        observations=mpObservations;
     }
 
-    if(observations.empty())
+    if(observations->empty())
         return;
 
-    vDescriptors.reserve(observations.size());
+    vDescriptors.reserve(observations->size());
 
-    for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    for(MapPointObservations::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
 
@@ -296,24 +371,19 @@ void MapPoint::ComputeDistinctiveDescriptors()
     // Compute distances between them
     const size_t N = vDescriptors.size();
 
-    float Distances[N][N];
+    cv::Mat Descriptors(N,vDescriptors[0].cols,CV_8U);
     for(size_t i=0;i<N;i++)
-    {
-        Distances[i][i]=0;
-        for(size_t j=i+1;j<N;j++)
-        {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
-            Distances[i][j]=distij;
-            Distances[j][i]=distij;
-        }
-    }
+        vDescriptors[i].copyTo(Descriptors.row(i));
+
+    cv::Mat Distances;
+    ORBmatcher::DescriptorDistances(Descriptors,Descriptors,Distances);
 
     // Take the descriptor with least median distance to the rest
     int BestMedian = INT_MAX;
     int BestIdx = 0;
     for(size_t i=0;i<N;i++)
     {
-        vector<int> vDists(Distances[i],Distances[i]+N);
+        vector<int> vDists(Distances.ptr<int>(i),Distances.ptr<int>(i)+N);
         sort(vDists.begin(),vDists.end());
         int median = vDists[0.5*(N-1)];
 
@@ -338,32 +408,23 @@ cv::Mat MapPoint::GetDescriptor()
 
 int MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservations.count(pKF))
-        return mObservations[pKF];
-    else
-        return -1;
+    return GetObservations()->Find(pKF);
 }
 
 int MapPoint::GetIndexInKeyFrameMnID(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservationsMnID.count(pKF->mnId))
-        return mObservationsMnID[pKF->mnId];
-    else
-        return -1;
+    return GetObservations()->FindByKFId(pKF->mnId);
 }
 
 
 bool MapPoint::IsInKeyFrame(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutexFeatures);
-    return (mObservations.count(pKF));
+    return GetObservations()->Find(pKF)>=0;
 }
 
 void MapPoint::UpdateNormalAndDepth()
 {
-    map<KeyFrame*,size_t> observations;
+    ObservationsPtr observations;
     KeyFrame* pRefKF;
     cv::Mat Pos;
     {
@@ -371,17 +432,21 @@ void MapPoint::UpdateNormalAndDepth()
         unique_lock<mutex> lock2(mMutexPos);
         if(mbBad)
             return;
-        observations=mObservations;
+        observations=mpObservations;
         pRefKF=mpRefKF;
         Pos = mWorldPos.clone();
     }
 
-    if(observations.empty())
+    if(observations->empty())
+        return;
+
+    const int nRefIdx = observations->Find(pRefKF);
+    if(nRefIdx<0)
         return;
 
     cv::Mat normal = cv::Mat::zeros(3,1,CV_32F);
     int n=0;
-    for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    for(MapPointObservations::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
         cv::Mat Owi = pKF->GetCameraCenter();
@@ -392,7 +457,7 @@ void MapPoint::UpdateNormalAndDepth()
 
     cv::Mat PC = Pos - pRefKF->GetCameraCenter();
     const float dist = cv::norm(PC);
-    const int level = pRefKF->mvKeysUn[observations[pRefKF]].octave;
+    const int level = pRefKF->mvKeysUn[nRefIdx].octave;
     const float levelScaleFactor =  pRefKF->mvScaleFactors[level];
     const int nLevels = pRefKF->mnScaleLevels;
 
@@ -451,18 +516,13 @@ int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 }
 
 
-void MapPoint::copyMObservations()
+void MapPoint::ClearObservations()
 {
-  //std::cout << "Copying MObservations" << endl;
-  std::map<KeyFrame*,size_t>::iterator it;
-  for(it = mObservations.begin(); it!= mObservations.end(); it++){
-      KeyFrame* kF = it->first;
-      size_t num = it->second;
-      if(!mObservationsMnID.count(kF->mnId)){
-          mObservationsMnID.insert(make_pair(kF->mnId, num));
-        }
-    }
- // std::cout << "Size of Mobservations: " << mObservations.size() << endl;
+    // The keyframe ids are kept, they are only looked up by keyframe id
+    shared_ptr<MapPointObservations> pObs = CopyObservations();
+    while(pObs->mnLive>0)
+        pObs->Retire(pObs->mnLive-1);
+    PublishObservations(pObs);
 }
 
 
@@ -507,7 +567,13 @@ template<class Archive>
         ar & const_cast<bool &> (mbBad);
         ar & const_cast<float &> (mfMinDistance);
         ar & const_cast<float &> (mfMaxDistance);
-        ar & const_cast<std::map<long unsigned int,size_t> &> (mObservationsMnID);
+
+        // Observations are stored by keyframe id
+        std::map<long unsigned int,size_t> observationsMnID;
+        ObservationsPtr pObs = GetObservations();
+        for(vector<MapPointObservations::Observation>::const_iterator vit=pObs->mvObservations.begin(), vend=pObs->mvObservations.end(); vit!=vend; vit++)
+            observationsMnID.insert(make_pair(vit->mnKFId,vit->second));
+        ar & observationsMnID;
 
     }
 
@@ -549,7 +615,17 @@ template<class Archive>
         ar & const_cast<bool &> (mbBad);
         ar & const_cast<float &> (mfMinDistance);
         ar & const_cast<float &> (mfMaxDistance);
-        ar & const_cast<std::map<long unsigned int,size_t> &> (mObservationsMnID);
+
+        std::map<long unsigned int,size_t> observationsMnID;
+        ar & observationsMnID;
+        shared_ptr<MapPointObservations> pObs = make_shared<MapPointObservations>();
+        for(std::map<long unsigned int,size_t>::const_iterator mit=observationsMnID.begin(), mend=observationsMnID.end(); mit!=mend; mit++)
+        {
+            MapPointObservations::Observation obs = {static_cast<KeyFrame*>(NULL), mit->second, mit->first};
+            pObs->mvObservations.push_back(obs);
+        }
+        unique_lock<mutex> lock(mMutexFeatures);
+        PublishObservations(pObs);
 
         //cout << mWorldPos << endl;
         //cout << mDescriptor << endl;
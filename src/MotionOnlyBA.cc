@@ -0,0 +1,485 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MotionOnlyBA.h"
+
+#include <Eigen/Cholesky>
+
+#include<algorithm>
+#include<cmath>
+#include<limits>
+
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// Observations are evaluated in blocks, and reduced in lanes of one AVX register of doubles
+const int kBlock = 16;
+const int kLanes = 4;
+
+// Huber thresholds of PoseOptimization, which were floats
+const double kDeltaMono = static_cast<float>(sqrt(5.991));
+const double kDeltaStereo = static_cast<float>(sqrt(7.815));
+
+// Damping schedule of g2o::OptimizationAlgorithmLevenberg
+const double kTau = 1e-5;
+const double kGoodStepLowerScale = 1./3.;
+const double kGoodStepUpperScale = 2./3.;
+const int kMaxTrialsAfterFailure = 10;
+
+} // namespace
+
+void MotionOnlyBA::Observations::Clear()
+{
+    n = 0;
+    vX.clear();
+    vY.clear();
+    vZ.clear();
+    vU.clear();
+    vV.clear();
+    vUr.clear();
+    vInvSigma2.clear();
+    vChi2.clear();
+    vbInlier.clear();
+    vIndex.clear();
+}
+
+void MotionOnlyBA::Observations::Add(const int idx, const float u, const float v, const float ur, const float invSigma2, const float* pXw)
+{
+    // Drop the padding of a previous optimization
+    const size_t nSize = n;
+    vX.resize(nSize);
+    vY.resize(nSize);
+    vZ.resize(nSize);
+    vU.resize(nSize);
+    vV.resize(nSize);
+    vUr.resize(nSize);
+    vInvSigma2.resize(nSize);
+    vChi2.resize(nSize);
+    vbInlier.resize(nSize);
+    vIndex.resize(nSize);
+
+    vX.push_back(pXw[0]);
+    vY.push_back(pXw[1]);
+    vZ.push_back(pXw[2]);
+    vU.push_back(u);
+    vV.push_back(v);
+    vUr.push_back(ur);
+    vInvSigma2.push_back(invSigma2);
+    vChi2.push_back(0);
+    vbInlier.push_back(1);
+    vIndex.push_back(idx);
+    n++;
+}
+
+void MotionOnlyBA::Observations::Pad()
+{
+    // Padding is an outlier in front of the camera
+    const size_t nPadded = (n+kBlock-1)/kBlock*kBlock;
+    vX.resize(nPadded,0);
+    vY.resize(nPadded,0);
+    vZ.resize(nPadded,1);
+    vU.resize(nPadded,0);
+    vV.resize(nPadded,0);
+    vUr.resize(nPadded,0);
+    vInvSigma2.resize(nPadded,0);
+    vChi2.resize(nPadded,0);
+    vbInlier.resize(nPadded,0);
+    vIndex.resize(nPadded,-1);
+}
+
+MotionOnlyBA::MotionOnlyBA():
+    fx(0), fy(0), cx(0), cy(0), bf(0), mbRobust(true)
+{
+    mObservations[MONOCULAR].Clear();
+    mObservations[STEREO].Clear();
+}
+
+void MotionOnlyBA::Clear(const float fx_, const float fy_, const float cx_, const float cy_, const float bf_)
+{
+    fx = fx_;
+    fy = fy_;
+    cx = cx_;
+    cy = cy_;
+    bf = bf_;
+    mbRobust = true;
+    mObservations[MONOCULAR].Clear();
+    mObservations[STEREO].Clear();
+}
+
+void MotionOnlyBA::AddMonocular(const int idx, const float u, const float v, const float invSigma2, const float* pXw)
+{
+    mObservations[MONOCULAR].Add(idx,u,v,-1,invSigma2,pXw);
+}
+
+void MotionOnlyBA::AddStereo(const int idx, const float u, const float v, const float ur, const float invSigma2, const float* pXw)
+{
+    mObservations[STEREO].Add(idx,u,v,ur,invSigma2,pXw);
+}
+
+void MotionOnlyBA::SetEstimate(const g2o::SE3Quat &Tcw)
+{
+    mTcw = Tcw;
+}
+
+const g2o::SE3Quat& MotionOnlyBA::GetEstimate() const
+{
+    return mTcw;
+}
+
+void MotionOnlyBA::SetRobust(const bool bRobust)
+{
+    mbRobust = bRobust;
+}
+
+size_t MotionOnlyBA::Size(const eObservationType type) const
+{
+    return mObservations[type].n;
+}
+
+int MotionOnlyBA::Index(const eObservationType type, const size_t i) const
+{
+    return mObservations[type].vIndex[i];
+}
+
+double MotionOnlyBA::Chi2(const eObservationType type, const size_t i) const
+{
+    return mObservations[type].vChi2[i];
+}
+
+void MotionOnlyBA::SetInlier(const eObservationType type, const size_t i, const bool bInlier)
+{
+    mObservations[type].vbInlier[i] = bInlier;
+}
+
+template<bool bStereo, bool bLinearize>
+double MotionOnlyBA::Evaluate(Observations &obs, double* H, double* b)
+{
+    const double r00 = mRcw(0,0), r01 = mRcw(0,1), r02 = mRcw(0,2);
+    const double r10 = mRcw(1,0), r11 = mRcw(1,1), r12 = mRcw(1,2);
+    const double r20 = mRcw(2,0), r21 = mRcw(2,1), r22 = mRcw(2,2);
+    const double t0 = mtcw[0], t1 = mtcw[1], t2 = mtcw[2];
+
+    const double delta = bStereo ? kDeltaStereo : kDeltaMono;
+    const double delta2 = delta*delta;
+    const bool bRobust = mbRobust;
+
+    const double* __restrict__ pX = obs.vX.data();
+    const double* __restrict__ pY = obs.vY.data();
+    const double* __restrict__ pZ = obs.vZ.data();
+    const double* __restrict__ pU = obs.vU.data();
+    const double* __restrict__ pV = obs.vV.data();
+    const double* __restrict__ pUr = obs.vUr.data();
+    const double* __restrict__ pInvSigma2 = obs.vInvSigma2.data();
+    const unsigned char* __restrict__ pbInlier = obs.vbInlier.data();
+    double* __restrict__ pChi2 = obs.vChi2.data();
+
+    // Each lane accumulates its own sums, so the lanes map to SIMD registers without reordering
+    // floating point additions
+    double chi2Lanes[kLanes] = {};
+    double HLanes[21][kLanes] = {};
+    double bLanes[6][kLanes] = {};
+
+    // Robust chi2, weighted residuals and Jacobians of a block, zero for outliers
+    double rho[kBlock], w[kBlock], ju[6][kBlock], jv[6][kBlock];
+    double e[3][kBlock] = {};
+    double jr[6][kBlock] = {};
+    std::fill(ju[4], ju[4]+kBlock, 0.0);
+    std::fill(jv[3], jv[3]+kBlock, 0.0);
+
+    const size_t nPadded = obs.vX.size();
+    for(size_t i0=0; i0<nPadded; i0+=kBlock)
+    {
+        for(int l=0; l<kBlock; l++)
+        {
+            const size_t i = i0+l;
+
+            const double x = r00*pX[i]+r01*pY[i]+r02*pZ[i]+t0;
+            const double y = r10*pX[i]+r11*pY[i]+r12*pZ[i]+t1;
+            const double z = r20*pX[i]+r21*pY[i]+r22*pZ[i]+t2;
+            const double invz = 1.0/z;
+
+            // Same rounding as the g2o edges: the stereo edge projects with a float inverse depth
+            double eu, ev, er;
+            if(bStereo)
+            {
+                const double invzf = static_cast<float>(invz);
+                const double u = x*invzf*fx+cx;
+                eu = pU[i]-u;
+                ev = pV[i]-(y*invzf*fy+cy);
+                er = pUr[i]-(u-bf*invzf);
+            }
+            else
+            {
+                eu = pU[i]-(x/z*fx+cx);
+                ev = pV[i]-(y/z*fy+cy);
+                er = 0;
+            }
+
+            // Outliers are recomputed at the estimate when the optimization ends
+            const double chi2 = pInvSigma2[i]*(eu*eu+ev*ev+er*er);
+            pChi2[i] = chi2;
+
+            const bool bInlier = pbInlier[i]!=0;
+            const double sqrte = sqrt(chi2);
+            const bool bHuber = bRobust & (chi2>delta2);
+            rho[l] = bInlier ? (bHuber ? 2*sqrte*delta-delta2 : chi2) : 0.0;
+
+            if(bLinearize)
+            {
+                // Outliers may be behind the camera, keep their terms finite
+                const double xl = bInlier ? x : 0.0;
+                const double yl = bInlier ? y : 0.0;
+                const double invzl = bInlier ? invz : 0.0;
+                const double invz2 = invzl*invzl;
+
+                w[l] = bInlier ? (bHuber ? delta/sqrte : 1.0)*pInvSigma2[i] : 0.0;
+                e[0][l] = bInlier ? eu : 0.0;
+                e[1][l] = bInlier ? ev : 0.0;
+
+                ju[0][l] = xl*yl*invz2*fx;
+                ju[1][l] = -(1+(xl*xl*invz2))*fx;
+                ju[2][l] = yl*invzl*fx;
+                ju[3][l] = -invzl*fx;
+                ju[5][l] = xl*invz2*fx;
+
+                jv[0][l] = (1+yl*yl*invz2)*fy;
+                jv[1][l] = -xl*yl*invz2*fy;
+                jv[2][l] = -xl*invzl*fy;
+                jv[4][l] = -invzl*fy;
+                jv[5][l] = yl*invz2*fy;
+
+                if(bStereo)
+                {
+                    e[2][l] = bInlier ? er : 0.0;
+                    jr[0][l] = ju[0][l]-bf*yl*invz2;
+                    jr[1][l] = ju[1][l]+bf*xl*invz2;
+                    jr[2][l] = ju[2][l];
+                    jr[3][l] = ju[3][l];
+                    jr[5][l] = ju[5][l]-bf*invz2;
+                }
+            }
+        }
+
+        for(int l0=0; l0<kBlock; l0+=kLanes)
+            for(int l=0; l<kLanes; l++)
+                chi2Lanes[l] += rho[l0+l];
+
+        if(bLinearize)
+        {
+            // b -= rho'·J^T·Ω·e and H += J^T·(rho'·Ω)·J, Ω = invSigma2·I
+            int k = 0;
+            for(int r=0; r<6; r++)
+            {
+                for(int l0=0; l0<kBlock; l0+=kLanes)
+                {
+                    for(int l=0; l<kLanes; l++)
+                    {
+                        const int j = l0+l;
+                        bLanes[r][l] -= w[j]*(ju[r][j]*e[0][j]+jv[r][j]*e[1][j]+jr[r][j]*e[2][j]);
+                    }
+                }
+
+                for(int c=r; c<6; c++, k++)
+                {
+                    for(int l0=0; l0<kBlock; l0+=kLanes)
+                    {
+                        for(int l=0; l<kLanes; l++)
+                        {
+                            const int j = l0+l;
+                            HLanes[k][l] += w[j]*(ju[r][j]*ju[c][j]+jv[r][j]*jv[c][j]+jr[r][j]*jr[c][j]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    double chi2 = 0;
+    for(int l=0; l<kLanes; l++)
+        chi2 += chi2Lanes[l];
+
+    if(bLinearize)
+    {
+        for(int k=0; k<21; k++)
+            for(int l=0; l<kLanes; l++)
+                H[k] += HLanes[k][l];
+        for(int r=0; r<6; r++)
+            for(int l=0; l<kLanes; l++)
+                b[r] += bLanes[r][l];
+    }
+
+    return chi2;
+}
+
+template<bool bStereo>
+void MotionOnlyBA::ComputeOutlierErrors(Observations &obs)
+{
+    for(size_t i=0; i<obs.n; i++)
+    {
+        if(obs.vbInlier[i])
+            continue;
+
+        const Eigen::Vector3d Xc = mTcw.map(Eigen::Vector3d(obs.vX[i],obs.vY[i],obs.vZ[i]));
+        double eu, ev, er;
+        if(bStereo)
+        {
+            const double invzf = static_cast<float>(1.0/Xc[2]);
+            const double u = Xc[0]*invzf*fx+cx;
+            eu = obs.vU[i]-u;
+            ev = obs.vV[i]-(Xc[1]*invzf*fy+cy);
+            er = obs.vUr[i]-(u-bf*invzf);
+        }
+        else
+        {
+            eu = obs.vU[i]-(Xc[0]/Xc[2]*fx+cx);
+            ev = obs.vV[i]-(Xc[1]/Xc[2]*fy+cy);
+            er = 0;
+        }
+        obs.vChi2[i] = obs.vInvSigma2[i]*(eu*eu+ev*ev+er*er);
+    }
+}
+
+double MotionOnlyBA::Linearize(Eigen::Matrix<double,6,6> &H, Eigen::Matrix<double,6,1> &b)
+{
+    mRcw = mTcw.rotation().toRotationMatrix();
+    mtcw = mTcw.translation();
+
+    double Hu[21] = {};
+    double bu[6] = {};
+    const double chi2 = Evaluate<false,true>(mObservations[MONOCULAR],Hu,bu) +
+                        Evaluate<true,true>(mObservations[STEREO],Hu,bu);
+
+    int k = 0;
+    for(int r=0; r<6; r++)
+    {
+        b[r] = bu[r];
+        for(int c=r; c<6; c++, k++)
+        {
+            H(r,c) = Hu[k];
+            H(c,r) = Hu[k];
+        }
+    }
+
+    return chi2;
+}
+
+double MotionOnlyBA::ComputeErrors()
+{
+    mRcw = mTcw.rotation().toRotationMatrix();
+    mtcw = mTcw.translation();
+
+    return Evaluate<false,false>(mObservations[MONOCULAR],NULL,NULL) +
+           Evaluate<true,false>(mObservations[STEREO],NULL,NULL);
+}
+
+void MotionOnlyBA::Optimize(const int nIterations)
+{
+    Observations &mono = mObservations[MONOCULAR];
+    Observations &stereo = mObservations[STEREO];
+    mono.Pad();
+    stereo.Pad();
+
+    bool bInliers = false;
+    for(size_t i=0; i<mono.n && !bInliers; i++)
+        bInliers = mono.vbInlier[i];
+    for(size_t i=0; i<stereo.n && !bInliers; i++)
+        bInliers = stereo.vbInlier[i];
+
+    // Without inliers g2o has no active vertex and leaves the estimate untouched
+    if(bInliers)
+    {
+        Eigen::Matrix<double,6,6> H;
+        Eigen::Matrix<double,6,1> b;
+        // Kept when the damped system is not positive definite, as the g2o solver does
+        g2o::Vector6d dx = g2o::Vector6d::Zero();
+
+        double lambda = 0;
+        double ni = 2;
+        int nBad = 0;
+
+        for(int it=0; it<nIterations; it++)
+        {
+            double currentChi = Linearize(H,b);
+            const double iniChi = currentChi;
+
+            if(it==0)
+                lambda = kTau*H.diagonal().cwiseAbs().maxCoeff();
+
+            double rho = 0;
+            int nTrials = 0;
+            do
+            {
+                const g2o::SE3Quat Tcw = mTcw;
+
+                Eigen::Matrix<double,6,6> Hdamped = H;
+                Hdamped.diagonal().array() += lambda;
+                const Eigen::LDLT<Eigen::Matrix<double,6,6> > ldlt(Hdamped);
+                const bool bSolved = ldlt.isPositive();
+                if(bSolved)
+                    dx = ldlt.solve(b);
+
+                mTcw = g2o::SE3Quat::exp(dx)*mTcw;
+
+                double tempChi = ComputeErrors();
+                if(!bSolved)
+                    tempChi = std::numeric_limits<double>::max();
+
+                rho = (currentChi-tempChi)/(dx.dot(lambda*dx+b)+1e-3);
+
+                if(rho>0 && std::isfinite(tempChi))
+                {
+                    const double alpha = std::min(1.-pow(2*rho-1,3),kGoodStepUpperScale);
+                    lambda *= std::max(kGoodStepLowerScale,alpha);
+                    ni = 2;
+                    currentChi = tempChi;
+                }
+                else
+                {
+                    lambda *= ni;
+                    ni *= 2;
+                    mTcw = Tcw;
+                }
+                nTrials++;
+            }
+            while(rho<0 && nTrials<kMaxTrialsAfterFailure);
+
+            if(nTrials==kMaxTrialsAfterFailure || rho==0)
+                break;
+
+            // Stop when the chi2 barely decreases for three iterations
+            if((iniChi-currentChi)*1e3<iniChi)
+                nBad++;
+            else
+                nBad = 0;
+
+            if(nBad>=3)
+                break;
+        }
+    }
+
+    ComputeOutlierErrors<false>(mono);
+    ComputeOutlierErrors<true>(stereo);
+}
+
+} //namespace ORB_SLAM
@@ -61,6 +61,7 @@
 #include <vector>
 
 #include "ORBextractor.h"
+#include "ThreadPool.h"
 
 
 using namespace cv;
@@ -431,6 +432,8 @@ ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
     }
 
     mvImagePyramid.resize(nlevels);
+    mvImagePyramidBorder.resize(nlevels);
+    mvBlurredPyramid.resize(nlevels);
 
     mnFeaturesPerLevel.resize(nlevels);
     float factor = 1.0f / scaleFactor;
@@ -768,65 +771,98 @@ void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoin
 
     const float W = 30;
 
+    // Cell grid of each level
+    vector<int> vnCols(nlevels), vnRows(nlevels), vwCell(nlevels), vhCell(nlevels);
+    vector<pair<int,int> > vLevelRows;
     for (int level = 0; level < nlevels; ++level)
     {
+        const float width = (mvImagePyramid[level].cols-2*EDGE_THRESHOLD+6);
+        const float height = (mvImagePyramid[level].rows-2*EDGE_THRESHOLD+6);
+
+        vnCols[level] = width/W;
+        vnRows[level] = height/W;
+        vwCell[level] = ceil(width/vnCols[level]);
+        vhCell[level] = ceil(height/vnRows[level]);
+
+        for(int i=0; i<vnRows[level]; i++)
+            vLevelRows.push_back(make_pair(level,i));
+    }
+
+    // FAST on the rows of cells of all levels in parallel. Each row writes its own vector,
+    // rows are concatenated in order afterwards so the result does not depend on scheduling.
+    vector<vector<cv::KeyPoint> > vRowKeys(vLevelRows.size());
+
+    ThreadPool::Global()->ParallelFor(vLevelRows.size(), [&](int iTask)
+    {
+        const int level = vLevelRows[iTask].first;
+        const int i = vLevelRows[iTask].second;
+
         const int minBorderX = EDGE_THRESHOLD-3;
         const int minBorderY = minBorderX;
         const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
         const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+        const int nCols = vnCols[level];
+        const int wCell = vwCell[level];
+        const int hCell = vhCell[level];
 
-        vector<cv::KeyPoint> vToDistributeKeys;
-        vToDistributeKeys.reserve(nfeatures*10);
+        vector<cv::KeyPoint> &vKeysRow = vRowKeys[iTask];
 
-        const float width = (maxBorderX-minBorderX);
-        const float height = (maxBorderY-minBorderY);
+        const float iniY =minBorderY+i*hCell;
+        float maxY = iniY+hCell+6;
 
-        const int nCols = width/W;
-        const int nRows = height/W;
-        const int wCell = ceil(width/nCols);
-        const int hCell = ceil(height/nRows);
+        if(iniY>=maxBorderY-3)
+            return;
+        if(maxY>maxBorderY)
+            maxY = maxBorderY;
 
-        for(int i=0; i<nRows; i++)
+        for(int j=0; j<nCols; j++)
         {
-            const float iniY =minBorderY+i*hCell;
-            float maxY = iniY+hCell+6;
-
-            if(iniY>=maxBorderY-3)
+            const float iniX =minBorderX+j*wCell;
+            float maxX = iniX+wCell+6;
+            if(iniX>=maxBorderX-6)
                 continue;
-            if(maxY>maxBorderY)
-                maxY = maxBorderY;
+            if(maxX>maxBorderX)
+                maxX = maxBorderX;
 
-            for(int j=0; j<nCols; j++)
-            {
-                const float iniX =minBorderX+j*wCell;
-                float maxX = iniX+wCell+6;
-                if(iniX>=maxBorderX-6)
-                    continue;
-                if(maxX>maxBorderX)
-                    maxX = maxBorderX;
+            vector<cv::KeyPoint> vKeysCell;
+            FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
+                 vKeysCell,iniThFAST,true);
 
-                vector<cv::KeyPoint> vKeysCell;
+            if(vKeysCell.empty())
+            {
                 FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                     vKeysCell,iniThFAST,true);
+                     vKeysCell,minThFAST,true);
+            }
 
-                if(vKeysCell.empty())
+            if(!vKeysCell.empty())
+            {
+                for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
                 {
-                    FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                         vKeysCell,minThFAST,true);
+                    (*vit).pt.x+=j*wCell;
+                    (*vit).pt.y+=i*hCell;
+                    vKeysRow.push_back(*vit);
                 }
-
-                if(!vKeysCell.empty())
-                {
-                    for(vector<cv::KeyPoint>::iterator vit=vKeysCell.begin(); vit!=vKeysCell.end();vit++)
-                    {
-                        (*vit).pt.x+=j*wCell;
-                        (*vit).pt.y+=i*hCell;
-                        vToDistributeKeys.push_back(*vit);
-                    }
-                }
-
             }
         }
+    });
+
+    // Distribute and compute orientations, one level per task
+    vector<int> vFirstRow(nlevels+1,0);
+    for (int level = 0; level < nlevels; ++level)
+        vFirstRow[level+1] = vFirstRow[level]+vnRows[level];
+
+    ThreadPool::Global()->ParallelFor(nlevels, [&](int level)
+    {
+        const int minBorderX = EDGE_THRESHOLD-3;
+        const int minBorderY = minBorderX;
+        const int maxBorderX = mvImagePyramid[level].cols-EDGE_THRESHOLD+3;
+        const int maxBorderY = mvImagePyramid[level].rows-EDGE_THRESHOLD+3;
+
+        vector<cv::KeyPoint> vToDistributeKeys;
+        vToDistributeKeys.reserve(nfeatures*10);
+
+        for(int iTask=vFirstRow[level]; iTask<vFirstRow[level+1]; iTask++)
+            vToDistributeKeys.insert(vToDistributeKeys.end(),vRowKeys[iTask].begin(),vRowKeys[iTask].end());
 
         vector<KeyPoint> & keypoints = allKeypoints[level];
         keypoints.reserve(nfeatures);
@@ -845,11 +881,10 @@ void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoin
             keypoints[i].octave=level;
             keypoints[i].size = scaledPatchSize;
         }
-    }
 
-    // compute orientations
-    for (int level = 0; level < nlevels; ++level)
-        computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+        // compute orientations
+        computeOrientation(mvImagePyramid[level], keypoints, umax);
+    });
 }
 
 void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<KeyPoint> > &allKeypoints)
@@ -1069,28 +1104,68 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
         descriptors = _descriptors.getMat();
     }
 
+    ComputeDescriptorsAndScale(allKeypoints, descriptors, _keypoints);
+}
+
+void ORBextractor::operator()( InputArray _image, vector<KeyPoint>& _keypoints,
+                      Mat &descriptorsBuffer, Mat &descriptors)
+{
+    if(_image.empty())
+        return;
+
+    Mat image = _image.getMat();
+    assert(image.type() == CV_8UC1 );
+
+    // Pre-compute the scale pyramid
+    ComputePyramid(image);
+
+    vector < vector<KeyPoint> > allKeypoints;
+    ComputeKeyPointsOctTree(allKeypoints);
+
+    int nkeypoints = 0;
+    for (int level = 0; level < nlevels; ++level)
+        nkeypoints += (int)allKeypoints[level].size();
+
+    if(descriptorsBuffer.rows<nkeypoints || descriptorsBuffer.cols!=32 || descriptorsBuffer.type()!=CV_8U)
+        descriptorsBuffer.create(max(nkeypoints,nfeatures), 32, CV_8U);
+
+    descriptors = descriptorsBuffer.rowRange(0, nkeypoints);
+
+    ComputeDescriptorsAndScale(allKeypoints, descriptors, _keypoints);
+}
+
+void ORBextractor::ComputeDescriptorsAndScale(vector<vector<KeyPoint> >& allKeypoints, Mat &descriptors,
+                                              vector<KeyPoint>& _keypoints)
+{
+    int nkeypoints = 0;
+    for (int level = 0; level < nlevels; ++level)
+        nkeypoints += (int)allKeypoints[level].size();
+
     _keypoints.clear();
     _keypoints.reserve(nkeypoints);
 
-    int offset = 0;
+    vector<int> vOffsets(nlevels+1,0);
     for (int level = 0; level < nlevels; ++level)
+        vOffsets[level+1] = vOffsets[level] + (int)allKeypoints[level].size();
+
+    // Descriptors of each level in parallel, into their own rows of the output
+    ThreadPool::Global()->ParallelFor(nlevels, [&](int level)
     {
         vector<KeyPoint>& keypoints = allKeypoints[level];
         int nkeypointsLevel = (int)keypoints.size();
 
         if(nkeypointsLevel==0)
-            continue;
+            return;
 
         // preprocess the resized image
-        Mat workingMat = mvImagePyramid[level].clone();
+        Mat &workingMat = mvBlurredPyramid[level];
+        mvImagePyramid[level].copyTo(workingMat);
         GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
 
         // Compute the descriptors
-        Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
+        Mat desc = descriptors.rowRange(vOffsets[level], vOffsets[level+1]);
         computeDescriptors(workingMat, keypoints, desc, pattern);
 
-        offset += nkeypointsLevel;
-
         // Scale keypoint coordinates
         if (level != 0)
         {
@@ -1099,9 +1174,11 @@ void ORBextractor::operator()( InputArray _image, InputArray _mask, vector<KeyPo
                  keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
                 keypoint->pt *= scale;
         }
-        // And add the keypoints to the output
-        _keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
-    }
+    });
+
+    // And add the keypoints to the output
+    for (int level = 0; level < nlevels; ++level)
+        _keypoints.insert(_keypoints.end(), allKeypoints[level].begin(), allKeypoints[level].end());
 }
 
 void ORBextractor::ComputePyramid(cv::Mat image)
@@ -1111,7 +1188,9 @@ void ORBextractor::ComputePyramid(cv::Mat image)
         float scale = mvInvScaleFactor[level];
         Size sz(cvRound((float)image.cols*scale), cvRound((float)image.rows*scale));
         Size wholeSize(sz.width + EDGE_THRESHOLD*2, sz.height + EDGE_THRESHOLD*2);
-        Mat temp(wholeSize, image.type()), masktemp;
+        // Only allocated for the first image (or if the image size changes)
+        Mat &temp = mvImagePyramidBorder[level];
+        temp.create(wholeSize, image.type());
         mvImagePyramid[level] = temp(Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
 
         // Compute the resized image
@@ -26,6 +26,7 @@
 #include<opencv2/features2d/features2d.hpp>
 
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
+#include "HammingDistance.h"
 
 #include<stdint-gcc.h>
 
@@ -405,7 +406,7 @@ namespace ORB_SLAM2
   int ORBmatcher::SearchByProjectionInterRobot( const vector<cv::KeyPoint>& keypoints,
                                                 const vector<float>& mvScaleFactors,
                                                 float mnMinX, float mnMinY, float mnMaxX, float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv,
-                                                float mnGridRows, float mnGridCols, int mnScaleLevels, float mfLogScaleFactor, std::vector< std::vector <std::vector<size_t> > > mGrid,
+                                                float mnGridRows, float mnGridCols, int mnScaleLevels, float mfLogScaleFactor, const FeatureGrid &grid,
                                                 const cv::Mat &Descriptors1,
                                                 float fx, float fy, float cx, float cy,
                                                 cv::Mat Scw, const vector<MapPoint*> &vpPoints, vector<MapPoint*> &vpMatched, int th)
@@ -486,8 +487,7 @@ namespace ORB_SLAM2
         // Search in a radius
         const float radius = th*mvScaleFactors[nPredictedLevel];
 
-        const vector<size_t> vIndices = GetFeaturesInArea(mnMinX, mnMinY, mfGridElementWidthInv, mfGridElementHeightInv, mnGridRows, mnGridCols, keypoints, mGrid,
-                                                          u, v, radius);
+        const vector<size_t> vIndices = GetFeaturesInArea(grid, u, v, radius);
 
         //const vector<size_t> vIndices = pKF->GetFeaturesInArea(u,v,radius);
 
@@ -1604,49 +1604,10 @@ namespace ORB_SLAM2
     return nScale;
   }
 
-  vector<size_t> ORBmatcher::GetFeaturesInArea(float mnMinX, float mnMinY, float mfGridElementWidthInv, float mfGridElementHeightInv, float mnGridRows, float mnGridCols,
-                                               const vector<cv::KeyPoint>& keypoints, std::vector< std::vector <std::vector<size_t> > > mGrid,
-                                               const float &x, const float &y, const float &r)
+  vector<size_t> ORBmatcher::GetFeaturesInArea(const FeatureGrid &grid, const float &x, const float &y, const float &r,
+                                               const int minLevel, const int maxLevel)
   {
-
-    int N = keypoints.size();
-    vector<size_t> vIndices;
-    vIndices.reserve(N);
-
-    const int nMinCellX = max(0,(int)floor((x-mnMinX-r)*mfGridElementWidthInv));
-    if(nMinCellX>=mnGridCols)
-      return vIndices;
-
-    const int nMaxCellX = min((int)mnGridCols-1,(int)ceil((x-mnMinX+r)*mfGridElementWidthInv));
-    if(nMaxCellX<0)
-      return vIndices;
-
-    const int nMinCellY = max(0,(int)floor((y-mnMinY-r)*mfGridElementHeightInv));
-    if(nMinCellY>=mnGridRows)
-      return vIndices;
-
-    const int nMaxCellY = min((int)mnGridRows-1,(int)ceil((y-mnMinY+r)*mfGridElementHeightInv));
-    if(nMaxCellY<0)
-      return vIndices;
-
-    for(int ix = nMinCellX; ix<=nMaxCellX; ix++)
-      {
-        for(int iy = nMinCellY; iy<=nMaxCellY; iy++)
-          {
-            const vector<size_t> vCell = mGrid[ix][iy];
-            for(size_t j=0, jend=vCell.size(); j<jend; j++)
-              {
-                const cv::KeyPoint &kpUn = keypoints[vCell[j]];
-                const float distx = kpUn.pt.x-x;
-                const float disty = kpUn.pt.y-y;
-
-                if(fabs(distx)<r && fabs(disty)<r)
-                  vIndices.push_back(vCell[j]);
-              }
-          }
-      }
-
-    return vIndices;
+    return grid.GetFeaturesInArea(x,y,r,minLevel,maxLevel);
   }
 
 
@@ -1661,7 +1622,7 @@ namespace ORB_SLAM2
                                          const vector<float>& mvScaleFactors,
                                          const vector<cv::Mat>& pointDescriptors,
                                          float mnMinX, float mnMinY, float mnMaxX, float mnMaxY, float mfGridElementWidthInv, float mfGridElementHeightInv,
-                                         float mnGridRows, float mnGridCols, int mnScaleLevels, float mfLogScaleFactor, std::vector< std::vector <std::vector<size_t> > > mGrid,
+                                         float mnGridRows, float mnGridCols, int mnScaleLevels, float mfLogScaleFactor, const FeatureGrid &grid,
                                          const cv::Mat &Descriptors1,
                                          cv::Mat pose, cv::Mat K,
                                          float fx, float fy, float cx, float cy,
@@ -1842,8 +1803,7 @@ namespace ORB_SLAM2
         // Search in a radius of 2.5*sigma(ScaleLevel)
         const float radius = th*mvScaleFactors[nPredictedLevel];
 
-        const vector<size_t> vIndices = GetFeaturesInArea(mnMinX, mnMinY, mfGridElementWidthInv, mfGridElementHeightInv, mnGridRows, mnGridCols, keypoints, mGrid,
-                                                          u, v, radius);
+        const vector<size_t> vIndices = GetFeaturesInArea(grid, u, v, radius);
         //const vector<size_t> vIndices = pKF1->GetFeaturesInArea(u,v,radius);
 
         if(vIndices.empty())
@@ -2220,24 +2180,29 @@ namespace ORB_SLAM2
   }
 
 
-  // Bit set count operation from
-  // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+  // The kernel (POPCNT, AVX2, AVX-512, NEON or the scalar bit set count) is chosen at runtime,
+  // see HammingDistance
   int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
   {
-    const int *pa = a.ptr<int32_t>();
-    const int *pb = b.ptr<int32_t>();
+    return HammingDistance::Distance(a.ptr<uint8_t>(),b.ptr<uint8_t>());
+  }
+
+  void ORBmatcher::DescriptorDistances(const cv::Mat &a, const cv::Mat &B, vector<int> &vDists)
+  {
+    vDists.resize(B.rows);
+    if(B.rows==0)
+      return;
 
-    int dist=0;
+    HammingDistance::OneToMany(a.ptr<uint8_t>(),B.ptr<uint8_t>(),B.step[0],B.rows,&vDists[0]);
+  }
 
-    for(int i=0; i<8; i++, pa++, pb++)
-      {
-        unsigned  int v = *pa ^ *pb;
-        v = v - ((v >> 1) & 0x55555555);
-        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-      }
+  void ORBmatcher::DescriptorDistances(const cv::Mat &A, const cv::Mat &B, cv::Mat &D)
+  {
+    D.create(A.rows,B.rows,CV_32S);
+    if(A.rows==0 || B.rows==0)
+      return;
 
-    return dist;
+    HammingDistance::ManyToMany(A.ptr<uint8_t>(),A.step[0],A.rows,B.ptr<uint8_t>(),B.step[0],B.rows,D.ptr<int>());
   }
 
 } //namespace ORB_SLAM
@@ -23,6 +23,7 @@
 #include "Thirdparty/g2o/g2o/core/block_solver.h"
 #include "Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h"
+#include "Thirdparty/g2o/g2o/solvers/linear_solver_block_cholesky.h"
 #include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
 #include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_dense.h"
@@ -30,13 +31,180 @@
 
 #include<Eigen/StdVector>
 
+#include "Thirdparty/g2o/g2o/core/parallel_for.h"
+
 #include "Converter.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "MotionOnlyBA.h"
 
 #include<mutex>
 
 namespace ORB_SLAM2
 {
 
+namespace
+{
+
+// The loops of g2o over edges and vertices (errors, Jacobians, Hessian blocks and Schur
+// complement) run on the shared thread pool
+struct G2OParallelFor
+{
+    G2OParallelFor()
+    {
+        g2o::setParallelFor([](int n, const std::function<void(int)> &f)
+        {
+            ThreadPool::Global()->ParallelFor(n,f);
+        });
+    }
+} gG2OParallelFor;
+
+// Objects that are reused instead of allocated for every graph. They are owned by the pool,
+// not by the optimizer they are added to.
+template<class T>
+class ElementPool
+{
+public:
+    ElementPool(): mnUsed(0) {}
+
+    ~ElementPool()
+    {
+        for(size_t i=0; i<mvpElements.size(); i++)
+            delete mvpElements[i];
+    }
+
+    T* Get()
+    {
+        if(mnUsed==mvpElements.size())
+            mvpElements.push_back(new T());
+        return mvpElements[mnUsed++];
+    }
+
+    void Reset()
+    {
+        mnUsed = 0;
+    }
+
+protected:
+    std::vector<T*> mvpElements;
+    size_t mnUsed;
+};
+
+// Edges with their Huber kernel. The kernel is detached from the edge when it is removed
+// for the second optimization and attached again when the edge is reused.
+template<class T>
+class RobustEdgePool
+{
+public:
+    RobustEdgePool(): mnUsed(0) {}
+
+    ~RobustEdgePool()
+    {
+        for(size_t i=0; i<mvpEdges.size(); i++)
+        {
+            mvpEdges[i]->releaseRobustKernel();
+            delete mvpEdges[i];
+            delete mvpKernels[i];
+        }
+    }
+
+    T* Get(const double delta)
+    {
+        if(mnUsed==mvpEdges.size())
+        {
+            mvpEdges.push_back(new T());
+            mvpKernels.push_back(new g2o::RobustKernelHuber());
+        }
+
+        T* e = mvpEdges[mnUsed];
+        g2o::RobustKernelHuber* rk = mvpKernels[mnUsed];
+        mnUsed++;
+
+        e->releaseRobustKernel();
+        e->setRobustKernel(rk);
+        rk->setDelta(delta);
+        e->setLevel(0);
+        return e;
+    }
+
+    void Reset()
+    {
+        mnUsed = 0;
+    }
+
+protected:
+    std::vector<T*> mvpEdges;
+    std::vector<g2o::RobustKernelHuber*> mvpKernels;
+    size_t mnUsed;
+};
+
+// Graph of the local bundle adjustment. The optimizer, solver, vertices and edges of the
+// previous call are reused. One per thread running local BA (Local Mapping).
+class LocalBAGraph
+{
+public:
+    LocalBAGraph()
+    {
+        g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
+
+        linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+
+        g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+
+        g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+        optimizer.setAlgorithm(solver);
+    }
+
+    ~LocalBAGraph()
+    {
+        optimizer.release();
+    }
+
+    // Removes the vertices and edges of the previous call from the optimizer
+    void Reset()
+    {
+        optimizer.release();
+        mPoses.Reset();
+        mPoints.Reset();
+        mEdgesMono.Reset();
+        mEdgesStereo.Reset();
+    }
+
+    g2o::VertexSE3Expmap* NewPose()
+    {
+        g2o::VertexSE3Expmap* v = mPoses.Get();
+        v->setFixed(false);
+        return v;
+    }
+
+    g2o::VertexSBAPointXYZ* NewPoint()
+    {
+        g2o::VertexSBAPointXYZ* v = mPoints.Get();
+        v->setFixed(false);
+        return v;
+    }
+
+    g2o::EdgeSE3ProjectXYZ* NewEdgeMono(const double thHuber)
+    {
+        return mEdgesMono.Get(thHuber);
+    }
+
+    g2o::EdgeStereoSE3ProjectXYZ* NewEdgeStereo(const double thHuber)
+    {
+        return mEdgesStereo.Get(thHuber);
+    }
+
+    g2o::SparseOptimizer optimizer;
+
+protected:
+    ElementPool<g2o::VertexSE3Expmap> mPoses;
+    ElementPool<g2o::VertexSBAPointXYZ> mPoints;
+    RobustEdgePool<g2o::EdgeSE3ProjectXYZ> mEdgesMono;
+    RobustEdgePool<g2o::EdgeStereoSE3ProjectXYZ> mEdgesStereo;
+};
+
+}
+
 
 void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
 {
@@ -49,6 +217,8 @@ void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopF
 void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
                                  int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
 {
+    ScopedTimer timer(Profiler::OPTIMIZER_GLOBAL_BA);
+
     vector<bool> vbNotIncludedMP;
     vbNotIncludedMP.resize(vpMP.size());
 
@@ -98,11 +268,11 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
         vPoint->setMarginalized(true);
         optimizer.addVertex(vPoint);
 
-       const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+       const MapPoint::ObservationsPtr observations = pMP->GetObservations();
 
         int nEdges = 0;
         //SET EDGES
-        for(map<KeyFrame*,size_t>::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
+        for(MapPointObservations::const_iterator mit=observations->begin(); mit!=observations->end(); mit++)
         {
 
             KeyFrame* pKF = mit->first;
@@ -238,42 +408,16 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
 
 int Optimizer::PoseOptimization(Frame *pFrame)
 {
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+    ScopedTimer timer(Profiler::OPTIMIZER_POSE);
 
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
+    // Reused by every frame tracked on this thread
+    static thread_local MotionOnlyBA motionBA;
+    motionBA.Clear(pFrame->fx,pFrame->fy,pFrame->cx,pFrame->cy,pFrame->mbf);
 
     int nInitialCorrespondences=0;
 
-    // Set Frame vertex
-    g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
-    vSE3->setEstimate(Converter::toSE3Quat(pFrame->mTcw));
-    vSE3->setId(0);
-    vSE3->setFixed(false);
-    optimizer.addVertex(vSE3);
-
-    // Set MapPoint vertices
     const int N = pFrame->N;
 
-    vector<g2o::EdgeSE3ProjectXYZOnlyPose*> vpEdgesMono;
-    vector<size_t> vnIndexEdgeMono;
-    vpEdgesMono.reserve(N);
-    vnIndexEdgeMono.reserve(N);
-
-    vector<g2o::EdgeStereoSE3ProjectXYZOnlyPose*> vpEdgesStereo;
-    vector<size_t> vnIndexEdgeStereo;
-    vpEdgesStereo.reserve(N);
-    vnIndexEdgeStereo.reserve(N);
-
-    const float deltaMono = sqrt(5.991);
-    const float deltaStereo = sqrt(7.815);
-
-
     {
     unique_lock<mutex> lock(MapPoint::mGlobalMutex);
 
@@ -282,79 +426,19 @@ int Optimizer::PoseOptimization(Frame *pFrame)
         MapPoint* pMP = pFrame->mvpMapPoints[i];
         if(pMP)
         {
-            // Monocular observation
-            if(pFrame->mvuRight[i]<0)
-            {
-                nInitialCorrespondences++;
-                pFrame->mvbOutlier[i] = false;
-
-                Eigen::Matrix<double,2,1> obs;
-                const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
-                obs << kpUn.pt.x, kpUn.pt.y;
+            nInitialCorrespondences++;
+            pFrame->mvbOutlier[i] = false;
 
-                g2o::EdgeSE3ProjectXYZOnlyPose* e = new g2o::EdgeSE3ProjectXYZOnlyPose();
+            const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
+            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+            float Xw[3];
+            pMP->GetWorldPos(Xw);
 
-                e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-                e->setMeasurement(obs);
-                const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
-
-                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                e->setRobustKernel(rk);
-                rk->setDelta(deltaMono);
-
-                e->fx = pFrame->fx;
-                e->fy = pFrame->fy;
-                e->cx = pFrame->cx;
-                e->cy = pFrame->cy;
-                cv::Mat Xw = pMP->GetWorldPos();
-                e->Xw[0] = Xw.at<float>(0);
-                e->Xw[1] = Xw.at<float>(1);
-                e->Xw[2] = Xw.at<float>(2);
-
-                optimizer.addEdge(e);
-
-                vpEdgesMono.push_back(e);
-                vnIndexEdgeMono.push_back(i);
-            }
+            // Monocular observation
+            if(pFrame->mvuRight[i]<0)
+                motionBA.AddMonocular(i,kpUn.pt.x,kpUn.pt.y,invSigma2,Xw);
             else  // Stereo observation
-            {
-                nInitialCorrespondences++;
-                pFrame->mvbOutlier[i] = false;
-
-                //SET EDGE
-                Eigen::Matrix<double,3,1> obs;
-                const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
-                const float &kp_ur = pFrame->mvuRight[i];
-                obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
-
-                g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
-
-                e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-                e->setMeasurement(obs);
-                const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
-                e->setInformation(Info);
-
-                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                e->setRobustKernel(rk);
-                rk->setDelta(deltaStereo);
-
-                e->fx = pFrame->fx;
-                e->fy = pFrame->fy;
-                e->cx = pFrame->cx;
-                e->cy = pFrame->cy;
-                e->bf = pFrame->mbf;
-                cv::Mat Xw = pMP->GetWorldPos();
-                e->Xw[0] = Xw.at<float>(0);
-                e->Xw[1] = Xw.at<float>(1);
-                e->Xw[2] = Xw.at<float>(2);
-
-                optimizer.addEdge(e);
-
-                vpEdgesStereo.push_back(e);
-                vnIndexEdgeStereo.push_back(i);
-            }
+                motionBA.AddStereo(i,kpUn.pt.x,kpUn.pt.y,pFrame->mvuRight[i],invSigma2,Xw);
         }
 
     }
@@ -370,81 +454,49 @@ int Optimizer::PoseOptimization(Frame *pFrame)
     const float chi2Stereo[4]={7.815,7.815,7.815, 7.815};
     const int its[4]={10,10,10,10};    
 
+    const MotionOnlyBA::eObservationType types[2]={MotionOnlyBA::MONOCULAR,MotionOnlyBA::STEREO};
+
     int nBad=0;
     for(size_t it=0; it<4; it++)
     {
 
-        vSE3->setEstimate(Converter::toSE3Quat(pFrame->mTcw));
-        optimizer.initializeOptimization(0);
-        optimizer.optimize(its[it]);
+        motionBA.SetEstimate(Converter::toSE3Quat(pFrame->mTcw));
+        motionBA.Optimize(its[it]);
 
         nBad=0;
-        for(size_t i=0, iend=vpEdgesMono.size(); i<iend; i++)
+        for(int t=0; t<2; t++)
         {
-            g2o::EdgeSE3ProjectXYZOnlyPose* e = vpEdgesMono[i];
+            const float chi2Th = types[t]==MotionOnlyBA::MONOCULAR ? chi2Mono[it] : chi2Stereo[it];
 
-            const size_t idx = vnIndexEdgeMono[i];
-
-            if(pFrame->mvbOutlier[idx])
+            for(size_t i=0, iend=motionBA.Size(types[t]); i<iend; i++)
             {
-                e->computeError();
-            }
+                const int idx = motionBA.Index(types[t],i);
 
-            const float chi2 = e->chi2();
+                const float chi2 = motionBA.Chi2(types[t],i);
 
-            if(chi2>chi2Mono[it])
-            {                
-                pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);
-                nBad++;
-            }
-            else
-            {
-                pFrame->mvbOutlier[idx]=false;
-                e->setLevel(0);
+                if(chi2>chi2Th)
+                {
+                    pFrame->mvbOutlier[idx]=true;
+                    motionBA.SetInlier(types[t],i,false);
+                    nBad++;
+                }
+                else
+                {
+                    pFrame->mvbOutlier[idx]=false;
+                    motionBA.SetInlier(types[t],i,true);
+                }
             }
-
-            if(it==2)
-                e->setRobustKernel(0);
         }
 
-        for(size_t i=0, iend=vpEdgesStereo.size(); i<iend; i++)
-        {
-            g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = vpEdgesStereo[i];
-
-            const size_t idx = vnIndexEdgeStereo[i];
+        if(it==2)
+            motionBA.SetRobust(false);
 
-            if(pFrame->mvbOutlier[idx])
-            {
-                e->computeError();
-            }
-
-            const float chi2 = e->chi2();
-
-            if(chi2>chi2Stereo[it])
-            {
-                pFrame->mvbOutlier[idx]=true;
-                e->setLevel(1);
-                nBad++;
-            }
-            else
-            {                
-                e->setLevel(0);
-                pFrame->mvbOutlier[idx]=false;
-            }
-
-            if(it==2)
-                e->setRobustKernel(0);
-        }
-
-        if(optimizer.edges().size()<10)
+        if(nInitialCorrespondences<10)
             break;
     }    
 
     // Recover optimized pose and return number of inliers
-    g2o::VertexSE3Expmap* vSE3_recov = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(0));
-    g2o::SE3Quat SE3quat_recov = vSE3_recov->estimate();
-    cv::Mat pose = Converter::toCvMat(SE3quat_recov);
+    cv::Mat pose = Converter::toCvMat(motionBA.GetEstimate());
     pFrame->SetPose(pose);
 
     return nInitialCorrespondences-nBad;
@@ -452,6 +504,8 @@ int Optimizer::PoseOptimization(Frame *pFrame)
 
 void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap)
 {    
+    ScopedTimer timer(Profiler::OPTIMIZER_LOCAL_BA);
+
     // Local KeyFrames: First Breath Search from Current Keyframe
     list<KeyFrame*> lLocalKeyFrames;
 
@@ -489,8 +543,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     list<KeyFrame*> lFixedCameras;
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
-        map<KeyFrame*,size_t> observations = (*lit)->GetObservations();
-        for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        MapPoint::ObservationsPtr observations = (*lit)->GetObservations();
+        for(MapPointObservations::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -503,19 +557,12 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
         }
     }
 
-    // Setup optimizer
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
+    // Setup optimizer. The graph of the previous call is reused
+    static thread_local LocalBAGraph graph;
+    graph.Reset();
+    g2o::SparseOptimizer &optimizer = graph.optimizer;
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
-
-    if(pbStopFlag)
-        optimizer.setForceStopFlag(pbStopFlag);
+    optimizer.setForceStopFlag(pbStopFlag);
 
     unsigned long maxKFid = 0;
 
@@ -523,7 +570,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<KeyFrame*>::iterator lit=lLocalKeyFrames.begin(), lend=lLocalKeyFrames.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap * vSE3 = graph.NewPose();
         vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
         vSE3->setId(pKFi->mnId);
         vSE3->setFixed(pKFi->mnId==0);
@@ -536,7 +583,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<KeyFrame*>::iterator lit=lFixedCameras.begin(), lend=lFixedCameras.end(); lit!=lend; lit++)
     {
         KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap * vSE3 = graph.NewPose();
         vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
         vSE3->setId(pKFi->mnId);
         vSE3->setFixed(true);
@@ -572,17 +619,17 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
         MapPoint* pMP = *lit;
-        g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+        g2o::VertexSBAPointXYZ* vPoint = graph.NewPoint();
         vPoint->setEstimate(Converter::toVector3d(pMP->GetWorldPos()));
         int id = pMP->mnId+maxKFid+1;
         vPoint->setId(id);
         vPoint->setMarginalized(true);
         optimizer.addVertex(vPoint);
 
-        const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+        const MapPoint::ObservationsPtr observations = pMP->GetObservations();
 
         //Set edges
-        for(map<KeyFrame*,size_t>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPointObservations::const_iterator mit=observations->begin(), mend=observations->end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -596,7 +643,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     Eigen::Matrix<double,2,1> obs;
                     obs << kpUn.pt.x, kpUn.pt.y;
 
-                    g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
+                    g2o::EdgeSE3ProjectXYZ* e = graph.NewEdgeMono(thHuberMono);
 
                     e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
                     e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
@@ -604,10 +651,6 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
                     e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberMono);
-
                     e->fx = pKFi->fx;
                     e->fy = pKFi->fy;
                     e->cx = pKFi->cx;
@@ -624,7 +667,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     const float kp_ur = pKFi->mvuRight[mit->second];
                     obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                    g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+                    g2o::EdgeStereoSE3ProjectXYZ* e = graph.NewEdgeStereo(thHuberStereo);
 
                     e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
                     e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
@@ -633,10 +676,6 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
                     Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
                     e->setInformation(Info);
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberStereo);
-
                     e->fx = pKFi->fx;
                     e->fy = pKFi->fy;
                     e->cx = pKFi->cx;
@@ -682,7 +721,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
             e->setLevel(1);
         }
 
-        e->setRobustKernel(0);
+        // The kernel is owned by the graph
+        e->releaseRobustKernel();
     }
 
     for(size_t i=0, iend=vpEdgesStereo.size(); i<iend;i++)
@@ -698,7 +738,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
             e->setLevel(1);
         }
 
-        e->setRobustKernel(0);
+        e->releaseRobustKernel();
     }
 
     // Optimize again without the outliers
@@ -783,11 +823,14 @@ void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* p
                                        const LoopClosing::KeyFrameAndPose &CorrectedSim3,
                                        const map<KeyFrame *, set<KeyFrame *> > &LoopConnections, const bool &bFixScale)
 {
+    ScopedTimer timer(Profiler::OPTIMIZER_ESSENTIAL_GRAPH);
+
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
+    // Parallel block Cholesky, the graph has one 7x7 block per keyframe
     g2o::BlockSolver_7_3::LinearSolverType * linearSolver =
-           new g2o::LinearSolverEigen<g2o::BlockSolver_7_3::PoseMatrixType>();
+           new g2o::LinearSolverBlockCholesky<g2o::BlockSolver_7_3::PoseMatrixType>();
     g2o::BlockSolver_7_3 * solver_ptr= new g2o::BlockSolver_7_3(linearSolver);
     g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
 
@@ -1045,6 +1088,8 @@ void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* p
 
 int Optimizer::OptimizeSim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &vpMatches1, g2o::Sim3 &g2oS12, const float th2, const bool bFixScale, const bool bUseMnID)
 {
+    ScopedTimer timer(Profiler::OPTIMIZER_SIM3);
+
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolverX::LinearSolverType * linearSolver;
 
@@ -1253,6 +1298,8 @@ int Optimizer::OptimizeSim3InterRobot(const vector<cv::Mat>& mapPoints,
                                                                cv::Mat pose, cv::Mat K1,
                                       KeyFrame *pKF2, vector<MapPoint *> &vpMatches1, g2o::Sim3 &g2oS12, const float th2, const bool bFixScale)
 {
+    ScopedTimer timer(Profiler::OPTIMIZER_SIM3);
+
     g2o::SparseOptimizer optimizer;
     g2o::BlockSolverX::LinearSolverType * linearSolver;
 
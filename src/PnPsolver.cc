@@ -55,6 +55,7 @@
 #include <vector>
 #include <cmath>
 #include <opencv2/core/core.hpp>
+#include <Eigen/Dense>
 #include "Thirdparty/DBoW2/DUtils/Random.h"
 #include <algorithm>
 
@@ -65,13 +66,15 @@ namespace ORB_SLAM2
 
 
 PnPsolver::PnPsolver(const Frame &F, const vector<MapPoint*> &vpMapPointMatches):
-    pws(0), us(0), alphas(0), pcs(0), maximum_number_of_correspondences(0), number_of_correspondences(0), mnInliersi(0),
-    mnIterations(0), mnBestInliers(0), N(0)
+    pws(0), us(0), alphas(0), pcs(0), maximum_number_of_correspondences(0), number_of_correspondences(0),
+    mnMatches(vpMapPointMatches.size()), mnInliersi(0), mnIterations(0), mnBestInliers(0), N(0)
 {
-    mvpMapPointMatches = vpMapPointMatches;
-    mvP2D.reserve(F.mvpMapPoints.size());
+    mvU.reserve(F.mvpMapPoints.size());
+    mvV.reserve(F.mvpMapPoints.size());
     mvSigma2.reserve(F.mvpMapPoints.size());
-    mvP3Dw.reserve(F.mvpMapPoints.size());
+    mvX.reserve(F.mvpMapPoints.size());
+    mvY.reserve(F.mvpMapPoints.size());
+    mvZ.reserve(F.mvpMapPoints.size());
     mvKeyPointIndices.reserve(F.mvpMapPoints.size());
     mvAllIndices.reserve(F.mvpMapPoints.size());
 
@@ -86,11 +89,14 @@ PnPsolver::PnPsolver(const Frame &F, const vector<MapPoint*> &vpMapPointMatches)
             {
                 const cv::KeyPoint &kp = F.mvKeysUn[i];
 
-                mvP2D.push_back(kp.pt);
+                mvU.push_back(kp.pt.x);
+                mvV.push_back(kp.pt.y);
                 mvSigma2.push_back(F.mvLevelSigma2[kp.octave]);
 
                 cv::Mat Pos = pMP->GetWorldPos();
-                mvP3Dw.push_back(cv::Point3f(Pos.at<float>(0),Pos.at<float>(1), Pos.at<float>(2)));
+                mvX.push_back(Pos.at<float>(0));
+                mvY.push_back(Pos.at<float>(1));
+                mvZ.push_back(Pos.at<float>(2));
 
                 mvKeyPointIndices.push_back(i);
                 mvAllIndices.push_back(idx);               
@@ -109,6 +115,39 @@ PnPsolver::PnPsolver(const Frame &F, const vector<MapPoint*> &vpMapPointMatches)
     SetRansacParameters();
 }
 
+PnPsolver::PnPsolver(const vector<cv::Point3f> &vP3Dw, const vector<cv::Point2f> &vP2D, const vector<float> &vSigma2,
+                     const float fx, const float fy, const float cx, const float cy):
+    pws(0), us(0), alphas(0), pcs(0), maximum_number_of_correspondences(0), number_of_correspondences(0),
+    mnMatches(vP3Dw.size()), mvSigma2(vSigma2), mnInliersi(0), mnIterations(0), mnBestInliers(0), N(0)
+{
+    const size_t n = vP3Dw.size();
+    mvU.resize(n);
+    mvV.resize(n);
+    mvX.resize(n);
+    mvY.resize(n);
+    mvZ.resize(n);
+    mvKeyPointIndices.resize(n);
+    mvAllIndices.resize(n);
+
+    for(size_t i=0; i<n; i++)
+    {
+        mvU[i] = vP2D[i].x;
+        mvV[i] = vP2D[i].y;
+        mvX[i] = vP3Dw[i].x;
+        mvY[i] = vP3Dw[i].y;
+        mvZ[i] = vP3Dw[i].z;
+        mvKeyPointIndices[i] = i;
+        mvAllIndices[i] = i;
+    }
+
+    fu = fx;
+    fv = fy;
+    uc = cx;
+    vc = cy;
+
+    SetRansacParameters();
+}
+
 PnPsolver::~PnPsolver()
 {
   delete [] pws;
@@ -126,9 +165,10 @@ void PnPsolver::SetRansacParameters(double probability, int minInliers, int maxI
     mRansacEpsilon = epsilon;
     mRansacMinSet = minSet;
 
-    N = mvP2D.size(); // number of correspondences
+    N = mvU.size(); // number of correspondences
 
     mvbInliersi.resize(N);
+    mvError2.resize(N);
 
     // Adjust Parameters according to number of correspondences
     int nMinInliers = N*mRansacEpsilon;
@@ -176,8 +216,6 @@ cv::Mat PnPsolver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInlie
         return cv::Mat();
     }
 
-    vector<size_t> vAvailableIndices;
-
     int nCurrentIterations = 0;
     while(mnIterations<mRansacMaxIts || nCurrentIterations<nIterations)
     {
@@ -185,19 +223,20 @@ cv::Mat PnPsolver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInlie
         mnIterations++;
         reset_correspondences();
 
-        vAvailableIndices = mvAllIndices;
+        // Same sampling sequence as before, but the buffer keeps its capacity between hypotheses
+        mvAvailableIndices.assign(mvAllIndices.begin(),mvAllIndices.end());
 
         // Get min set of points
         for(short i = 0; i < mRansacMinSet; ++i)
         {
-            int randi = DUtils::Random::RandomInt(0, vAvailableIndices.size()-1);
+            int randi = DUtils::Random::RandomInt(0, mvAvailableIndices.size()-1);
 
-            int idx = vAvailableIndices[randi];
+            int idx = mvAvailableIndices[randi];
 
-            add_correspondence(mvP3Dw[idx].x,mvP3Dw[idx].y,mvP3Dw[idx].z,mvP2D[idx].x,mvP2D[idx].y);
+            add_correspondence(mvX[idx],mvY[idx],mvZ[idx],mvU[idx],mvV[idx]);
 
-            vAvailableIndices[randi] = vAvailableIndices.back();
-            vAvailableIndices.pop_back();
+            mvAvailableIndices[randi] = mvAvailableIndices.back();
+            mvAvailableIndices.pop_back();
         }
 
         // Compute camera pose
@@ -226,7 +265,7 @@ cv::Mat PnPsolver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInlie
             if(Refine())
             {
                 nInliers = mnRefinedInliers;
-                vbInliers = vector<bool>(mvpMapPointMatches.size(),false);
+                vbInliers.assign(mnMatches,false);
                 for(int i=0; i<N; i++)
                 {
                     if(mvbRefinedInliers[i])
@@ -244,7 +283,7 @@ cv::Mat PnPsolver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInlie
         if(mnBestInliers>=mRansacMinInliers)
         {
             nInliers=mnBestInliers;
-            vbInliers = vector<bool>(mvpMapPointMatches.size(),false);
+            vbInliers.assign(mnMatches,false);
             for(int i=0; i<N; i++)
             {
                 if(mvbBestInliers[i])
@@ -259,25 +298,24 @@ cv::Mat PnPsolver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInlie
 
 bool PnPsolver::Refine()
 {
-    vector<int> vIndices;
-    vIndices.reserve(mvbBestInliers.size());
+    mvRefineIndices.clear();
 
     for(size_t i=0; i<mvbBestInliers.size(); i++)
     {
         if(mvbBestInliers[i])
         {
-            vIndices.push_back(i);
+            mvRefineIndices.push_back(i);
         }
     }
 
-    set_maximum_number_of_correspondences(vIndices.size());
+    set_maximum_number_of_correspondences(mvRefineIndices.size());
 
     reset_correspondences();
 
-    for(size_t i=0; i<vIndices.size(); i++)
+    for(size_t i=0; i<mvRefineIndices.size(); i++)
     {
-        int idx = vIndices[i];
-        add_correspondence(mvP3Dw[idx].x,mvP3Dw[idx].y,mvP3Dw[idx].z,mvP2D[idx].x,mvP2D[idx].y);
+        int idx = mvRefineIndices[i];
+        add_correspondence(mvX[idx],mvY[idx],mvZ[idx],mvU[idx],mvV[idx]);
     }
 
     // Compute camera pose
@@ -309,32 +347,41 @@ void PnPsolver::CheckInliers()
 {
     mnInliersi=0;
 
+    // Reprojection errors over the coordinate arrays. The loop has no branches nor
+    // aliasing so that it is vectorized, and keeps the precision of each operation
+    const double r00 = mRi[0][0], r01 = mRi[0][1], r02 = mRi[0][2];
+    const double r10 = mRi[1][0], r11 = mRi[1][1], r12 = mRi[1][2];
+    const double r20 = mRi[2][0], r21 = mRi[2][1], r22 = mRi[2][2];
+    const double t0 = mti[0], t1 = mti[1], t2 = mti[2];
+    const double fx = fu, fy = fv, cx = uc, cy = vc;
+
+    const float * __restrict pX = &mvX[0];
+    const float * __restrict pY = &mvY[0];
+    const float * __restrict pZ = &mvZ[0];
+    const float * __restrict pU = &mvU[0];
+    const float * __restrict pV = &mvV[0];
+    float * __restrict pError2 = &mvError2[0];
+
     for(int i=0; i<N; i++)
     {
-        cv::Point3f P3Dw = mvP3Dw[i];
-        cv::Point2f P2D = mvP2D[i];
+        const float Xc = r00*pX[i]+r01*pY[i]+r02*pZ[i]+t0;
+        const float Yc = r10*pX[i]+r11*pY[i]+r12*pZ[i]+t1;
+        const float invZc = 1/(r20*pX[i]+r21*pY[i]+r22*pZ[i]+t2);
 
-        float Xc = mRi[0][0]*P3Dw.x+mRi[0][1]*P3Dw.y+mRi[0][2]*P3Dw.z+mti[0];
-        float Yc = mRi[1][0]*P3Dw.x+mRi[1][1]*P3Dw.y+mRi[1][2]*P3Dw.z+mti[1];
-        float invZc = 1/(mRi[2][0]*P3Dw.x+mRi[2][1]*P3Dw.y+mRi[2][2]*P3Dw.z+mti[2]);
+        const double ue = cx + fx * Xc * invZc;
+        const double ve = cy + fy * Yc * invZc;
 
-        double ue = uc + fu * Xc * invZc;
-        double ve = vc + fv * Yc * invZc;
+        const float distX = pU[i]-ue;
+        const float distY = pV[i]-ve;
 
-        float distX = P2D.x-ue;
-        float distY = P2D.y-ve;
-
-        float error2 = distX*distX+distY*distY;
+        pError2[i] = distX*distX+distY*distY;
+    }
 
-        if(error2<mvMaxError[i])
-        {
-            mvbInliersi[i]=true;
-            mnInliersi++;
-        }
-        else
-        {
-            mvbInliersi[i]=false;
-        }
+    for(int i=0; i<N; i++)
+    {
+        const bool bInlier = pError2[i]<mvMaxError[i];
+        mvbInliersi[i] = bInlier;
+        mnInliersi += bInlier;
     }
 }
 
@@ -385,41 +432,36 @@ void PnPsolver::choose_control_points(void)
 
 
   // Take C1, C2, and C3 from PCA on the reference points:
-  CvMat * PW0 = cvCreateMat(number_of_correspondences, 3, CV_64F);
-
-  double pw0tpw0[3 * 3], dc[3], uct[3 * 3];
-  CvMat PW0tPW0 = cvMat(3, 3, CV_64F, pw0tpw0);
-  CvMat DC      = cvMat(3, 1, CV_64F, dc);
-  CvMat UCt     = cvMat(3, 3, CV_64F, uct);
+  Eigen::Matrix3d PW0tPW0 = Eigen::Matrix3d::Zero();
 
-  for(int i = 0; i < number_of_correspondences; i++)
-    for(int j = 0; j < 3; j++)
-      PW0->data.db[3 * i + j] = pws[3 * i + j] - cws[0][j];
-
-  cvMulTransposed(PW0, &PW0tPW0, 1);
-  cvSVD(&PW0tPW0, &DC, &UCt, 0, CV_SVD_MODIFY_A | CV_SVD_U_T);
+  for(int i = 0; i < number_of_correspondences; i++) {
+    const Eigen::Vector3d pw0(pws[3 * i] - cws[0][0], pws[3 * i + 1] - cws[0][1], pws[3 * i + 2] - cws[0][2]);
+    PW0tPW0.noalias() += pw0 * pw0.transpose();
+  }
 
-  cvReleaseMat(&PW0);
+  // Symmetric PSD: eigenvalues are the singular values, in increasing order
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(PW0tPW0);
+  const Eigen::Vector3d & dc = eig.eigenvalues();
+  const Eigen::Matrix3d & UC = eig.eigenvectors();
 
   for(int i = 1; i < 4; i++) {
-    double k = sqrt(dc[i - 1] / number_of_correspondences);
+    double k = sqrt(max(dc(3 - i), 0.0) / number_of_correspondences);
     for(int j = 0; j < 3; j++)
-      cws[i][j] = cws[0][j] + k * uct[3 * (i - 1) + j];
+      cws[i][j] = cws[0][j] + k * UC(j, 3 - i);
   }
 }
 
 void PnPsolver::compute_barycentric_coordinates(void)
 {
-  double cc[3 * 3], cc_inv[3 * 3];
-  CvMat CC     = cvMat(3, 3, CV_64F, cc);
-  CvMat CC_inv = cvMat(3, 3, CV_64F, cc_inv);
+  Eigen::Matrix<double,3,3,Eigen::RowMajor> CC, CC_inv;
 
   for(int i = 0; i < 3; i++)
     for(int j = 1; j < 4; j++)
-      cc[3 * i + j - 1] = cws[j][i] - cws[0][i];
+      CC(i, j - 1) = cws[j][i] - cws[0][i];
 
-  cvInvert(&CC, &CC_inv, CV_SVD);
-  double * ci = cc_inv;
+  // Pseudo-inverse through the SVD, as the control points are degenerate for planar sets
+  CC_inv = Eigen::JacobiSVD<Eigen::Matrix3d>(CC, Eigen::ComputeFullU | Eigen::ComputeFullV).solve(Eigen::Matrix3d::Identity());
+  const double * ci = CC_inv.data();
   for(int i = 0; i < number_of_correspondences; i++) {
     double * pi = pws + 3 * i;
     double * a = alphas + 4 * i;
@@ -433,11 +475,11 @@ void PnPsolver::compute_barycentric_coordinates(void)
   }
 }
 
-void PnPsolver::fill_M(CvMat * M,
-		  const int row, const double * as, const double u, const double v)
+void PnPsolver::fill_M(Matrix12d & MtM,
+		  const double * as, const double u, const double v)
 {
-  double * M1 = M->data.db + row * 12;
-  double * M2 = M1 + 12;
+  // The two rows of M for this correspondence are accumulated into M^T M directly
+  Eigen::Matrix<double,12,1> M1, M2;
 
   for(int i = 0; i < 4; i++) {
     M1[3 * i    ] = as[i] * fu;
@@ -448,6 +490,9 @@ void PnPsolver::fill_M(CvMat * M,
     M2[3 * i + 1] = as[i] * fv;
     M2[3 * i + 2] = as[i] * (vc - v);
   }
+
+  MtM.noalias() += M1 * M1.transpose();
+  MtM.noalias() += M2 * M2.transpose();
 }
 
 void PnPsolver::compute_ccs(const double * betas, const double * ut)
@@ -479,40 +524,36 @@ double PnPsolver::compute_pose(double R[3][3], double t[3])
   choose_control_points();
   compute_barycentric_coordinates();
 
-  CvMat * M = cvCreateMat(2 * number_of_correspondences, 12, CV_64F);
+  Matrix12d MtM = Matrix12d::Zero();
 
   for(int i = 0; i < number_of_correspondences; i++)
-    fill_M(M, 2 * i, alphas + 4 * i, us[2 * i], us[2 * i + 1]);
-
-  double mtm[12 * 12], d[12], ut[12 * 12];
-  CvMat MtM = cvMat(12, 12, CV_64F, mtm);
-  CvMat D   = cvMat(12,  1, CV_64F, d);
-  CvMat Ut  = cvMat(12, 12, CV_64F, ut);
+    fill_M(MtM, alphas + 4 * i, us[2 * i], us[2 * i + 1]);
 
-  cvMulTransposed(M, &MtM, 1);
-  cvSVD(&MtM, &D, &Ut, 0, CV_SVD_MODIFY_A | CV_SVD_U_T);
-  cvReleaseMat(&M);
+  // Rows of ut are the singular vectors of M^T M in decreasing order of singular value,
+  // the eigen solver returns them as columns in increasing order
+  Eigen::SelfAdjointEigenSolver<Matrix12d> eig(MtM);
+  Matrix12d Ut = eig.eigenvectors().transpose().colwise().reverse();
+  const double * ut = Ut.data();
 
-  double l_6x10[6 * 10], rho[6];
-  CvMat L_6x10 = cvMat(6, 10, CV_64F, l_6x10);
-  CvMat Rho    = cvMat(6,  1, CV_64F, rho);
+  Matrix6x10d L_6x10;
+  Vector6d Rho;
 
-  compute_L_6x10(ut, l_6x10);
-  compute_rho(rho);
+  compute_L_6x10(ut, L_6x10.data());
+  compute_rho(Rho.data());
 
   double Betas[4][4], rep_errors[4];
   double Rs[4][3][3], ts[4][3];
 
-  find_betas_approx_1(&L_6x10, &Rho, Betas[1]);
-  gauss_newton(&L_6x10, &Rho, Betas[1]);
+  find_betas_approx_1(L_6x10, Rho, Betas[1]);
+  gauss_newton(L_6x10, Rho, Betas[1]);
   rep_errors[1] = compute_R_and_t(ut, Betas[1], Rs[1], ts[1]);
 
-  find_betas_approx_2(&L_6x10, &Rho, Betas[2]);
-  gauss_newton(&L_6x10, &Rho, Betas[2]);
+  find_betas_approx_2(L_6x10, Rho, Betas[2]);
+  gauss_newton(L_6x10, Rho, Betas[2]);
   rep_errors[2] = compute_R_and_t(ut, Betas[2], Rs[2], ts[2]);
 
-  find_betas_approx_3(&L_6x10, &Rho, Betas[3]);
-  gauss_newton(&L_6x10, &Rho, Betas[3]);
+  find_betas_approx_3(L_6x10, Rho, Betas[3]);
+  gauss_newton(L_6x10, Rho, Betas[3]);
   rep_errors[3] = compute_R_and_t(ut, Betas[3], Rs[3], ts[3]);
 
   int N = 1;
@@ -587,13 +628,9 @@ void PnPsolver::estimate_R_and_t(double R[3][3], double t[3])
     pw0[j] /= number_of_correspondences;
   }
 
-  double abt[3 * 3], abt_d[3], abt_u[3 * 3], abt_v[3 * 3];
-  CvMat ABt   = cvMat(3, 3, CV_64F, abt);
-  CvMat ABt_D = cvMat(3, 1, CV_64F, abt_d);
-  CvMat ABt_U = cvMat(3, 3, CV_64F, abt_u);
-  CvMat ABt_V = cvMat(3, 3, CV_64F, abt_v);
+  Eigen::Matrix<double,3,3,Eigen::RowMajor> ABt = Eigen::Matrix3d::Zero();
+  double * abt = ABt.data();
 
-  cvSetZero(&ABt);
   for(int i = 0; i < number_of_correspondences; i++) {
     double * pc = pcs + 3 * i;
     double * pw = pws + 3 * i;
@@ -605,11 +642,12 @@ void PnPsolver::estimate_R_and_t(double R[3][3], double t[3])
     }
   }
 
-  cvSVD(&ABt, &ABt_D, &ABt_U, &ABt_V, CV_SVD_MODIFY_A);
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(ABt, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  const Eigen::Matrix3d Rm = svd.matrixU() * svd.matrixV().transpose();
 
   for(int i = 0; i < 3; i++)
     for(int j = 0; j < 3; j++)
-      R[i][j] = dot(abt_u + 3 * i, abt_v + 3 * j);
+      R[i][j] = Rm(i, j);
 
   const double det =
     R[0][0] * R[1][1] * R[2][2] + R[0][1] * R[1][2] * R[2][0] + R[0][2] * R[1][0] * R[2][1] -
@@ -664,21 +702,17 @@ double PnPsolver::compute_R_and_t(const double * ut, const double * betas,
 // betas10        = [B11 B12 B22 B13 B23 B33 B14 B24 B34 B44]
 // betas_approx_1 = [B11 B12     B13         B14]
 
-void PnPsolver::find_betas_approx_1(const CvMat * L_6x10, const CvMat * Rho,
+void PnPsolver::find_betas_approx_1(const Matrix6x10d & L_6x10, const Vector6d & Rho,
 			       double * betas)
 {
-  double l_6x4[6 * 4], b4[4];
-  CvMat L_6x4 = cvMat(6, 4, CV_64F, l_6x4);
-  CvMat B4    = cvMat(4, 1, CV_64F, b4);
+  Eigen::Matrix<double,6,4> L_6x4;
 
-  for(int i = 0; i < 6; i++) {
-    cvmSet(&L_6x4, i, 0, cvmGet(L_6x10, i, 0));
-    cvmSet(&L_6x4, i, 1, cvmGet(L_6x10, i, 1));
-    cvmSet(&L_6x4, i, 2, cvmGet(L_6x10, i, 3));
-    cvmSet(&L_6x4, i, 3, cvmGet(L_6x10, i, 6));
-  }
+  L_6x4.col(0) = L_6x10.col(0);
+  L_6x4.col(1) = L_6x10.col(1);
+  L_6x4.col(2) = L_6x10.col(3);
+  L_6x4.col(3) = L_6x10.col(6);
 
-  cvSolve(&L_6x4, Rho, &B4, CV_SVD);
+  const Vector4d b4 = L_6x4.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV).solve(Rho);
 
   if (b4[0] < 0) {
     betas[0] = sqrt(-b4[0]);
@@ -696,20 +730,12 @@ void PnPsolver::find_betas_approx_1(const CvMat * L_6x10, const CvMat * Rho,
 // betas10        = [B11 B12 B22 B13 B23 B33 B14 B24 B34 B44]
 // betas_approx_2 = [B11 B12 B22                            ]
 
-void PnPsolver::find_betas_approx_2(const CvMat * L_6x10, const CvMat * Rho,
+void PnPsolver::find_betas_approx_2(const Matrix6x10d & L_6x10, const Vector6d & Rho,
 			       double * betas)
 {
-  double l_6x3[6 * 3], b3[3];
-  CvMat L_6x3  = cvMat(6, 3, CV_64F, l_6x3);
-  CvMat B3     = cvMat(3, 1, CV_64F, b3);
+  const Eigen::Matrix<double,6,3> L_6x3 = L_6x10.leftCols<3>();
 
-  for(int i = 0; i < 6; i++) {
-    cvmSet(&L_6x3, i, 0, cvmGet(L_6x10, i, 0));
-    cvmSet(&L_6x3, i, 1, cvmGet(L_6x10, i, 1));
-    cvmSet(&L_6x3, i, 2, cvmGet(L_6x10, i, 2));
-  }
-
-  cvSolve(&L_6x3, Rho, &B3, CV_SVD);
+  const Eigen::Vector3d b3 = L_6x3.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV).solve(Rho);
 
   if (b3[0] < 0) {
     betas[0] = sqrt(-b3[0]);
@@ -728,22 +754,12 @@ void PnPsolver::find_betas_approx_2(const CvMat * L_6x10, const CvMat * Rho,
 // betas10        = [B11 B12 B22 B13 B23 B33 B14 B24 B34 B44]
 // betas_approx_3 = [B11 B12 B22 B13 B23                    ]
 
-void PnPsolver::find_betas_approx_3(const CvMat * L_6x10, const CvMat * Rho,
+void PnPsolver::find_betas_approx_3(const Matrix6x10d & L_6x10, const Vector6d & Rho,
 			       double * betas)
 {
-  double l_6x5[6 * 5], b5[5];
-  CvMat L_6x5 = cvMat(6, 5, CV_64F, l_6x5);
-  CvMat B5    = cvMat(5, 1, CV_64F, b5);
+  const Eigen::Matrix<double,6,5> L_6x5 = L_6x10.leftCols<5>();
 
-  for(int i = 0; i < 6; i++) {
-    cvmSet(&L_6x5, i, 0, cvmGet(L_6x10, i, 0));
-    cvmSet(&L_6x5, i, 1, cvmGet(L_6x10, i, 1));
-    cvmSet(&L_6x5, i, 2, cvmGet(L_6x10, i, 2));
-    cvmSet(&L_6x5, i, 3, cvmGet(L_6x10, i, 3));
-    cvmSet(&L_6x5, i, 4, cvmGet(L_6x10, i, 4));
-  }
-
-  cvSolve(&L_6x5, Rho, &B5, CV_SVD);
+  const Eigen::Matrix<double,5,1> b5 = L_6x5.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV).solve(Rho);
 
   if (b5[0] < 0) {
     betas[0] = sqrt(-b5[0]);
@@ -810,18 +826,18 @@ void PnPsolver::compute_rho(double * rho)
 }
 
 void PnPsolver::compute_A_and_b_gauss_newton(const double * l_6x10, const double * rho,
-					double betas[4], CvMat * A, CvMat * b)
+					double betas[4], Matrix6x4d & A, Vector6d & b)
 {
   for(int i = 0; i < 6; i++) {
     const double * rowL = l_6x10 + i * 10;
-    double * rowA = A->data.db + i * 4;
+    double * rowA = A.data() + i * 4;
 
     rowA[0] = 2 * rowL[0] * betas[0] +     rowL[1] * betas[1] +     rowL[3] * betas[2] +     rowL[6] * betas[3];
     rowA[1] =     rowL[1] * betas[0] + 2 * rowL[2] * betas[1] +     rowL[4] * betas[2] +     rowL[7] * betas[3];
     rowA[2] =     rowL[3] * betas[0] +     rowL[4] * betas[1] + 2 * rowL[5] * betas[2] +     rowL[8] * betas[3];
     rowA[3] =     rowL[6] * betas[0] +     rowL[7] * betas[1] +     rowL[8] * betas[2] + 2 * rowL[9] * betas[3];
 
-    cvmSet(b, i, 0, rho[i] -
+    b(i) = rho[i] -
 	   (
 	    rowL[0] * betas[0] * betas[0] +
 	    rowL[1] * betas[0] * betas[1] +
@@ -833,49 +849,39 @@ void PnPsolver::compute_A_and_b_gauss_newton(const double * l_6x10, const double
 	    rowL[7] * betas[1] * betas[3] +
 	    rowL[8] * betas[2] * betas[3] +
 	    rowL[9] * betas[3] * betas[3]
-	    ));
+	    );
   }
 }
 
-void PnPsolver::gauss_newton(const CvMat * L_6x10, const CvMat * Rho,
+void PnPsolver::gauss_newton(const Matrix6x10d & L_6x10, const Vector6d & Rho,
 			double betas[4])
 {
   const int iterations_number = 5;
 
-  double a[6*4], b[6], x[4];
-  CvMat A = cvMat(6, 4, CV_64F, a);
-  CvMat B = cvMat(6, 1, CV_64F, b);
-  CvMat X = cvMat(4, 1, CV_64F, x);
+  Matrix6x4d A;
+  Vector6d B;
+  Vector4d X;
 
   for(int k = 0; k < iterations_number; k++) {
-    compute_A_and_b_gauss_newton(L_6x10->data.db, Rho->data.db,
-				 betas, &A, &B);
-    qr_solve(&A, &B, &X);
+    compute_A_and_b_gauss_newton(L_6x10.data(), Rho.data(),
+				 betas, A, B);
+    qr_solve(A, B, X);
 
     for(int i = 0; i < 4; i++)
-      betas[i] += x[i];
+      betas[i] += X[i];
   }
 }
 
-void PnPsolver::qr_solve(CvMat * A, CvMat * b, CvMat * X)
+void PnPsolver::qr_solve(Matrix6x4d & A, Vector6d & b, Vector4d & X)
 {
-  static int max_nr = 0;
-  static double * A1, * A2;
-
-  const int nr = A->rows;
-  const int nc = A->cols;
+  // Householder workspace on the stack: the former static buffers were shared
+  // by all solvers, which now run concurrently during relocalization
+  const int nr = Matrix6x4d::RowsAtCompileTime;
+  const int nc = Matrix6x4d::ColsAtCompileTime;
 
-  if (max_nr != 0 && max_nr < nr) {
-    delete [] A1;
-    delete [] A2;
-  }
-  if (max_nr < nr) {
-    max_nr = nr;
-    A1 = new double[nr];
-    A2 = new double[nr];
-  }
+  double A1[nc], A2[nc];
 
-  double * pA = A->data.db, * ppAkk = pA;
+  double * pA = A.data(), * ppAkk = pA;
   for(int k = 0; k < nc; k++) {
     double * ppAik = ppAkk, eta = fabs(*ppAik);
     for(int i = k + 1; i < nr; i++) {
@@ -886,6 +892,7 @@ void PnPsolver::qr_solve(CvMat * A, CvMat * b, CvMat * X)
 
     if (eta == 0) {
       A1[k] = A2[k] = 0.0;
+      X.setZero();
       cerr << "God damnit, A is singular, this shouldn't happen." << endl;
       return;
     } else {
@@ -919,7 +926,7 @@ void PnPsolver::qr_solve(CvMat * A, CvMat * b, CvMat * X)
   }
 
   // b <- Qt b
-  double * ppAjj = pA, * pb = b->data.db;
+  double * ppAjj = pA, * pb = b.data();
   for(int j = 0; j < nc; j++) {
     double * ppAij = ppAjj, tau = 0;
     for(int i = j; i < nr; i++)	{
@@ -936,7 +943,7 @@ void PnPsolver::qr_solve(CvMat * A, CvMat * b, CvMat * X)
   }
 
   // X = R-1 b
-  double * pX = X->data.db;
+  double * pX = X.data();
   pX[nc - 1] = pb[nc - 1] / A2[nc - 1];
   for(int i = nc - 2; i >= 0; i--) {
     double * ppAij = pA + i * nc + (i + 1), sum = 0;
@@ -0,0 +1,422 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Profiler.h"
+
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// Log-linear buckets over nanoseconds: exact below 8 ns, then 8 buckets per power of two
+// (12.5% resolution) up to 2^40 ns (~18 min)
+const int BUCKET_SUBBITS = 3;
+const int MAX_EXPONENT = 40;
+const int N_BUCKETS = (MAX_EXPONENT-BUCKET_SUBBITS+1)<<BUCKET_SUBBITS;
+
+inline int BucketIndex(unsigned long long ns)
+{
+    if(ns < (1ull<<BUCKET_SUBBITS))
+        return ns;
+    const int e = 63-__builtin_clzll(ns);
+    if(e>=MAX_EXPONENT)
+        return N_BUCKETS-1;
+    const int sub = (ns>>(e-BUCKET_SUBBITS)) & ((1<<BUCKET_SUBBITS)-1);
+    return ((e-BUCKET_SUBBITS+1)<<BUCKET_SUBBITS) + sub;
+}
+
+// Middle of the bucket, in nanoseconds
+inline double BucketValue(int idx)
+{
+    if(idx < (1<<BUCKET_SUBBITS))
+        return idx;
+    const int e = (idx>>BUCKET_SUBBITS)+BUCKET_SUBBITS-1;
+    const int sub = idx & ((1<<BUCKET_SUBBITS)-1);
+    const double width = std::ldexp(1.0,e-BUCKET_SUBBITS);
+    return ((1<<BUCKET_SUBBITS)+sub+0.5)*width;
+}
+
+// Written only by its thread, read by any thread
+struct ThreadProfile
+{
+    ThreadProfile(): bNamed(false), bFinished(false)
+    {
+        for(int s=0; s<Profiler::N_STAGES; s++)
+        {
+            for(int b=0; b<N_BUCKETS; b++)
+                vHistograms[s][b].store(0,std::memory_order_relaxed);
+            vnTotal[s].store(0,std::memory_order_relaxed);
+            vnMax[s].store(0,std::memory_order_relaxed);
+        }
+        for(int c=0; c<Profiler::N_COUNTERS; c++)
+            vCounters[c].store(0,std::memory_order_relaxed);
+    }
+
+    std::string name;
+    // Set by SetThreadName
+    bool bNamed;
+    // Holds the samples of the finished threads with this name
+    bool bFinished;
+    std::atomic<unsigned long long> vHistograms[Profiler::N_STAGES][N_BUCKETS];
+    std::atomic<unsigned long long> vnTotal[Profiler::N_STAGES];
+    std::atomic<unsigned long long> vnMax[Profiler::N_STAGES];
+    std::atomic<unsigned long long> vCounters[Profiler::N_COUNTERS];
+};
+
+std::atomic<bool> gbEnabled(true);
+
+inline void Add(std::atomic<unsigned long long> &a, unsigned long long n)
+{
+    a.store(a.load(std::memory_order_relaxed)+n,std::memory_order_relaxed);
+}
+
+// Profiles of the running threads, and one profile per name for the finished threads
+std::mutex gMutexProfiles;
+std::vector<ThreadProfile*> gvpProfiles;
+unsigned long gnThreads = 0;
+
+// Call with gMutexProfiles locked. Merges the profile of a finished thread into the one of the
+// finished threads with the same name and frees it, so that threads started repeatedly
+// (e.g. global BA) do not keep one profile each.
+void RetireProfile(ThreadProfile* pProfile)
+{
+    gvpProfiles.erase(std::find(gvpProfiles.begin(),gvpProfiles.end(),pProfile));
+    if(!pProfile->bNamed)
+        pProfile->name = "finished threads";
+
+    for(size_t i=0; i<gvpProfiles.size(); i++)
+    {
+        ThreadProfile* pFinished = gvpProfiles[i];
+        if(!pFinished->bFinished || pFinished->name!=pProfile->name)
+            continue;
+
+        for(int s=0; s<Profiler::N_STAGES; s++)
+        {
+            for(int b=0; b<N_BUCKETS; b++)
+                Add(pFinished->vHistograms[s][b],pProfile->vHistograms[s][b].load(std::memory_order_relaxed));
+            Add(pFinished->vnTotal[s],pProfile->vnTotal[s].load(std::memory_order_relaxed));
+            if(pProfile->vnMax[s].load(std::memory_order_relaxed)>pFinished->vnMax[s].load(std::memory_order_relaxed))
+                pFinished->vnMax[s].store(pProfile->vnMax[s].load(std::memory_order_relaxed),std::memory_order_relaxed);
+        }
+        for(int c=0; c<Profiler::N_COUNTERS; c++)
+            Add(pFinished->vCounters[c],pProfile->vCounters[c].load(std::memory_order_relaxed));
+        delete pProfile;
+        return;
+    }
+
+    pProfile->bFinished = true;
+    gvpProfiles.push_back(pProfile);
+}
+
+thread_local ThreadProfile* tpProfile = NULL;
+
+// Retires the profile of the thread when it exits
+struct ThreadProfileOwner
+{
+    ~ThreadProfileOwner()
+    {
+        if(!tpProfile)
+            return;
+        std::unique_lock<std::mutex> lock(gMutexProfiles);
+        RetireProfile(tpProfile);
+        tpProfile = NULL;
+    }
+};
+
+thread_local ThreadProfileOwner tOwner;
+
+ThreadProfile* GetThreadProfile()
+{
+    if(!tpProfile)
+    {
+        ThreadProfile* pProfile = new ThreadProfile();
+        std::unique_lock<std::mutex> lock(gMutexProfiles);
+        pProfile->name = "thread " + std::to_string(gnThreads++);
+        gvpProfiles.push_back(pProfile);
+        tpProfile = pProfile;
+        // Registers the owner for the thread exit
+        (void)&tOwner;
+    }
+    return tpProfile;
+}
+
+struct Histogram
+{
+    Histogram(): nCount(0), nTotal(0), nMax(0), vBuckets(N_BUCKETS,0) {}
+
+    void Merge(const ThreadProfile* pProfile, int stage)
+    {
+        for(int b=0; b<N_BUCKETS; b++)
+        {
+            const unsigned long long n = pProfile->vHistograms[stage][b].load(std::memory_order_relaxed);
+            vBuckets[b] += n;
+            nCount += n;
+        }
+        nTotal += pProfile->vnTotal[stage].load(std::memory_order_relaxed);
+        nMax = std::max(nMax,pProfile->vnMax[stage].load(std::memory_order_relaxed));
+    }
+
+    // In nanoseconds
+    double Percentile(double p) const
+    {
+        if(nCount==0)
+            return 0;
+        const unsigned long long nRank = std::max<unsigned long long>(1,std::ceil(p*nCount));
+        unsigned long long nCum = 0;
+        for(int b=0; b<N_BUCKETS; b++)
+        {
+            nCum += vBuckets[b];
+            if(nCum>=nRank)
+                return std::min(BucketValue(b),double(nMax));
+        }
+        return nMax;
+    }
+
+    Profiler::StageStats Stats(int stage) const
+    {
+        Profiler::StageStats stats;
+        stats.name = Profiler::StageName(static_cast<Profiler::Stage>(stage));
+        stats.count = nCount;
+        stats.total = 1e-6*nTotal;
+        stats.mean = nCount>0 ? stats.total/nCount : 0;
+        stats.p50 = 1e-6*Percentile(0.5);
+        stats.p90 = 1e-6*Percentile(0.9);
+        stats.p99 = 1e-6*Percentile(0.99);
+        stats.max = 1e-6*nMax;
+        return stats;
+    }
+
+    unsigned long long nCount;
+    unsigned long long nTotal;
+    unsigned long long nMax;
+    std::vector<unsigned long long> vBuckets;
+};
+
+void WriteStageJSON(std::ostream &os, const Profiler::StageStats &stats)
+{
+    os << "{\"name\": \"" << stats.name << "\", \"count\": " << stats.count
+       << ", \"total_ms\": " << stats.total << ", \"mean_ms\": " << stats.mean
+       << ", \"p50_ms\": " << stats.p50 << ", \"p90_ms\": " << stats.p90
+       << ", \"p99_ms\": " << stats.p99 << ", \"max_ms\": " << stats.max << "}";
+}
+
+} // namespace
+
+void Profiler::SetEnabled(bool bEnabled)
+{
+    gbEnabled.store(bEnabled,std::memory_order_relaxed);
+}
+
+bool Profiler::Enabled()
+{
+    return gbEnabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::Record(Stage stage, std::chrono::steady_clock::duration duration)
+{
+    ThreadProfile* pProfile = GetThreadProfile();
+    const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    const unsigned long long n = ns>0 ? ns : 0;
+
+    Add(pProfile->vHistograms[stage][BucketIndex(n)],1);
+    Add(pProfile->vnTotal[stage],n);
+    if(n>pProfile->vnMax[stage].load(std::memory_order_relaxed))
+        pProfile->vnMax[stage].store(n,std::memory_order_relaxed);
+}
+
+void Profiler::Count(Counter counter, unsigned long n)
+{
+    if(!Enabled())
+        return;
+    Add(GetThreadProfile()->vCounters[counter],n);
+}
+
+void Profiler::SetThreadName(const std::string &name)
+{
+    ThreadProfile* pProfile = GetThreadProfile();
+    std::unique_lock<std::mutex> lock(gMutexProfiles);
+    pProfile->name = name;
+    pProfile->bNamed = true;
+}
+
+std::vector<Profiler::StageStats> Profiler::GetStageStats()
+{
+    std::vector<Histogram> vHistograms(N_STAGES);
+    {
+        std::unique_lock<std::mutex> lock(gMutexProfiles);
+        for(size_t i=0; i<gvpProfiles.size(); i++)
+            for(int s=0; s<N_STAGES; s++)
+                vHistograms[s].Merge(gvpProfiles[i],s);
+    }
+
+    std::vector<StageStats> vStats;
+    vStats.reserve(N_STAGES);
+    for(int s=0; s<N_STAGES; s++)
+        vStats.push_back(vHistograms[s].Stats(s));
+    return vStats;
+}
+
+std::vector<Profiler::CounterStats> Profiler::GetCounterStats()
+{
+    std::vector<CounterStats> vStats(N_COUNTERS);
+    for(int c=0; c<N_COUNTERS; c++)
+    {
+        vStats[c].name = CounterName(static_cast<Counter>(c));
+        vStats[c].value = 0;
+    }
+
+    std::unique_lock<std::mutex> lock(gMutexProfiles);
+    for(size_t i=0; i<gvpProfiles.size(); i++)
+        for(int c=0; c<N_COUNTERS; c++)
+            vStats[c].value += gvpProfiles[i]->vCounters[c].load(std::memory_order_relaxed);
+    return vStats;
+}
+
+void Profiler::WriteJSON(std::ostream &os)
+{
+    const std::vector<StageStats> vStages = GetStageStats();
+    const std::vector<CounterStats> vCounters = GetCounterStats();
+
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(4);
+    os << "{\n  \"stages\": [";
+    for(size_t i=0; i<vStages.size(); i++)
+    {
+        os << (i==0 ? "\n    " : ",\n    ");
+        WriteStageJSON(os,vStages[i]);
+    }
+    os << "\n  ],\n  \"counters\": {";
+    for(size_t i=0; i<vCounters.size(); i++)
+        os << (i==0 ? "\n    " : ",\n    ") << "\"" << vCounters[i].name << "\": " << vCounters[i].value;
+    os << "\n  },\n  \"threads\": [";
+
+    std::unique_lock<std::mutex> lock(gMutexProfiles);
+    for(size_t i=0; i<gvpProfiles.size(); i++)
+    {
+        os << (i==0 ? "\n    " : ",\n    ") << "{\"name\": \"" << gvpProfiles[i]->name << "\", \"stages\": [";
+        bool bFirst = true;
+        for(int s=0; s<N_STAGES; s++)
+        {
+            Histogram histogram;
+            histogram.Merge(gvpProfiles[i],s);
+            if(histogram.nCount==0)
+                continue;
+            os << (bFirst ? "\n      " : ",\n      ");
+            WriteStageJSON(os,histogram.Stats(s));
+            bFirst = false;
+        }
+        os << (bFirst ? "]}" : "\n    ]}");
+    }
+    os << "\n  ]\n}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void Profiler::WriteCSV(std::ostream &os)
+{
+    const std::vector<StageStats> vStages = GetStageStats();
+
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(4);
+    os << "stage,count,total_ms,mean_ms,p50_ms,p90_ms,p99_ms,max_ms" << std::endl;
+    for(size_t i=0; i<vStages.size(); i++)
+    {
+        const StageStats &s = vStages[i];
+        os << s.name << "," << s.count << "," << s.total << "," << s.mean << ","
+           << s.p50 << "," << s.p90 << "," << s.p99 << "," << s.max << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void Profiler::Reset()
+{
+    std::unique_lock<std::mutex> lock(gMutexProfiles);
+    for(size_t i=0; i<gvpProfiles.size(); i++)
+    {
+        ThreadProfile* pProfile = gvpProfiles[i];
+        for(int s=0; s<N_STAGES; s++)
+        {
+            for(int b=0; b<N_BUCKETS; b++)
+                pProfile->vHistograms[s][b].store(0,std::memory_order_relaxed);
+            pProfile->vnTotal[s].store(0,std::memory_order_relaxed);
+            pProfile->vnMax[s].store(0,std::memory_order_relaxed);
+        }
+        for(int c=0; c<N_COUNTERS; c++)
+            pProfile->vCounters[c].store(0,std::memory_order_relaxed);
+    }
+}
+
+const char* Profiler::StageName(Stage stage)
+{
+    static const char* names[N_STAGES] = {
+        "frame.extract_orb",
+        "frame.undistort",
+        "frame.stereo_match",
+        "frame.bow",
+        "track",
+        "track.initialization",
+        "track.reference_kf",
+        "track.motion_model",
+        "track.relocalization",
+        "track.local_map",
+        "track.new_keyframe",
+        "local_mapping.process_kf",
+        "local_mapping.mappoint_culling",
+        "local_mapping.create_mappoints",
+        "local_mapping.search_neighbors",
+        "local_mapping.keyframe_culling",
+        "optimizer.pose",
+        "optimizer.local_ba",
+        "optimizer.global_ba",
+        "optimizer.essential_graph",
+        "optimizer.sim3",
+        "loop.detect",
+        "loop.compute_sim3",
+        "loop.correct"
+    };
+    return names[stage];
+}
+
+const char* Profiler::CounterName(Counter counter)
+{
+    static const char* names[N_COUNTERS] = {
+        "frames",
+        "keyframes_created",
+        "keyframes_refused",
+        "keyframes_culled",
+        "mappoints_created",
+        "mappoints_culled",
+        "loops_detected"
+    };
+    return names[counter];
+}
+
+} //namespace ORB_SLAM
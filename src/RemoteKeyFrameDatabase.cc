@@ -0,0 +1,285 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RemoteKeyFrameDatabase.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+bool HigherScore(const RemoteKeyFrameDatabase::Candidate &a, const RemoteKeyFrameDatabase::Candidate &b)
+{
+    return a.score > b.score;
+}
+
+}
+
+RemoteKeyFrameDatabase::RemoteKeyFrameDatabase(const ORBVocabulary &voc, size_t nMaxBytes):
+    mpVoc(&voc), mnSlots(0), mnMaxBytes(nMaxBytes), mnBytes(0), mnEvicted(0)
+{
+    mvInvertedFile.resize(voc.size());
+}
+
+RemoteKeyFrameDatabase::~RemoteKeyFrameDatabase()
+{
+    for(size_t i=0; i<mdEntries.size(); i++)
+        delete mdEntries[i];
+}
+
+void RemoteKeyFrameDatabase::SetMemoryBudget(size_t nMaxBytes)
+{
+    unique_lock<mutex> lock(mMutex);
+    mnMaxBytes = nMaxBytes;
+    while(mnBytes>mnMaxBytes && !mdEntries.empty())
+        EvictOldest();
+}
+
+bool RemoteKeyFrameDatabase::add(const RemoteKeyFrame &kf)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    const pair<int,uint64_t> key(kf.mnRobotId, kf.mnSymbolIndex);
+    if(mmEntries.count(key))
+        return false;
+
+    Entry* pEntry = new Entry();
+    pEntry->nRobotId = kf.mnRobotId;
+    pEntry->mSymbolChr = kf.mSymbolChr;
+    pEntry->mnSymbolIndex = kf.mnSymbolIndex;
+    pEntry->mfMinScore = kf.mfMinScore;
+    pEntry->vWords.reserve(kf.mBowVec.size());
+    pEntry->vWeights.reserve(kf.mBowVec.size());
+    for(DBoW2::BowVector::const_iterator vit=kf.mBowVec.begin(), vend=kf.mBowVec.end(); vit!=vend; vit++)
+    {
+        // Words out of the vocabulary come from a robot with another one
+        if(vit->first>=mvInvertedFile.size())
+            continue;
+        pEntry->vWords.push_back(vit->first);
+        pEntry->vWeights.push_back(vit->second);
+    }
+    pEntry->vPositions.resize(pEntry->vWords.size());
+
+    if(!mvFreeSlots.empty())
+    {
+        pEntry->nSlot = mvFreeSlots.back();
+        mvFreeSlots.pop_back();
+    }
+    else
+    {
+        pEntry->nSlot = mnSlots++;
+        mvSlotWords.push_back(0);
+        mvSlotScores.push_back(0);
+    }
+
+    for(size_t k=0; k<pEntry->vWords.size(); k++)
+    {
+        vector<Posting> &vPostings = mvInvertedFile[pEntry->vWords[k]];
+        pEntry->vPositions[k] = vPostings.size();
+        Posting posting = {pEntry, static_cast<uint32_t>(k)};
+        vPostings.push_back(posting);
+    }
+
+    mmEntries[key] = pEntry;
+    mdEntries.push_back(pEntry);
+    mnBytes += EntryBytes(pEntry);
+
+    while(mnBytes>mnMaxBytes && !mdEntries.empty())
+        EvictOldest();
+
+    return true;
+}
+
+void RemoteKeyFrameDatabase::clear()
+{
+    unique_lock<mutex> lock(mMutex);
+
+    for(size_t i=0; i<mdEntries.size(); i++)
+        delete mdEntries[i];
+    mdEntries.clear();
+    mmEntries.clear();
+
+    mvInvertedFile.clear();
+    mvInvertedFile.resize(mpVoc->size());
+
+    mvFreeSlots.clear();
+    mvSlotWords.clear();
+    mvSlotScores.clear();
+    mnSlots = 0;
+    mnBytes = 0;
+}
+
+vector<RemoteKeyFrameDatabase::Candidate> RemoteKeyFrameDatabase::DetectCandidates(const DBoW2::BowVector &bowVec, float minScore)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    // The L1 score only depends on the shared words, it is accumulated from the postings
+    // (Nister, 2006), like DBoW2::L1Scoring. Other scorings need the whole vectors.
+    const bool bL1 = mpVoc->getScoringType()==DBoW2::L1_NORM;
+
+    // Search all entries that share a word with the query, counting the shared words
+    vector<Entry*> vpSharingWords;
+    for(DBoW2::BowVector::const_iterator vit=bowVec.begin(), vend=bowVec.end(); vit!=vend; vit++)
+    {
+        if(vit->first>=mvInvertedFile.size())
+            continue;
+
+        const float vi = vit->second;
+        const vector<Posting> &vPostings = mvInvertedFile[vit->first];
+        for(vector<Posting>::const_iterator pit=vPostings.begin(), pend=vPostings.end(); pit!=pend; pit++)
+        {
+            const uint32_t nSlot = pit->pEntry->nSlot;
+            if(mvSlotWords[nSlot]++==0)
+                vpSharingWords.push_back(pit->pEntry);
+            if(bL1)
+            {
+                const float wi = pit->pEntry->vWeights[pit->nWord];
+                mvSlotScores[nSlot] += fabs(vi-wi)-fabs(vi)-fabs(wi);
+            }
+        }
+    }
+
+    // Only compare against those entries that share enough words
+    int maxCommonWords=0;
+    for(size_t i=0; i<vpSharingWords.size(); i++)
+        maxCommonWords = max(maxCommonWords, mvSlotWords[vpSharingWords[i]->nSlot]);
+
+    const int minCommonWords = maxCommonWords*0.8f;
+
+    // Compute similarity score. Retain the matches whose score is higher than minScore
+    vector<Candidate> vCandidates;
+    float bestScore = minScore;
+    DBoW2::BowVector entryBowVec;
+    for(size_t i=0; i<vpSharingWords.size(); i++)
+    {
+        const Entry* pEntry = vpSharingWords[i];
+        if(mvSlotWords[pEntry->nSlot]>minCommonWords)
+        {
+            float score;
+            if(bL1)
+                score = -mvSlotScores[pEntry->nSlot]/2;
+            else
+            {
+                ToBowVector(pEntry, entryBowVec);
+                score = mpVoc->score(bowVec, entryBowVec);
+            }
+            if(score>=minScore)
+            {
+                Candidate candidate = {pEntry->nRobotId, pEntry->mnSymbolIndex, score};
+                vCandidates.push_back(candidate);
+                bestScore = max(bestScore, score);
+            }
+        }
+        mvSlotWords[pEntry->nSlot] = 0;
+        mvSlotScores[pEntry->nSlot] = 0;
+    }
+
+    // Return all those entries with a score higher than 0.75*bestScore
+    const float minScoreToRetain = 0.75f*bestScore;
+    vector<Candidate> vRetained;
+    vRetained.reserve(vCandidates.size());
+    for(size_t i=0; i<vCandidates.size(); i++)
+        if(vCandidates[i].score>minScoreToRetain)
+            vRetained.push_back(vCandidates[i]);
+
+    sort(vRetained.begin(), vRetained.end(), HigherScore);
+    return vRetained;
+}
+
+void RemoteKeyFrameDatabase::GetSummaries(map<int, vector<RemoteKeyFrame> > &mSummaries, size_t nMaxPerRobot)
+{
+    unique_lock<mutex> lock(mMutex);
+
+    // Newest first, stopping at the window of each robot
+    mSummaries.clear();
+    for(deque<Entry*>::const_reverse_iterator dit=mdEntries.rbegin(), dend=mdEntries.rend(); dit!=dend; dit++)
+    {
+        const Entry* pEntry = *dit;
+        vector<RemoteKeyFrame> &vSummaries = mSummaries[pEntry->nRobotId];
+        if(vSummaries.size()>=nMaxPerRobot)
+            continue;
+        vSummaries.push_back(RemoteKeyFrame());
+        RemoteKeyFrame &kf = vSummaries.back();
+        kf.mnRobotId = pEntry->nRobotId;
+        kf.mSymbolChr = pEntry->mSymbolChr;
+        kf.mnSymbolIndex = pEntry->mnSymbolIndex;
+        kf.mfMinScore = pEntry->mfMinScore;
+        ToBowVector(pEntry, kf.mBowVec);
+    }
+
+    for(map<int, vector<RemoteKeyFrame> >::iterator mit=mSummaries.begin(), mend=mSummaries.end(); mit!=mend; mit++)
+        reverse(mit->second.begin(), mit->second.end());
+}
+
+void RemoteKeyFrameDatabase::GetUsage(size_t &nKeyFrames, size_t &nBytes, unsigned long &nEvicted)
+{
+    unique_lock<mutex> lock(mMutex);
+    nKeyFrames = mdEntries.size();
+    nBytes = mnBytes;
+    nEvicted = mnEvicted;
+}
+
+size_t RemoteKeyFrameDatabase::EntryBytes(const Entry* pEntry)
+{
+    // Approximate: the entry, its words and postings, and its node in the map
+    const size_t nWords = pEntry->vWords.size();
+    return sizeof(Entry) + nWords*(sizeof(DBoW2::WordId)+sizeof(float)+sizeof(uint32_t)+sizeof(Posting)) +
+            sizeof(pair<const pair<int,uint64_t>, Entry*>) + 4*sizeof(void*);
+}
+
+void RemoteKeyFrameDatabase::EvictOldest()
+{
+    Entry* pEntry = mdEntries.front();
+    mdEntries.pop_front();
+    mmEntries.erase(make_pair(pEntry->nRobotId, pEntry->mnSymbolIndex));
+
+    // Erase the postings of the entry
+    for(size_t k=0; k<pEntry->vWords.size(); k++)
+    {
+        // Move the last posting of the list into the erased one
+        vector<Posting> &vPostings = mvInvertedFile[pEntry->vWords[k]];
+        const uint32_t pos = pEntry->vPositions[k];
+        const Posting last = vPostings.back();
+        vPostings[pos] = last;
+        last.pEntry->vPositions[last.nWord] = pos;
+        vPostings.pop_back();
+    }
+
+    mvFreeSlots.push_back(pEntry->nSlot);
+    mnBytes -= EntryBytes(pEntry);
+    mnEvicted++;
+    delete pEntry;
+}
+
+void RemoteKeyFrameDatabase::ToBowVector(const Entry* pEntry, DBoW2::BowVector &bowVec)
+{
+    // Words are sorted, so every insertion goes at the end
+    bowVec.clear();
+    for(size_t k=0; k<pEntry->vWords.size(); k++)
+        bowVec.insert(bowVec.end(), make_pair(pEntry->vWords[k], static_cast<DBoW2::WordValue>(pEntry->vWeights[k])));
+}
+
+} //namespace ORB_SLAM
@@ -0,0 +1,107 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RosTransport.h"
+
+#include <boost/function.hpp>
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+const char* const kTopics[InterRobotTransport::NUM_CHANNELS] = {"/keyframe_summary", "/keyframe_request", "/keyframe"};
+
+// Queue of 1000 messages per topic
+const uint32_t kQueueSize = 1000;
+
+std::string RobotNamespace(char robotName)
+{
+    char robotString[100];
+    sprintf(robotString, "%c", robotName);
+    return robotString;
+}
+
+} // namespace
+
+RosTransport::RosTransport(char robotName): mNodeHandle(RobotNamespace(robotName)) // all messages will be published in this name space
+{
+    for(int i=0; i<NUM_CHANNELS; i++)
+        mvPublishers[i] = mNodeHandle.advertise<std_msgs::UInt8MultiArray>(kTopics[i], kQueueSize);
+    mMeasurementPublisher = mNodeHandle.advertise<distributed_mapper_msgs::Measurement>("/measurement", kQueueSize); // pubilsh relative pose
+}
+
+void RosTransport::Publish(eChannel channel, std::vector<unsigned char> &vData)
+{
+    std_msgs::UInt8MultiArray msg;
+    msg.data.swap(vData);
+    mvPublishers[channel].publish(msg);
+}
+
+void RosTransport::PublishMeasurement(const InterRobotMeasurement &measurement)
+{
+    distributed_mapper_msgs::Measurement measurementMsg;
+    measurementMsg.symbolChr1 = measurement.mSymbolChr1;
+    measurementMsg.symbolIndex1 = measurement.mnSymbolIndex1;
+    measurementMsg.symbolChr2 = measurement.mSymbolChr2;
+    measurementMsg.symbolIndex2 = measurement.mnSymbolIndex2;
+    for(int i =0; i < measurement.mR.rows*measurement.mR.cols; i++)
+        measurementMsg.relativeRotation.push_back(measurement.mR.at<float>(i));
+    for(int i =0; i < measurement.mt.rows*measurement.mt.cols; i++)
+        measurementMsg.relativeTranslation.push_back(measurement.mt.at<float>(i));
+    measurementMsg.relativeScale = measurement.mfScale;
+    mMeasurementPublisher.publish(measurementMsg);
+}
+
+void RosTransport::Subscribe(eChannel channel, const MessageHandler &handler)
+{
+    // The message handed out shares the ROS message, that keeps the bytes alive
+    boost::function<void(const std_msgs::UInt8MultiArray::ConstPtr&)> callback =
+            [handler](const std_msgs::UInt8MultiArray::ConstPtr &msg)
+    {
+        handler(Message(&msg->data, [msg](const std::vector<unsigned char>*){}));
+    };
+    mvSubscribers.push_back(mNodeHandle.subscribe<std_msgs::UInt8MultiArray>(kTopics[channel], kQueueSize, callback));
+}
+
+void RosTransport::SubscribeMeasurements(const MeasurementHandler &handler)
+{
+    boost::function<void(const distributed_mapper_msgs::Measurement::ConstPtr&)> callback =
+            [handler](const distributed_mapper_msgs::Measurement::ConstPtr &msg)
+    {
+        InterRobotMeasurement measurement;
+        measurement.mSymbolChr1 = msg->symbolChr1;
+        measurement.mnSymbolIndex1 = msg->symbolIndex1;
+        measurement.mSymbolChr2 = msg->symbolChr2;
+        measurement.mnSymbolIndex2 = msg->symbolIndex2;
+        measurement.mR = cv::Mat::eye(3, 3, CV_32F);
+        for(size_t i = 0; i < msg->relativeRotation.size() && i < 9; i++)
+            measurement.mR.at<float>(i) = msg->relativeRotation[i];
+        measurement.mt = cv::Mat::zeros(3, 1, CV_32F);
+        for(size_t i = 0; i < msg->relativeTranslation.size() && i < 3; i++)
+            measurement.mt.at<float>(i) = msg->relativeTranslation[i];
+        measurement.mfScale = msg->relativeScale;
+        handler(measurement);
+    };
+    mvSubscribers.push_back(mNodeHandle.subscribe<distributed_mapper_msgs::Measurement>("/measurement", kQueueSize, callback));
+}
+
+} //namespace ORB_SLAM
@@ -22,17 +22,53 @@
 
 #include "System.h"
 #include "Converter.h"
+#include "TrackingPipeline.h"
+#ifdef ORB_SLAM2_WITH_ROS
+#include "RosTransport.h"
+#endif
 #include <thread>
 #include <pangolin/pangolin.h>
 #include <iomanip>
 #include <time.h>
+#include <unistd.h>
 
 namespace ORB_SLAM2
 {
 
+  namespace
+  {
+    void PrintQueueStats(const string &strThread, const WorkSignal::Stats &stats)
+    {
+      cout << strThread << " wakeups: " << stats.nWakeups;
+      if(stats.nWakeups>0)
+        cout << ", queue wait mean/max: " << 1e3*stats.dTotalQueueWait/stats.nWakeups << "/" << 1e3*stats.dMaxQueueWait << " ms";
+      cout << ", idle: " << stats.dTotalIdle << " s" << endl;
+    }
+
+    void PrintRemoteRobotStats(const map<int, LoopClosingInterRobot::RemoteRobotStats> &mStats)
+    {
+      for(map<int, LoopClosingInterRobot::RemoteRobotStats>::const_iterator it=mStats.begin(); it!=mStats.end(); it++)
+        {
+          const LoopClosingInterRobot::RemoteRobotStats &stats = it->second;
+          cout << "Robot " << it->first << " summaries: " << stats.nSummaries << ", requested: " << stats.nRequests
+               << ", received: " << stats.nKeyFrames << ", resent: " << stats.nResent << ", expired: " << stats.nExpired
+               << ", dropped: " << stats.nDropped
+               << ", matched: " << stats.nMatched << "/" << stats.nVerified;
+          if(stats.nKeyFrames>0)
+            cout << ", request latency mean/max: " << 1e3*stats.dTotalRequestLatency/stats.nKeyFrames << "/" << 1e3*stats.dMaxRequestLatency << " ms";
+          if(stats.nVerified>0)
+            cout << ", backlog wait mean/max: " << 1e3*stats.dTotalBacklogWait/stats.nVerified << "/" << 1e3*stats.dMaxBacklogWait << " ms"
+                 << ", match mean/max: " << 1e3*stats.dTotalMatchTime/stats.nVerified << "/" << 1e3*stats.dMaxMatchTime << " ms";
+          cout << endl;
+        }
+    }
+  }
+
   System::System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor,
-                 const bool bUseViewer, const bool bUseLoopClosure, const bool bUseInterRobotLoopCloser, int robotID, char robotName, bool correctLoop):mSensor(sensor),mbReset(false),mbActivateLocalizationMode(false),
-    mbDeactivateLocalizationMode(false), bUseLoopClosure_(bUseLoopClosure), bUseInterRobotLoopCloser_(bUseInterRobotLoopCloser), robotID_(robotID), robotName_(robotName), bUseViewer_(bUseViewer)
+                 const bool bUseViewer, const bool bUseLoopClosure, const bool bUseInterRobotLoopCloser, int robotID, char robotName, bool correctLoop,
+                 InterRobotTransport* pTransport):mSensor(sensor),mbReset(false),mbActivateLocalizationMode(false),
+    mbDeactivateLocalizationMode(false), bUseLoopClosure_(bUseLoopClosure), bUseInterRobotLoopCloser_(bUseInterRobotLoopCloser), robotID_(robotID), robotName_(robotName), bUseViewer_(bUseViewer),
+    mpTrackingPipeline(0), mpOwnTransport(0)
   {
     // Output welcome message
     cout << endl <<
@@ -60,10 +96,30 @@ namespace ORB_SLAM2
 
 
     //Load ORB Vocabulary
-    cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
+    //A binary vocabulary (see Examples/Tools/bin_vocabulary) is memory-mapped and loads
+    //in milliseconds. If a .txt vocabulary is given and a .bin file exists next to it, use it.
+    string strVocBinFile;
+    if(strVocFile.size()>4 && strVocFile.compare(strVocFile.size()-4,4,".bin")==0)
+      strVocBinFile = strVocFile;
+    else if(strVocFile.size()>4 && strVocFile.compare(strVocFile.size()-4,4,".txt")==0)
+      {
+        string strCandidate = strVocFile.substr(0,strVocFile.size()-4) + ".bin";
+        if(access(strCandidate.c_str(),R_OK)==0)
+          strVocBinFile = strCandidate;
+      }
 
     mpVocabulary = new ORBVocabulary();
-    bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+    bool bVocLoad = false;
+    if(!strVocBinFile.empty())
+      {
+        cout << endl << "Loading binary ORB Vocabulary from " << strVocBinFile << endl;
+        bVocLoad = mpVocabulary->loadFromBinaryFile(strVocBinFile);
+      }
+    if(!bVocLoad && strVocBinFile!=strVocFile)
+      {
+        cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
+        bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+      }
     if(!bVocLoad)
       {
         cerr << "Wrong path to vocabulary. " << endl;
@@ -87,6 +143,7 @@ namespace ORB_SLAM2
     //(it will live in the main thread of execution, the one that called this constructor)
     mpTracker = new Tracking(this, mpVocabulary, mpFrameDrawer, mpMapDrawer,
                              mpMap, mpKeyFrameDatabase, strSettingsFile, mSensor);
+    Profiler::SetThreadName("Tracking");
 
     //Initialize the Local Mapping thread and launch
     mpLocalMapper = new LocalMapping(mpMap, mpKeyFrameDatabase, mSensor==MONOCULAR);
@@ -95,12 +152,43 @@ namespace ORB_SLAM2
     //Initialize the Loop Closing thread and launch
     if(bUseLoopClosure){
         mpLoopCloser = new LoopClosing(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, correctLoop);
+        // Optional, refine corrected loops incrementally instead of restarting the global BA
+        int nIncrementalBA = fsSettings["LoopClosing.IncrementalBA"];
+        if(correctLoop && nIncrementalBA)
+          mpLoopCloser->UseIncrementalBundleAdjustment();
         mptLoopClosing = new thread(&ORB_SLAM2::LoopClosing::Run, mpLoopCloser);
       }
 
     //Initialize the Loop Closing thread and launch
     if(bUseInterRobotLoopCloser){
-        mpLoopCloserInterRobot = new LoopClosingInterRobot(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, robotID_, robotName_);
+        if(!pTransport)
+          {
+#ifdef ORB_SLAM2_WITH_ROS
+            mpOwnTransport = new RosTransport(robotName_);
+            pTransport = mpOwnTransport;
+#else
+            cerr << "Inter-robot loop closing needs a transport, ORB_SLAM2 was built without ROS" << endl;
+            exit(-1);
+#endif
+          }
+        mpLoopCloserInterRobot = new LoopClosingInterRobot(mpMap, mpKeyFrameDatabase, mpVocabulary, mSensor!=MONOCULAR, pTransport, robotID_, robotName_);
+        // Optional, deflate the keyframes sent to the other robots
+        int nCompressKeyFrames = fsSettings["InterRobot.CompressKeyFrames"];
+        mpLoopCloserInterRobot->SetCompressKeyFrames(nCompressKeyFrames);
+        // Optional, workers matching the requested keyframes, their backlog and its order (0: newest, 1: best BoW score first)
+        int nMatchThreads = fsSettings["InterRobot.MatchThreads"];
+        int nMatchBacklog = fsSettings["InterRobot.MatchBacklog"];
+        int nMatchPriority = fsSettings["InterRobot.MatchPriority"];
+        mpLoopCloserInterRobot->SetMatchingPool(nMatchThreads>0 ? nMatchThreads : 1, nMatchBacklog>0 ? nMatchBacklog : 16,
+                                                nMatchPriority==1 ? LoopClosingInterRobot::BEST_SCORE_FIRST : LoopClosingInterRobot::NEWEST_FIRST);
+        // Optional, memory for the keyframe summaries of the other robots in MB
+        int nRemoteMemoryBudget = fsSettings["InterRobot.RemoteMemoryBudget"];
+        if(nRemoteMemoryBudget>0)
+          mpLoopCloserInterRobot->SetRemoteMemoryBudget(static_cast<size_t>(nRemoteMemoryBudget)<<20);
+        // Optional, seconds before a requested keyframe is requested again and number of attempts
+        float fRequestTimeout = fsSettings["InterRobot.RequestTimeout"];
+        int nRequestAttempts = fsSettings["InterRobot.RequestAttempts"];
+        mpLoopCloserInterRobot->SetRequestTimeout(fRequestTimeout>0 ? fRequestTimeout : 2.0, nRequestAttempts>0 ? nRequestAttempts : 3);
         mptLoopClosingInterRobotKeyFramePublisher = new thread(&ORB_SLAM2::LoopClosingInterRobot::Publish, mpLoopCloserInterRobot);
       }
 
@@ -146,39 +234,7 @@ namespace ORB_SLAM2
         exit(-1);
       }
 
-    // Check mode change
-    {
-      unique_lock<mutex> lock(mMutexMode);
-      if(mbActivateLocalizationMode)
-        {
-          mpLocalMapper->RequestStop();
-
-          // Wait until Local Mapping has effectively stopped
-          while(!mpLocalMapper->isStopped())
-            {
-              usleep(1000);
-            }
-
-          mpTracker->InformOnlyTracking(true);
-          mbActivateLocalizationMode = false;
-        }
-      if(mbDeactivateLocalizationMode)
-        {
-          mpTracker->InformOnlyTracking(false);
-          mpLocalMapper->Release();
-          mbDeactivateLocalizationMode = false;
-        }
-    }
-
-    // Check reset
-    {
-      unique_lock<mutex> lock(mMutexReset);
-      if(mbReset)
-        {
-          mpTracker->Reset();
-          mbReset = false;
-        }
-    }
+    CheckModeAndReset();
 
     return mpTracker->GrabImageStereo(imLeft,imRight,timestamp);
   }
@@ -197,39 +253,7 @@ namespace ORB_SLAM2
         exit(-1);
       }
 
-    // Check mode change
-    {
-      unique_lock<mutex> lock(mMutexMode);
-      if(mbActivateLocalizationMode)
-        {
-          mpLocalMapper->RequestStop();
-
-          // Wait until Local Mapping has effectively stopped
-          while(!mpLocalMapper->isStopped())
-            {
-              usleep(1000);
-            }
-
-          mpTracker->InformOnlyTracking(true);
-          mbActivateLocalizationMode = false;
-        }
-      if(mbDeactivateLocalizationMode)
-        {
-          mpTracker->InformOnlyTracking(false);
-          mpLocalMapper->Release();
-          mbDeactivateLocalizationMode = false;
-        }
-    }
-
-    // Check reset
-    {
-      unique_lock<mutex> lock(mMutexReset);
-      if(mbReset)
-        {
-          mpTracker->Reset();
-          mbReset = false;
-        }
-    }
+    CheckModeAndReset();
 
     clock_t start = clock(); // Clock
     double duration;
@@ -281,6 +305,13 @@ namespace ORB_SLAM2
         exit(-1);
       }
 
+    CheckModeAndReset();
+
+    return mpTracker->GrabImageMonocular(im,timestamp);
+  }
+
+  void System::CheckModeAndReset()
+  {
     // Check mode change
     {
       unique_lock<mutex> lock(mMutexMode);
@@ -289,10 +320,7 @@ namespace ORB_SLAM2
           mpLocalMapper->RequestStop();
 
           // Wait until Local Mapping has effectively stopped
-          while(!mpLocalMapper->isStopped())
-            {
-              usleep(1000);
-            }
+          mpLocalMapper->WaitUntilStopped();
 
           mpTracker->InformOnlyTracking(true);
           mbActivateLocalizationMode = false;
@@ -314,8 +342,68 @@ namespace ORB_SLAM2
           mbReset = false;
         }
     }
+  }
 
-    return mpTracker->GrabImageMonocular(im,timestamp);
+  bool System::SubmitStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timestamp)
+  {
+    if(mSensor!=STEREO)
+      {
+        cerr << "ERROR: you called SubmitStereo but input sensor was not set to STEREO." << endl;
+        exit(-1);
+      }
+
+    return GetTrackingPipeline()->Submit(imLeft,imRight,timestamp,gtsam::Symbol('x', 999999));
+  }
+
+  bool System::SubmitRGBD(const cv::Mat &im, const cv::Mat &depthmap, const double &timestamp, gtsam::Key key)
+  {
+    if(mSensor!=RGBD)
+      {
+        cerr << "ERROR: you called SubmitRGBD but input sensor was not set to RGBD." << endl;
+        exit(-1);
+      }
+
+    return GetTrackingPipeline()->Submit(im,depthmap,timestamp,key);
+  }
+
+  bool System::SubmitMonocular(const cv::Mat &im, const double &timestamp)
+  {
+    if(mSensor!=MONOCULAR)
+      {
+        cerr << "ERROR: you called SubmitMonocular but input sensor was not set to Monocular." << endl;
+        exit(-1);
+      }
+
+    return GetTrackingPipeline()->Submit(im,cv::Mat(),timestamp,gtsam::Symbol('x', 999999));
+  }
+
+  bool System::PollPose(cv::Mat &Tcw, double &timestamp)
+  {
+    TrackingPipeline::Result result;
+    if(!mpTrackingPipeline || !mpTrackingPipeline->Poll(result))
+      return false;
+
+    Tcw = result.Tcw;
+    timestamp = result.timestamp;
+    return true;
+  }
+
+  bool System::WaitPose(cv::Mat &Tcw, double &timestamp)
+  {
+    TrackingPipeline::Result result;
+    if(!mpTrackingPipeline || !mpTrackingPipeline->Wait(result))
+      return false;
+
+    Tcw = result.Tcw;
+    timestamp = result.timestamp;
+    return true;
+  }
+
+  TrackingPipeline* System::GetTrackingPipeline()
+  {
+    if(!mpTrackingPipeline)
+      mpTrackingPipeline = new TrackingPipeline(mpTracker,[this]{CheckModeAndReset();});
+    return mpTrackingPipeline;
   }
 
   void System::ActivateLocalizationMode()
@@ -338,6 +426,12 @@ namespace ORB_SLAM2
 
   void System::Shutdown()
   {
+    // Frames still in the pipeline are tracked before the other threads stop
+    if(mpTrackingPipeline)
+      {
+        delete mpTrackingPipeline;
+        mpTrackingPipeline = 0;
+      }
 
     mpLocalMapper->RequestFinish();
     cout << "Local Mapper Finish Requested " << endl;
@@ -354,28 +448,39 @@ namespace ORB_SLAM2
 
     // Wait until all thread have effectively stopped
 
-    while(!mpLocalMapper->isFinished() )
-      {
-        usleep(5000);
-      }
+    mpLocalMapper->WaitUntilFinished();
 
     cout << "Local Mapper finished " << endl;
 
-    if(bUseViewer_){
-        while(!mpViewer->isFinished()){
-            usleep(5000);
-          }
-      }
+    if(bUseViewer_)
+      mpViewer->WaitUntilFinished();
 
     cout << "Viewer finished " << endl;
 
-    if(bUseLoopClosure_){
-        while (!mpLoopCloser->isFinished() ||  mpLoopCloser->isRunningGBA()){
-            usleep(5000);
-          }
-      }
+    if(bUseLoopClosure_)
+      mpLoopCloser->WaitUntilFinished();
+
     cout << "Loop Closure finished " << endl;
 
+    PrintQueueStats("Local Mapping",mpLocalMapper->GetQueueStats());
+    if(bUseLoopClosure_)
+      PrintQueueStats("Loop Closing",mpLoopCloser->GetQueueStats());
+
+    int nLoopOverflows, nInterRobotOverflows;
+    mpLocalMapper->GetQueueOverflows(nLoopOverflows,nInterRobotOverflows);
+    cout << "Keyframes refused by Local Mapping: " << mpTracker->GetRefusedKeyFrames()
+         << ", not queued for Loop Closing: " << nLoopOverflows
+         << ", not queued for inter-robot publishing: " << nInterRobotOverflows << endl;
+    if(bUseInterRobotLoopCloser_)
+      {
+        PrintRemoteRobotStats(mpLoopCloserInterRobot->GetRemoteRobotStats());
+
+        size_t nRemoteKeyFrames, nRemoteBytes;
+        unsigned long nRemoteEvicted;
+        mpLoopCloserInterRobot->GetRemoteKeyFrameUsage(nRemoteKeyFrames,nRemoteBytes,nRemoteEvicted);
+        cout << "Remote keyframes stored: " << nRemoteKeyFrames << " (" << nRemoteBytes/1024 << " KB), evicted: " << nRemoteEvicted << endl;
+      }
+
     if(bUseViewer_)
      pangolin::BindToContext("ORB-SLAM2: Map Viewer");
   }
@@ -532,4 +637,38 @@ namespace ORB_SLAM2
     cout << endl << "trajectory saved!" << endl;
   }
 
+  vector<Profiler::StageStats> System::GetStageStats()
+  {
+    return Profiler::GetStageStats();
+  }
+
+  vector<Profiler::CounterStats> System::GetCounterStats()
+  {
+    return Profiler::GetCounterStats();
+  }
+
+  void System::SaveStageStats(const string &filename)
+  {
+    cout << endl << "Saving stage statistics to " << filename << " ..." << endl;
+
+    ofstream f;
+    f.open(filename.c_str());
+    const string ext = ".json";
+    if(filename.size()>=ext.size() && filename.compare(filename.size()-ext.size(),ext.size(),ext)==0)
+      Profiler::WriteJSON(f);
+    else
+      Profiler::WriteCSV(f);
+    f.close();
+  }
+
+  long unsigned int System::KeyFramesInMap()
+  {
+    return mpMap->KeyFramesInMap();
+  }
+
+  long unsigned int System::MapPointsInMap()
+  {
+    return mpMap->MapPointsInMap();
+  }
+
 } //namespace ORB_SLAM
@@ -0,0 +1,153 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <memory>
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+// State of a ParallelFor call, shared with the helper tasks queued in the pool.
+// A helper may start after the call has returned, it then finds no iteration left.
+struct ParallelForState
+{
+    ParallelForState(int n, const std::function<void(int)> *pf): nIterations(n), nNext(0), nDone(0), nHelperAllocations(0), pFunction(pf) {}
+
+    // Executes iterations until none is left
+    void Work(bool bHelper)
+    {
+        int i;
+        while((i = nNext++) < nIterations)
+        {
+            const unsigned long nAllocations = AllocationCounter::ThreadAllocations();
+
+            (*pFunction)(i);
+
+            // Allocations of the workers are attributed to the thread that called ParallelFor
+            if(bHelper)
+                nHelperAllocations += AllocationCounter::ThreadAllocations()-nAllocations;
+
+            if(++nDone == nIterations)
+            {
+                std::unique_lock<std::mutex> lock(mMutexDone);
+                mcvDone.notify_all();
+            }
+        }
+    }
+
+    const int nIterations;
+    std::atomic<int> nNext;
+    std::atomic<int> nDone;
+    std::atomic<unsigned long> nHelperAllocations;
+    const std::function<void(int)> *pFunction;
+    std::mutex mMutexDone;
+    std::condition_variable mcvDone;
+};
+
+}
+
+ThreadPool::ThreadPool(int nThreads): mbFinish(false)
+{
+    mvThreads.reserve(nThreads);
+    for(int i=0; i<nThreads; i++)
+        mvThreads.push_back(std::thread(&ThreadPool::Run,this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutexTasks);
+        mbFinish = true;
+    }
+    mcvTasks.notify_all();
+
+    for(size_t i=0; i<mvThreads.size(); i++)
+        mvThreads[i].join();
+}
+
+ThreadPool* ThreadPool::Global()
+{
+    static ThreadPool pool(std::max(1,(int)std::thread::hardware_concurrency()-1));
+    return &pool;
+}
+
+void ThreadPool::Run()
+{
+    Profiler::SetThreadName("Thread Pool");
+
+    while(1)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutexTasks);
+            mcvTasks.wait(lock, [this]{return mbFinish || !mlTasks.empty();});
+            if(mlTasks.empty())
+                return;
+
+            task = std::move(mlTasks.front());
+            mlTasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(int n, const std::function<void(int)> &f)
+{
+    if(n<=0)
+        return;
+
+    if(n==1 || mvThreads.empty())
+    {
+        for(int i=0; i<n; i++)
+            f(i);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> pState = std::make_shared<ParallelForState>(n,&f);
+
+    // The caller takes one share of the work
+    const int nHelpers = std::min(n-1,(int)mvThreads.size());
+    {
+        std::unique_lock<std::mutex> lock(mMutexTasks);
+        for(int i=0; i<nHelpers; i++)
+            mlTasks.push_back([pState]{pState->Work(true);});
+    }
+    if(nHelpers==1)
+        mcvTasks.notify_one();
+    else
+        mcvTasks.notify_all();
+
+    pState->Work(false);
+
+    std::unique_lock<std::mutex> lock(pState->mMutexDone);
+    pState->mcvDone.wait(lock, [&pState]{return pState->nDone == pState->nIterations;});
+
+    AllocationCounter::AddThreadAllocations(pState->nHelperAllocations);
+}
+
+} //namespace ORB_SLAM
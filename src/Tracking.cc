@@ -32,10 +32,14 @@
 
 #include"Optimizer.h"
 #include"PnPsolver.h"
+#include"ThreadPool.h"
+#include"Profiler.h"
 
 #include<iostream>
 
 #include<mutex>
+#include<atomic>
+#include<cassert>
 
 
 using namespace std;
@@ -47,7 +51,10 @@ Tracking::Tracking(System *pSys, ORBVocabulary* pVoc, FrameDrawer *pFrameDrawer,
     mState(NO_IMAGES_YET), mSensor(sensor), mbOnlyTracking(false), mbVO(false), mpORBVocabulary(pVoc),
     mpKeyFrameDB(pKFDB), mpInitializer(static_cast<Initializer*>(NULL)), mpSystem(pSys),
     mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpMap(pMap), mnLastRelocFrameId(0),
-    mbLoopClose(true) // mbLoopClose() added by @itzsid
+    mbLostSinceSet(false), mnLostSinceFrameId(0), mdTimeToRelocalize(-1.0), mnFramesToRelocalize(-1),
+    mdLastRelocalizationTime(0.0), mnRefusedKeyFrames(0), mbWaitingInitialization(true), mnResetCount(0),
+    mbLoopClose(true), // mbLoopClose() added by @itzsid
+    mnAllocationsLastFrame(0)
 {
     // Load camera parameters from settings file
 
@@ -183,74 +190,27 @@ void Tracking::SetViewer(Viewer *pViewer)
 
 cv::Mat Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp)
 {
-    mImGray = imRectLeft;
-    cv::Mat imGrayRight = imRectRight;
+    const unsigned long nAllocations = AllocationCounter::ThreadAllocations();
 
-    if(mImGray.channels()==3)
-    {
-        if(mbRGB)
-        {
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_RGB2GRAY);
-        }
-        else
-        {
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_BGR2GRAY);
-        }
-    }
-    else if(mImGray.channels()==4)
-    {
-        if(mbRGB)
-        {
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_RGBA2GRAY);
-        }
-        else
-        {
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
-            cvtColor(imGrayRight,imGrayRight,CV_BGRA2GRAY);
-        }
-    }
-
-    mCurrentFrame = Frame(mImGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    PrepareFrame(imRectLeft,imRectRight,timestamp,gtsam::Symbol('x', 999999),mCurrentFrame,mImGray);
 
     Track();
 
+    mnAllocationsLastFrame = AllocationCounter::ThreadAllocations()-nAllocations;
+
     return mCurrentFrame.mTcw.clone();
 }
 
 
 cv::Mat Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const double &timestamp, gtsam::Key key)
 {
-    mImGray = imRGB;
-    cv::Mat imDepth = imD;
+    const unsigned long nAllocations = AllocationCounter::ThreadAllocations();
 
-    if(mImGray.channels()==3)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
-        else
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
-    }
-    else if(mImGray.channels()==4)
-    {
-        if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
-        else
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
-    }
-
-    if((fabs(mDepthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
-        imDepth.convertTo(imDepth,CV_32F,mDepthMapFactor);
+    PrepareFrame(imRGB,imD,timestamp,key,mCurrentFrame,mImGray);
 
-    mCurrentFrame = Frame(mImGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth, key);
-    clock_t start = clock(); // Clock
-    double duration;
     Track();
-    duration = (clock() - start)/(double)CLOCKS_PER_SEC;
-    //std::cout << "Track() took: " << duration << " seconds" << std::endl;
 
+    mnAllocationsLastFrame = AllocationCounter::ThreadAllocations()-nAllocations;
 
     return mCurrentFrame.mTcw.clone();
 }
@@ -258,35 +218,95 @@ cv::Mat Tracking::GrabImageRGBD(const cv::Mat &imRGB,const cv::Mat &imD, const d
 
 cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp)
 {
-    mImGray = im;
+    const unsigned long nAllocations = AllocationCounter::ThreadAllocations();
+
+    PrepareFrame(im,cv::Mat(),timestamp,gtsam::Symbol('x', 999999),mCurrentFrame,mImGray);
+
+    Track();
 
-    if(mImGray.channels()==3)
+    mnAllocationsLastFrame = AllocationCounter::ThreadAllocations()-nAllocations;
+
+    return mCurrentFrame.mTcw.clone();
+}
+
+void Tracking::ConvertToGray(cv::Mat &im)
+{
+    if(im.channels()==3)
     {
         if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGB2GRAY);
+            cvtColor(im,im,CV_RGB2GRAY);
         else
-            cvtColor(mImGray,mImGray,CV_BGR2GRAY);
+            cvtColor(im,im,CV_BGR2GRAY);
     }
-    else if(mImGray.channels()==4)
+    else if(im.channels()==4)
     {
         if(mbRGB)
-            cvtColor(mImGray,mImGray,CV_RGBA2GRAY);
+            cvtColor(im,im,CV_RGBA2GRAY);
         else
-            cvtColor(mImGray,mImGray,CV_BGRA2GRAY);
+            cvtColor(im,im,CV_BGRA2GRAY);
     }
+}
+
+unsigned long Tracking::PrepareFrame(const cv::Mat &im1, const cv::Mat &im2, const double &timestamp, gtsam::Key key,
+                                     Frame &frame, cv::Mat &imGray)
+{
+    imGray = im1;
+    ConvertToGray(imGray);
+
+    // The extractor depends on the state reset by Reset()
+    unique_lock<mutex> lock(mMutexPrepareFrame);
 
-    if(mState==NOT_INITIALIZED || mState==NO_IMAGES_YET)
-        mCurrentFrame = Frame(mImGray,timestamp,mpIniORBextractor,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    if(mSensor==System::STEREO)
+    {
+        cv::Mat imGrayRight = im2;
+        ConvertToGray(imGrayRight);
+        frame.CreateStereo(imGray,imGrayRight,timestamp,mpORBextractorLeft,mpORBextractorRight,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    }
+    else if(mSensor==System::RGBD)
+    {
+        cv::Mat imDepth = im2;
+        if((fabs(mDepthMapFactor-1.0f)>1e-5) || imDepth.type()!=CV_32F)
+            imDepth.convertTo(imDepth,CV_32F,mDepthMapFactor);
+        frame.CreateRGBD(imGray,imDepth,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth,key);
+    }
     else
-        mCurrentFrame = Frame(mImGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    {
+        // More features until the map is initialized
+        if(mbWaitingInitialization)
+            frame.CreateMonocular(imGray,timestamp,mpIniORBextractor,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+        else
+            frame.CreateMonocular(imGray,timestamp,mpORBextractorLeft,mpORBVocabulary,mK,mDistCoef,mbf,mThDepth);
+    }
+
+    return mnResetCount;
+}
+
+unsigned long Tracking::GetResetCount()
+{
+    unique_lock<mutex> lock(mMutexPrepareFrame);
+    return mnResetCount;
+}
+
+cv::Mat Tracking::TrackFrame(const Frame &frame, const cv::Mat &imGray)
+{
+    const unsigned long nAllocations = AllocationCounter::ThreadAllocations();
+
+    mImGray = imGray;
+    mCurrentFrame = frame;
+    mCurrentFrame.mnId = Frame::nNextId++;
 
     Track();
 
+    mnAllocationsLastFrame = AllocationCounter::ThreadAllocations()-nAllocations;
+
     return mCurrentFrame.mTcw.clone();
 }
 
 void Tracking::Track()
 {
+    ScopedTimer timer(Profiler::TRACK);
+    Profiler::Count(Profiler::FRAMES);
+
     if(mState==NO_IMAGES_YET)
     {
         mState = NOT_INITIALIZED;
@@ -308,6 +328,8 @@ void Tracking::Track()
 
         if(mState!=OK)
             return;
+
+        mbWaitingInitialization = false;
     }
     else
     {
@@ -503,7 +525,7 @@ void Tracking::Track()
         if(!mCurrentFrame.mpReferenceKF)
             mCurrentFrame.mpReferenceKF = mpReferenceKF;
 
-        mLastFrame = Frame(mCurrentFrame);
+        mLastFrame.CopyFrom(mCurrentFrame);
     }
 
     // Store frame pose information to retrieve the complete camera trajectory afterwards.
@@ -566,10 +588,8 @@ void Tracking::Track()
     std::advance(it, index-1);
     KeyFrame* kF = *it;
 
-    // Check if connections are found yet or not
-    while(kF->mnId!=0 && kF->mbFirstConnection){
-        usleep(1000);
-      }
+    // Wait until Local Mapping has found its connections
+    kF->WaitUntilConnected();
 
     vector<KeyFrame* > covisibleKFs = kF->GetVectorCovisibleKeyFrames();
     covisibleKFs.push_back(kF); // push this keyframe too
@@ -600,6 +620,8 @@ void Tracking::Track()
 
 void Tracking::StereoInitialization()
 {
+    ScopedTimer timer(Profiler::TRACK_INITIALIZATION);
+
     if(mCurrentFrame.N>500)
     {
         // Set Frame pose to the origin
@@ -631,9 +653,14 @@ void Tracking::StereoInitialization()
 
         cout << "New map created with " << mpMap->MapPointsInMap() << " points" << endl;
 
-        mpLocalMapper->InsertKeyFrame(pKFini);
+        if(!mpLocalMapper->InsertKeyFrame(pKFini))
+        {
+            cout << "Local Mapping queue full, reseting..." << endl;
+            Reset();
+            return;
+        }
 
-        mLastFrame = Frame(mCurrentFrame);
+        mLastFrame.CopyFrom(mCurrentFrame);
         mnLastKeyFrameId=mCurrentFrame.mnId;
         mpLastKeyFrame = pKFini;
 
@@ -685,9 +712,14 @@ void Tracking::StereoInitialization(cv::Mat startingPose)
 
         cout << "New map created with " << mpMap->MapPointsInMap() << " points" << endl;
 
-        mpLocalMapper->InsertKeyFrame(pKFini);
+        if(!mpLocalMapper->InsertKeyFrame(pKFini))
+        {
+            cout << "Local Mapping queue full, reseting..." << endl;
+            Reset();
+            return;
+        }
 
-        mLastFrame = Frame(mCurrentFrame);
+        mLastFrame.CopyFrom(mCurrentFrame);
         mnLastKeyFrameId=mCurrentFrame.mnId;
         mpLastKeyFrame = pKFini;
 
@@ -708,14 +740,15 @@ void Tracking::StereoInitialization(cv::Mat startingPose)
 
 void Tracking::MonocularInitialization()
 {
+    ScopedTimer timer(Profiler::TRACK_INITIALIZATION);
 
     if(!mpInitializer)
     {
         // Set Reference Frame
         if(mCurrentFrame.mvKeys.size()>100)
         {
-            mInitialFrame = Frame(mCurrentFrame);
-            mLastFrame = Frame(mCurrentFrame);
+            mInitialFrame.CopyFrom(mCurrentFrame);
+            mLastFrame.CopyFrom(mCurrentFrame);
             mvbPrevMatched.resize(mCurrentFrame.mvKeysUn.size());
             for(size_t i=0; i<mCurrentFrame.mvKeysUn.size(); i++)
                 mvbPrevMatched[i]=mCurrentFrame.mvKeysUn[i].pt;
@@ -858,8 +891,12 @@ void Tracking::CreateInitialMapMonocular()
         }
     }
 
-    mpLocalMapper->InsertKeyFrame(pKFini);
-    mpLocalMapper->InsertKeyFrame(pKFcur);
+    if(!mpLocalMapper->InsertKeyFrame(pKFini) || !mpLocalMapper->InsertKeyFrame(pKFcur))
+    {
+        cout << "Local Mapping queue full, reseting..." << endl;
+        Reset();
+        return;
+    }
 
     mCurrentFrame.SetPose(pKFcur->GetPose());
     mnLastKeyFrameId=mCurrentFrame.mnId;
@@ -871,7 +908,7 @@ void Tracking::CreateInitialMapMonocular()
     mpReferenceKF = pKFcur;
     mCurrentFrame.mpReferenceKF = pKFcur;
 
-    mLastFrame = Frame(mCurrentFrame);
+    mLastFrame.CopyFrom(mCurrentFrame);
 
     mpMap->SetReferenceMapPoints(mvpLocalMapPoints);
 
@@ -902,6 +939,8 @@ void Tracking::CheckReplacedInLastFrame()
 
 bool Tracking::TrackReferenceKeyFrame()
 {
+    ScopedTimer timer(Profiler::TRACK_REFERENCE_KF);
+
     // Compute Bag of Words vector
     mCurrentFrame.ComputeBoW();
 
@@ -1012,6 +1051,8 @@ void Tracking::UpdateLastFrame()
 
 bool Tracking::TrackWithMotionModel()
 {
+    ScopedTimer timer(Profiler::TRACK_MOTION_MODEL);
+
     ORBmatcher matcher(0.9,true);
 
     // Update last frame pose according to its reference keyframe
@@ -1075,6 +1116,8 @@ bool Tracking::TrackWithMotionModel()
 
 bool Tracking::TrackLocalMap()
 {
+    ScopedTimer timer(Profiler::TRACK_LOCAL_MAP);
+
     // We have an estimation of the camera pose and some map points tracked in the frame.
     // We retrieve the local map and try to find matches to points in the local map.
 
@@ -1183,24 +1226,26 @@ bool Tracking::NeedNewKeyFrame()
     if((c1a||c1b||c1c)&&c2)
     {
         // If the mapping accepts keyframes, insert keyframe.
-        // Otherwise send a signal to interrupt BA
-        if(bLocalMappingIdle)
+        // Otherwise send a signal to interrupt BA, and only stereo/RGB-D insert
+        if(!bLocalMappingIdle)
         {
-            return true;
+            mpLocalMapper->InterruptBA();
+            if(mSensor==System::MONOCULAR)
+                return false;
         }
-        else
+
+        // Backpressure: the queue to Local Mapping is bounded. When it is full the keyframe
+        // is refused and tracking continues against the current reference keyframe.
+        // Tracking is its only producer, so a keyframe accepted here fits in the queue.
+        if(mpLocalMapper->KeyFrameQueueFull())
         {
             mpLocalMapper->InterruptBA();
-            if(mSensor!=System::MONOCULAR)
-            {
-                if(mpLocalMapper->KeyframesInQueue()<3)
-                    return true;
-                else
-                    return false;
-            }
-            else
-                return false;
+            mnRefusedKeyFrames++;
+            Profiler::Count(Profiler::KEYFRAMES_REFUSED);
+            return false;
         }
+
+        return true;
     }
     else
         return false;
@@ -1208,6 +1253,8 @@ bool Tracking::NeedNewKeyFrame()
 
 void Tracking::CreateNewKeyFrame()
 {
+    ScopedTimer timer(Profiler::TRACK_NEW_KEYFRAME);
+
     if(!mpLocalMapper->SetNotStop(true))
         return;
 
@@ -1278,7 +1325,11 @@ void Tracking::CreateNewKeyFrame()
         }
     }
 
-    mpLocalMapper->InsertKeyFrame(pKF);
+    // NeedNewKeyFrame checked that the queue had room, and Tracking is its only producer
+    const bool bInserted = mpLocalMapper->InsertKeyFrame(pKF);
+    assert(bInserted);
+    (void)bInserted;
+    Profiler::Count(Profiler::KEYFRAMES_CREATED);
 
     mpLocalMapper->SetNotStop(false);
 
@@ -1385,8 +1436,8 @@ void Tracking::UpdateLocalKeyFrames()
             MapPoint* pMP = mCurrentFrame.mvpMapPoints[i];
             if(!pMP->isBad())
             {
-                const map<KeyFrame*,size_t> observations = pMP->GetObservations();
-                for(map<KeyFrame*,size_t>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
+                const MapPoint::ObservationsPtr observations = pMP->GetObservations();
+                for(MapPointObservations::const_iterator it=observations->begin(), itend=observations->end(); it!=itend; it++)
                     keyframeCounter[it->first]++;
             }
             else
@@ -1486,6 +1537,16 @@ void Tracking::UpdateLocalKeyFrames()
 
 bool Tracking::Relocalization()
 {
+    ScopedTimer timer(Profiler::TRACK_RELOCALIZATION);
+
+    const chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+    if(mState==LOST && !mbLostSinceSet)
+    {
+        mbLostSinceSet = true;
+        mtLostSince = tStart;
+        mnLostSinceFrameId = mCurrentFrame.mnId;
+    }
+
     // Compute Bag of Words Vector
     mCurrentFrame.ComputeBoW();
 
@@ -1494,159 +1555,178 @@ bool Tracking::Relocalization()
     vector<KeyFrame*> vpCandidateKFs = mpKeyFrameDB->DetectRelocalizationCandidates(&mCurrentFrame);
 
     if(vpCandidateKFs.empty())
+    {
+        UpdateRelocalizationMetrics(tStart,false);
         return false;
+    }
 
     const int nKFs = vpCandidateKFs.size();
 
-    // We perform first an ORB matching with each candidate
+    // We perform first an ORB matching with each candidate, in parallel
     // If enough matches are found we setup a PnP solver
-    ORBmatcher matcher(0.75,true);
-
-    vector<PnPsolver*> vpPnPsolvers;
-    vpPnPsolvers.resize(nKFs);
-
-    vector<vector<MapPoint*> > vvpMapPointMatches;
-    vvpMapPointMatches.resize(nKFs);
+    vector<PnPsolver*> vpPnPsolvers(nKFs,static_cast<PnPsolver*>(NULL));
+    vector<vector<MapPoint*> > vvpMapPointMatches(nKFs);
 
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nKFs);
-
-    int nCandidates=0;
-
-    for(int i=0; i<nKFs; i++)
+    ThreadPool::Global()->ParallelFor(nKFs, [&](int i)
     {
         KeyFrame* pKF = vpCandidateKFs[i];
         if(pKF->isBad())
-            vbDiscarded[i] = true;
-        else
-        {
-            int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
-            if(nmatches<15)
-            {
-                vbDiscarded[i] = true;
-                continue;
-            }
-            else
-            {
-                PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
-                pSolver->SetRansacParameters(0.99,10,300,4,0.5,5.991);
-                vpPnPsolvers[i] = pSolver;
-                nCandidates++;
-            }
-        }
-    }
+            return;
 
-    // Alternatively perform some iterations of P4P RANSAC
-    // Until we found a camera pose supported by enough inliers
-    bool bMatch = false;
-    ORBmatcher matcher2(0.9,true);
+        ORBmatcher matcher(0.75,true);
+        int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
+        if(nmatches<15)
+            return;
 
-    while(nCandidates>0 && !bMatch)
+        PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
+        pSolver->SetRansacParameters(0.99,10,300,4,0.5,5.991);
+        vpPnPsolvers[i] = pSolver;
+    });
+
+    vector<int> vCandidates;
+    vCandidates.reserve(nKFs);
+    for(int i=0; i<nKFs; i++)
+        if(vpPnPsolvers[i])
+            vCandidates.push_back(i);
+
+    // Perform P4P RANSAC on all the candidates at the same time, 5 iterations at a time,
+    // until one of them finds a camera pose supported by enough inliers.
+    // Each hypothesis is verified on its own copy of the frame, the winner is copied back.
+    atomic<bool> bMatch(false);
+    mutex mutexMatch;
+    cv::Mat bestTcw;
+    vector<MapPoint*> vpBestMapPoints;
+    vector<bool> vbBestOutliers;
+
+    ThreadPool::Global()->ParallelFor(vCandidates.size(), [&](int k)
     {
-        for(int i=0; i<nKFs; i++)
-        {
-            if(vbDiscarded[i])
-                continue;
+        const int i = vCandidates[k];
+        PnPsolver* pSolver = vpPnPsolvers[i];
+        ORBmatcher matcher2(0.9,true);
+        Frame frame;
 
+        bool bNoMore = false;
+        while(!bNoMore && !bMatch)
+        {
             // Perform 5 Ransac Iterations
+            // If Ransac reachs max. iterations the keyframe is discarded
             vector<bool> vbInliers;
             int nInliers;
-            bool bNoMore;
-
-            PnPsolver* pSolver = vpPnPsolvers[i];
             cv::Mat Tcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers);
 
-            // If Ransac reachs max. iterations discard keyframe
-            if(bNoMore)
-            {
-                vbDiscarded[i]=true;
-                nCandidates--;
-            }
-
             // If a Camera Pose is computed, optimize
-            if(!Tcw.empty())
-            {
-                Tcw.copyTo(mCurrentFrame.mTcw);
+            if(Tcw.empty())
+                continue;
+
+            frame.CopyFrom(mCurrentFrame);
+            Tcw.copyTo(frame.mTcw);
 
-                set<MapPoint*> sFound;
+            set<MapPoint*> sFound;
 
-                const int np = vbInliers.size();
+            const int np = vbInliers.size();
 
-                for(int j=0; j<np; j++)
+            for(int j=0; j<np; j++)
+            {
+                if(vbInliers[j])
                 {
-                    if(vbInliers[j])
-                    {
-                        mCurrentFrame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
-                        sFound.insert(vvpMapPointMatches[i][j]);
-                    }
-                    else
-                        mCurrentFrame.mvpMapPoints[j]=NULL;
+                    frame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
+                    sFound.insert(vvpMapPointMatches[i][j]);
                 }
+                else
+                    frame.mvpMapPoints[j]=NULL;
+            }
 
-                int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+            int nGood = Optimizer::PoseOptimization(&frame);
 
-                if(nGood<10)
-                    continue;
+            if(nGood<10)
+                continue;
 
-                for(int io =0; io<mCurrentFrame.N; io++)
-                    if(mCurrentFrame.mvbOutlier[io])
-                        mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+            for(int io =0; io<frame.N; io++)
+                if(frame.mvbOutlier[io])
+                    frame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
 
-                // If few inliers, search by projection in a coarse window and optimize again
-                if(nGood<50)
+            // If few inliers, search by projection in a coarse window and optimize again
+            if(nGood<50)
+            {
+                int nadditional =matcher2.SearchByProjection(frame,vpCandidateKFs[i],sFound,10,100);
+
+                if(nadditional+nGood>=50)
                 {
-                    int nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,10,100);
+                    nGood = Optimizer::PoseOptimization(&frame);
 
-                    if(nadditional+nGood>=50)
+                    // If many inliers but still not enough, search by projection again in a narrower window
+                    // the camera has been already optimized with many points
+                    if(nGood>30 && nGood<50)
                     {
-                        nGood = Optimizer::PoseOptimization(&mCurrentFrame);
-
-                        // If many inliers but still not enough, search by projection again in a narrower window
-                        // the camera has been already optimized with many points
-                        if(nGood>30 && nGood<50)
+                        sFound.clear();
+                        for(int ip =0; ip<frame.N; ip++)
+                            if(frame.mvpMapPoints[ip])
+                                sFound.insert(frame.mvpMapPoints[ip]);
+                        nadditional =matcher2.SearchByProjection(frame,vpCandidateKFs[i],sFound,3,64);
+
+                        // Final optimization
+                        if(nGood+nadditional>=50)
                         {
-                            sFound.clear();
-                            for(int ip =0; ip<mCurrentFrame.N; ip++)
-                                if(mCurrentFrame.mvpMapPoints[ip])
-                                    sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
-                            nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,3,64);
-
-                            // Final optimization
-                            if(nGood+nadditional>=50)
-                            {
-                                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                            nGood = Optimizer::PoseOptimization(&frame);
 
-                                for(int io =0; io<mCurrentFrame.N; io++)
-                                    if(mCurrentFrame.mvbOutlier[io])
-                                        mCurrentFrame.mvpMapPoints[io]=NULL;
-                            }
+                            for(int io =0; io<frame.N; io++)
+                                if(frame.mvbOutlier[io])
+                                    frame.mvpMapPoints[io]=NULL;
                         }
                     }
                 }
+            }
 
-
-                // If the pose is supported by enough inliers stop ransacs and continue
-                if(nGood>=50)
+            // If the pose is supported by enough inliers stop ransacs and continue
+            if(nGood>=50)
+            {
+                unique_lock<mutex> lock(mutexMatch);
+                if(!bMatch)
                 {
                     bMatch = true;
-                    break;
+                    bestTcw = frame.mTcw.clone();
+                    vpBestMapPoints = frame.mvpMapPoints;
+                    vbBestOutliers = frame.mvbOutlier;
                 }
+                return;
             }
         }
-    }
+    });
+
+    for(int i=0; i<nKFs; i++)
+        delete vpPnPsolvers[i];
 
     if(!bMatch)
     {
+        UpdateRelocalizationMetrics(tStart,false);
         return false;
     }
     else
     {
+        mCurrentFrame.SetPose(bestTcw);
+        mCurrentFrame.mvpMapPoints = vpBestMapPoints;
+        mCurrentFrame.mvbOutlier = vbBestOutliers;
+
         mnLastRelocFrameId = mCurrentFrame.mnId;
+        UpdateRelocalizationMetrics(tStart,true);
         return true;
     }
 
 }
 
+void Tracking::UpdateRelocalizationMetrics(const chrono::steady_clock::time_point &tStart, bool bRelocalized)
+{
+    const chrono::steady_clock::time_point tEnd = chrono::steady_clock::now();
+    mdLastRelocalizationTime = chrono::duration_cast<chrono::duration<double> >(tEnd-tStart).count();
+
+    if(bRelocalized && mbLostSinceSet)
+    {
+        mdTimeToRelocalize = chrono::duration_cast<chrono::duration<double> >(tEnd-mtLostSince).count();
+        mnFramesToRelocalize = mCurrentFrame.mnId-mnLostSinceFrameId;
+        mbLostSinceSet = false;
+    }
+}
+
 void Tracking::Reset()
 {
     mpViewer->RequestStop();
@@ -1686,9 +1766,18 @@ void Tracking::Reset()
     // Clear Map (this erase MapPoints and KeyFrames)
     mpMap->clear();
 
+    if(mbLoopCloseInterRobot)
+      mpLoopClosingInterRobot->FinishReset();
+
     KeyFrame::nNextId = 0;
     Frame::nNextId = 0;
+    {
+        unique_lock<mutex> lock(mMutexPrepareFrame);
+        mbWaitingInitialization = true;
+        mnResetCount++;
+    }
     mState = NO_IMAGES_YET;
+    mbLostSinceSet = false;
 
     if(mpInitializer)
     {
@@ -1736,9 +1825,18 @@ void Tracking::ResetAndInitialize(cv::Mat startingPose)
     // Clear Map (this erase MapPoints and KeyFrames)
     mpMap->clear();
 
+    if(mbLoopCloseInterRobot)
+      mpLoopClosingInterRobot->FinishReset();
+
     KeyFrame::nNextId = 0;
     Frame::nNextId = 0;
+    {
+        unique_lock<mutex> lock(mMutexPrepareFrame);
+        mbWaitingInitialization = true;
+        mnResetCount++;
+    }
     mState = NO_IMAGES_YET;
+    mbLostSinceSet = false;
 
     if(mpInitializer)
     {
@@ -0,0 +1,159 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TrackingPipeline.h"
+#include "Tracking.h"
+#include "Profiler.h"
+
+
+namespace ORB_SLAM2
+{
+
+TrackingPipeline::TrackingPipeline(Tracking* pTracker, const std::function<void()> &beforeTrack, int nDepth):
+    mpTracker(pTracker), mBeforeTrack(beforeTrack), mnDepth(std::max(nDepth,1)), mnInFlight(0),
+    mvPreparedFrames(mnDepth), mqInput(mnDepth), mqPrepared(mnDepth), mqFree(mnDepth), mqResults(mnDepth),
+    mbStop(false)
+{
+    for(int i=0; i<mnDepth; i++)
+        mqFree.Push(&mvPreparedFrames[i]);
+
+    mtPrepare = std::thread(&TrackingPipeline::RunPrepare,this);
+    mtTrack = std::thread(&TrackingPipeline::RunTrack,this);
+}
+
+TrackingPipeline::~TrackingPipeline()
+{
+    Result result;
+    while(Wait(result));
+
+    mbStop = true;
+    mPrepareSignal.Notify();
+    mTrackSignal.Notify();
+    mtPrepare.join();
+    mtTrack.join();
+}
+
+bool TrackingPipeline::Submit(const cv::Mat &im1, const cv::Mat &im2, const double &timestamp, gtsam::Key key)
+{
+    if(mnInFlight>=mnDepth)
+        return false;
+
+    Input input;
+    input.im1 = im1;
+    input.im2 = im2;
+    input.timestamp = timestamp;
+    input.key = key;
+
+    // Cannot fail, there are at most nDepth frames in the pipeline
+    mqInput.Push(input);
+    mnInFlight++;
+    mPrepareSignal.Notify();
+    return true;
+}
+
+bool TrackingPipeline::Poll(Result &result)
+{
+    if(!mqResults.Pop(result))
+        return false;
+
+    mnInFlight--;
+    return true;
+}
+
+bool TrackingPipeline::Wait(Result &result)
+{
+    if(mnInFlight==0)
+        return false;
+
+    mResultSignal.WaitUntil([this]{return !mqResults.Empty();});
+    return Poll(result);
+}
+
+int TrackingPipeline::FramesInFlight()
+{
+    return mnInFlight;
+}
+
+void TrackingPipeline::RunPrepare()
+{
+    Profiler::SetThreadName("Frame Preparation");
+
+    while(!mbStop)
+    {
+        // A free frame is always available for a submitted input, since both are bounded by nDepth
+        if(mqInput.Empty() || mqFree.Empty())
+        {
+            mPrepareSignal.Wait();
+            continue;
+        }
+
+        Input input;
+        PreparedFrame* pFrame;
+        mqInput.Pop(input);
+        mqFree.Pop(pFrame);
+
+        pFrame->input = input;
+        pFrame->nResetCount = mpTracker->PrepareFrame(input.im1,input.im2,input.timestamp,input.key,pFrame->frame,pFrame->imGray);
+
+        mqPrepared.Push(pFrame);
+        mTrackSignal.Notify();
+    }
+}
+
+void TrackingPipeline::RunTrack()
+{
+    Profiler::SetThreadName("Tracking");
+
+    while(!mbStop)
+    {
+        PreparedFrame* pFrame;
+        if(!mqPrepared.Pop(pFrame))
+        {
+            mTrackSignal.Wait();
+            continue;
+        }
+
+        mBeforeTrack();
+
+        // The tracker was reset after the frame was prepared, with the state it was built from
+        if(pFrame->nResetCount!=mpTracker->GetResetCount())
+        {
+            const Input &input = pFrame->input;
+            pFrame->nResetCount = mpTracker->PrepareFrame(input.im1,input.im2,input.timestamp,input.key,pFrame->frame,pFrame->imGray);
+        }
+
+        Result result;
+        result.timestamp = pFrame->frame.mTimeStamp;
+        result.Tcw = mpTracker->TrackFrame(pFrame->frame,pFrame->imGray);
+        result.nState = mpTracker->mState;
+
+        // Release the images before handing the buffers back
+        pFrame->imGray.release();
+        pFrame->input.im1.release();
+        pFrame->input.im2.release();
+        mqFree.Push(pFrame);
+        mPrepareSignal.Notify();
+
+        mqResults.Push(result);
+        mResultSignal.Notify();
+    }
+}
+
+} //namespace ORB_SLAM
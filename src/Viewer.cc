@@ -154,10 +154,7 @@ void Viewer::Run()
 
         if(Stop())
         {
-            while(isStopped())
-            {
-                usleep(3000);
-            }
+            mSignal.WaitUntil([this]{return !isStopped();});
         }
 
         if(CheckFinish())
@@ -181,8 +178,11 @@ bool Viewer::CheckFinish()
 
 void Viewer::SetFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinished = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinished = true;
+    }
+    mSignal.Notify();
 }
 
 bool Viewer::isFinished()
@@ -191,6 +191,11 @@ bool Viewer::isFinished()
     return mbFinished;
 }
 
+void Viewer::WaitUntilFinished()
+{
+    mSignal.WaitUntil([this]{return isFinished();});
+}
+
 void Viewer::RequestStop()
 {
     unique_lock<mutex> lock(mMutexStop);
@@ -224,8 +229,11 @@ bool Viewer::Stop()
 
 void Viewer::Release()
 {
-    unique_lock<mutex> lock(mMutexStop);
-    mbStopped = false;
+    {
+        unique_lock<mutex> lock(mMutexStop);
+        mbStopped = false;
+    }
+    mSignal.Notify();
 }
 
 }
@@ -0,0 +1,101 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WorkSignal.h"
+
+#include <algorithm>
+
+namespace ORB_SLAM2
+{
+
+namespace
+{
+
+double Seconds(const std::chrono::steady_clock::time_point &t1, const std::chrono::steady_clock::time_point &t2)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double> >(t2-t1).count();
+}
+
+}
+
+WorkSignal::WorkSignal(): mnSequence(0), mbPending(false)
+{
+}
+
+void WorkSignal::Notify()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mnSequence++;
+        if(!mbPending)
+        {
+            mbPending = true;
+            mtPending = std::chrono::steady_clock::now();
+        }
+    }
+    mcv.notify_all();
+}
+
+bool WorkSignal::Wait(double timeout)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    const std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+    if(timeout<0)
+        mcv.wait(lock, [this]{return mbPending;});
+    else
+        mcv.wait_for(lock, std::chrono::duration<double>(timeout), [this]{return mbPending;});
+
+    const std::chrono::steady_clock::time_point tEnd = std::chrono::steady_clock::now();
+    mStats.dTotalIdle += Seconds(tStart,tEnd);
+
+    if(!mbPending)
+        return false;
+
+    mbPending = false;
+
+    const double dQueueWait = Seconds(mtPending,tEnd);
+    mStats.nWakeups++;
+    mStats.dTotalQueueWait += dQueueWait;
+    mStats.dMaxQueueWait = std::max(mStats.dMaxQueueWait,dQueueWait);
+
+    return true;
+}
+
+WorkSignal::Stats WorkSignal::GetStats()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+unsigned long WorkSignal::GetSequence()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mnSequence;
+}
+
+void WorkSignal::WaitSequenceChange(unsigned long nSequence)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mcv.wait(lock, [this,nSequence]{return mnSequence!=nSequence;});
+}
+
+} //namespace ORB_SLAM